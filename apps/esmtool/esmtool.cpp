@@ -52,6 +52,7 @@ struct Arguments
     unsigned int quiet_given;
     unsigned int loadcells_given;
     bool plain_given;
+    bool mmap_given;
 
     std::string mode;
     std::string encoding;
@@ -83,6 +84,8 @@ bool parseOptions (int argc, char** argv, Arguments &info)
          "Only affects dump mode.")
         ("quiet,q", "Supress all record information. Useful for speed tests.")
         ("loadcells,C", "Browse through contents of all cells.")
+        ("mmap,M", "Memory map the input file instead of streaming it. "
+         "Combine with --quiet to compare load times.")
 
         ( "encoding,e", bpo::value<std::string>(&(info.encoding))->
           default_value("win1252"),
@@ -181,6 +184,7 @@ bool parseOptions (int argc, char** argv, Arguments &info)
     info.quiet_given = variables.count ("quiet");
     info.loadcells_given = variables.count ("loadcells");
     info.plain_given = (variables.count("plain") > 0);
+    info.mmap_given = (variables.count("mmap") > 0);
 
     // Font encoding settings
     info.encoding = variables["encoding"].as<std::string>();
@@ -278,6 +282,7 @@ int load(Arguments& info)
     ESM::ESMReader& esm = info.reader;
     ToUTF8::Utf8Encoder encoder (ToUTF8::calculateEncoding(info.encoding));
     esm.setEncoder(&encoder);
+    esm.setMemoryMapped(info.mmap_given);
 
     std::string filename = info.filename;
     std::cout << "Loading file: " << filename << std::endl;
@@ -4,6 +4,7 @@
 
 #include <OgreRoot.h>
 #include <OgreRenderWindow.h>
+#include <OgreTimer.h>
 
 #include <MyGUI_WidgetManager.h>
 
@@ -48,18 +49,29 @@ void OMW::Engine::executeLocalScripts()
 {
     MWWorld::LocalScripts& localScripts = MWBase::Environment::get().getWorld()->getLocalScripts();
 
-    localScripts.startIteration();
+    localScripts.startIteration (mEnvironment.getFrameDuration());
+
+    unsigned long budget = static_cast<unsigned long> (localScripts.getBudget() * 1000000);
+    Ogre::Timer timer;
 
     while (!localScripts.isFinished())
     {
-        std::pair<std::string, MWWorld::Ptr> script = localScripts.getNext();
+        MWWorld::LocalScripts::Entry script = localScripts.getNext();
 
         MWScript::InterpreterContext interpreterContext (
-            &script.second.getRefData().getLocals(), script.second);
-        MWBase::Environment::get().getScriptManager()->run (script.first, interpreterContext);
+            &script.mPtr.getRefData().getLocals(), script.mPtr);
+
+        // deferred scripts get the time that has passed since they have been run the last time
+        if (budget)
+            interpreterContext.setSecondsPassed (script.mSecondsPassed);
+
+        MWBase::Environment::get().getScriptManager()->run (script.mSlot, interpreterContext);
 
         if (MWBase::Environment::get().getWorld()->hasCellChanged())
             break;
+
+        if (budget && timer.getMicroseconds()>budget)
+            localScripts.deferRemaining();
     }
 
     localScripts.setIgnore (MWWorld::Ptr());
@@ -176,36 +188,15 @@ OMW::Engine::~Engine()
 
 void OMW::Engine::loadBSA()
 {
-    // We use separate resource groups to handle location priority.
-    const Files::PathContainer& dataDirs = mFileCollections.getPaths();
-
-    int i=0;
-    for (Files::PathContainer::const_iterator iter = dataDirs.begin(); iter != dataDirs.end(); ++iter)
-    {
-        // Last data dir has the highest priority
-        std::string groupName = "Data" + Ogre::StringConverter::toString(dataDirs.size()-i, 8, '0');
-        Ogre::ResourceGroupManager::getSingleton ().createResourceGroup (groupName);
-
-        std::string dataDirectory = iter->string();
-        std::cout << "Data dir " << dataDirectory << std::endl;
-        Bsa::addDir(dataDirectory, mFSStrict, groupName);
-        ++i;
-    }
-
-    i=0;
+    // All data directories and archives are merged into one index. Later additions take
+    // precedence, so the archives go first and the last data dir has the highest priority.
     for (std::vector<std::string>::const_iterator archive = mArchives.begin(); archive != mArchives.end(); ++archive)
     {
         if (mFileCollections.doesExist(*archive))
         {
-            // Last BSA has the highest priority
-            std::string groupName = "DataBSA" + Ogre::StringConverter::toString(mArchives.size()-i, 8, '0');
-
-            Ogre::ResourceGroupManager::getSingleton ().createResourceGroup (groupName);
-
             const std::string archivePath = mFileCollections.getPath(*archive).string();
             std::cout << "Adding BSA archive " << archivePath << std::endl;
-            Bsa::addBSA(archivePath, groupName);
-            ++i;
+            Bsa::addBSA(archivePath);
         }
         else
         {
@@ -214,6 +205,18 @@ void OMW::Engine::loadBSA()
             throw std::runtime_error(message.str());
         }
     }
+
+    const Files::PathContainer& dataDirs = mFileCollections.getPaths();
+
+    for (Files::PathContainer::const_iterator iter = dataDirs.begin(); iter != dataDirs.end(); ++iter)
+    {
+        std::string dataDirectory = iter->string();
+        std::cout << "Data dir " << dataDirectory << std::endl;
+        Bsa::addDir(dataDirectory, mFSStrict);
+    }
+
+    Ogre::ResourceGroupManager::getSingleton ().createResourceGroup ("Data");
+    Bsa::registerResources("Data");
 }
 
 // add resources directory
@@ -407,8 +410,14 @@ void OMW::Engine::prepareEngine (Settings::Manager & settings)
     mScriptContext = new MWScript::CompilerContext (MWScript::CompilerContext::Type_Full);
     mScriptContext->setExtensions (&mExtensions);
 
+    // compiled scripts depend on the records of all content files
+    std::vector<boost::filesystem::path> contentPaths;
+    std::vector<ESM::ESMReader>& readers = MWBase::Environment::get().getWorld()->getEsmReader();
+    for (std::size_t i = 0; i < readers.size(); ++i)
+        contentPaths.push_back (readers[i].getContext().filename);
+
     mEnvironment.setScriptManager (new MWScript::ScriptManager (MWBase::Environment::get().getWorld()->getStore(),
-        mVerboseScripts, *mScriptContext));
+        mVerboseScripts, *mScriptContext, mCfgMgr.getCachePath(), mCfgMgr.getLogPath(), contentPaths));
 
     // Create game mechanics system
     MWMechanics::MechanicsManager* mechanics = new MWMechanics::MechanicsManager;
@@ -446,7 +455,7 @@ void OMW::Engine::prepareEngine (Settings::Manager & settings)
     mOgre->getRoot()->addFrameListener (this);
 
     // scripts
-    if (mCompileAll)
+    if (mCompileAll || Settings::Manager::getBool ("precompile scripts", "General"))
     {
         std::pair<int, int> result = MWBase::Environment::get().getScriptManager()->compileAll();
 
@@ -2,6 +2,7 @@
 #define GAME_MWBASE_SCRIPTMANAGER_H
 
 #include <string>
+#include <iosfwd>
 
 namespace Interpreter
 {
@@ -40,6 +41,25 @@ namespace MWBase
             virtual void run (const std::string& name, Interpreter::Context& interpreterContext) = 0;
             ///< Run the script with the given name (compile first, if not compiled yet)
 
+            virtual int getScriptSlot (const std::string& name) = 0;
+            ///< Return the slot of the script with the given name, which can be used to run it
+            /// without looking it up by name. The script does not have to be compiled yet.
+
+            virtual void run (int slot, Interpreter::Context& interpreterContext) = 0;
+            ///< Run the script in \a slot (compile first, if not compiled yet)
+
+            virtual bool isDeferrable (int slot) = 0;
+            ///< Does the script in \a slot only read the state of the game and change its own local
+            /// variables? (compile first, if not compiled yet)
+
+            virtual unsigned int getSideEffectCount() const = 0;
+            ///< Return how often scripts that are not deferrable have been run so far. As long as
+            /// it does not change, only local variables can have been changed by scripts.
+
+            virtual void addSideEffect() = 0;
+            ///< Note that a script that may have changed the state of the game has been run outside
+            /// of the script manager.
+
             virtual bool compile (const std::string& name) = 0;
             ///< Compile script with the given namen
             /// \return Success?
@@ -58,6 +78,12 @@ namespace MWBase
             ///< Return index of the variable of the given name and type in the given script. Will
             /// throw an exception, if there is no such script or variable or the type does not match.
 
+            virtual bool toggleProfiler() = 0;
+            ///< \return Is the profiler enabled now?
+
+            virtual void reportProfile (std::ostream& stream, std::size_t count) const = 0;
+            ///< Write the \a count scripts, references and instructions that took the most time
+            /// to \a stream.
     };
 }
 
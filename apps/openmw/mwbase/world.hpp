@@ -143,6 +143,14 @@ namespace MWBase
 
             virtual MWWorld::Globals::Data getGlobalVariable (const std::string& name) const = 0;
 
+            virtual MWWorld::Globals::Data& getGlobalVariable (int index) = 0;
+
+            virtual MWWorld::Globals::Data getGlobalVariable (int index) const = 0;
+
+            virtual int getGlobalVariableIndex (const std::string& name) const = 0;
+            ///< Return an index, that can be used instead of the name of the global variable, or -1,
+            /// if there is no global variable with this name.
+
             virtual char getGlobalVariableType (const std::string& name) const = 0;
             ///< Return ' ', if there is no global variable with this name.
 
@@ -262,6 +270,11 @@ namespace MWBase
             /// collisions and gravity.
             /// \return Resulting mode
 
+            virtual std::string benchmarkMovement (int frames, int copies) = 0;
+            ///< Move the actors of the last frame \a copies times over for \a frames frames, on
+            /// the main thread and on the movement threads, without changing the world.
+            /// \return Report of the timings
+
             virtual bool toggleRenderMode (RenderMode mode) = 0;
             ///< Toggle a render mode.
             ///< \return Resulting mode
@@ -364,6 +377,11 @@ namespace MWBase
             virtual bool getLOS(const MWWorld::Ptr& npc,const MWWorld::Ptr& targetNpc) = 0;
             ///< get Line of Sight (morrowind stupid implementation)
 
+            virtual void getLOS(const std::vector<std::pair<MWWorld::Ptr, MWWorld::Ptr> >& pairs,
+                std::vector<bool>& visible) = 0;
+            ///< Line of Sight for all \a pairs (npc, target) at once. \a visible[i] is the result
+            /// for \a pairs[i].
+
             virtual void enableActorCollision(const MWWorld::Ptr& actor, bool enable) = 0;
 
             virtual void setupExternalRendering (MWRender::ExternalRendering& rendering) = 0;
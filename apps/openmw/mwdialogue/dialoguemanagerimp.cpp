@@ -46,17 +46,31 @@
 namespace MWDialogue
 {
     DialogueManager::DialogueManager (const Compiler::Extensions& extensions, bool scriptVerbose, Translation::Storage& translationDataStorage) :
+      mInfoIndex (MWBase::Environment::get().getWorld()->getStore()),
       mCompilerContext (MWScript::CompilerContext::Type_Dialgoue),
         mErrorStream(std::cout.rdbuf()),mErrorHandler(mErrorStream)
       , mTemporaryDispositionChange(0.f)
       , mPermanentDispositionChange(0.f), mScriptVerbose (scriptVerbose)
       , mTranslationDataStorage(translationDataStorage)
       , mTalkedTo(false)
+      , mActorKnownTopicsValid(false)
+      , mSideEffects(0)
     {
         mChoice = -1;
         mIsInChoice = false;
         mCompilerContext.setExtensions (&extensions);
 
+        const std::vector<const InfoIndex::Dialogue *>& topics =
+            mInfoIndex.getDialogues (ESM::Dialogue::Topic);
+
+        for (std::size_t i = 0; i < topics.size(); ++i)
+        {
+            mTopics.push_back (Misc::StringUtils::lowerCase (topics[i]->mDialogue->mId));
+
+            if (!mTopics.back().empty())
+                mTopicSearch.seed (mTopics.back(), static_cast<int> (i));
+        }
+
         const MWWorld::Store<ESM::Dialogue> &dialogs =
             MWBase::Environment::get().getWorld()->getStore().get<ESM::Dialogue>();
 
@@ -97,25 +111,27 @@ namespace MWDialogue
             }
         }
 
+        updateActorKnownTopics();
+
         for (size_t i = 0; i < hypertext.size(); ++i)
         {
-            std::list<std::string>::iterator it;
-            for(it = mActorKnownTopics.begin(); it != mActorKnownTopics.end(); ++it)
+            if (hypertext[i].mLink)
             {
-                if (hypertext[i].mLink)
+                int topic;
+                if (mTopicSearch.containsKeyword (hypertext[i].mText, topic) && mActorKnownTopics[topic])
                 {
-                    if( hypertext[i].mText == *it )
-                    {
-                        mKnownTopics[hypertext[i].mText] = true;
-                    }
+                    mKnownTopics[mTopics[topic]] = true;
                 }
-                else if( !mTranslationDataStorage.hasTranslation() )
+            }
+            else if( !mTranslationDataStorage.hasTranslation() )
+            {
+                std::vector<TopicSearch::Match> matches;
+                mTopicSearch.searchAll (hypertext[i].mText.begin(), hypertext[i].mText.end(), matches);
+
+                for (std::vector<TopicSearch::Match>::const_iterator it = matches.begin(); it != matches.end(); ++it)
                 {
-                    size_t pos = Misc::StringUtils::lowerCase(hypertext[i].mText).find(*it, 0);
-                    if(pos !=std::string::npos)
-                    {
-                        mKnownTopics[*it] = true;
-                    }
+                    if (mActorKnownTopics[it->mValue])
+                        mKnownTopics[mTopics[it->mValue]] = true;
                 }
             }
         }
@@ -135,7 +151,7 @@ namespace MWDialogue
         MWMechanics::CreatureStats& creatureStats = MWWorld::Class::get (actor).getCreatureStats (actor);
         mTalkedTo = creatureStats.hasTalkedToPlayer();
 
-        mActorKnownTopics.clear();
+        invalidateActorKnownTopics();
 
         MWGui::DialogueWindow* win = MWBase::Environment::get().getWindowManager()->getDialogueWindow();
         win->startDialogue(actor, MWWorld::Class::get (actor).getName (actor));
@@ -144,36 +160,33 @@ namespace MWDialogue
         updateTopics();
 
         //greeting
-        const MWWorld::Store<ESM::Dialogue> &dialogs =
-            MWBase::Environment::get().getWorld()->getStore().get<ESM::Dialogue>();
+        const std::vector<const InfoIndex::Dialogue *>& greetings =
+            mInfoIndex.getDialogues (ESM::Dialogue::Greeting);
 
-        Filter filter (actor, mChoice, mTalkedTo);
+        Filter filter (mInfoIndex, actor, mChoice, mTalkedTo);
 
-        for (MWWorld::Store<ESM::Dialogue>::iterator it = dialogs.begin(); it != dialogs.end(); ++it)
+        for (std::vector<const InfoIndex::Dialogue *>::const_iterator it = greetings.begin(); it != greetings.end(); ++it)
         {
-            if(it->mType == ESM::Dialogue::Greeting)
+            // Search a response (we do not accept a fallback to "Info refusal" here)
+            if (const ESM::DialInfo *info = filter.search (**it, false))
             {
-                // Search a response (we do not accept a fallback to "Info refusal" here)
-                if (const ESM::DialInfo *info = filter.search (*it, false))
-                {
-                    //initialise the GUI
-                    MWBase::Environment::get().getWindowManager()->pushGuiMode(MWGui::GM_Dialogue);
+                //initialise the GUI
+                MWBase::Environment::get().getWindowManager()->pushGuiMode(MWGui::GM_Dialogue);
 
-                    creatureStats.talkedToPlayer();
+                creatureStats.talkedToPlayer();
 
-                    if (!info->mSound.empty())
-                    {
-                        // TODO play sound
-                    }
+                if (!info->mSound.empty())
+                {
+                    // TODO play sound
+                }
 
-                    parseText (info->mResponse);
+                parseText (info->mResponse);
 
-                    MWScript::InterpreterContext interpreterContext(&mActor.getRefData().getLocals(),mActor);
-                    win->addResponse (Interpreter::fixDefinesDialog(info->mResponse, interpreterContext));
-                    executeScript (info->mResultScript);
-                    mLastTopic = Misc::StringUtils::lowerCase(it->mId);
-                    break;
-                }
+                MWScript::InterpreterContext interpreterContext(&mActor.getRefData().getLocals(),mActor);
+                win->addResponse (Interpreter::fixDefinesDialog(info->mResponse, interpreterContext));
+                executeScript (info->mResultScript);
+                mLastTopic = Misc::StringUtils::lowerCase((*it)->mDialogue->mId);
+                break;
             }
         }
     }
@@ -242,6 +255,7 @@ namespace MWDialogue
                 MWScript::InterpreterContext interpreterContext(&mActor.getRefData().getLocals(),mActor);
                 Interpreter::Interpreter interpreter;
                 MWScript::installOpcodes (interpreter);
+                MWBase::Environment::get().getScriptManager()->addSideEffect();
                 interpreter.run (&code[0], code.size(), interpreterContext);
             }
             catch (const std::exception& error)
@@ -253,7 +267,7 @@ namespace MWDialogue
 
     void DialogueManager::executeTopic (const std::string& topic, bool randomResponse)
     {
-        Filter filter (mActor, mChoice, mTalkedTo);
+        Filter filter (mInfoIndex, mActor, mChoice, mTalkedTo);
 
         const MWWorld::Store<ESM::Dialogue> &dialogues =
             MWBase::Environment::get().getWorld()->getStore().get<ESM::Dialogue>();
@@ -300,33 +314,55 @@ namespace MWDialogue
         }
     }
 
-    void DialogueManager::updateTopics()
+    void DialogueManager::invalidateActorKnownTopics()
     {
-        std::list<std::string> keywordList;
+        mActorKnownTopicsValid = false;
+    }
+
+    void DialogueManager::updateActorKnownTopics()
+    {
+        unsigned int sideEffects = MWBase::Environment::get().getScriptManager()->getSideEffectCount();
+        const MWScript::Locals& locals = mActor.getRefData().getLocals();
+
+        if (mActorKnownTopicsValid && sideEffects == mSideEffects && locals.mShorts == mActorLocals.mShorts
+            && locals.mLongs == mActorLocals.mLongs && locals.mFloats == mActorLocals.mFloats)
+            return;
+
         int choice = mChoice;
         mChoice = -1;
-        mActorKnownTopics.clear();
 
-        const MWWorld::Store<ESM::Dialogue> &dialogs =
-            MWBase::Environment::get().getWorld()->getStore().get<ESM::Dialogue>();
+        const std::vector<const InfoIndex::Dialogue *>& topics =
+            mInfoIndex.getDialogues (ESM::Dialogue::Topic);
+
+        Filter filter (mInfoIndex, mActor, mChoice, mTalkedTo);
+
+        mActorKnownTopics.resize (topics.size());
 
-        Filter filter (mActor, mChoice, mTalkedTo);
+        for (std::size_t i = 0; i < topics.size(); ++i)
+            mActorKnownTopics[i] = filter.responseAvailable (*topics[i]);
 
-        for (MWWorld::Store<ESM::Dialogue>::iterator iter = dialogs.begin(); iter != dialogs.end(); ++iter)
+        mActorKnownTopicsValid = true;
+        mSideEffects = sideEffects;
+        mActorLocals = locals;
+
+        mChoice = choice;
+    }
+
+    void DialogueManager::updateTopics()
+    {
+        updateActorKnownTopics();
+
+        std::list<std::string> keywordList;
+
+        const std::vector<const InfoIndex::Dialogue *>& topics =
+            mInfoIndex.getDialogues (ESM::Dialogue::Topic);
+
+        for (std::size_t i = 0; i < topics.size(); ++i)
         {
-            if (iter->mType == ESM::Dialogue::Topic)
+            //does the player know the topic?
+            if (mActorKnownTopics[i] && mKnownTopics.find (mTopics[i]) != mKnownTopics.end())
             {
-                if (filter.responseAvailable (*iter))
-                {
-                    std::string lower = Misc::StringUtils::lowerCase(iter->mId);
-                    mActorKnownTopics.push_back (lower);
-
-                    //does the player know the topic?
-                    if (mKnownTopics.find (lower) != mKnownTopics.end())
-                    {
-                        keywordList.push_back (iter->mId);
-                    }
-                }
+                keywordList.push_back (topics[i]->mDialogue->mId);
             }
         }
 
@@ -385,12 +421,12 @@ namespace MWDialogue
         // sort again, because the previous sort was case-sensitive
         keywordList.sort(Misc::StringUtils::ciEqual);
         win->setKeywords(keywordList);
-
-        mChoice = choice;
     }
 
     void DialogueManager::keywordSelected (const std::string& keyword)
     {
+        invalidateActorKnownTopics();
+
         if(!mIsInChoice)
         {
             if(mDialogueMap.find(keyword) != mDialogueMap.end())
@@ -427,11 +463,13 @@ namespace MWDialogue
 
     void DialogueManager::questionAnswered (int answer)
     {
+        invalidateActorKnownTopics();
+
         mChoice = answer;
 
         if (mDialogueMap.find(mLastTopic) != mDialogueMap.end())
         {
-            Filter filter (mActor, mChoice, mTalkedTo);
+            Filter filter (mInfoIndex, mActor, mChoice, mTalkedTo);
 
             if (mDialogueMap[mLastTopic].mType == ESM::Dialogue::Topic
                     || mDialogueMap[mLastTopic].mType == ESM::Dialogue::Greeting)
@@ -479,6 +517,8 @@ namespace MWDialogue
 
     void DialogueManager::persuade(int type)
     {
+        invalidateActorKnownTopics();
+
         bool success;
         float temp, perm;
         MWBase::Environment::get().getMechanicsManager()->getPersuasionDispositionChange(
@@ -524,7 +564,9 @@ namespace MWDialogue
 
     bool DialogueManager::checkServiceRefused()
     {
-        Filter filter (mActor, mChoice, mTalkedTo);
+        invalidateActorKnownTopics();
+
+        Filter filter (mInfoIndex, mActor, mChoice, mTalkedTo);
 
         const MWWorld::Store<ESM::Dialogue> &dialogues =
             MWBase::Environment::get().getWorld()->getStore().get<ESM::Dialogue>();
@@ -565,7 +607,7 @@ namespace MWDialogue
         const MWWorld::ESMStore &store = MWBase::Environment::get().getWorld()->getStore();
         const ESM::Dialogue *dial = store.get<ESM::Dialogue>().find(topic);
 
-        Filter filter(actor, 0, false);
+        Filter filter(mInfoIndex, actor, 0, false);
         const ESM::DialInfo *info = filter.search(*dial, false);
         if(info != NULL)
         {
@@ -12,14 +12,32 @@
 #include "../mwworld/ptr.hpp"
 
 #include "../mwscript/compilercontext.hpp"
+#include "../mwscript/locals.hpp"
+
+#include "../mwgui/keywordsearch.hpp"
+
+#include "infoindex.hpp"
 
 namespace MWDialogue
 {
     class DialogueManager : public MWBase::DialogueManager
     {
+            typedef MWGui::KeywordSearch<std::string, int> TopicSearch;
+
             std::map<std::string, ESM::Dialogue> mDialogueMap;
+            InfoIndex mInfoIndex;
             std::map<std::string, bool> mKnownTopics;// Those are the topics the player knows.
-            std::list<std::string> mActorKnownTopics;
+            std::vector<std::string> mTopics; // lower case ids of the topics in mInfoIndex
+            TopicSearch mTopicSearch; // indices into mTopics
+
+            // Which topics the actor has a response for. The filters read the whole state of the
+            // game, which may change between calls from the GUI (barter, training, time passing),
+            // see invalidateActorKnownTopics(). Within a call, it only has to be updated after
+            // scripts have run or the local variables of the actor have changed.
+            std::vector<bool> mActorKnownTopics;
+            bool mActorKnownTopicsValid;
+            unsigned int mSideEffects;
+            MWScript::Locals mActorLocals;
 
             Translation::Storage& mTranslationDataStorage;
             MWScript::CompilerContext mCompilerContext;
@@ -39,6 +57,13 @@ namespace MWDialogue
 
             void parseText (const std::string& text);
 
+            void invalidateActorKnownTopics();
+            ///< Drop the topic cache. Call this first thing in every function the GUI calls,
+            /// the game may have changed since the last one.
+
+            void updateActorKnownTopics();
+            ///< Filter the topics again, if anything they depend on may have changed.
+
             void updateTopics();
 
             bool compile (const std::string& cmd,std::vector<Interpreter::Type_Code>& code);
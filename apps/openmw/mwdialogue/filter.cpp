@@ -1,6 +1,8 @@
 
 #include "filter.hpp"
 
+#include <algorithm>
+
 #include "../mwbase/environment.hpp"
 #include "../mwbase/world.hpp"
 #include "../mwbase/journal.hpp"
@@ -17,108 +19,131 @@
 
 #include "selectwrapper.hpp"
 
-bool MWDialogue::Filter::testActor (const ESM::DialInfo& info) const
+std::vector<const MWDialogue::InfoIndex::Info *> MWDialogue::Filter::getCandidates (
+    const InfoIndex::Dialogue& dialogue) const
 {
-    bool isCreature = (mActor.getTypeName() != typeid (ESM::NPC).name());
+    std::vector<int> indices;
+
+    for (std::vector<int>::const_iterator key (mKeys.begin()); key!=mKeys.end(); ++key)
+    {
+        std::vector<std::pair<int, int> >::const_iterator iter = std::lower_bound (
+            dialogue.mKeyed.begin(), dialogue.mKeyed.end(), std::make_pair (*key, -1));
+
+        for (; iter!=dialogue.mKeyed.end() && iter->first==*key; ++iter)
+            indices.push_back (iter->second);
+    }
+
+    // Creatures must not have topics aside of those specific to their id
+    if (!mIsCreature)
+        indices.insert (indices.end(), dialogue.mUnkeyed.begin(), dialogue.mUnkeyed.end());
+
+    std::sort (indices.begin(), indices.end());
+
+    std::vector<const InfoIndex::Info *> candidates;
+    candidates.reserve (indices.size());
+
+    for (std::vector<int>::const_iterator iter (indices.begin()); iter!=indices.end(); ++iter)
+        candidates.push_back (&dialogue.mInfos[*iter]);
 
+    return candidates;
+}
+
+bool MWDialogue::Filter::testActor (const InfoIndex::Info& info) const
+{
     // actor id
-    if (!info.mActor.empty())
+    if (info.mActor!=-1)
     {
-        if ( Misc::StringUtils::lowerCase (info.mActor)!=MWWorld::Class::get (mActor).getId (mActor))
+        if (info.mActor!=mActorId)
             return false;
     }
-    else if (isCreature)
+    else if (mIsCreature)
     {
         // Creatures must not have topics aside of those specific to their id
         return false;
     }
 
     // NPC race
-    if (!info.mRace.empty())
+    if (info.mRace!=-1)
     {
-        if (isCreature)
+        if (mIsCreature)
             return false;
 
-        MWWorld::LiveCellRef<ESM::NPC> *cellRef = mActor.get<ESM::NPC>();
-
-        if (Misc::StringUtils::lowerCase (info.mRace)!= Misc::StringUtils::lowerCase (cellRef->mBase->mRace))
+        if (info.mRace!=mRace)
             return false;
     }
 
     // NPC class
-    if (!info.mClass.empty())
+    if (info.mClass!=-1)
     {
-        if (isCreature)
+        if (mIsCreature)
             return false;
 
-        MWWorld::LiveCellRef<ESM::NPC> *cellRef = mActor.get<ESM::NPC>();
-
-        if ( Misc::StringUtils::lowerCase (info.mClass)!= Misc::StringUtils::lowerCase (cellRef->mBase->mClass))
+        if (info.mClass!=mClass)
             return false;
     }
 
     // NPC faction
-    if (!info.mFaction.empty())
+    if (info.mFaction!=-1)
     {
-        if (isCreature)
+        if (mIsCreature)
             return false;
 
         MWMechanics::NpcStats& stats = MWWorld::Class::get (mActor).getNpcStats (mActor);
-        std::map<std::string, int>::iterator iter = stats.getFactionRanks().find ( Misc::StringUtils::lowerCase (info.mFaction));
+        std::map<std::string, int>::iterator iter = stats.getFactionRanks().find (mIndex.getString (info.mFaction));
 
         if (iter==stats.getFactionRanks().end())
             return false;
 
         // check rank
-        if (iter->second < info.mData.mRank)
+        if (iter->second < info.mInfo->mData.mRank)
             return false;
     }
-    else if (info.mData.mRank != -1)
+    else if (info.mInfo->mData.mRank != -1)
     {
         // if there is a rank condition, but the NPC is not in a faction, always fail
         return false;
     }
 
     // Gender
-    if (!isCreature)
+    if (!mIsCreature)
     {
         MWWorld::LiveCellRef<ESM::NPC>* npc = mActor.get<ESM::NPC>();
-        if (info.mData.mGender==(npc->mBase->mFlags & npc->mBase->Female ? 0 : 1))
+        if (info.mInfo->mData.mGender==(npc->mBase->mFlags & npc->mBase->Female ? 0 : 1))
             return false;
     }
 
     return true;
 }
 
-bool MWDialogue::Filter::testPlayer (const ESM::DialInfo& info) const
+bool MWDialogue::Filter::testPlayer (const InfoIndex::Info& info) const
 {
-    const MWWorld::Ptr player = MWBase::Environment::get().getWorld()->getPlayer().getPlayer();
-
     // check player faction
-    if (!info.mPcFaction.empty())
+    if (info.mPcFaction!=-1)
     {
+        const MWWorld::Ptr player = MWBase::Environment::get().getWorld()->getPlayer().getPlayer();
+
         MWMechanics::NpcStats& stats = MWWorld::Class::get (player).getNpcStats (player);
-        std::map<std::string,int>::iterator iter = stats.getFactionRanks().find (Misc::StringUtils::lowerCase (info.mPcFaction));
+        std::map<std::string,int>::iterator iter = stats.getFactionRanks().find (mIndex.getString (info.mPcFaction));
 
         if(iter==stats.getFactionRanks().end())
             return false;
 
         // check rank
-        if (iter->second < info.mData.mPCrank)
+        if (iter->second < info.mInfo->mData.mPCrank)
             return false;
     }
 
     // check cell
-    if (!info.mCell.empty())
-        if (Misc::StringUtils::lowerCase (player.getCell()->mCell->mName) != Misc::StringUtils::lowerCase (info.mCell))
+    if (info.mCell!=-1)
+        if (info.mCell!=mPlayerCell)
             return false;
 
     return true;
 }
 
-bool MWDialogue::Filter::testSelectStructs (const ESM::DialInfo& info) const
+bool MWDialogue::Filter::testSelectStructs (const InfoIndex::Info& info) const
 {
-    for (std::vector<ESM::DialInfo::SelectStruct>::const_iterator iter (info.mSelects.begin());
+    for (std::vector<InfoIndex::Select>::const_iterator iter (info.mSelects.begin());
         iter != info.mSelects.end(); ++iter)
         if (!testSelectStruct (*iter))
             return false;
@@ -128,9 +153,7 @@ bool MWDialogue::Filter::testSelectStructs (const ESM::DialInfo& info) const
 
 bool MWDialogue::Filter::testDisposition (const ESM::DialInfo& info, bool invert) const
 {
-    bool isCreature = (mActor.getTypeName() != typeid (ESM::NPC).name());
-
-    if (isCreature)
+    if (mIsCreature)
         return true;
 
     int actorDisposition = MWBase::Environment::get().getMechanicsManager()->getDerivedDisposition(mActor);
@@ -139,21 +162,21 @@ bool MWDialogue::Filter::testDisposition (const ESM::DialInfo& info, bool invert
                   : (actorDisposition >= info.mData.mDisposition);
 }
 
-bool MWDialogue::Filter::testSelectStruct (const SelectWrapper& select) const
+bool MWDialogue::Filter::testSelectStruct (const InfoIndex::Select& select) const
 {
-    if (select.isNpcOnly() && (mActor.getTypeName() != typeid (ESM::NPC).name()))
+    if (select.mNpcOnly && mIsCreature)
         // If the actor is a creature, we do not test the conditions applicable
         // only to NPCs. Such conditions can never be satisfied, apart
         // inverted ones (NotClass, NotRace, NotFaction return true
         // because creatures are not of any race, class or faction).
-        return select.getType() == SelectWrapper::Type_Inverted;
+        return select.mType == SelectWrapper::Type_Inverted;
 
-    switch (select.getType())
+    switch (select.mType)
     {
         case SelectWrapper::Type_None: return true;
-        case SelectWrapper::Type_Integer: return select.selectCompare (getSelectStructInteger (select));
+        case SelectWrapper::Type_Integer: return select.compare (getSelectStructInteger (select));
         case SelectWrapper::Type_Numeric: return testSelectStructNumeric (select);
-        case SelectWrapper::Type_Boolean: return select.selectCompare (getSelectStructBoolean (select));
+        case SelectWrapper::Type_Boolean: return select.compare (getSelectStructBoolean (select));
 
         // We must not do the comparison for inverted functions (eg. Function_NotClass)
         case SelectWrapper::Type_Inverted: return getSelectStructBoolean (select);
@@ -162,50 +185,35 @@ bool MWDialogue::Filter::testSelectStruct (const SelectWrapper& select) const
     return true;
 }
 
-bool MWDialogue::Filter::testSelectStructNumeric (const SelectWrapper& select) const
+bool MWDialogue::Filter::testSelectStructNumeric (const InfoIndex::Select& select) const
 {
-    switch (select.getFunction())
+    switch (select.mFunction)
     {
         case SelectWrapper::Function_Global:
 
             // internally all globals are float :(
-            return select.selectCompare (
-                MWBase::Environment::get().getWorld()->getGlobalVariable (select.getName()).mFloat);
+            return select.compare (
+                MWBase::Environment::get().getWorld()->getGlobalVariable (mIndex.getString (select.mName)).mFloat);
 
         case SelectWrapper::Function_Local:
         {
-            std::string scriptName = MWWorld::Class::get (mActor).getScript (mActor);
-
-            if (scriptName.empty())
+            if (mScript.empty())
                 return false; // no script
 
-            const ESM::Script *script =
-                MWBase::Environment::get().getWorld()->getStore().get<ESM::Script>().find (scriptName);
-
-            std::string name = select.getName();
+            const InfoIndex::Local *local = mIndex.getLocal (mScript, select.mName);
 
-            int i = 0;
-
-            for (; i<static_cast<int> (script->mVarNames.size()); ++i)
-                if (Misc::StringUtils::lowerCase(script->mVarNames[i]) == name)
-                    break;
-
-            if (i>=static_cast<int> (script->mVarNames.size()))
+            if (!local)
                 return false; // script does not have a variable of this name
 
             const MWScript::Locals& locals = mActor.getRefData().getLocals();
 
-            if (i<script->mData.mNumShorts)
-                return select.selectCompare (static_cast<int> (locals.mShorts[i]));
-
-            i -= script->mData.mNumShorts;
-
-            if (i<script->mData.mNumLongs)
-                return select.selectCompare (locals.mLongs[i]);
-
-            i -= script->mData.mNumLongs;
+            switch (local->mType)
+            {
+                case 's': return select.compare (static_cast<int> (locals.mShorts[local->mIndex]));
+                case 'l': return select.compare (locals.mLongs[local->mIndex]);
+            }
 
-            return select.selectCompare (locals.mFloats.at (i));
+            return select.compare (locals.mFloats.at (local->mIndex));
         }
 
         case SelectWrapper::Function_PcHealthPercent:
@@ -215,7 +223,7 @@ bool MWDialogue::Filter::testSelectStructNumeric (const SelectWrapper& select) c
             float ratio = MWWorld::Class::get (player).getCreatureStats (player).getHealth().getCurrent() /
                 MWWorld::Class::get (player).getCreatureStats (player).getHealth().getModified();
 
-            return select.selectCompare (ratio);
+            return select.compare (ratio);
         }
 
         case SelectWrapper::Function_PcDynamicStat:
@@ -223,9 +231,9 @@ bool MWDialogue::Filter::testSelectStructNumeric (const SelectWrapper& select) c
             MWWorld::Ptr player = MWBase::Environment::get().getWorld()->getPlayer().getPlayer();
 
             float value = MWWorld::Class::get (player).getCreatureStats (player).
-                getDynamic (select.getArgument()).getCurrent();
+                getDynamic (select.mArgument).getCurrent();
 
-            return select.selectCompare (value);
+            return select.compare (value);
         }
 
         case SelectWrapper::Function_HealthPercent:
@@ -233,7 +241,7 @@ bool MWDialogue::Filter::testSelectStructNumeric (const SelectWrapper& select) c
             float ratio = MWWorld::Class::get (mActor).getCreatureStats (mActor).getHealth().getCurrent() /
                 MWWorld::Class::get (mActor).getCreatureStats (mActor).getHealth().getModified();
 
-            return select.selectCompare (ratio);
+            return select.compare (ratio);
         }
 
         default:
@@ -242,15 +250,15 @@ bool MWDialogue::Filter::testSelectStructNumeric (const SelectWrapper& select) c
     }
 }
 
-int MWDialogue::Filter::getSelectStructInteger (const SelectWrapper& select) const
+int MWDialogue::Filter::getSelectStructInteger (const InfoIndex::Select& select) const
 {
     MWWorld::Ptr player = MWBase::Environment::get().getWorld()->getPlayer().getPlayer();
 
-    switch (select.getFunction())
+    switch (select.mFunction)
     {
         case SelectWrapper::Function_Journal:
 
-            return MWBase::Environment::get().getJournal()->getJournalIndex (select.getName());
+            return MWBase::Environment::get().getJournal()->getJournalIndex (mIndex.getString (select.mName));
 
         case SelectWrapper::Function_Item:
         {
@@ -258,10 +266,10 @@ int MWDialogue::Filter::getSelectStructInteger (const SelectWrapper& select) con
 
             int sum = 0;
 
-            std::string name = select.getName();
+            const std::string& name = mIndex.getString (select.mName);
 
             for (MWWorld::ContainerStoreIterator iter (store.begin()); iter!=store.end(); ++iter)
-                if (Misc::StringUtils::lowerCase(iter->getCellRef().mRefID) == name)
+                if (Misc::StringUtils::ciEqual (iter->getCellRef().mRefID, name))
                     sum += iter->getRefData().getCount();
 
             return sum;
@@ -269,7 +277,7 @@ int MWDialogue::Filter::getSelectStructInteger (const SelectWrapper& select) con
 
         case SelectWrapper::Function_Dead:
 
-            return MWBase::Environment::get().getMechanicsManager()->countDeaths (select.getName());
+            return MWBase::Environment::get().getMechanicsManager()->countDeaths (mIndex.getString (select.mName));
 
         case SelectWrapper::Function_Choice:
 
@@ -277,17 +285,17 @@ int MWDialogue::Filter::getSelectStructInteger (const SelectWrapper& select) con
 
         case SelectWrapper::Function_AiSetting:
 
-            return MWWorld::Class::get (mActor).getCreatureStats (mActor).getAiSetting (select.getArgument());
+            return MWWorld::Class::get (mActor).getCreatureStats (mActor).getAiSetting (select.mArgument);
 
         case SelectWrapper::Function_PcAttribute:
 
             return MWWorld::Class::get (player).getCreatureStats (player).
-                getAttribute (select.getArgument()).getModified();
+                getAttribute (select.mArgument).getModified();
 
         case SelectWrapper::Function_PcSkill:
 
             return static_cast<int> (MWWorld::Class::get (player).
-                getNpcStats (player).getSkill (select.getArgument()).getModified());
+                getNpcStats (player).getSkill (select.mArgument).getModified());
 
         case SelectWrapper::Function_FriendlyHit:
         {
@@ -385,7 +393,7 @@ int MWDialogue::Filter::getSelectStructInteger (const SelectWrapper& select) con
         case SelectWrapper::Function_RankLow:
         case SelectWrapper::Function_RankHigh:
         {
-            bool low = select.getFunction()==SelectWrapper::Function_RankLow;
+            bool low = select.mFunction==SelectWrapper::Function_RankLow;
 
             if (MWWorld::Class::get (mActor).getNpcStats (mActor).getFactionRanks().empty())
                 return 0;
@@ -415,11 +423,11 @@ int MWDialogue::Filter::getSelectStructInteger (const SelectWrapper& select) con
     }
 }
 
-bool MWDialogue::Filter::getSelectStructBoolean (const SelectWrapper& select) const
+bool MWDialogue::Filter::getSelectStructBoolean (const InfoIndex::Select& select) const
 {
     MWWorld::Ptr player = MWBase::Environment::get().getWorld()->getPlayer().getPlayer();
 
-    switch (select.getFunction())
+    switch (select.mFunction)
     {
         case SelectWrapper::Function_False:
 
@@ -427,47 +435,28 @@ bool MWDialogue::Filter::getSelectStructBoolean (const SelectWrapper& select) co
 
         case SelectWrapper::Function_NotId:
 
-            return select.getName()!=Misc::StringUtils::lowerCase (MWWorld::Class::get (mActor).getId (mActor));
+            return select.mName!=mActorId;
 
         case SelectWrapper::Function_NotFaction:
 
-            return Misc::StringUtils::lowerCase (mActor.get<ESM::NPC>()->mBase->mFaction)!=select.getName();
+            return select.mName!=mFaction;
 
         case SelectWrapper::Function_NotClass:
 
-            return Misc::StringUtils::lowerCase (mActor.get<ESM::NPC>()->mBase->mClass)!=select.getName();
+            return select.mName!=mClass;
 
         case SelectWrapper::Function_NotRace:
 
-            return Misc::StringUtils::lowerCase (mActor.get<ESM::NPC>()->mBase->mRace)!=select.getName();
+            return select.mName!=mRace;
 
         case SelectWrapper::Function_NotCell:
 
-            return Misc::StringUtils::lowerCase (mActor.getCell()->mCell->mName)!=select.getName();
+            return select.mName!=mCell;
 
         case SelectWrapper::Function_NotLocal:
-        {
-            std::string scriptName = MWWorld::Class::get (mActor).getScript (mActor);
-
-            if (scriptName.empty())
-                // This actor has no attached script, so there is no local variable
-                return true;
-
-            const ESM::Script *script =
-                MWBase::Environment::get().getWorld()->getStore().get<ESM::Script>().find (scriptName);
-
-            std::string name = select.getName();
-
-            int i = 0;
-            for (; i < static_cast<int> (script->mVarNames.size()); ++i)
-                if (Misc::StringUtils::lowerCase(script->mVarNames[i]) == name)
-                    break;
 
-            if (i >= static_cast<int> (script->mVarNames.size()))
-                return true; // script does not have a variable of this name
-
-            return false;
-        }
+            // An actor without an attached script has no local variables
+            return mScript.empty() || !mIndex.getLocal (mScript, select.mName);
 
         case SelectWrapper::Function_SameGender:
 
@@ -476,8 +465,8 @@ bool MWDialogue::Filter::getSelectStructBoolean (const SelectWrapper& select) co
 
         case SelectWrapper::Function_SameRace:
 
-            return Misc::StringUtils::lowerCase (mActor.get<ESM::NPC>()->mBase->mRace)!=
-                Misc::StringUtils::lowerCase (player.get<ESM::NPC>()->mBase->mRace);
+            return !Misc::StringUtils::ciEqual (mActor.get<ESM::NPC>()->mBase->mRace,
+                player.get<ESM::NPC>()->mBase->mRace);
 
         case SelectWrapper::Function_SameFaction:
 
@@ -592,11 +581,51 @@ bool MWDialogue::Filter::hasFactionRankReputationRequirements (const MWWorld::Pt
     return stats.getFactionReputation (factionId)>=faction.mData.mRankData[rank].mFactReaction;
 }
 
-MWDialogue::Filter::Filter (const MWWorld::Ptr& actor, int choice, bool talkedToPlayer)
-: mActor (actor), mChoice (choice), mTalkedToPlayer (talkedToPlayer)
-{}
+MWDialogue::Filter::Filter (const InfoIndex& index, const MWWorld::Ptr& actor, int choice,
+    bool talkedToPlayer)
+: mIndex (index), mActor (actor), mChoice (choice), mTalkedToPlayer (talkedToPlayer),
+  mIsCreature (actor.getTypeName() != typeid (ESM::NPC).name()), mRace (-1), mClass (-1), mFaction (-1)
+{
+    mActorId = mIndex.lookup (MWWorld::Class::get (mActor).getId (mActor));
+    mCell = mIndex.lookup (mActor.getCell()->mCell->mName);
 
-const ESM::DialInfo* MWDialogue::Filter::search (const ESM::Dialogue& dialogue, const bool fallbackToInfoRefusal) const
+    const MWWorld::Ptr player = MWBase::Environment::get().getWorld()->getPlayer().getPlayer();
+    mPlayerCell = mIndex.lookup (player.getCell()->mCell->mName);
+
+    mScript = MWWorld::Class::get (mActor).getScript (mActor);
+
+    if (mActorId!=-1)
+        mKeys.push_back (InfoIndex::makeKey (InfoIndex::Key_Actor, mActorId));
+
+    if (!mIsCreature)
+    {
+        const ESM::NPC& npc = *mActor.get<ESM::NPC>()->mBase;
+
+        mRace = mIndex.lookup (npc.mRace);
+        mClass = mIndex.lookup (npc.mClass);
+        mFaction = mIndex.lookup (npc.mFaction);
+
+        if (mRace!=-1)
+            mKeys.push_back (InfoIndex::makeKey (InfoIndex::Key_Race, mRace));
+
+        if (mClass!=-1)
+            mKeys.push_back (InfoIndex::makeKey (InfoIndex::Key_Class, mClass));
+
+        const std::map<std::string, int>& ranks =
+            MWWorld::Class::get (mActor).getNpcStats (mActor).getFactionRanks();
+
+        for (std::map<std::string, int>::const_iterator iter (ranks.begin()); iter!=ranks.end(); ++iter)
+        {
+            int faction = mIndex.lookup (iter->first);
+
+            if (faction!=-1)
+                mKeys.push_back (InfoIndex::makeKey (InfoIndex::Key_Faction, faction));
+        }
+    }
+}
+
+const ESM::DialInfo* MWDialogue::Filter::search (const InfoIndex::Dialogue& dialogue,
+    const bool fallbackToInfoRefusal) const
 {
     std::vector<const ESM::DialInfo *> suitableInfos = list (dialogue, fallbackToInfoRefusal, false);
 
@@ -606,21 +635,28 @@ const ESM::DialInfo* MWDialogue::Filter::search (const ESM::Dialogue& dialogue,
         return suitableInfos[0];
 }
 
-std::vector<const ESM::DialInfo *> MWDialogue::Filter::list (const ESM::Dialogue& dialogue,
+const ESM::DialInfo* MWDialogue::Filter::search (const ESM::Dialogue& dialogue, const bool fallbackToInfoRefusal) const
+{
+    return search (mIndex.find (dialogue.mId), fallbackToInfoRefusal);
+}
+
+std::vector<const ESM::DialInfo *> MWDialogue::Filter::list (const InfoIndex::Dialogue& dialogue,
     bool fallbackToInfoRefusal, bool searchAll, bool invertDisposition) const
 {
     std::vector<const ESM::DialInfo *> infos;
 
     bool infoRefusal = false;
 
+    std::vector<const InfoIndex::Info *> candidates = getCandidates (dialogue);
+
     // Iterate over topic responses to find a matching one
-    for (std::vector<ESM::DialInfo>::const_iterator iter = dialogue.mInfo.begin();
-        iter!=dialogue.mInfo.end(); ++iter)
+    for (std::vector<const InfoIndex::Info *>::const_iterator iter = candidates.begin();
+        iter!=candidates.end(); ++iter)
     {
-        if (testActor (*iter) && testPlayer (*iter) && testSelectStructs (*iter))
+        if (testActor (**iter) && testPlayer (**iter) && testSelectStructs (**iter))
         {
-            if (testDisposition (*iter, invertDisposition)) {
-                infos.push_back(&*iter);
+            if (testDisposition (*(*iter)->mInfo, invertDisposition)) {
+                infos.push_back((*iter)->mInfo);
                 if (!searchAll)
                     break;
             }
@@ -634,15 +670,12 @@ std::vector<const ESM::DialInfo *> MWDialogue::Filter::list (const ESM::Dialogue
         // No response is valid because of low NPC disposition,
         // search a response in the topic "Info Refusal"
 
-        const MWWorld::Store<ESM::Dialogue> &dialogues =
-            MWBase::Environment::get().getWorld()->getStore().get<ESM::Dialogue>();
-
-        const ESM::Dialogue& infoRefusalDialogue = *dialogues.find ("Info Refusal");
+        candidates = getCandidates (mIndex.find ("Info Refusal"));
 
-        for (std::vector<ESM::DialInfo>::const_iterator iter = infoRefusalDialogue.mInfo.begin();
-            iter!=infoRefusalDialogue.mInfo.end(); ++iter)
-            if (testActor (*iter) && testPlayer (*iter) && testSelectStructs (*iter) && testDisposition(*iter, invertDisposition)) {
-                infos.push_back(&*iter);
+        for (std::vector<const InfoIndex::Info *>::const_iterator iter = candidates.begin();
+            iter!=candidates.end(); ++iter)
+            if (testActor (**iter) && testPlayer (**iter) && testSelectStructs (**iter) && testDisposition(*(*iter)->mInfo, invertDisposition)) {
+                infos.push_back((*iter)->mInfo);
                 if (!searchAll)
                     break;
             }
@@ -651,12 +684,20 @@ std::vector<const ESM::DialInfo *> MWDialogue::Filter::list (const ESM::Dialogue
     return infos;
 }
 
-bool MWDialogue::Filter::responseAvailable (const ESM::Dialogue& dialogue) const
+std::vector<const ESM::DialInfo *> MWDialogue::Filter::list (const ESM::Dialogue& dialogue,
+    bool fallbackToInfoRefusal, bool searchAll, bool invertDisposition) const
+{
+    return list (mIndex.find (dialogue.mId), fallbackToInfoRefusal, searchAll, invertDisposition);
+}
+
+bool MWDialogue::Filter::responseAvailable (const InfoIndex::Dialogue& dialogue) const
 {
-    for (std::vector<ESM::DialInfo>::const_iterator iter = dialogue.mInfo.begin();
-        iter!=dialogue.mInfo.end(); ++iter)
+    std::vector<const InfoIndex::Info *> candidates = getCandidates (dialogue);
+
+    for (std::vector<const InfoIndex::Info *>::const_iterator iter = candidates.begin();
+        iter!=candidates.end(); ++iter)
     {
-        if (testActor (*iter) && testPlayer (*iter) && testSelectStructs (*iter))
+        if (testActor (**iter) && testPlayer (**iter) && testSelectStructs (**iter))
             return true;
     }
 
@@ -2,9 +2,12 @@
 #define GAME_MWDIALOGUE_FILTER_H
 
 #include <vector>
+#include <string>
 
 #include "../mwworld/ptr.hpp"
 
+#include "infoindex.hpp"
+
 namespace ESM
 {
     struct DialInfo;
@@ -13,33 +16,48 @@ namespace ESM
 
 namespace MWDialogue
 {
-    class SelectWrapper;
-
     class Filter
     {
+            const InfoIndex& mIndex;
             MWWorld::Ptr mActor;
             int mChoice;
             bool mTalkedToPlayer;
+            bool mIsCreature;
+
+            // interned ids of the actor, -1 if no info refers to them
+            int mActorId;
+            int mRace;
+            int mClass;
+            int mFaction;
+            int mCell;
+            int mPlayerCell;
+
+            std::vector<int> mKeys; ///< InfoIndex keys of the infos that can match the actor
+            std::string mScript;
+
+            std::vector<const InfoIndex::Info *> getCandidates (const InfoIndex::Dialogue& dialogue) const;
+            ///< Infos of \a dialogue that do not require a different speaker, faction, class or race,
+            /// in their original order.
 
-            bool testActor (const ESM::DialInfo& info) const;
+            bool testActor (const InfoIndex::Info& info) const;
             ///< Is this the right actor for this \a info?
 
-            bool testPlayer (const ESM::DialInfo& info) const;
+            bool testPlayer (const InfoIndex::Info& info) const;
             ///< Do the player and the cell the player is currently in match \a info?
 
-            bool testSelectStructs (const ESM::DialInfo& info) const;
+            bool testSelectStructs (const InfoIndex::Info& info) const;
             ///< Are all select structs matching?
 
             bool testDisposition (const ESM::DialInfo& info, bool invert=false) const;
             ///< Is the actor disposition toward the player high enough (or low enough, if \a invert is true)?
 
-            bool testSelectStruct (const SelectWrapper& select) const;
+            bool testSelectStruct (const InfoIndex::Select& select) const;
 
-            bool testSelectStructNumeric (const SelectWrapper& select) const;
+            bool testSelectStructNumeric (const InfoIndex::Select& select) const;
 
-            int getSelectStructInteger (const SelectWrapper& select) const;
+            int getSelectStructInteger (const InfoIndex::Select& select) const;
 
-            bool getSelectStructBoolean (const SelectWrapper& select) const;
+            bool getSelectStructBoolean (const InfoIndex::Select& select) const;
 
             int getFactionRank (const MWWorld::Ptr& actor, const std::string& factionId) const;
 
@@ -51,16 +69,21 @@ namespace MWDialogue
 
         public:
 
-            Filter (const MWWorld::Ptr& actor, int choice, bool talkedToPlayer);
+            Filter (const InfoIndex& index, const MWWorld::Ptr& actor, int choice, bool talkedToPlayer);
+
+            std::vector<const ESM::DialInfo *> list (const InfoIndex::Dialogue& dialogue,
+                bool fallbackToInfoRefusal, bool searchAll, bool invertDisposition=false) const;
 
             std::vector<const ESM::DialInfo *> list (const ESM::Dialogue& dialogue,
                 bool fallbackToInfoRefusal, bool searchAll, bool invertDisposition=false) const;
 
-            const ESM::DialInfo* search (const ESM::Dialogue& dialogue, const bool fallbackToInfoRefusal) const;
+            const ESM::DialInfo* search (const InfoIndex::Dialogue& dialogue, const bool fallbackToInfoRefusal) const;
             ///< Get a matching response for the requested dialogue.
             ///  Redirect to "Info Refusal" topic if a response fulfills all conditions but disposition.
 
-            bool responseAvailable (const ESM::Dialogue& dialogue) const;
+            const ESM::DialInfo* search (const ESM::Dialogue& dialogue, const bool fallbackToInfoRefusal) const;
+
+            bool responseAvailable (const InfoIndex::Dialogue& dialogue) const;
             ///< Does a matching response exist? (disposition is ignored for this check)
     };
 }
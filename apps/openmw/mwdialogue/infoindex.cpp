@@ -0,0 +1,186 @@
+
+#include "infoindex.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <components/esm/loadscpt.hpp>
+
+#include "../mwworld/esmstore.hpp"
+
+MWDialogue::InfoIndex::InfoIndex (const MWWorld::ESMStore& store)
+: mStore (store)
+{
+    const MWWorld::Store<ESM::Dialogue>& dialogues = store.get<ESM::Dialogue>();
+
+    for (MWWorld::Store<ESM::Dialogue>::iterator iter = dialogues.begin(); iter!=dialogues.end(); ++iter)
+    {
+        Dialogue *dialogue = mDialogues.insert (iter->mId, Dialogue()).first;
+        dialogue->mDialogue = &*iter;
+        compile (*dialogue);
+        mByType[iter->mType].push_back (dialogue);
+    }
+}
+
+int MWDialogue::InfoIndex::intern (const std::string& string)
+{
+    if (string.empty())
+        return -1;
+
+    StringIndex::const_iterator iter = mStringIndex.find (string);
+
+    if (iter!=mStringIndex.end())
+        return iter->second;
+
+    int id = static_cast<int> (mStrings.size());
+    mStrings.push_back (Misc::StringUtils::lowerCase (string));
+    mStringIndex.insert (std::make_pair (mStrings.back(), id));
+    return id;
+}
+
+void MWDialogue::InfoIndex::compile (Dialogue& dialogue)
+{
+    const std::vector<ESM::DialInfo>& infos = dialogue.mDialogue->mInfo;
+
+    dialogue.mInfos.resize (infos.size());
+
+    for (std::size_t i=0; i<infos.size(); ++i)
+    {
+        const ESM::DialInfo& source = infos[i];
+        Info& info = dialogue.mInfos[i];
+
+        info.mInfo = &source;
+        info.mActor = intern (source.mActor);
+        info.mRace = intern (source.mRace);
+        info.mClass = intern (source.mClass);
+        info.mFaction = intern (source.mFaction);
+        info.mPcFaction = intern (source.mPcFaction);
+        info.mCell = intern (source.mCell);
+
+        info.mSelects.reserve (source.mSelects.size());
+
+        for (std::vector<ESM::DialInfo::SelectStruct>::const_iterator iter (source.mSelects.begin());
+            iter!=source.mSelects.end(); ++iter)
+        {
+            SelectWrapper wrapper (*iter);
+
+            Select select;
+            select.mSelect = &*iter;
+            select.mFunction = wrapper.getFunction();
+            select.mType = wrapper.getType();
+            select.mNpcOnly = wrapper.isNpcOnly();
+            select.mArgument = wrapper.getArgument();
+
+            // all functions except those of type 1 (and the empty type 0) take a name
+            select.mName = iter->mSelectRule.size()>5 && iter->mSelectRule[1]>'1' ?
+                intern (wrapper.getName()) : -1;
+
+            info.mSelects.push_back (select);
+        }
+
+        // An info can only match actors with the speaker, faction, class or race it requires.
+        // Index it by the most specific of them.
+        int index = static_cast<int> (i);
+
+        if (info.mActor!=-1)
+            dialogue.mKeyed.push_back (std::make_pair (makeKey (Key_Actor, info.mActor), index));
+        else if (info.mFaction!=-1)
+            dialogue.mKeyed.push_back (std::make_pair (makeKey (Key_Faction, info.mFaction), index));
+        else if (info.mClass!=-1)
+            dialogue.mKeyed.push_back (std::make_pair (makeKey (Key_Class, info.mClass), index));
+        else if (info.mRace!=-1)
+            dialogue.mKeyed.push_back (std::make_pair (makeKey (Key_Race, info.mRace), index));
+        else
+            dialogue.mUnkeyed.push_back (index);
+    }
+
+    std::sort (dialogue.mKeyed.begin(), dialogue.mKeyed.end());
+}
+
+const MWDialogue::InfoIndex::Locals& MWDialogue::InfoIndex::getLocals (const std::string& script) const
+{
+    if (const Locals *locals = mLocals.search (script))
+        return *locals;
+
+    Locals& locals = *mLocals.insert (script, Locals()).first;
+
+    const ESM::Script *record = mStore.get<ESM::Script>().find (script);
+
+    // only variables that are referred to by an info can be looked up
+    for (int i=0; i<static_cast<int> (record->mVarNames.size()); ++i)
+    {
+        int name = lookup (record->mVarNames[i]);
+
+        if (name==-1 || locals.find (name)!=locals.end())
+            continue;
+
+        Local local;
+        local.mIndex = i;
+
+        if (local.mIndex<record->mData.mNumShorts)
+            local.mType = 's';
+        else if ((local.mIndex -= record->mData.mNumShorts)<record->mData.mNumLongs)
+            local.mType = 'l';
+        else
+        {
+            local.mType = 'f';
+            local.mIndex -= record->mData.mNumLongs;
+        }
+
+        locals.insert (std::make_pair (name, local));
+    }
+
+    return locals;
+}
+
+const MWDialogue::InfoIndex::Dialogue *MWDialogue::InfoIndex::search (const std::string& id) const
+{
+    return mDialogues.search (id);
+}
+
+const MWDialogue::InfoIndex::Dialogue& MWDialogue::InfoIndex::find (const std::string& id) const
+{
+    const Dialogue *dialogue = search (id);
+
+    if (!dialogue)
+        throw std::runtime_error ("no dialogue infos for '" + id + "'");
+
+    return *dialogue;
+}
+
+const std::vector<const MWDialogue::InfoIndex::Dialogue *>& MWDialogue::InfoIndex::getDialogues (
+    int type) const
+{
+    static const std::vector<const Dialogue *> empty;
+
+    std::map<int, std::vector<const Dialogue *> >::const_iterator iter = mByType.find (type);
+
+    return iter!=mByType.end() ? iter->second : empty;
+}
+
+int MWDialogue::InfoIndex::lookup (const std::string& string) const
+{
+    StringIndex::const_iterator iter = mStringIndex.find (string);
+
+    return iter!=mStringIndex.end() ? iter->second : -1;
+}
+
+const std::string& MWDialogue::InfoIndex::getString (int id) const
+{
+    return mStrings.at (id);
+}
+
+const MWDialogue::InfoIndex::Local *MWDialogue::InfoIndex::getLocal (const std::string& script,
+    int name) const
+{
+    const Locals& locals = getLocals (script);
+
+    Locals::const_iterator iter = locals.find (name);
+
+    return iter!=locals.end() ? &iter->second : 0;
+}
+
+int MWDialogue::InfoIndex::makeKey (Key type, int id)
+{
+    return id*4 + type;
+}
@@ -0,0 +1,141 @@
+#ifndef GAME_MWDIALOGUE_INFOINDEX_H
+#define GAME_MWDIALOGUE_INFOINDEX_H
+
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <components/esm/loaddial.hpp>
+#include <components/misc/idmap.hpp>
+#include <components/misc/stringops.hpp>
+
+#include "selectwrapper.hpp"
+
+namespace MWWorld
+{
+    class ESMStore;
+}
+
+namespace MWDialogue
+{
+    /// \brief Dialogue infos in a form that is cheap to filter
+    ///
+    /// All ids an info refers to are interned into integers, select structs are decoded and
+    /// the infos of every dialogue are indexed by the speaker, faction, class or race they
+    /// require, so that a Filter only has to look at the infos that can match its actor.
+    class InfoIndex
+    {
+        public:
+
+            struct Select
+            {
+                const ESM::DialInfo::SelectStruct *mSelect;
+                SelectWrapper::Function mFunction;
+                SelectWrapper::Type mType;
+                bool mNpcOnly;
+                int mArgument;
+                int mName; ///< interned, -1 for functions without a name
+
+                template<typename T>
+                bool compare (T value) const
+                {
+                    return SelectWrapper (*mSelect).selectCompare (value);
+                }
+            };
+
+            struct Info
+            {
+                const ESM::DialInfo *mInfo;
+
+                // interned, -1 if there is no condition
+                int mActor;
+                int mRace;
+                int mClass;
+                int mFaction;
+                int mPcFaction;
+                int mCell;
+
+                std::vector<Select> mSelects;
+            };
+
+            struct Dialogue
+            {
+                const ESM::Dialogue *mDialogue;
+                std::vector<Info> mInfos;
+                std::vector<std::pair<int, int> > mKeyed; ///< key and info index, sorted
+                std::vector<int> mUnkeyed; ///< infos that do not require a speaker, faction, class or race
+            };
+
+            enum Key
+            {
+                Key_Actor, Key_Faction, Key_Class, Key_Race
+            };
+
+            struct Local
+            {
+                char mType;
+                int mIndex; ///< index into the locals of \a mType
+            };
+
+        private:
+
+            #if defined HAVE_UNORDERED_MAP
+                typedef std::unordered_map<std::string, int, Misc::StringUtils::CiHash,
+                    Misc::StringUtils::CiEqual> StringIndex;
+            #else
+                typedef std::tr1::unordered_map<std::string, int, Misc::StringUtils::CiHash,
+                    Misc::StringUtils::CiEqual> StringIndex;
+            #endif
+
+            typedef std::map<int, Local> Locals; // by interned variable name
+
+            const MWWorld::ESMStore& mStore;
+            StringIndex mStringIndex;
+            std::vector<std::string> mStrings; // lower case
+            Misc::IdMap<Dialogue> mDialogues;
+            std::map<int, std::vector<const Dialogue *> > mByType;
+            mutable Misc::IdMap<Locals> mLocals; // by script, filled on first use
+
+            int intern (const std::string& string);
+            ///< \return -1 for an empty string
+
+            void compile (Dialogue& dialogue);
+
+            const Locals& getLocals (const std::string& script) const;
+
+        public:
+
+            InfoIndex (const MWWorld::ESMStore& store);
+
+            const Dialogue *search (const std::string& id) const;
+            ///< \return 0 if there is no dialogue \a id
+
+            const Dialogue& find (const std::string& id) const;
+            ///< Throws an exception if there is no dialogue \a id
+
+            const std::vector<const Dialogue *>& getDialogues (int type) const;
+            ///< Dialogues of ESM::Dialogue::Type \a type in the order of the store
+
+            int lookup (const std::string& string) const;
+            ///< Return the interned form of \a string (case insensitive) or -1, if no info refers to it.
+
+            const std::string& getString (int id) const;
+            ///< Return the lower case string interned as \a id.
+
+            const Local *getLocal (const std::string& script, int name) const;
+            ///< Return the slot of the local variable \a name of \a script or 0, if there is no such
+            /// variable.
+
+            static int makeKey (Key type, int id);
+    };
+}
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "../mwbase/environment.hpp"
 #include "../mwbase/windowmanager.hpp"
+#include "../mwbase/scriptmanager.hpp"
 
 namespace MWGui
 {
@@ -183,6 +184,7 @@ namespace MWGui
                 MWScript::installOpcodes (interpreter, mConsoleOnlyScripts);
                 std::vector<Interpreter::Type_Code> code;
                 output.getCode (code);
+                MWBase::Environment::get().getScriptManager()->addSideEffect();
                 interpreter.run (&code[0], code.size(), interpreterContext);
             }
             catch (const std::exception& error)
@@ -5,13 +5,19 @@
 #include <locale>
 #include <stdexcept>
 #include <vector>
-#include <algorithm>    // std::reverse
+#include <deque>
+#include <algorithm>    // std::max
 
 #include <components/misc/stringops.hpp>
 
 namespace MWGui
 {
 
+/// \brief Case insensitive search for a set of keywords
+///
+/// The keywords are kept in an Aho-Corasick automaton, so a text is searched for all of them in
+/// a single pass. Keywords can be added at any time; the failure links are rebuilt by the
+/// first search after a change.
 template <typename string_t, typename value_t>
 class KeywordSearch
 {
@@ -26,171 +32,220 @@ public:
         value_t mValue;
     };
 
+    KeywordSearch ()
+    {
+        clear ();
+    }
+
     void seed (string_t keyword, value_t value)
     {
-        seed_impl  (/*std::move*/ (keyword), /*std::move*/ (value), 0, mRoot);
+        if (keyword.empty ())
+            throw std::runtime_error ("empty keyword inserted");
+
+        size_t node = 0;
+
+        for (Point i = keyword.begin (); i != keyword.end (); ++i)
+        {
+            char_t ch = std::tolower (*i, mLocale);
+
+            typename Node::children_t::const_iterator child = mNodes [node].mChildren.find (ch);
+
+            if (child == mNodes [node].mChildren.end ())
+            {
+                size_t next = mNodes.size ();
+                mNodes.push_back (Node (mNodes [node].mDepth + 1));
+                mNodes [node].mChildren [ch] = next;
+                node = next;
+            }
+            else
+                node = child->second;
+        }
+
+        Node& entry = mNodes [node];
+
+        if (!entry.mKeyword.empty () && keyword == entry.mKeyword)
+            throw std::runtime_error ("duplicate keyword inserted");
+
+        entry.mKeyword = /*std::move*/ (keyword);
+        entry.mValue = /*std::move*/ (value);
+
+        mMaxLength = std::max (mMaxLength, entry.mDepth);
+        mPrepared = false;
     }
 
     void clear ()
     {
-        mRoot.mChildren.clear ();
-        mRoot.mKeyword.clear ();
+        mNodes.clear ();
+        mNodes.push_back (Node (0));
+        mMaxLength = 0;
+        mPrepared = true;
     }
 
     bool containsKeyword (string_t keyword, value_t& value)
     {
-        typename Entry::childen_t::iterator current;
-        typename Entry::childen_t::iterator next;
+        size_t node = 0;
 
-        current = mRoot.mChildren.find (std::tolower (*keyword.begin(), mLocale));
-        if (current == mRoot.mChildren.end())
-            return false;
-        else if (current->second.mKeyword.size() && Misc::StringUtils::ciEqual(current->second.mKeyword, keyword))
+        for (Point i = keyword.begin (); i != keyword.end (); ++i)
         {
-            value = current->second.mValue;
-            return true;
-        }
+            typename Node::children_t::const_iterator child =
+                mNodes [node].mChildren.find (std::tolower (*i, mLocale));
 
-        for (Point i = ++keyword.begin(); i != keyword.end(); ++i)
-        {
-            next = current->second.mChildren.find(std::tolower (*i, mLocale));
-            if (next == current->second.mChildren.end())
+            if (child == mNodes [node].mChildren.end ())
                 return false;
-            if (Misc::StringUtils::ciEqual(next->second.mKeyword, keyword))
-            {
-                value = next->second.mValue;
-                return true;
-            }
-            current = next;
+
+            node = child->second;
         }
-        return false;
+
+        if (mNodes [node].mKeyword.empty ())
+            return false;
+
+        value = mNodes [node].mValue;
+        return true;
     }
 
+    /// Find the keyword that starts first in [\a beg, \a end). If several keywords start at the
+    /// same position, the longest one is chosen.
     bool search (Point beg, Point end, Match & match)
     {
-        for (Point i = beg; i != end; ++i)
-        {
-            // check first character
-            typename Entry::childen_t::iterator candidate = mRoot.mChildren.find (std::tolower (*i, mLocale));
+        prepare ();
 
-            // no match, on to next character
-            if (candidate == mRoot.mChildren.end ())
-                continue;
+        size_t state = 0;
+        size_t pos = 0;
+        size_t bestNode = 0;
+        size_t bestBeg = 0;
 
-            // see how far the match goes
-            Point j = i;
+        for (Point i = beg; i != end; ++i, ++pos)
+        {
+            // a keyword that ends at or after this character starts too late to be preferred
+            if (bestNode && pos >= bestBeg + mMaxLength)
+                break;
 
-            // some keywords might be longer variations of other keywords, so we definitely need a list of candidates
-            // the first element in the pair is length of the match, i.e. depth from the first character on
-            std::vector< typename std::pair<int, typename Entry::childen_t::iterator> > candidates;
+            state = step (state, std::tolower (*i, mLocale));
 
-            while ((j + 1) != end)
+            for (size_t node = firstOutput (state); node; node = mNodes [node].mOutput)
             {
-                typename Entry::childen_t::iterator next = candidate->second.mChildren.find (std::tolower (*++j, mLocale));
+                size_t start = pos + 1 - mNodes [node].mDepth;
 
-                if (next == candidate->second.mChildren.end ())
+                if (!bestNode || start < bestBeg ||
+                    (start == bestBeg && mNodes [node].mDepth > mNodes [bestNode].mDepth))
                 {
-                    if (candidate->second.mKeyword.size() > 0)
-                        candidates.push_back(std::make_pair((j-i), candidate));
-                    break;
+                    bestNode = node;
+                    bestBeg = start;
                 }
-
-                candidate = next;
-
-                if (candidate->second.mKeyword.size() > 0)
-                    candidates.push_back(std::make_pair((j-i), candidate));
             }
+        }
 
-            if (candidates.empty())
-                continue; // didn't match enough to disambiguate, on to next character
-
-            // shorter candidates will be added to the vector first. however, we want to check against longer candidates first
-            std::reverse(candidates.begin(), candidates.end());
-
-            for (typename std::vector< std::pair<int, typename Entry::childen_t::iterator> >::iterator it = candidates.begin();
-                 it != candidates.end(); ++it)
-            {
-                candidate = it->second;
-                // try to match the rest of the keyword
-                Point k = i + it->first;
-                typename string_t::const_iterator t = candidate->second.mKeyword.begin () + (k - i);
+        if (!bestNode)
+            return false;
 
+        match.mValue = mNodes [bestNode].mValue;
+        match.mBeg = beg + bestBeg;
+        match.mEnd = match.mBeg + mNodes [bestNode].mDepth;
 
-                while (k != end && t != candidate->second.mKeyword.end ())
-                {
-                    if (std::tolower (*k, mLocale) != std::tolower (*t, mLocale))
-                        break;
+        return true;
+    }
 
-                    ++k, ++t;
-                }
+    /// Append all occurrences of keywords in [\a beg, \a end), including overlapping ones, to
+    /// \a matches, ordered by their end.
+    void searchAll (Point beg, Point end, std::vector<Match>& matches)
+    {
+        prepare ();
 
-                // didn't match full keyword, try the next candidate
-                if (t != candidate->second.mKeyword.end ())
-                    continue;
+        size_t state = 0;
 
-                // we did it, report the good news
-                match.mValue = candidate->second.mValue;
-                match.mBeg = i;
-                match.mEnd = k;
+        for (Point i = beg; i != end; ++i)
+        {
+            state = step (state, std::tolower (*i, mLocale));
 
-                return true;
+            for (size_t node = firstOutput (state); node; node = mNodes [node].mOutput)
+            {
+                Match match;
+                match.mValue = mNodes [node].mValue;
+                match.mEnd = i + 1;
+                match.mBeg = match.mEnd - mNodes [node].mDepth;
+                matches.push_back (match);
             }
         }
-
-        // no match in range, report the bad news
-        return false;
     }
 
 private:
 
-    struct Entry
+    typedef typename string_t::value_type char_t;
+
+    struct Node
     {
-        typedef std::map <wchar_t, Entry> childen_t;
+        typedef std::map <char_t, size_t> children_t;
 
-        string_t mKeyword;
+        string_t mKeyword; // empty if no keyword ends here
         value_t mValue;
-        childen_t mChildren;
+        children_t mChildren;
+        size_t mDepth;
+        size_t mFail; // longest proper suffix that is in the trie
+        size_t mOutput; // longest proper suffix that is a keyword, 0 if there is none
+
+        explicit Node (size_t depth) : mValue (), mDepth (depth), mFail (0), mOutput (0) {}
     };
 
-    void seed_impl (string_t keyword, value_t value, size_t depth, Entry  & entry)
+    size_t step (size_t state, char_t ch) const
+    {
+        for (;;)
+        {
+            typename Node::children_t::const_iterator child = mNodes [state].mChildren.find (ch);
+
+            if (child != mNodes [state].mChildren.end ())
+                return child->second;
+
+            if (state == 0)
+                return 0;
+
+            state = mNodes [state].mFail;
+        }
+    }
+
+    size_t firstOutput (size_t state) const
     {
-        int ch = tolower (keyword.at (depth), mLocale);
+        return mNodes [state].mKeyword.empty () ? mNodes [state].mOutput : state;
+    }
 
-        typename Entry::childen_t::iterator j = entry.mChildren.find (ch);
+    void prepare ()
+    {
+        if (mPrepared)
+            return;
+
+        // breadth first, so that the failure links of shorter prefixes are known
+        std::deque<size_t> queue;
 
-        if (j == entry.mChildren.end ())
+        for (typename Node::children_t::const_iterator i = mNodes [0].mChildren.begin ();
+            i != mNodes [0].mChildren.end (); ++i)
         {
-            entry.mChildren [ch].mValue = /*std::move*/ (value);
-            entry.mChildren [ch].mKeyword = /*std::move*/ (keyword);
+            mNodes [i->second].mFail = 0;
+            mNodes [i->second].mOutput = 0;
+            queue.push_back (i->second);
         }
-        else
+
+        while (!queue.empty ())
         {
-            if (j->second.mKeyword.size () > 0)
-            {
-                if (keyword == j->second.mKeyword)
-                    throw std::runtime_error ("duplicate keyword inserted");
+            size_t node = queue.front ();
+            queue.pop_front ();
 
-                value_t pushValue = /*std::move*/ (j->second.mValue);
-                string_t pushKeyword = /*std::move*/ (j->second.mKeyword);
+            for (typename Node::children_t::const_iterator i = mNodes [node].mChildren.begin ();
+                i != mNodes [node].mChildren.end (); ++i)
+            {
+                size_t fail = step (mNodes [node].mFail, i->first);
 
-                if (depth >= pushKeyword.size ())
-                    throw std::runtime_error ("unexpected");
+                mNodes [i->second].mFail = fail;
+                mNodes [i->second].mOutput = firstOutput (fail);
 
-                if (depth+1 < pushKeyword.size())
-                {
-                    seed_impl (/*std::move*/ (pushKeyword), /*std::move*/ (pushValue), depth+1, j->second);
-                    j->second.mKeyword.clear ();
-                }
+                queue.push_back (i->second);
             }
-            if (depth+1 == keyword.size())
-                j->second.mKeyword = value;
-            else // depth+1 < keyword.size()
-                seed_impl (/*std::move*/ (keyword), /*std::move*/ (value), depth+1, j->second);
         }
 
+        mPrepared = true;
     }
 
-    Entry mRoot;
+    std::vector<Node> mNodes; // the root is the first node
+    size_t mMaxLength;
+    bool mPrepared;
     std::locale mLocale;
 };
 
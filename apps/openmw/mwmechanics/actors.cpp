@@ -78,7 +78,7 @@ namespace MWMechanics
                     {
                         disp = MWBase::Environment::get().getMechanicsManager()->getDerivedDisposition(ptr);
                     }
-                    bool LOS = MWBase::Environment::get().getWorld()->getLOS(ptr,MWBase::Environment::get().getWorld()->getPlayer().getPlayer());
+                    bool LOS = seesPlayer(ptr);
                     if(  ( (fight == 100 )
                         || (fight >= 95 && d <= 3000)
                         || (fight >= 90 && d <= 2000)
@@ -104,6 +104,41 @@ namespace MWMechanics
         }
     }
 
+    void Actors::updateLineOfSight()
+    {
+        mSeesPlayer.clear();
+
+        if(MWBase::Environment::get().getWindowManager()->isGuiMode() ||
+            !MWBase::Environment::get().getMechanicsManager()->isAIActive())
+            return;
+
+        MWWorld::Ptr player = MWBase::Environment::get().getWorld()->getPlayer().getPlayer();
+
+        // the actors that updateActor checks for combat
+        std::vector<std::pair<MWWorld::Ptr, MWWorld::Ptr> > pairs;
+        for(PtrControllerMap::iterator iter(mActors.begin());iter != mActors.end();++iter)
+        {
+            const CreatureStats &stats = iter->first.getClass().getCreatureStats(iter->first);
+            if(iter->first != player && !stats.isDead() && !stats.isHostile())
+                pairs.push_back(std::make_pair(iter->first, player));
+        }
+
+        std::vector<bool> visible;
+        MWBase::Environment::get().getWorld()->getLOS(pairs, visible);
+
+        for(std::size_t i = 0;i < pairs.size();++i)
+            mSeesPlayer[pairs[i].first] = visible[i];
+    }
+
+    bool Actors::seesPlayer (const MWWorld::Ptr& ptr)
+    {
+        std::map<MWWorld::Ptr, bool>::const_iterator iter = mSeesPlayer.find(ptr);
+        if(iter != mSeesPlayer.end())
+            return iter->second;
+
+        return MWBase::Environment::get().getWorld()->getLOS(ptr,MWBase::Environment::get().getWorld()->getPlayer().getPlayer());
+    }
+
     void Actors::updateNpc (const MWWorld::Ptr& ptr, float duration, bool paused)
     {
         if(!paused)
@@ -569,6 +604,8 @@ namespace MWMechanics
     {
         if (!paused)
         {
+            updateLineOfSight();
+
             for(PtrControllerMap::iterator iter(mActors.begin());iter != mActors.end();iter++)
             {
                 const MWWorld::Class &cls = MWWorld::Class::get(iter->first);
@@ -614,6 +651,8 @@ namespace MWMechanics
                 if(cls.isEssential(iter->first))
                     MWBase::Environment::get().getWindowManager()->messageBox("#{sKilledEssential}");
             }
+
+            mSeesPlayer.clear();
         }
 
         if(!paused)
@@ -30,6 +30,12 @@ namespace MWMechanics
 
             std::map<std::string, int> mDeathCount;
             MWWorld::Ptr mTorchPtr;
+            std::map<MWWorld::Ptr, bool> mSeesPlayer; // line of sight, during update()
+
+            void updateLineOfSight();
+            ///< Trace the line of sight to the player of all actors that may start combat in one go.
+
+            bool seesPlayer (const MWWorld::Ptr& ptr);
 
             void updateNpc(const MWWorld::Ptr &ptr, float duration, bool paused);
 
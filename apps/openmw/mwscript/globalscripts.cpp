@@ -36,43 +36,48 @@ namespace MWScript
         if (mScripts.find (name)==mScripts.end())
             if (const ESM::Script *script = mStore.get<ESM::Script>().find (name))
             {
-                Locals locals;
+                Script entry;
+                entry.mRunning = true;
+                entry.mSlot = -1;
+                entry.mLocals.configure (*script);
 
-                locals.configure (*script);
-
-                mScripts.insert (std::make_pair (name, std::make_pair (true, locals)));
+                mScripts.insert (std::make_pair (name, entry));
             }
     }
 
     void GlobalScripts::removeScript (const std::string& name)
     {
-        std::map<std::string, std::pair<bool, Locals> >::iterator iter = mScripts.find (name);
+        std::map<std::string, Script>::iterator iter = mScripts.find (name);
 
         if (iter!=mScripts.end())
-            iter->second.first = false;
+            iter->second.mRunning = false;
     }
 
     bool GlobalScripts::isRunning (const std::string& name) const
     {
-        std::map<std::string, std::pair<bool, Locals> >::const_iterator iter =
-            mScripts.find (name);
+        std::map<std::string, Script>::const_iterator iter = mScripts.find (name);
 
         if (iter==mScripts.end())
             return false;
 
-        return iter->second.first;
+        return iter->second.mRunning;
     }
 
     void GlobalScripts::run()
     {
-        for (std::map<std::string, std::pair<bool, Locals> >::iterator iter (mScripts.begin());
+        for (std::map<std::string, Script>::iterator iter (mScripts.begin());
             iter!=mScripts.end(); ++iter)
         {
-            if (iter->second.first)
+            if (iter->second.mRunning)
             {
+                MWBase::ScriptManager *scriptManager = MWBase::Environment::get().getScriptManager();
+
+                if (iter->second.mSlot==-1)
+                    iter->second.mSlot = scriptManager->getScriptSlot (iter->first);
+
                 MWScript::InterpreterContext interpreterContext (
-                    &iter->second.second, MWWorld::Ptr());
-                MWBase::Environment::get().getScriptManager()->run (iter->first, interpreterContext);
+                    &iter->second.mLocals, MWWorld::Ptr());
+                scriptManager->run (iter->second.mSlot, interpreterContext);
             }
         }
     }
@@ -15,8 +15,15 @@ namespace MWScript
 {
     class GlobalScripts
     {
+            struct Script
+            {
+                bool mRunning;
+                int mSlot; // see MWBase::ScriptManager::getScriptSlot; -1 until first run
+                Locals mLocals;
+            };
+
             const MWWorld::ESMStore& mStore;
-            std::map<std::string, std::pair<bool, Locals> > mScripts; // running, local variables
+            std::map<std::string, Script> mScripts;
 
         public:
 
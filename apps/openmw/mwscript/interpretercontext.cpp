@@ -55,10 +55,23 @@ namespace MWScript
         }
     }
 
+    Locals& InterpreterContext::getMemberLocals (const MWWorld::Ptr& ptr) const
+    {
+        if (!ptr.getRefData().hasLocals())
+        {
+            std::string scriptId = MWWorld::Class::get (ptr).getScript (ptr);
+
+            ptr.getRefData().setLocals (
+                *MWBase::Environment::get().getWorld()->getStore().get<ESM::Script>().find (scriptId));
+        }
+
+        return ptr.getRefData().getLocals();
+    }
+
     InterpreterContext::InterpreterContext (
         MWScript::Locals *locals, MWWorld::Ptr reference)
     : mLocals (locals), mReference (reference),
-      mActivationHandled (false)
+      mActivationHandled (false), mSecondsPassed (-1)
     {}
 
     int InterpreterContext::getLocalShort (int index) const
@@ -177,6 +190,45 @@ namespace MWScript
             MWBase::Environment::get().getWorld()->getGlobalVariable (name).mFloat = value;
     }
 
+    int InterpreterContext::getGlobalSlot (const std::string& name) const
+    {
+        if (name=="gamehour" || name=="day" || name=="month")
+            return -1;
+
+        return MWBase::Environment::get().getWorld()->getGlobalVariableIndex (name);
+    }
+
+    int InterpreterContext::getGlobalShort (int slot) const
+    {
+        return MWBase::Environment::get().getWorld()->getGlobalVariable (slot).mShort;
+    }
+
+    int InterpreterContext::getGlobalLong (int slot) const
+    {
+        // a global long is internally a float.
+        return MWBase::Environment::get().getWorld()->getGlobalVariable (slot).mLong;
+    }
+
+    float InterpreterContext::getGlobalFloat (int slot) const
+    {
+        return MWBase::Environment::get().getWorld()->getGlobalVariable (slot).mFloat;
+    }
+
+    void InterpreterContext::setGlobalShort (int slot, int value)
+    {
+        MWBase::Environment::get().getWorld()->getGlobalVariable (slot).mShort = value;
+    }
+
+    void InterpreterContext::setGlobalLong (int slot, int value)
+    {
+        MWBase::Environment::get().getWorld()->getGlobalVariable (slot).mLong = value;
+    }
+
+    void InterpreterContext::setGlobalFloat (int slot, float value)
+    {
+        MWBase::Environment::get().getWorld()->getGlobalVariable (slot).mFloat = value;
+    }
+
     std::vector<std::string> InterpreterContext::getGlobals () const
     {
         MWBase::World *world = MWBase::Environment::get().getWorld();
@@ -400,9 +452,17 @@ namespace MWScript
 
     float InterpreterContext::getSecondsPassed() const
     {
+        if (mSecondsPassed>=0)
+            return mSecondsPassed;
+
         return MWBase::Environment::get().getFrameDuration();
     }
 
+    void InterpreterContext::setSecondsPassed (float seconds)
+    {
+        mSecondsPassed = seconds;
+    }
+
     bool InterpreterContext::isDisabled (const std::string& id) const
     {
         const MWWorld::Ptr ref = getReference (id, false);
@@ -499,6 +559,51 @@ namespace MWScript
         ptr.getRefData().getLocals().mFloats[index] = value;
     }
 
+    int InterpreterContext::getMemberSlot (const std::string& id, const std::string& name,
+        char type) const
+    {
+        const MWWorld::Ptr ptr = getReference (id, false);
+
+        std::string scriptId = MWWorld::Class::get (ptr).getScript (ptr);
+
+        return MWBase::Environment::get().getScriptManager()->getLocalIndex (scriptId, name, type);
+    }
+
+    int InterpreterContext::getMemberShort (const std::string& id, int slot) const
+    {
+        return getMemberLocals (getReference (id, false)).mShorts[slot];
+    }
+
+    int InterpreterContext::getMemberLong (const std::string& id, int slot) const
+    {
+        return getMemberLocals (getReference (id, false)).mLongs[slot];
+    }
+
+    float InterpreterContext::getMemberFloat (const std::string& id, int slot) const
+    {
+        return getMemberLocals (getReference (id, false)).mFloats[slot];
+    }
+
+    void InterpreterContext::setMemberShort (const std::string& id, int slot, int value)
+    {
+        getMemberLocals (getReference (id, false)).mShorts[slot] = value;
+    }
+
+    void InterpreterContext::setMemberLong (const std::string& id, int slot, int value)
+    {
+        getMemberLocals (getReference (id, false)).mLongs[slot] = value;
+    }
+
+    void InterpreterContext::setMemberFloat (const std::string& id, int slot, float value)
+    {
+        getMemberLocals (getReference (id, false)).mFloats[slot] = value;
+    }
+
+    std::string InterpreterContext::getReferenceId() const
+    {
+        return mReference.isEmpty() ? "" : mReference.getCellRef().mRefID;
+    }
+
     MWWorld::Ptr InterpreterContext::getReference()
     {
         return getReference ("", true);
@@ -32,11 +32,15 @@ namespace MWScript
             MWWorld::Ptr mActivated;
             bool mActivationHandled;
             boost::shared_ptr<MWWorld::Action> mAction;
+            float mSecondsPassed; // -1: frame duration
 
             MWWorld::Ptr getReference (const std::string& id, bool activeOnly);
 
             const MWWorld::Ptr getReference (const std::string& id, bool activeOnly) const;
 
+            Locals& getMemberLocals (const MWWorld::Ptr& ptr) const;
+            ///< Return the local variables of \a ptr, configuring them first if necessary.
+
         public:
 
             InterpreterContext (MWScript::Locals *locals, MWWorld::Ptr reference);
@@ -75,6 +79,21 @@ namespace MWScript
             virtual void setGlobalLong (const std::string& name, int value);
 
             virtual void setGlobalFloat (const std::string& name, float value);
+
+            virtual int getGlobalSlot (const std::string& name) const;
+            ///< Variables, that are not simply stored, are accessed by name.
+
+            virtual int getGlobalShort (int slot) const;
+
+            virtual int getGlobalLong (int slot) const;
+
+            virtual float getGlobalFloat (int slot) const;
+
+            virtual void setGlobalShort (int slot, int value);
+
+            virtual void setGlobalLong (int slot, int value);
+
+            virtual void setGlobalFloat (int slot, float value);
             
             virtual std::vector<std::string> getGlobals () const;
 
@@ -132,6 +151,9 @@ namespace MWScript
 
             virtual float getSecondsPassed() const;
 
+            void setSecondsPassed (float seconds);
+            ///< Override the frame duration returned by getSecondsPassed().
+
             virtual bool isDisabled (const std::string& id = "") const;
 
             virtual void enable (const std::string& id = "");
@@ -150,6 +172,22 @@ namespace MWScript
 
             virtual void setMemberFloat (const std::string& id, const std::string& name, float value);
 
+            virtual int getMemberSlot (const std::string& id, const std::string& name, char type) const;
+
+            virtual int getMemberShort (const std::string& id, int slot) const;
+
+            virtual int getMemberLong (const std::string& id, int slot) const;
+
+            virtual float getMemberFloat (const std::string& id, int slot) const;
+
+            virtual void setMemberShort (const std::string& id, int slot, int value);
+
+            virtual void setMemberLong (const std::string& id, int slot, int value);
+
+            virtual void setMemberFloat (const std::string& id, int slot, float value);
+
+            virtual std::string getReferenceId() const;
+
             MWWorld::Ptr getReference();
             ///< Reference, that the script is running from (can be empty)
     };
@@ -701,6 +701,46 @@ namespace MWScript
         };
 
 
+        class OpToggleScriptProfiler : public Interpreter::Opcode0
+        {
+            public:
+                virtual void execute (Interpreter::Runtime& runtime)
+                {
+                    bool enabled = MWBase::Environment::get().getScriptManager()->toggleProfiler();
+
+                    runtime.getContext().report (enabled ? "Script Profiler -> On" : "Script Profiler -> Off");
+                }
+        };
+
+        class OpShowScriptProfile : public Interpreter::Opcode0
+        {
+            public:
+                virtual void execute (Interpreter::Runtime& runtime)
+                {
+                    std::stringstream str;
+
+                    MWBase::Environment::get().getScriptManager()->reportProfile (str, 10);
+
+                    runtime.getContext().report (str.str());
+                }
+        };
+
+        class OpBenchmarkMovement : public Interpreter::Opcode0
+        {
+            public:
+                virtual void execute (Interpreter::Runtime& runtime)
+                {
+                    Interpreter::Type_Integer frames = runtime[0].mInteger;
+                    runtime.pop();
+
+                    Interpreter::Type_Integer copies = runtime[0].mInteger;
+                    runtime.pop();
+
+                    runtime.getContext().report (
+                        MWBase::Environment::get().getWorld()->benchmarkMovement (frames, copies));
+                }
+        };
+
         void installOpcodes (Interpreter::Interpreter& interpreter)
         {
             interpreter.installSegment5 (Compiler::Misc::opcodeXBox, new OpXBox);
@@ -761,6 +801,9 @@ namespace MWScript
             interpreter.installSegment5 (Compiler::Misc::opcodeToggleGodMode, new OpToggleGodMode);
             interpreter.installSegment5 (Compiler::Misc::opcodeDisableLevitation, new OpEnableLevitation<false>);
             interpreter.installSegment5 (Compiler::Misc::opcodeEnableLevitation, new OpEnableLevitation<true>);
+            interpreter.installSegment5 (Compiler::Misc::opcodeToggleScriptProfiler, new OpToggleScriptProfiler);
+            interpreter.installSegment5 (Compiler::Misc::opcodeShowScriptProfile, new OpShowScriptProfile);
+            interpreter.installSegment5 (Compiler::Misc::opcodeBenchmarkMovement, new OpBenchmarkMovement);
         }
     }
 }
@@ -3,126 +3,277 @@
 
 #include <cassert>
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <exception>
+#include <ctime>
+
+#include <boost/filesystem/operations.hpp>
 
 #include <components/esm/loadscpt.hpp>
 #include "../mwworld/esmstore.hpp"
 
-#include <components/compiler/scanner.hpp>
 #include <components/compiler/context.hpp>
-#include <components/compiler/exception.hpp>
+#include <components/compiler/extensions.hpp>
+#include <components/compiler/batchcompiler.hpp>
+
+#include <components/interpreter/context.hpp>
+
+#include <components/settings/settings.hpp>
 
 #include "extensions.hpp"
 
 namespace MWScript
 {
     ScriptManager::ScriptManager (const MWWorld::ESMStore& store, bool verbose,
-        Compiler::Context& compilerContext)
+        Compiler::Context& compilerContext, const boost::filesystem::path& cacheDir,
+        const boost::filesystem::path& logDir,
+        const std::vector<boost::filesystem::path>& contentFiles)
     : mErrorHandler (std::cerr), mStore (store), mVerbose (verbose),
       mCompilerContext (compilerContext), mParser (mErrorHandler, mCompilerContext),
-      mOpcodesInstalled (false), mGlobalScripts (store)
-    {}
+      mOpcodesInstalled (false), mGlobalScripts (store),
+      mCache (*compilerContext.getExtensions()),
+      mCompileThreads (Settings::Manager::getInt ("script compile threads", "General")),
+      mSideEffects (0)
+    {
+        if (Settings::Manager::getBool ("script cache", "General"))
+        {
+            mCacheFile = cacheDir / "scripts.cache";
 
-    bool ScriptManager::compile (const std::string& name)
+            for (std::vector<boost::filesystem::path>::const_iterator iter (contentFiles.begin());
+                iter!=contentFiles.end(); ++iter)
+            {
+                // size and time are -1 for a file that can't be inspected
+                boost::system::error_code ec;
+                std::string path = iter->string();
+                uintmax_t size = boost::filesystem::file_size (*iter, ec);
+                std::time_t time = boost::filesystem::last_write_time (*iter, ec);
+
+                mCache.addToKey (path.c_str(), path.size()+1);
+                mCache.addToKey (&size, sizeof (size));
+                mCache.addToKey (&time, sizeof (time));
+            }
+
+            if (mCache.load (mCacheFile.string()))
+                std::cout << "Loaded " << mCache.size() << " scripts from " << mCacheFile.string() << std::endl;
+        }
+
+        if (Settings::Manager::getString ("script profile format", "General")=="json")
+            mProfileFile = logDir / "scriptprofile.json";
+        else
+            mProfileFile = logDir / "scriptprofile.csv";
+
+        if (Settings::Manager::getBool ("profile scripts", "General"))
+            mInterpreter.setProfiler (&mProfiler);
+    }
+
+    ScriptManager::~ScriptManager()
     {
-        mParser.reset();
-        mErrorHandler.reset();
+        // Keep the scripts that have been compiled during the game as well
+        saveCache();
+        saveProfile();
+    }
 
-        bool Success = true;
+    void ScriptManager::addScript (const std::string& name,
+        const std::vector<Interpreter::Type_Code>& code, const Compiler::Locals& locals)
+    {
+        CompiledScript& script = mSlots[getScriptSlot (name)];
 
-        if (const ESM::Script *script = mStore.get<ESM::Script>().find (name))
+        if (!script.mCompiled)
         {
-            if (mVerbose)
-                std::cout << "compiling script: " << name << std::endl;
+            script.mCompiled = true;
+            script.mByteCode = code;
+            script.mLocals = locals;
 
-            try
-            {
-                std::istringstream input (script->mScriptText);
+            // TODO sanity check on generated locals
+        }
+    }
 
-                Compiler::Scanner scanner (mErrorHandler, input, mCompilerContext.getExtensions());
+    void ScriptManager::saveCache()
+    {
+        if (mCacheFile.empty() || !mCache.isModified())
+            return;
 
-                scanner.scan (mParser);
+        boost::filesystem::path temp = mCacheFile.string() + ".tmp";
 
-                if (!mErrorHandler.isGood())
-                    Success = false;
-            }
-            catch (const Compiler::SourceException&)
-            {
-                // error has already been reported via error handler
-                Success = false;
-            }
-            catch (const std::exception& error)
-            {
-                std::cerr << "An exception has been thrown: " << error.what() << std::endl;
-                Success = false;
-            }
+        try
+        {
+            boost::filesystem::create_directories (mCacheFile.parent_path());
+            mCache.save (temp.string());
+            boost::filesystem::rename (temp, mCacheFile);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to write script cache: " << e.what() << std::endl;
 
-            if (!Success && mVerbose)
-            {
-                std::cerr
-                    << "compiling failed: " << name << std::endl
-                    << script->mScriptText
-                    << std::endl << std::endl;
-            }
+            boost::system::error_code ec;
+            boost::filesystem::remove (temp, ec);
+        }
+    }
+
+    void ScriptManager::saveProfile() const
+    {
+        if (mProfiler.empty())
+            return;
+
+        std::ofstream stream (mProfileFile.string().c_str());
+
+        if (!stream)
+        {
+            std::cerr << "Failed to write script profile to " << mProfileFile.string() << std::endl;
+            return;
+        }
+
+        if (mProfileFile.extension()==".json")
+            mProfiler.writeJson (stream, getOpcodeNames());
+        else
+            mProfiler.writeCsv (stream, getOpcodeNames());
+
+        std::cout << "Wrote script profile to " << mProfileFile.string() << std::endl;
+    }
+
+    Interpreter::Profiler::OpcodeNames ScriptManager::getOpcodeNames() const
+    {
+        Interpreter::Profiler::OpcodeNames names;
+
+        if (const Compiler::Extensions *extensions = mCompilerContext.getExtensions())
+            extensions->listOpcodes (names);
+
+        return names;
+    }
+
+    bool ScriptManager::compile (const std::string& name)
+    {
+        if (const ESM::Script *script = mStore.get<ESM::Script>().find (name))
+        {
+            std::vector<Interpreter::Type_Code> code;
+            Compiler::Locals locals;
 
-            if (Success)
+            if (!mCache.get (name, script->mScriptText, code, locals))
             {
-                std::vector<Interpreter::Type_Code> code;
-                mParser.getCode (code);
-                mScripts.insert (std::make_pair (name, std::make_pair (code, mParser.getLocals())));
+                if (mVerbose)
+                    std::cout << "compiling script: " << name << std::endl;
 
-                // TODO sanity check on generated locals
+                if (!Compiler::compile (script->mScriptText, mParser, mErrorHandler,
+                    mCompilerContext.getExtensions(), std::cerr))
+                {
+                    if (mVerbose)
+                        reportFailure (*script);
+
+                    return false;
+                }
 
-                return true;
+                mParser.getCode (code);
+                locals = mParser.getLocals();
+                mCache.set (name, script->mScriptText, code, locals);
             }
+
+            addScript (name, code, locals);
+            return true;
         }
 
         return false;
     }
 
-    void ScriptManager::run (const std::string& name, Interpreter::Context& interpreterContext)
+    int ScriptManager::getScriptSlot (const std::string& name)
     {
-        // compile script
         ScriptCollection::iterator iter = mScripts.find (name);
 
         if (iter==mScripts.end())
         {
-            if (!compile (name))
+            iter = mScripts.insert (std::make_pair (name, static_cast<int> (mSlots.size()))).first;
+            mSlots.push_back (CompiledScript (name));
+        }
+
+        return iter->second;
+    }
+
+    void ScriptManager::run (const std::string& name, Interpreter::Context& interpreterContext)
+    {
+        run (getScriptSlot (name), interpreterContext);
+    }
+
+    bool ScriptManager::prepare (CompiledScript& script)
+    {
+        // compile script
+        if (!script.mCompiled)
+        {
+            if (!compile (script.mName))
             {
                 // failed -> ignore script from now on.
-                std::vector<Interpreter::Type_Code> empty;
-                mScripts.insert (std::make_pair (name, std::make_pair (empty, Compiler::Locals())));
-                return;
+                script.mCompiled = true;
+                return false;
             }
+        }
+
+        if (script.mByteCode.empty())
+            return false;
 
-            iter = mScripts.find (name);
-            assert (iter!=mScripts.end());
+        if (!mOpcodesInstalled)
+        {
+            installOpcodes (mInterpreter);
+            mOpcodesInstalled = true;
         }
 
+        if (script.mProgram.empty())
+            mInterpreter.decode (&script.mByteCode[0], script.mByteCode.size(), script.mProgram);
+
+        return true;
+    }
+
+    void ScriptManager::run (int slot, Interpreter::Context& interpreterContext)
+    {
+        CompiledScript& script = mSlots.at (slot);
+
         // execute script
-        if (!iter->second.first.empty())
+        if (prepare (script))
             try
             {
-                if (!mOpcodesInstalled)
-                {
-                    installOpcodes (mInterpreter);
-                    mOpcodesInstalled = true;
-                }
+                if (mInterpreter.getProfiler())
+                    mProfiler.setScript (script.mName, interpreterContext.getReferenceId());
 
-                mInterpreter.run (&iter->second.first[0], iter->second.first.size(), interpreterContext);
+                if (!script.mProgram.isDeferrable())
+                    ++mSideEffects;
+
+                mInterpreter.run (script.mProgram, interpreterContext);
             }
             catch (const std::exception& e)
             {
-                std::cerr << "execution of script " << name << " failed." << std::endl;
+                std::cerr << "execution of script " << script.mName << " failed." << std::endl;
 
                 if (mVerbose)
                     std::cerr << "(" << e.what() << ")" << std::endl;
 
-                iter->second.first.clear(); // don't execute again.
+                script.mByteCode.clear(); // don't execute again.
+                script.mProgram.clear();
             }
     }
 
+    bool ScriptManager::isDeferrable (int slot)
+    {
+        CompiledScript& script = mSlots.at (slot);
+
+        return prepare (script) && script.mProgram.isDeferrable();
+    }
+
+    unsigned int ScriptManager::getSideEffectCount() const
+    {
+        return mSideEffects;
+    }
+
+    void ScriptManager::addSideEffect()
+    {
+        ++mSideEffects;
+    }
+
+    void ScriptManager::reportFailure (const ESM::Script& script) const
+    {
+        std::cerr
+            << "compiling failed: " << script.mId << std::endl
+            << script.mScriptText
+            << std::endl << std::endl;
+    }
+
     std::pair<int, int> ScriptManager::compileAll()
     {
         int count = 0;
@@ -131,9 +282,63 @@ namespace MWScript
         const MWWorld::Store<ESM::Script>& scripts = mStore.get<ESM::Script>();
         MWWorld::Store<ESM::Script>::iterator it = scripts.begin();
 
+        if (mCompileThreads==1)
+        {
+            for (; it != scripts.end(); ++it, ++count)
+                if (compile (it->mId))
+                    ++success;
+
+            saveCache();
+            return std::make_pair (count, success);
+        }
+
+        // The compilers query the locals of other scripts through mCompilerContext, so the
+        // scripts must not be changed while they are running. Apply the cached scripts first.
+        std::vector<const ESM::Script *> queued;
+
         for (; it != scripts.end(); ++it, ++count)
-            if (compile (it->mId))
+        {
+            std::vector<Interpreter::Type_Code> code;
+            Compiler::Locals locals;
+
+            if (mCache.get (it->mId, it->mScriptText, code, locals))
+            {
+                addScript (it->mId, code, locals);
+                ++success;
+            }
+            else
+                queued.push_back (&*it);
+        }
+
+        Compiler::BatchCompiler compiler (mCompilerContext, mCompileThreads>1 ? mCompileThreads : 0);
+
+        for (std::vector<const ESM::Script *>::const_iterator iter (queued.begin());
+            iter!=queued.end(); ++iter)
+            compiler.add ((*iter)->mId, (*iter)->mScriptText);
+
+        compiler.waitTillDone();
+
+        // collect the results in the order of the store, to keep the output deterministic
+        for (int i=0; i<compiler.size(); ++i)
+        {
+            const Compiler::BatchCompiler::Result& result = compiler.getResult (i);
+
+            if (mVerbose)
+                std::cout << "compiling script: " << result.mName << std::endl;
+
+            std::cerr << result.mMessages;
+
+            if (result.mSuccess)
+            {
+                addScript (result.mName, result.mCode, result.mLocals);
+                mCache.set (result.mName, queued[i]->mScriptText, result.mCode, result.mLocals);
                 ++success;
+            }
+            else if (mVerbose)
+                reportFailure (*queued[i]);
+        }
+
+        saveCache();
 
         return std::make_pair (count, success);
     }
@@ -143,8 +348,8 @@ namespace MWScript
         {
             ScriptCollection::iterator iter = mScripts.find (name);
 
-            if (iter!=mScripts.end())
-                return iter->second.second;
+            if (iter!=mScripts.end() && mSlots[iter->second].mCompiled)
+                return mSlots[iter->second].mLocals;
         }
 
         {
@@ -227,4 +432,15 @@ namespace MWScript
     {
         mGlobalScripts.reset();
     }
+
+    bool ScriptManager::toggleProfiler()
+    {
+        mInterpreter.setProfiler (mInterpreter.getProfiler() ? 0 : &mProfiler);
+        return mInterpreter.getProfiler()!=0;
+    }
+
+    void ScriptManager::reportProfile (std::ostream& stream, std::size_t count) const
+    {
+        mProfiler.report (stream, getOpcodeNames(), count);
+    }
 }
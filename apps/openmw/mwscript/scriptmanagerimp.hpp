@@ -2,12 +2,18 @@
 #define GAME_SCRIPT_SCRIPTMANAGER_H
 
 #include <map>
+#include <deque>
 #include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
 
 #include <components/compiler/streamerrorhandler.hpp>
 #include <components/compiler/fileparser.hpp>
+#include <components/compiler/codecache.hpp>
 
 #include <components/interpreter/interpreter.hpp>
+#include <components/interpreter/profiler.hpp>
 #include <components/interpreter/types.hpp>
 
 #include "../mwbase/scriptmanager.hpp"
@@ -19,6 +25,11 @@ namespace MWWorld
     struct ESMStore;
 }
 
+namespace ESM
+{
+    class Script;
+}
+
 namespace Compiler
 {
     class Context;
@@ -32,6 +43,16 @@ namespace Interpreter
 
 namespace MWScript
 {
+    /// \brief Compiles and runs scripts
+    ///
+    /// If the "script cache" setting is enabled, compiled scripts are kept in a cache file
+    /// in \a cacheDir, so that they don't have to be compiled again in later runs. The code of a
+    /// script depends on globals, IDs and the locals of other scripts, so the cache is dropped
+    /// whenever one of the \a contentFiles changes. compileAll() compiles the scripts on
+    /// "script compile threads" worker threads.
+    ///
+    /// While the profiler is enabled, scripts run through run() are timed. The results are
+    /// written to \a logDir on destruction.
     class ScriptManager : public MWBase::ScriptManager
     {
             Compiler::StreamErrorHandler mErrorHandler;
@@ -42,21 +63,75 @@ namespace MWScript
             Interpreter::Interpreter mInterpreter;
             bool mOpcodesInstalled;
 
-            typedef std::pair<std::vector<Interpreter::Type_Code>, Compiler::Locals> CompiledScript;
-            typedef std::map<std::string, CompiledScript> ScriptCollection;
+            struct CompiledScript
+            {
+                std::string mName;
+                bool mCompiled; // false until the script has been compiled or loaded from the cache
+                std::vector<Interpreter::Type_Code> mByteCode; // empty if compiling failed
+                Compiler::Locals mLocals;
+                Interpreter::Program mProgram; // decoded on first use
+
+                CompiledScript (const std::string& name) : mName (name), mCompiled (false) {}
+            };
 
-            ScriptCollection mScripts;
+            typedef std::map<std::string, int> ScriptCollection;
+
+            ScriptCollection mScripts; // slot by name
+            std::deque<CompiledScript> mSlots; // a deque keeps the byte code of the programs in place
             GlobalScripts mGlobalScripts;
             std::map<std::string, Compiler::Locals> mOtherLocals;
+            Compiler::CodeCache mCache;
+            boost::filesystem::path mCacheFile; // empty if the cache is disabled
+            int mCompileThreads;
+            Interpreter::Profiler mProfiler;
+            boost::filesystem::path mProfileFile;
+            unsigned int mSideEffects;
+
+            void addScript (const std::string& name, const std::vector<Interpreter::Type_Code>& code,
+                const Compiler::Locals& locals);
+
+            void saveCache();
+
+            void reportFailure (const ESM::Script& script) const;
+
+            bool prepare (CompiledScript& script);
+            ///< Compile and decode \a script, if necessary.
+            /// \return Can the script be run?
+
+            void saveProfile() const;
+
+            Interpreter::Profiler::OpcodeNames getOpcodeNames() const;
 
         public:
 
             ScriptManager (const MWWorld::ESMStore& store, bool verbose,
-                Compiler::Context& compilerContext);
+                Compiler::Context& compilerContext, const boost::filesystem::path& cacheDir,
+                const boost::filesystem::path& logDir,
+                const std::vector<boost::filesystem::path>& contentFiles);
+
+            virtual ~ScriptManager();
 
             virtual void run (const std::string& name, Interpreter::Context& interpreterContext);
             ///< Run the script with the given name (compile first, if not compiled yet)
 
+            virtual int getScriptSlot (const std::string& name);
+            ///< Return the slot of the script with the given name, which can be used to run it
+            /// without looking it up by name. The script does not have to be compiled yet.
+
+            virtual void run (int slot, Interpreter::Context& interpreterContext);
+            ///< Run the script in \a slot (compile first, if not compiled yet)
+
+            virtual bool isDeferrable (int slot);
+            ///< Does the script in \a slot only read the state of the game and change its own local
+            /// variables? (compile first, if not compiled yet)
+
+            virtual unsigned int getSideEffectCount() const;
+            ///< Return how often scripts that are not deferrable have been run so far.
+
+            virtual void addSideEffect();
+            ///< Note that a script that may have changed the state of the game has been run outside
+            /// of the script manager.
+
             virtual bool compile (const std::string& name);
             ///< Compile script with the given namen
             /// \return Success?
@@ -64,7 +139,7 @@ namespace MWScript
             virtual void resetGlobalScripts();
 
             virtual std::pair<int, int> compileAll();
-            ///< Compile all scripts
+            ///< Compile all scripts and update the cache file
             /// \return count, success
 
             virtual Compiler::Locals& getLocals (const std::string& name);
@@ -76,6 +151,13 @@ namespace MWScript
                 char type);
             ///< Return index of the variable of the given name and type in the given script. Will
             /// throw an exception, if there is no such script or variable or the type does not match.
+
+            virtual bool toggleProfiler();
+            ///< \return Is the profiler enabled now?
+
+            virtual void reportProfile (std::ostream& stream, std::size_t count) const;
+            ///< Write the \a count scripts, references and instructions that took the most time
+            /// to \a stream.
     };
 }
 
@@ -0,0 +1,154 @@
+#include "cellpreloader.hpp"
+
+#include <iostream>
+#include <memory>
+
+#include <components/to_utf8/to_utf8.hpp>
+
+#include "cellstore.hpp"
+
+namespace MWWorld
+{
+    /// Reads the references of one cell on a worker thread.
+    class CellPreloader::Job : public Misc::WorkItem
+    {
+            const ESM::Cell& mCell;
+            std::vector<ESM::ESMReader> mReaders;
+            std::auto_ptr<ToUTF8::Utf8Encoder> mEncoder;
+
+        public:
+
+            std::vector<ESM::CellRef> mRefs;
+            std::size_t mSize;
+
+            /// \note Must be called on the main thread
+            Job (const ESM::Cell& cell, const std::vector<ESM::ESMReader>& readers)
+            : mCell (cell), mReaders (readers.size()), mSize (0)
+            {
+                std::vector<bool> copied (readers.size(), false);
+
+                for (std::vector<ESM::ESM_Context>::const_iterator iter (cell.mContextList.begin());
+                    iter!=cell.mContextList.end(); ++iter)
+                {
+                    if (copied.at (iter->index))
+                        continue;
+
+                    copied[iter->index] = true;
+
+                    ESM::ESMReader& reader = mReaders[iter->index];
+                    reader = readers[iter->index];
+
+                    // Copies of a streamed reader share the stream, so the job needs its own.
+                    // Memory mapped readers keep their own position and can be used as they are.
+                    if (!reader.isMemoryMapped())
+                        reader.close();
+
+                    // The encoder keeps a conversion buffer and can't be shared either.
+                    if (!mEncoder.get() && reader.getEncoder())
+                        mEncoder.reset (new ToUTF8::Utf8Encoder (*reader.getEncoder()));
+                }
+            }
+
+        protected:
+
+            void doWork()
+            {
+                for (std::vector<ESM::ESMReader>::iterator iter (mReaders.begin());
+                    iter!=mReaders.end(); ++iter)
+                    iter->setEncoder (mEncoder.get());
+
+                CellStore::readRefs (mCell, mReaders, mRefs);
+
+                for (std::vector<ESM::ESMReader>::iterator iter (mReaders.begin());
+                    iter!=mReaders.end(); ++iter)
+                    iter->close();
+
+                mSize = mRefs.capacity() * sizeof (ESM::CellRef);
+
+                for (std::vector<ESM::CellRef>::const_iterator iter (mRefs.begin());
+                    iter!=mRefs.end(); ++iter)
+                    mSize += iter->mRefID.capacity() + iter->mOwner.capacity() +
+                        iter->mGlob.capacity() + iter->mSoul.capacity() + iter->mFaction.capacity() +
+                        iter->mKey.capacity() + iter->mTrap.capacity() + iter->mDestCell.capacity();
+            }
+    };
+
+    std::size_t CellPreloader::getMemoryUsage() const
+    {
+        std::size_t size = 0;
+
+        for (JobMap::const_iterator iter (mJobs.begin()); iter!=mJobs.end(); ++iter)
+            if (iter->second->isDone())
+                size += iter->second->mSize;
+
+        return size;
+    }
+
+    CellPreloader::CellPreloader (const std::vector<ESM::ESMReader>& readers, std::size_t memoryBudget)
+    : mReaders (readers), mMemoryBudget (memoryBudget), mQueue (1)
+    {}
+
+    CellPreloader::~CellPreloader()
+    {
+        clear();
+    }
+
+    void CellPreloader::preload (const ESM::Cell *cell)
+    {
+        if (mJobs.find (cell)!=mJobs.end() || getMemoryUsage()>=mMemoryBudget)
+            return;
+
+        Job *job = new Job (*cell, mReaders);
+        mJobs.insert (std::make_pair (cell, job));
+        mQueue.addWorkItem (job);
+    }
+
+    bool CellPreloader::isPreloading (const ESM::Cell *cell) const
+    {
+        return mJobs.find (cell)!=mJobs.end();
+    }
+
+    bool CellPreloader::take (const ESM::Cell *cell, std::vector<ESM::CellRef>& refs)
+    {
+        JobMap::iterator iter = mJobs.find (cell);
+
+        if (iter==mJobs.end())
+            return false;
+
+        std::auto_ptr<Job> job (iter->second);
+        mJobs.erase (iter);
+
+        job->waitTillDone();
+
+        std::string error = job->getError();
+
+        if (!error.empty())
+        {
+            std::cerr << "Failed to preload cell " << cell->getDescription() << ": " << error << std::endl;
+            return false;
+        }
+
+        refs.swap (job->mRefs);
+        return true;
+    }
+
+    const ESM::Cell *CellPreloader::getFinished() const
+    {
+        for (JobMap::const_iterator iter (mJobs.begin()); iter!=mJobs.end(); ++iter)
+            if (iter->second->isDone())
+                return iter->first;
+
+        return 0;
+    }
+
+    void CellPreloader::clear()
+    {
+        for (JobMap::iterator iter (mJobs.begin()); iter!=mJobs.end(); ++iter)
+        {
+            iter->second->waitTillDone();
+            delete iter->second;
+        }
+
+        mJobs.clear();
+    }
+}
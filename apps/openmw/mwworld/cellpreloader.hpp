@@ -0,0 +1,63 @@
+#ifndef GAME_MWWORLD_CELLPRELOADER_H
+#define GAME_MWWORLD_CELLPRELOADER_H
+
+#include <map>
+#include <vector>
+
+#include <components/esm/esmreader.hpp>
+#include <components/esm/loadcell.hpp>
+#include <components/misc/workqueue.hpp>
+
+namespace MWWorld
+{
+    /// \brief Reads the references of exterior cells on worker threads
+    ///
+    /// Only the content files are touched off the main thread. Resolving the references
+    /// against the ESMStore and attaching them to the scene is left to the caller.
+    class CellPreloader
+    {
+            class Job;
+
+            typedef std::map<const ESM::Cell *, Job *> JobMap;
+
+            const std::vector<ESM::ESMReader>& mReaders;
+            std::size_t mMemoryBudget;
+            JobMap mJobs;
+            Misc::WorkQueue mQueue;
+
+            CellPreloader (const CellPreloader&);
+            CellPreloader& operator= (const CellPreloader&);
+
+            /// Estimated size of the references held by finished jobs.
+            std::size_t getMemoryUsage() const;
+
+        public:
+
+            /// \param memoryBudget Upper limit in bytes for the references held for
+            /// cells that have not been taken yet.
+            CellPreloader (const std::vector<ESM::ESMReader>& readers, std::size_t memoryBudget);
+
+            ~CellPreloader();
+
+            /// Start reading the references of \a cell, unless this is already happening or
+            /// the memory budget is used up.
+            ///
+            /// \note \a cell must stay valid until it is taken or the preloader is cleared.
+            void preload (const ESM::Cell *cell);
+
+            bool isPreloading (const ESM::Cell *cell) const;
+
+            /// Hand over the references read for \a cell, waiting for the job if it is still
+            /// running.
+            /// \return Has \a cell been read successfully? If not, \a refs is left untouched.
+            bool take (const ESM::Cell *cell, std::vector<ESM::CellRef>& refs);
+
+            /// \return A cell whose references are ready to be taken, or 0 if there is none.
+            const ESM::Cell *getFinished() const;
+
+            /// Discard all preloaded references. Waits for running jobs.
+            void clear();
+    };
+}
+
+#endif
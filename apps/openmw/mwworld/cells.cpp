@@ -1,11 +1,16 @@
 #include "cells.hpp"
 
+#include <iostream>
+
+#include <components/settings/settings.hpp>
+
 #include "../mwbase/environment.hpp"
 #include "../mwbase/world.hpp"
 
 #include "class.hpp"
 #include "esmstore.hpp"
 #include "containerstore.hpp"
+#include "cellpreloader.hpp"
 
 MWWorld::Ptr::CellStore *MWWorld::Cells::getCellStore (const ESM::Cell *cell)
 {
@@ -36,34 +41,45 @@ MWWorld::Ptr::CellStore *MWWorld::Cells::getCellStore (const ESM::Cell *cell)
     }
 }
 
+MWWorld::Cells::IndexStats::IndexStats()
+: mHits (0), mMisses (0), mStale (0)
+{}
+
 void MWWorld::Cells::clear()
 {
+    if (mPreloader)
+        mPreloader->clear();
+
     mInteriors.clear();
     mExteriors.clear();
-    std::fill(mIdCache.begin(), mIdCache.end(), std::make_pair("", (MWWorld::Ptr::CellStore*)0));
-    mIdCacheIndex = 0;
+    mRefIndex.clear();
 }
 
-MWWorld::Ptr MWWorld::Cells::getPtrAndCache (const std::string& name, Ptr::CellStore& cellStore)
+MWWorld::Ptr MWWorld::Cells::indexed (const Ptr& ptr)
 {
-    Ptr ptr = getPtr (name, cellStore);
+    addToIndex (ptr);
+    return ptr;
+}
 
-    if (!ptr.isEmpty() && ptr.isInCell())
+MWWorld::Cells::Cells (const MWWorld::ESMStore& store, std::vector<ESM::ESMReader>& reader)
+: mStore (store), mReader (reader), mPreloader (0)
+{
+    if (Settings::Manager::getBool ("preload cells", "General"))
     {
-        mIdCache[mIdCacheIndex].first = name;
-        mIdCache[mIdCacheIndex].second = &cellStore;
-        if (++mIdCacheIndex>=mIdCache.size())
-            mIdCacheIndex = 0;
+        std::size_t budget = Settings::Manager::getInt ("preload memory budget", "General");
+        mPreloader = new CellPreloader (mReader, budget * 1024 * 1024);
     }
-
-    return ptr;
 }
 
-MWWorld::Cells::Cells (const MWWorld::ESMStore& store, std::vector<ESM::ESMReader>& reader)
-: mStore (store), mReader (reader),
-  mIdCache (40, std::pair<std::string, Ptr::CellStore *> ("", (Ptr::CellStore*)0)), /// \todo make cache size configurable
-  mIdCacheIndex (0)
-{}
+MWWorld::Cells::~Cells()
+{
+    if (mIndexStats.mHits || mIndexStats.mMisses)
+        std::cout
+            << "reference index: " << mIndexStats.mHits << " hits, " << mIndexStats.mMisses
+            << " misses, " << mIndexStats.mStale << " stale entries" << std::endl;
+
+    delete mPreloader;
+}
 
 MWWorld::Ptr::CellStore *MWWorld::Cells::getExterior (int x, int y)
 {
@@ -94,13 +110,56 @@ MWWorld::Ptr::CellStore *MWWorld::Cells::getExterior (int x, int y)
 
     if (result->second.mState!=Ptr::CellStore::State_Loaded)
     {
+        std::vector<ESM::CellRef> refs;
+
         // Multiple plugin support for landscape data is much easier than for references. The last plugin wins.
-        result->second.load (mStore, mReader);
+        if (mPreloader && mPreloader->take (result->second.mCell, refs))
+            result->second.load (mStore, refs);
+        else
+            result->second.load (mStore, mReader);
     }
 
     return &result->second;
 }
 
+void MWWorld::Cells::preloadExterior (int x, int y)
+{
+    if (!mPreloader)
+        return;
+
+    std::map<std::pair<int, int>, Ptr::CellStore>::const_iterator result =
+        mExteriors.find (std::make_pair (x, y));
+
+    if (result!=mExteriors.end() && result->second.mState==Ptr::CellStore::State_Loaded)
+        return;
+
+    const ESM::Cell *cell = mStore.get<ESM::Cell>().search (x, y);
+
+    // Cells without a record are made on the fly and have nothing to read.
+    if (cell && !cell->mContextList.empty())
+        mPreloader->preload (cell);
+}
+
+MWWorld::Ptr::CellStore *MWWorld::Cells::adoptPreloaded()
+{
+    if (!mPreloader)
+        return 0;
+
+    const ESM::Cell *cell = mPreloader->getFinished();
+
+    if (!cell)
+        return 0;
+
+    // The cell may have been loaded in the meantime, in which case the references are dropped.
+    std::vector<ESM::CellRef> refs;
+    Ptr::CellStore *cellStore = getCellStore (cell);
+
+    if (mPreloader->take (cell, refs))
+        cellStore->load (mStore, refs);
+
+    return cellStore;
+}
+
 MWWorld::Ptr::CellStore *MWWorld::Cells::getInterior (const std::string& name)
 {
     std::string lowerName = Misc::StringUtils::lowerCase(name);
@@ -140,64 +199,64 @@ MWWorld::Ptr MWWorld::Cells::getPtr (const std::string& name, Ptr::CellStore& ce
     }
 
     if (MWWorld::LiveCellRef<ESM::Activator> *ref = cell.mActivators.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Potion> *ref = cell.mPotions.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Apparatus> *ref = cell.mAppas.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Armor> *ref = cell.mArmors.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Book> *ref = cell.mBooks.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Clothing> *ref = cell.mClothes.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Container> *ref = cell.mContainers.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Creature> *ref = cell.mCreatures.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Door> *ref = cell.mDoors.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Ingredient> *ref = cell.mIngreds.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::CreatureLevList> *ref = cell.mCreatureLists.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::ItemLevList> *ref = cell.mItemLists.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Light> *ref = cell.mLights.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Lockpick> *ref = cell.mLockpicks.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Miscellaneous> *ref = cell.mMiscItems.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::NPC> *ref = cell.mNpcs.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Probe> *ref = cell.mProbes.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Repair> *ref = cell.mRepairs.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Static> *ref = cell.mStatics.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (MWWorld::LiveCellRef<ESM::Weapon> *ref = cell.mWeapons.find (name))
-        return Ptr (ref, &cell);
+        return indexed (Ptr (ref, &cell));
 
     if (searchInContainers)
         return cell.searchInContainer (name);
@@ -207,21 +266,11 @@ MWWorld::Ptr MWWorld::Cells::getPtr (const std::string& name, Ptr::CellStore& ce
 
 MWWorld::Ptr MWWorld::Cells::getPtr (const std::string& name)
 {
-    // First check the cache
-    for (std::vector<std::pair<std::string, Ptr::CellStore *> >::iterator iter (mIdCache.begin());
-        iter!=mIdCache.end(); ++iter)
-        if (iter->first==name && iter->second)
-        {
-            Ptr ptr = getPtr (name, *iter->second);
-            if (!ptr.isEmpty())
-                return ptr;
-        }
-
-    // Then check cells that are already listed
+    // First check cells that are already listed
     for (std::map<std::pair<int, int>, Ptr::CellStore>::iterator iter = mExteriors.begin();
         iter!=mExteriors.end(); ++iter)
     {
-        Ptr ptr = getPtrAndCache (name, iter->second);
+        Ptr ptr = getPtr (name, iter->second);
         if (!ptr.isEmpty())
             return ptr;
     }
@@ -229,7 +278,7 @@ MWWorld::Ptr MWWorld::Cells::getPtr (const std::string& name)
     for (std::map<std::string, Ptr::CellStore>::iterator iter = mInteriors.begin();
         iter!=mInteriors.end(); ++iter)
     {
-        Ptr ptr = getPtrAndCache (name, iter->second);
+        Ptr ptr = getPtr (name, iter->second);
         if (!ptr.isEmpty())
             return ptr;
     }
@@ -242,7 +291,7 @@ MWWorld::Ptr MWWorld::Cells::getPtr (const std::string& name)
     {
         Ptr::CellStore *cellStore = getCellStore (&(*iter));
 
-        Ptr ptr = getPtrAndCache (name, *cellStore);
+        Ptr ptr = getPtr (name, *cellStore);
 
         if (!ptr.isEmpty())
             return ptr;
@@ -252,7 +301,7 @@ MWWorld::Ptr MWWorld::Cells::getPtr (const std::string& name)
     {
         Ptr::CellStore *cellStore = getCellStore (&(*iter));
 
-        Ptr ptr = getPtrAndCache (name, *cellStore);
+        Ptr ptr = getPtr (name, *cellStore);
 
         if (!ptr.isEmpty())
             return ptr;
@@ -261,3 +310,49 @@ MWWorld::Ptr MWWorld::Cells::getPtr (const std::string& name)
     // giving up
     return Ptr();
 }
+
+MWWorld::Ptr MWWorld::Cells::searchIndex (const std::string& name)
+{
+    RefIndex::iterator iter = mRefIndex.find (name);
+
+    if (iter!=mRefIndex.end())
+    {
+        if (iter->second.getRefData().getCount()>0)
+        {
+            ++mIndexStats.mHits;
+            return iter->second;
+        }
+
+        mRefIndex.erase (iter);
+        ++mIndexStats.mStale;
+    }
+
+    ++mIndexStats.mMisses;
+    return Ptr();
+}
+
+void MWWorld::Cells::addToIndex (const Ptr& ptr)
+{
+    if (!ptr.isInCell())
+        return;
+
+    std::pair<RefIndex::iterator, bool> result =
+        mRefIndex.insert (std::make_pair (ptr.getCellRef().mRefID, ptr));
+
+    // Like a search through the cells, prefer the reference that has been there first.
+    if (!result.second && result.first->second.getRefData().getCount()<=0)
+        result.first->second = ptr;
+}
+
+void MWWorld::Cells::removeFromIndex (const Ptr& ptr)
+{
+    RefIndex::iterator iter = mRefIndex.find (ptr.getCellRef().mRefID);
+
+    if (iter!=mRefIndex.end() && iter->second==ptr)
+        mRefIndex.erase (iter);
+}
+
+const MWWorld::Cells::IndexStats& MWWorld::Cells::getIndexStats() const
+{
+    return mIndexStats;
+}
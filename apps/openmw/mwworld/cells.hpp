@@ -1,6 +1,14 @@
 #ifndef GAME_MWWORLD_CELLS_H
 #define GAME_MWWORLD_CELLS_H
 
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
 #include <map>
 #include <list>
 #include <string>
@@ -15,23 +23,45 @@ namespace ESM
 namespace MWWorld
 {
     class ESMStore;
+    class CellPreloader;
 
     /// \brief Cell container
     class Cells
     {
+        public:
+
+            struct IndexStats
+            {
+                std::size_t mHits;
+                std::size_t mMisses;
+                std::size_t mStale; ///< Entries dropped, because the reference had been deleted
+
+                IndexStats();
+            };
+
+        private:
+
+#if defined HAVE_UNORDERED_MAP
+            typedef std::unordered_map<std::string, Ptr> RefIndex;
+#else
+            typedef std::tr1::unordered_map<std::string, Ptr> RefIndex;
+#endif
+
             const MWWorld::ESMStore& mStore;
             std::vector<ESM::ESMReader>& mReader;
             std::map<std::string, CellStore> mInteriors;
             std::map<std::pair<int, int>, CellStore> mExteriors;
-            std::vector<std::pair<std::string, CellStore *> > mIdCache;
-            std::size_t mIdCacheIndex;
+            RefIndex mRefIndex; // references in cells by refID
+            IndexStats mIndexStats;
+            CellPreloader *mPreloader;
 
             Cells (const Cells&);
             Cells& operator= (const Cells&);
 
             CellStore *getCellStore (const ESM::Cell *cell);
 
-            Ptr getPtrAndCache (const std::string& name, CellStore& cellStore);
+            Ptr indexed (const Ptr& ptr);
+            ///< addToIndex (ptr) and return \a ptr.
 
         public:
 
@@ -41,14 +71,41 @@ namespace MWWorld
             ///< \todo pass the dynamic part of the ESMStore isntead (once it is written) of the whole
             /// world
 
+            ~Cells();
+
             CellStore *getExterior (int x, int y);
 
             CellStore *getInterior (const std::string& name);
 
+            void preloadExterior (int x, int y);
+            ///< Start reading the references of an exterior cell in the background, if preloading
+            /// is enabled and the cell has not been loaded yet.
+
+            CellStore *adoptPreloaded();
+            ///< Finish loading one exterior cell whose references have been read in the background.
+            /// \return The cell, or 0 if there was none to finish
+
             Ptr getPtr (const std::string& name, CellStore& cellStore, bool searchInContainers = false);
-            ///< \param searchInContainers Only affect loaded cells.
+            ///< References that are found in the cell itself are added to the index.
+            /// \param searchInContainers Only affect loaded cells.
 
             Ptr getPtr (const std::string& name);
+            ///< Search all cells, loading them if necessary.
+            /// \note The index is not consulted, use searchIndex() first.
+
+            Ptr searchIndex (const std::string& name);
+            ///< Look up a reference that has been found or inserted before. Entries of
+            /// references that have been deleted since are removed.
+            /// \return An empty Ptr, if \a name is not in the index.
+
+            void addToIndex (const Ptr& ptr);
+            ///< Index a reference in a cell under its refID, unless there already is an entry
+            /// for a reference with this refID that has not been deleted.
+
+            void removeFromIndex (const Ptr& ptr);
+            ///< Remove the entry for \a ptr, if there is one.
+
+            const IndexStats& getIndexStats() const;
     };
 }
 
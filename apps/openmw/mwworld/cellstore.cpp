@@ -38,13 +38,37 @@ namespace MWWorld
     void CellRefList<X>::load(ESM::CellRef &ref, const MWWorld::ESMStore &esmStore)
     {
         // Get existing reference, in case we need to overwrite it.
-        typename std::list<LiveRef>::iterator iter = std::find(mList.begin(), mList.end(), ref.mRefnum);
+        typename RefnumIndex::iterator index = mIndex.find(ref.mRefnum);
 
         // Skip this when reference was deleted.
         // TODO: Support respawning references, in this case, we need to track it somehow.
         if (ref.mDeleted) {
-            if (iter != mList.end())
-                mList.erase(iter);
+            if (index != mIndex.end())
+            {
+                std::size_t position = index->second;
+
+                mList.erase(mList.begin() + position);
+                mIndex.erase(index);
+
+                // The cell is still being loaded, so there are no Ptrs yet that could
+                // refer to the references that moved.
+                for (typename RefnumIndex::iterator iter = mIndex.begin(); iter != mIndex.end(); ++iter)
+                    if (iter->second > position)
+                        --iter->second;
+
+                for (typename IdIndex::iterator iter = mIdIndex.begin(); iter != mIdIndex.end(); ++iter)
+                {
+                    std::vector<std::size_t>& positions = iter->second;
+
+                    positions.erase (std::remove (positions.begin(), positions.end(), position),
+                        positions.end());
+
+                    for (std::vector<std::size_t>::iterator iter2 = positions.begin();
+                        iter2 != positions.end(); ++iter2)
+                        if (*iter2 > position)
+                            --*iter2;
+                }
+            }
             return;
         }
 
@@ -57,18 +81,32 @@ namespace MWWorld
         if (ptr == NULL) {
             std::cout << "Warning: could not resolve cell reference " << ref.mRefID << ", trying to continue anyway" << std::endl;
         } else {
-          if (iter != mList.end())
-            *iter = LiveRef(ref, ptr);
+          if (index != mIndex.end())
+          {
+            std::size_t position = index->second;
+
+            // A plugin may replace the reference with one of a different object.
+            if (mList[position].mRef.mRefID != ref.mRefID)
+            {
+                std::vector<std::size_t>& positions = mIdIndex[mList[position].mRef.mRefID];
+                positions.erase (std::find (positions.begin(), positions.end(), position));
+
+                std::vector<std::size_t>& newPositions = mIdIndex[ref.mRefID];
+                newPositions.insert (std::lower_bound (newPositions.begin(), newPositions.end(),
+                    position), position);
+            }
+
+            mList[position] = LiveRef(ref, ptr);
+          }
           else
+          {
+            mIndex.insert(std::make_pair(ref.mRefnum, mList.size()));
+            mIdIndex[ref.mRefID].push_back(mList.size());
             mList.push_back(LiveRef(ref, ptr));
+          }
         }
     }
 
-    template<typename X> bool operator==(const LiveCellRef<X>& ref, int pRefnum)
-    {
-        return (ref.mRef.mRefnum == pRefnum);
-    }
-
     CellStore::CellStore (const ESM::Cell *cell)
       : mCell (cell), mState (State_Unloaded)
     {
@@ -76,6 +114,19 @@ namespace MWWorld
     }
 
     void CellStore::load (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm)
+    {
+        if (mState!=State_Loaded)
+        {
+            std::vector<ESM::CellRef> refs;
+
+            if (mCell->mContextList.empty() == false) // skip dynamically generated cells
+                readRefs (*mCell, esm, refs);
+
+            load (store, refs);
+        }
+    }
+
+    void CellStore::load (const MWWorld::ESMStore &store, std::vector<ESM::CellRef> &refs)
     {
         if (mState!=State_Loaded)
         {
@@ -84,7 +135,7 @@ namespace MWWorld
 
             std::cout << "loading cell " << mCell->getDescription() << std::endl;
 
-            loadRefs (store, esm);
+            loadRefs (store, refs);
 
             mState = State_Loaded;
         }
@@ -133,69 +184,38 @@ namespace MWWorld
         std::sort (mIds.begin(), mIds.end());
     }
 
-    void CellStore::loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm)
+    void CellStore::readRefs (const ESM::Cell &cell, std::vector<ESM::ESMReader> &esm,
+        std::vector<ESM::CellRef> &refs)
     {
-      assert (mCell);
-
-        if (mCell->mContextList.empty())
-            return; // this is a dynamically generated cell -> skipping.
-
         // Load references from all plugins that do something with this cell.
-        for (size_t i = 0; i < mCell->mContextList.size(); i++)
+        for (size_t i = 0; i < cell.mContextList.size(); i++)
         {
             // Reopen the ESM reader and seek to the right position.
-            int index = mCell->mContextList.at(i).index;
-            mCell->restore (esm[index], i);
+            int index = cell.mContextList.at(i).index;
+            cell.restore (esm[index], i);
 
             ESM::CellRef ref;
 
             // Get each reference in turn
-            while(mCell->getNextRef(esm[index], ref))
+            while(cell.getNextRef(esm[index], ref))
             {
                 // Don't load reference if it was moved to a different cell.
-                std::string lowerCase = Misc::StringUtils::lowerCase(ref.mRefID);
-                ESM::MovedCellRefTracker::const_iterator iter = std::find(mCell->mMovedRefs.begin(), mCell->mMovedRefs.end(), ref.mRefnum);
-                if (iter != mCell->mMovedRefs.end()) {
+                ESM::MovedCellRefTracker::const_iterator iter = std::find(cell.mMovedRefs.begin(), cell.mMovedRefs.end(), ref.mRefnum);
+                if (iter != cell.mMovedRefs.end()) {
                     continue;
                 }
-                int rec = store.find(ref.mRefID);
-
-                ref.mRefID = lowerCase;
-
-            /* We can optimize this further by storing the pointer to the
-                record itself in store.all, so that we don't need to look it
-                up again here. However, never optimize. There are infinite
-                opportunities to do that later.
-            */
-            switch(rec)
-                {
-            case ESM::REC_ACTI: mActivators.load(ref, store); break;
-            case ESM::REC_ALCH: mPotions.load(ref, store); break;
-            case ESM::REC_APPA: mAppas.load(ref, store); break;
-            case ESM::REC_ARMO: mArmors.load(ref, store); break;
-            case ESM::REC_BOOK: mBooks.load(ref, store); break;
-            case ESM::REC_CLOT: mClothes.load(ref, store); break;
-            case ESM::REC_CONT: mContainers.load(ref, store); break;
-            case ESM::REC_CREA: mCreatures.load(ref, store); break;
-            case ESM::REC_DOOR: mDoors.load(ref, store); break;
-            case ESM::REC_INGR: mIngreds.load(ref, store); break;
-            case ESM::REC_LEVC: mCreatureLists.load(ref, store); break;
-            case ESM::REC_LEVI: mItemLists.load(ref, store); break;
-            case ESM::REC_LIGH: mLights.load(ref, store); break;
-            case ESM::REC_LOCK: mLockpicks.load(ref, store); break;
-            case ESM::REC_MISC: mMiscItems.load(ref, store); break;
-            case ESM::REC_NPC_: mNpcs.load(ref, store); break;
-            case ESM::REC_PROB: mProbes.load(ref, store); break;
-            case ESM::REC_REPA: mRepairs.load(ref, store); break;
-            case ESM::REC_STAT: mStatics.load(ref, store); break;
-            case ESM::REC_WEAP: mWeapons.load(ref, store); break;
 
-                case 0: std::cout << "Cell reference " + ref.mRefID + " not found!\n"; break;
-                default:
-                std::cout << "WARNING: Ignoring reference '" << ref.mRefID << "' of unhandled type\n";
-                }
+                refs.push_back (ref);
             }
         }
+    }
+
+    void CellStore::loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::CellRef> &refs)
+    {
+        assert (mCell);
+
+        for (std::vector<ESM::CellRef>::iterator it = refs.begin(); it != refs.end(); ++it)
+            loadRef (*it, store);
 
         // Load moved references, from separately tracked list.
         for (ESM::CellRefTracker::const_iterator it = mCell->mLeasedRefs.begin(); it != mCell->mLeasedRefs.end(); ++it)
@@ -204,22 +224,23 @@ namespace MWWorld
             ESM::CellRef &ref = const_cast<ESM::CellRef&>(*it);
             //ESM::CellRef &ref = const_cast<ESM::CellRef&>(it->second);
 
-            std::string lowerCase;
-
-            std::transform (ref.mRefID.begin(), ref.mRefID.end(), std::back_inserter (lowerCase),
-                (int(*)(int)) std::tolower);
+            loadRef (ref, store);
+        }
+    }
 
-            int rec = store.find(ref.mRefID);
+    void CellStore::loadRef (ESM::CellRef &ref, const MWWorld::ESMStore &store)
+    {
+        int rec = store.find(ref.mRefID);
 
-            ref.mRefID = lowerCase;
+        ref.mRefID = Misc::StringUtils::lowerCase(ref.mRefID);
 
-            /* We can optimize this further by storing the pointer to the
-                record itself in store.all, so that we don't need to look it
-                up again here. However, never optimize. There are infinite
-                opportunities to do that later.
-            */
-            switch(rec)
-                {
+        /* We can optimize this further by storing the pointer to the
+            record itself in store.all, so that we don't need to look it
+            up again here. However, never optimize. There are infinite
+            opportunities to do that later.
+        */
+        switch(rec)
+        {
             case ESM::REC_ACTI: mActivators.load(ref, store); break;
             case ESM::REC_ALCH: mPotions.load(ref, store); break;
             case ESM::REC_APPA: mAppas.load(ref, store); break;
@@ -241,11 +262,9 @@ namespace MWWorld
             case ESM::REC_STAT: mStatics.load(ref, store); break;
             case ESM::REC_WEAP: mWeapons.load(ref, store); break;
 
-                case 0: std::cout << "Cell reference " + ref.mRefID + " not found!\n"; break;
-                default:
+            case 0: std::cout << "Cell reference " + ref.mRefID + " not found!\n"; break;
+            default:
                 std::cout << "WARNING: Ignoring reference '" << ref.mRefID << "' of unhandled type\n";
-                }
-
         }
     }
 
@@ -1,9 +1,19 @@
 #ifndef GAME_MWWORLD_CELLSTORE_H
 #define GAME_MWWORLD_CELLSTORE_H
 
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
 #include <deque>
 #include <algorithm>
 
+#include <components/misc/segmentedvector.hpp>
+
 #include "livecellref.hpp"
 #include "esmstore.hpp"
 
@@ -15,9 +25,26 @@ namespace MWWorld
   struct CellRefList
   {
     typedef LiveCellRef<X> LiveRef;
-    typedef std::list<LiveRef> List;
+
+    /// References never move once they are in the list, so Ptrs to them stay valid.
+    typedef Misc::SegmentedVector<LiveRef> List;
     List mList;
 
+#if defined HAVE_UNORDERED_MAP
+    typedef std::unordered_map<int, std::size_t> RefnumIndex;
+    typedef std::unordered_map<std::string, std::vector<std::size_t> > IdIndex;
+#else
+    typedef std::tr1::unordered_map<int, std::size_t> RefnumIndex;
+    typedef std::tr1::unordered_map<std::string, std::vector<std::size_t> > IdIndex;
+#endif
+
+    /// Position in mList by refnum, for references added by load()
+    RefnumIndex mIndex;
+
+    /// Positions in mList by refID in ascending order, for references added by load() and
+    /// insert()
+    IdIndex mIdIndex;
+
     // Search for the given reference in the given reclist from
     // ESMStore. Insert the reference into the list if a match is
     // found. If not, throw an exception.
@@ -27,18 +54,28 @@ namespace MWWorld
     // all methods are known.
     void load(ESM::CellRef &ref, const MWWorld::ESMStore &esmStore);
 
+    /// \return The first reference with refID \a name that has not been deleted, or 0
     LiveRef *find (const std::string& name)
     {
-        for (typename std::list<LiveRef>::iterator iter (mList.begin()); iter!=mList.end(); ++iter)
+        typename IdIndex::const_iterator found = mIdIndex.find (name);
+
+        if (found==mIdIndex.end())
+            return 0;
+
+        for (std::vector<std::size_t>::const_iterator iter (found->second.begin());
+            iter!=found->second.end(); ++iter)
         {
-            if (iter->mData.getCount() > 0 && iter->mRef.mRefID == name)
-                return &*iter;
+            LiveRef& ref = mList[*iter];
+
+            if (ref.mData.getCount() > 0)
+                return &ref;
         }
 
         return 0;
     }
 
     LiveRef &insert(const LiveRef &item) {
+        mIdIndex[item.mRef.mRefID].push_back(mList.size());
         mList.push_back(item);
         return mList.back();
     }
@@ -86,6 +123,9 @@ namespace MWWorld
 
     void load (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
 
+    /// Load from references that have already been read with readRefs().
+    void load (const MWWorld::ESMStore &store, std::vector<ESM::CellRef> &refs);
+
     void preload (const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
 
     /// Call functor (ref) for each reference. functor must return a bool. Returning
@@ -133,6 +173,13 @@ namespace MWWorld
 
     Ptr searchInContainer (const std::string& id);
 
+    /// Read the references of \a cell, skipping the ones that were moved to another cell.
+    ///
+    /// Nothing is looked up in the ESMStore, so this may run on a worker thread, as long as
+    /// the readers are not used anywhere else at the same time.
+    static void readRefs (const ESM::Cell &cell, std::vector<ESM::ESMReader> &esm,
+        std::vector<ESM::CellRef> &refs);
+
   private:
 
     template<class Functor, class List>
@@ -152,7 +199,9 @@ namespace MWWorld
     /// Run through references and store IDs
     void listRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
 
-    void loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::ESMReader> &esm);
+    void loadRefs(const MWWorld::ESMStore &store, std::vector<ESM::CellRef> &refs);
+
+    void loadRef (ESM::CellRef &ref, const MWWorld::ESMStore &store);
 
   };
 }
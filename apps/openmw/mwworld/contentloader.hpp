@@ -27,6 +27,12 @@ struct ContentLoader
       mListener.setLabel(filepath.string());
     }
 
+    /// Called after all content files have been passed to load(). Loaders that
+    /// work in the background have to be done when this function returns.
+    virtual void finishLoading()
+    {
+    }
+
     protected:
         Loading::Listener& mListener;
 };
@@ -1,18 +1,115 @@
 #include "esmloader.hpp"
 #include "esmstore.hpp"
 
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+
+#include <boost/filesystem/operations.hpp>
+
+#include "components/esm/esmwriter.hpp"
 #include "components/to_utf8/to_utf8.hpp"
+#include "components/settings/settings.hpp"
+#include "components/misc/workqueue.hpp"
+
+namespace
+{
+  // Increase when the cache layout or any record's save()/load() changes
+  const int sCacheVersion = 1;
+
+  // FNV-1a
+  void hash(uint64_t& key, const void* data, size_t size)
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+      key ^= bytes[i];
+      key *= 1099511628211ULL;
+    }
+  }
+
+  void hash(uint64_t& key, const std::string& data)
+  {
+    hash(key, data.c_str(), data.size() + 1);
+  }
+}
 
 namespace MWWorld
 {
 
+/// Reads the records of one content file on a worker thread.
+class EsmLoader::StageJob : public Misc::WorkItem
+{
+    const MWWorld::ESMStore& mStore;
+    ESM::ESMReader mReader;
+    ESM::ESM_Context mContext;
+    ToUTF8::Utf8Encoder mEncoder;
+
+public:
+    std::string mName;
+    StagedContent mStaging;
+
+    /// \note Must be called on the main thread
+    StageJob(const MWWorld::ESMStore& store, ESM::ESMReader& reader, const ToUTF8::Utf8Encoder& encoder,
+        const std::string& name)
+      : mStore(store)
+      , mReader(reader)
+      , mContext(reader.getContext())
+      , mEncoder(encoder)
+      , mName(name)
+    {
+        // Copies of a streamed reader share the stream, so the job needs its own.
+        // Memory mapped readers keep their own position and can be used as they are.
+        if (!mReader.isMemoryMapped())
+            mReader.close();
+    }
+
+protected:
+    void doWork()
+    {
+        mReader.setEncoder(&mEncoder);
+        mReader.restoreContext(mContext);
+        mStore.stage(mReader, mStaging);
+
+        // Don't keep the file open until the job is deleted
+        mReader.close();
+    }
+};
+
 EsmLoader::EsmLoader(MWWorld::ESMStore& store, std::vector<ESM::ESMReader>& readers,
-  ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener)
+  ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener,
+  const boost::filesystem::path& cacheDir)
   : ContentLoader(listener)
   , mStore(store)
   , mEsm(readers)
   , mEncoder(encoder)
+  , mWorkQueue(0)
+  , mUseCache(Settings::Manager::getBool("content cache", "General"))
+  , mCacheFile(cacheDir / "content.cache")
+  , mCacheKey(14695981039346656037ULL)
 {
+  int threads = Settings::Manager::getInt("content loading threads", "General");
+
+  if (threads != 1)
+    mWorkQueue = new Misc::WorkQueue(threads > 1 ? threads : 0);
+
+  hash(mCacheKey, &sCacheVersion, sizeof(sCacheVersion));
+
+  // Strings in the cache are stored in the legacy encoding, so a different
+  // encoding setting has to invalidate it.
+  std::string legacy;
+  for (int i = 0x80; i <= 0xff; ++i)
+    legacy += static_cast<char>(i);
+  hash(mCacheKey, mEncoder->getUtf8(legacy.c_str(), legacy.size()));
+}
+
+EsmLoader::~EsmLoader()
+{
+  // Stop the workers before deleting the jobs they might be processing
+  delete mWorkQueue;
+
+  for (std::vector<StageJob*>::iterator it = mJobs.begin(); it != mJobs.end(); ++it)
+    delete *it;
 }
 
 void EsmLoader::load(const boost::filesystem::path& filepath, int& index)
@@ -23,9 +120,179 @@ void EsmLoader::load(const boost::filesystem::path& filepath, int& index)
   lEsm.setEncoder(mEncoder);
   lEsm.setIndex(index);
   lEsm.setGlobalReaderList(&mEsm);
+  lEsm.setMemoryMapped(Settings::Manager::getBool("memory mapped content", "General"));
   lEsm.open(filepath.string());
   mEsm[index] = lEsm;
-  mStore.load(mEsm[index], &mListener);
+
+  // Later files look up their masters in the reader list, so this can't wait.
+  // Loading cell references needs this as well, even if the records come from the cache.
+  ESMStore::resolveMasters(mEsm[index]);
+
+  if (mUseCache)
+  {
+    hash(mCacheKey, filepath.string());
+
+    uintmax_t size = boost::filesystem::file_size(filepath);
+    std::time_t time = boost::filesystem::last_write_time(filepath);
+    hash(mCacheKey, &size, sizeof(size));
+    hash(mCacheKey, &time, sizeof(time));
+
+    mDeferred.push_back(std::make_pair(index, filepath.filename().string()));
+    return;
+  }
+
+  stage(index, filepath.filename().string());
+}
+
+void EsmLoader::stage(int index, const std::string& name)
+{
+  if (!mWorkQueue)
+  {
+    mListener.setLabel(name);
+    mStore.load(mEsm[index], &mListener);
+    return;
+  }
+
+  StageJob* job = new StageJob(mStore, mEsm[index], *mEncoder, name);
+  mJobs.push_back(job);
+  mWorkQueue->addWorkItem(job);
+}
+
+void EsmLoader::finishLoading()
+{
+  if (mUseCache)
+  {
+    if (readCache())
+      return;
+
+    for (std::vector<std::pair<int, std::string> >::const_iterator it = mDeferred.begin();
+      it != mDeferred.end(); ++it)
+    {
+      stage(it->first, it->second);
+    }
+  }
+
+  for (std::vector<StageJob*>::iterator it = mJobs.begin(); it != mJobs.end(); ++it)
+  {
+    StageJob* job = *it;
+
+    mListener.setLabel(job->mName);
+
+    while (!job->waitTillDone(50))
+      mListener.indicateProgress();
+
+    std::string error = job->getError();
+    if (!error.empty())
+      throw std::runtime_error(error);
+
+    mStore.merge(job->mStaging, &mListener);
+
+    delete job;
+    *it = 0;
+  }
+
+  mJobs.clear();
+
+  if (mUseCache)
+    writeCache();
+}
+
+bool EsmLoader::readCache()
+{
+  if (!boost::filesystem::exists(mCacheFile))
+    return false;
+
+  ESM::ESMReader reader;
+  reader.setEncoder(mEncoder);
+  reader.setGlobalReaderList(&mEsm);
+  reader.setIndex(mEsm.size());
+  reader.setMemoryMapped(true);
+
+  try
+  {
+    reader.open(mCacheFile.string());
+
+    uint64_t key = 0;
+    if (reader.hasMoreRecs() && reader.getRecName() == "XKEY")
+    {
+      reader.getRecHeader();
+      reader.getHNT(key, "DATA");
+    }
+
+    if (key != mCacheKey)
+    {
+      std::cout << "Content files have changed, ignoring " << mCacheFile.string() << std::endl;
+      return false;
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Ignoring content cache: " << e.what() << std::endl;
+    return false;
+  }
+
+  std::cout << "Loading content cache " << mCacheFile.string() << std::endl;
+  mListener.setLabel(mCacheFile.filename().string());
+
+  try
+  {
+    mStore.readCache(reader, &mListener);
+  }
+  catch (const std::exception& e)
+  {
+    // The store is partially filled at this point, so there is no way to fall back
+    // to the content files. At least make sure the next start works.
+    reader.close();
+    boost::system::error_code ec;
+    boost::filesystem::remove(mCacheFile, ec);
+    throw std::runtime_error(std::string("Failed to load content cache, it has been removed: ") + e.what());
+  }
+
+  return true;
+}
+
+void EsmLoader::writeCache()
+{
+  boost::filesystem::path temp = mCacheFile.string() + ".tmp";
+
+  try
+  {
+    boost::filesystem::create_directories(mCacheFile.parent_path());
+
+    {
+      std::ofstream stream(temp.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!stream)
+        throw std::runtime_error("can't open " + temp.string());
+
+      ESM::ESMWriter writer;
+      writer.setEncoder(mEncoder);
+      writer.setVersion();
+      writer.setFormat(0);
+      writer.setRecordCount(0);
+      writer.setAuthor("OpenMW");
+      writer.setDescription("Content cache");
+      writer.save(stream);
+
+      writer.startRecord("XKEY");
+      writer.writeHNT("DATA", mCacheKey);
+      writer.endRecord("XKEY");
+
+      mStore.writeCache(writer);
+      writer.close();
+
+      if (!stream.flush())
+        throw std::runtime_error("can't write " + temp.string());
+    }
+
+    boost::filesystem::rename(temp, mCacheFile);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Failed to write content cache: " << e.what() << std::endl;
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(temp, ec);
+  }
 }
 
 } /* namespace MWWorld */
@@ -2,6 +2,9 @@
 #define ESMLOADER_HPP
 
 #include <vector>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
 
 #include "contentloader.hpp"
 #include "components/esm/esmreader.hpp"
@@ -11,22 +14,70 @@ namespace ToUTF8
   class Utf8Encoder;
 }
 
+namespace Misc
+{
+  class WorkQueue;
+}
+
 namespace MWWorld
 {
 
 class ESMStore;
 
+/// Loads esm/esp files into an ESMStore.
+///
+/// Unless the "content loading threads" setting is 1, the records of each file
+/// are read on worker threads and merged into the store in load order by
+/// finishLoading().
+///
+/// If the "content cache" setting is enabled, the merged store is written to a cache
+/// file in \a cacheDir. As long as the content files don't change, later runs only
+/// open the content files and read their records from the cache instead.
 struct EsmLoader : public ContentLoader
 {
     EsmLoader(MWWorld::ESMStore& store, std::vector<ESM::ESMReader>& readers,
-      ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener);
+      ToUTF8::Utf8Encoder* encoder, Loading::Listener& listener,
+      const boost::filesystem::path& cacheDir);
+
+    ~EsmLoader();
 
     void load(const boost::filesystem::path& filepath, int& index);
 
+    void finishLoading();
+
     private:
+      class StageJob;
+
+      EsmLoader(const EsmLoader&);
+      EsmLoader& operator= (const EsmLoader&);
+
+      /// Load the records of an opened content file, or queue them for loading
+      void stage(int index, const std::string& name);
+
+      /// \return false if there is no cache file for the current content files
+      bool readCache();
+
+      void writeCache();
+
       std::vector<ESM::ESMReader>& mEsm;
       MWWorld::ESMStore& mStore;
       ToUTF8::Utf8Encoder* mEncoder;
+
+      // 0 if content files are loaded on the main thread
+      Misc::WorkQueue* mWorkQueue;
+
+      // Files that have not been merged yet, in load order
+      std::vector<StageJob*> mJobs;
+
+      bool mUseCache;
+      boost::filesystem::path mCacheFile;
+
+      // Hash of the content files, their sizes and modification times
+      uint64_t mCacheKey;
+
+      // Files that have been opened, but not staged yet, because they may be loaded
+      // from the cache
+      std::vector<std::pair<int, std::string> > mDeferred;
 };
 
 } /* namespace MWWorld */
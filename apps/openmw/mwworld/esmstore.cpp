@@ -10,6 +10,37 @@
 namespace MWWorld
 {
 
+StagedContent::~StagedContent()
+{
+    clear();
+}
+
+void StagedContent::clear()
+{
+    for (std::vector<Record>::iterator iter (mRecords.begin()); iter!=mRecords.end(); ++iter)
+        delete iter->mRecord;
+
+    mRecords.clear();
+}
+
+void StagedContent::add(int type, const std::string& id, StagedRecord *record)
+{
+    Record entry;
+    entry.mType = type;
+    entry.mId = id;
+    entry.mRecord = record;
+
+    try
+    {
+        mRecords.push_back(entry);
+    }
+    catch (...)
+    {
+        delete record;
+        throw;
+    }
+}
+
 static bool isCacheableRecord(int id)
 {
     if (id == ESM::REC_ACTI || id == ESM::REC_ALCH || id == ESM::REC_APPA || id == ESM::REC_ARMO ||
@@ -25,12 +56,15 @@ static bool isCacheableRecord(int id)
 
 void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
 {
-    listener->setProgressRange(1000);
-
-    std::set<std::string> missing;
+    resolveMasters(esm);
 
-    ESM::Dialogue *dialogue = 0;
+    StagedContent staging;
+    stage(esm, staging, listener);
+    merge(staging);
+}
 
+void ESMStore::resolveMasters(ESM::ESMReader &esm)
+{
     /// \todo Move this to somewhere else. ESMReader?
     // Cache parent esX files by tracking their indices in the global list of
     //  all files/readers used by the engine. This will greaty accelerate
@@ -58,6 +92,17 @@ void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
         }
         mast.index = index;
     }
+}
+
+void ESMStore::stage(ESM::ESMReader &esm, StagedContent &staging, Loading::Listener* listener) const
+{
+    if (listener)
+        listener->setProgressRange(1000);
+
+    std::set<std::string> missing;
+
+    // Infos belong to the last dialogue record
+    bool dialogue = false;
 
     // Loop through all records
     while(esm.hasMoreRecs())
@@ -66,23 +111,24 @@ void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
         esm.getRecHeader();
 
         // Look up the record type.
-        std::map<int, StoreBase *>::iterator it = mStores.find(n.val);
+        std::map<int, StoreBase *>::const_iterator it = mStores.find(n.val);
 
         if (it == mStores.end()) {
             if (n.val == ESM::REC_INFO) {
                 std::string id = esm.getHNOString("INAM");
                 if (dialogue) {
-                    dialogue->mInfo.push_back(ESM::DialInfo());
-                    dialogue->mInfo.back().mId = id;
-                    dialogue->mInfo.back().load(esm);
+                    std::auto_ptr<Staged<ESM::DialInfo> > info(new Staged<ESM::DialInfo>);
+                    info->mRecord.mId = id;
+                    info->mRecord.load(esm);
+                    staging.add(n.val, id, info.release());
                 } else {
                     std::cerr << "error: info record without dialog" << std::endl;
                     esm.skipRecord();
                 }
             } else if (n.val == ESM::REC_MGEF) {
-                mMagicEffects.load (esm);
+                staging.add(n.val, "", mMagicEffects.read(esm));
             } else if (n.val == ESM::REC_SKIL) {
-                mSkills.load (esm);
+                staging.add(n.val, "", mSkills.read(esm));
             } else {
                 // Not found (this would be an error later)
                 esm.skipRecord();
@@ -96,22 +142,15 @@ void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
             //  on the structure will (probably) fail.
             if (esm.isNextSub("DELE")) {
               esm.skipRecord();
-              it->second->eraseStatic(id);
+              staging.add(n.val, id, 0);
               continue;
             }
-            it->second->load(esm, id);
+            staging.add(n.val, id, it->second->read(esm, id));
 
-            if (n.val==ESM::REC_DIAL) {
-                dialogue = const_cast<ESM::Dialogue*>(mDialogs.find(id));
-            } else {
-                dialogue = 0;
-            }
-            // Insert the reference into the global lookup
-            if (!id.empty() && isCacheableRecord(n.val)) {
-                mIds[id] = n.val;
-            }
+            dialogue = (n.val==ESM::REC_DIAL);
         }
-        listener->setProgress(esm.getFileOffset() / (float)esm.getFileSize() * 1000);
+        if (listener)
+            listener->setProgress(esm.getFileOffset() / (float)esm.getFileSize() * 1000);
     }
 
   /* This information isn't needed on screen. But keep the code around
@@ -128,6 +167,123 @@ void ESMStore::load(ESM::ESMReader &esm, Loading::Listener* listener)
   */
 }
 
+void ESMStore::merge(StagedContent &staging, Loading::Listener* listener)
+{
+    if (listener)
+        listener->setProgressRange(1000);
+
+    ESM::Dialogue *dialogue = 0;
+
+    size_t count = staging.mRecords.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        StagedContent::Record &record = staging.mRecords[i];
+
+        std::map<int, StoreBase *>::iterator it = mStores.find(record.mType);
+
+        if (it == mStores.end()) {
+            if (record.mType == ESM::REC_INFO) {
+                if (dialogue)
+                    dialogue->mInfo.push_back(static_cast<Staged<ESM::DialInfo> *>(record.mRecord)->mRecord);
+            } else if (record.mType == ESM::REC_MGEF) {
+                mMagicEffects.insertStaged(*record.mRecord);
+            } else if (record.mType == ESM::REC_SKIL) {
+                mSkills.insertStaged(*record.mRecord);
+            }
+        } else if (!record.mRecord) {
+            it->second->eraseStatic(record.mId);
+        } else {
+            it->second->insertStaged(*record.mRecord);
+
+            if (record.mType==ESM::REC_DIAL) {
+                dialogue = const_cast<ESM::Dialogue*>(mDialogs.find(record.mId));
+            } else {
+                dialogue = 0;
+            }
+            // Insert the reference into the global lookup
+            if (!record.mId.empty() && isCacheableRecord(record.mType)) {
+                mIds[record.mId] = record.mType;
+            }
+        }
+
+        // Free memory as we go, the staged copy is not needed anymore
+        delete record.mRecord;
+        record.mRecord = 0;
+
+        if (listener)
+            listener->setProgress((i+1) * 1000 / count);
+    }
+
+    staging.clear();
+}
+
+void ESMStore::writeCache(ESM::ESMWriter &writer) const
+{
+    for (std::map<int, StoreBase *>::const_iterator it = mStores.begin(); it != mStores.end(); ++it) {
+        ESM::NAME name;
+        name.val = it->first;
+        it->second->writeCache(writer, name.toString());
+    }
+
+    mMagicEffects.writeCache(writer, "MGEF");
+    mSkills.writeCache(writer, "SKIL");
+
+    writer.startRecord("XIDS");
+    for (std::map<std::string, int>::const_iterator it = mIds.begin(); it != mIds.end(); ++it) {
+        writer.writeHNCString("NAME", it->first);
+        writer.writeHNT("INTV", it->second);
+    }
+    writer.endRecord("XIDS");
+}
+
+void ESMStore::readCache(ESM::ESMReader &esm, Loading::Listener* listener)
+{
+    if (listener)
+        listener->setProgressRange(1000);
+
+    ESM::Dialogue *dialogue = 0;
+
+    while(esm.hasMoreRecs())
+    {
+        ESM::NAME n = esm.getRecName();
+        esm.getRecHeader();
+
+        std::map<int, StoreBase *>::iterator it = mStores.find(n.val);
+
+        if (it != mStores.end()) {
+            std::string id = esm.getHNOString("NAME");
+            it->second->readCache(esm, id);
+
+            if (n.val == ESM::REC_DIAL) {
+                dialogue = const_cast<ESM::Dialogue*>(mDialogs.find(id));
+            } else {
+                dialogue = 0;
+            }
+        } else if (n.val == ESM::REC_INFO) {
+            if (!dialogue)
+                esm.fail("info record without dialog");
+            ESM::DialInfo info;
+            info.mId = esm.getHNOString("INAM");
+            info.load(esm);
+            dialogue->mInfo.push_back(info);
+        } else if (n.val == ESM::REC_MGEF) {
+            mMagicEffects.load(esm);
+        } else if (n.val == ESM::REC_SKIL) {
+            mSkills.load(esm);
+        } else if (n == "XIDS") {
+            while (esm.hasMoreSubs()) {
+                std::string id = esm.getHNString("NAME");
+                esm.getHNT(mIds[id], "INTV");
+            }
+        } else {
+            esm.fail("unknown record in content cache");
+        }
+
+        if (listener)
+            listener->setProgress(esm.getFileOffset() / (float)esm.getFileSize() * 1000);
+    }
+}
+
 void ESMStore::setUp()
 {
     std::map<int, StoreBase *>::iterator it = mStores.begin();
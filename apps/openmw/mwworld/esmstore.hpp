@@ -13,6 +13,39 @@ namespace Loading
 
 namespace MWWorld
 {
+    /// Records of a single content file that have been read, but not merged into an
+    /// ESMStore yet. See ESMStore::stage() and ESMStore::merge().
+    class StagedContent
+    {
+            struct Record
+            {
+                int mType;
+                std::string mId;
+
+                // 0 for deleted records
+                StagedRecord *mRecord;
+            };
+
+            std::vector<Record> mRecords;
+
+            StagedContent(const StagedContent&);
+            StagedContent& operator= (const StagedContent&);
+
+            void add(int type, const std::string& id, StagedRecord *record);
+
+            friend class ESMStore;
+
+        public:
+
+            StagedContent() {}
+
+            ~StagedContent();
+
+            void clear();
+
+            size_t getSize() const { return mRecords.size(); }
+    };
+
     class ESMStore
     {
         Store<ESM::Activator>       mActivators;
@@ -165,6 +198,30 @@ namespace MWWorld
 
         void load(ESM::ESMReader &esm, Loading::Listener* listener);
 
+        /// Map the master files of \a esm to indices into its global reader list.
+        /// All masters have to be opened already.
+        static void resolveMasters(ESM::ESMReader &esm);
+
+        /// Read all records of \a esm into \a staging, without modifying the store.
+        /// Safe to call from multiple threads at once, as long as each thread uses
+        /// its own reader and encoder. Masters have to be resolved already.
+        /// \param listener Receives progress updates, if not 0.
+        void stage(ESM::ESMReader &esm, StagedContent &staging, Loading::Listener* listener = 0) const;
+
+        /// Add records read by stage(). Content files have to be merged in load order.
+        /// \param listener Receives progress updates, if not 0.
+        void merge(StagedContent &staging, Loading::Listener* listener = 0);
+
+        /// Write all records loaded from content files, in a form readCache() understands.
+        /// Has to be called before anything else modifies the store.
+        void writeCache(ESM::ESMWriter &writer) const;
+
+        /// Load the records written by writeCache(), instead of loading the content files
+        /// they came from. The readers of the content files have to be in the global
+        /// reader list of \a esm, as records keep referring to them.
+        /// \param listener Receives progress updates, if not 0.
+        void readCache(ESM::ESMReader &esm, Loading::Listener* listener = 0);
+
         template <class T>
         const Store<T> &get() const {
             throw std::runtime_error("Storage for this type not exist");
@@ -10,32 +10,22 @@ namespace MWWorld
     std::vector<std::string> Globals::getGlobals () const
     {
         std::vector<std::string> retval;
-        Collection::const_iterator it;
-        for(it = mVariables.begin(); it != mVariables.end(); ++it){
+        std::map<std::string, int>::const_iterator it;
+        for(it = mIndices.begin(); it != mIndices.end(); ++it){
             retval.push_back(it->first);
         }
 
         return retval;
     }
 
-    Globals::Collection::const_iterator Globals::find (const std::string& name) const
+    int Globals::find (const std::string& name) const
     {
-        Collection::const_iterator iter = mVariables.find (name);
+        std::map<std::string, int>::const_iterator iter = mIndices.find (name);
 
-        if (iter==mVariables.end())
+        if (iter==mIndices.end())
             throw std::runtime_error ("unknown global variable: " + name);
 
-        return iter;
-    }
-
-    Globals::Collection::iterator Globals::find (const std::string& name)
-    {
-        Collection::iterator iter = mVariables.find (name);
-
-        if (iter==mVariables.end())
-            throw std::runtime_error ("unknown global variable: " + name);
-
-        return iter;
+        return iter->second;
     }
 
     Globals::Globals (const MWWorld::ESMStore& store)
@@ -72,33 +62,50 @@ namespace MWWorld
                     throw std::runtime_error ("unsupported global variable type");
             }
 
-            mVariables.insert (std::make_pair (iter->mId, std::make_pair (type, value)));
+            if (mIndices.insert (std::make_pair (iter->mId, mVariables.size())).second)
+                mVariables.push_back (std::make_pair (type, value));
         }
     }
 
     const Globals::Data& Globals::operator[] (const std::string& name) const
     {
-        Collection::const_iterator iter = find (name);
-
-        return iter->second.second;
+        return mVariables[find (name)].second;
     }
 
     Globals::Data& Globals::operator[] (const std::string& name)
     {
-        Collection::iterator iter = find (name);
+        return mVariables[find (name)].second;
+    }
+
+    const Globals::Data& Globals::operator[] (int index) const
+    {
+        return mVariables.at (index).second;
+    }
+
+    Globals::Data& Globals::operator[] (int index)
+    {
+        return mVariables.at (index).second;
+    }
+
+    int Globals::getIndex (const std::string& name) const
+    {
+        std::map<std::string, int>::const_iterator iter = mIndices.find (name);
+
+        if (iter==mIndices.end())
+            return -1;
 
-        return iter->second.second;
+        return iter->second;
     }
 
     void Globals::setInt (const std::string& name, int value)
     {
-        Collection::iterator iter = find (name);
+        std::pair<char, Data>& variable = mVariables[find (name)];
 
-        switch (iter->second.first)
+        switch (variable.first)
         {
-            case 's': iter->second.second.mShort = value; break;
-            case 'l': iter->second.second.mLong = value; break;
-            case 'f': iter->second.second.mFloat = value; break;
+            case 's': variable.second.mShort = value; break;
+            case 'l': variable.second.mLong = value; break;
+            case 'f': variable.second.mFloat = value; break;
 
             default: throw std::runtime_error ("unsupported global variable type");
         }
@@ -106,13 +113,13 @@ namespace MWWorld
 
     void Globals::setFloat (const std::string& name, float value)
     {
-        Collection::iterator iter = find (name);
+        std::pair<char, Data>& variable = mVariables[find (name)];
 
-        switch (iter->second.first)
+        switch (variable.first)
         {
-            case 's': iter->second.second.mShort = value; break;
-            case 'l': iter->second.second.mLong = value; break;
-            case 'f': iter->second.second.mFloat = value; break;
+            case 's': variable.second.mShort = value; break;
+            case 'l': variable.second.mLong = value; break;
+            case 'f': variable.second.mFloat = value; break;
 
             default: throw std::runtime_error ("unsupported global variable type");
         }
@@ -120,13 +127,13 @@ namespace MWWorld
 
     int Globals::getInt (const std::string& name) const
     {
-        Collection::const_iterator iter = find (name);
+        const std::pair<char, Data>& variable = mVariables[find (name)];
 
-        switch (iter->second.first)
+        switch (variable.first)
         {
-            case 's': return iter->second.second.mShort;
-            case 'l': return iter->second.second.mLong;
-            case 'f': return iter->second.second.mFloat;
+            case 's': return variable.second.mShort;
+            case 'l': return variable.second.mLong;
+            case 'f': return variable.second.mFloat;
 
             default: throw std::runtime_error ("unsupported global variable type");
         }
@@ -134,13 +141,13 @@ namespace MWWorld
 
     float Globals::getFloat (const std::string& name) const
     {
-        Collection::const_iterator iter = find (name);
+        const std::pair<char, Data>& variable = mVariables[find (name)];
 
-        switch (iter->second.first)
+        switch (variable.first)
         {
-            case 's': return iter->second.second.mShort;
-            case 'l': return iter->second.second.mLong;
-            case 'f': return iter->second.second.mFloat;
+            case 's': return variable.second.mShort;
+            case 'l': return variable.second.mLong;
+            case 'f': return variable.second.mFloat;
 
             default: throw std::runtime_error ("unsupported global variable type");
         }
@@ -148,12 +155,12 @@ namespace MWWorld
 
     char Globals::getType (const std::string& name) const
     {
-        Collection::const_iterator iter = mVariables.find (name);
+        int index = getIndex (name);
 
-        if (iter==mVariables.end())
+        if (index==-1)
             return ' ';
 
-        return iter->second.first;
+        return mVariables[index].first;
     }
 }
 
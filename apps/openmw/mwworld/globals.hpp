@@ -11,6 +11,10 @@ namespace MWWorld
 {
     class ESMStore;
 
+    /// \brief Global variables
+    ///
+    /// Besides by name, variables can be accessed through an index, which is assigned in the
+    /// order of the store and therefore stays the same for every Globals object created from it.
     class Globals
     {
         public:
@@ -22,15 +26,14 @@ namespace MWWorld
                 Interpreter::Type_Float mShort;
             };
         
-            typedef std::map<std::string, std::pair<char, Data> > Collection;
+            typedef std::vector<std::pair<char, Data> > Collection;
         
         private:
         
             Collection mVariables; // type, value
+            std::map<std::string, int> mIndices;
         
-            Collection::const_iterator find (const std::string& name) const;
-
-            Collection::iterator find (const std::string& name);
+            int find (const std::string& name) const;
         
         public:
         
@@ -39,6 +42,13 @@ namespace MWWorld
             const Data& operator[] (const std::string& name) const;
 
             Data& operator[] (const std::string& name);
+
+            const Data& operator[] (int index) const;
+
+            Data& operator[] (int index);
+
+            int getIndex (const std::string& name) const;
+            ///< If there is no global variable with this name, -1 is returned.
             
             void setInt (const std::string& name, int value);
             ///< Set value independently from real type.
@@ -1,5 +1,12 @@
 #include "localscripts.hpp"
 
+#include <cassert>
+
+#include <components/settings/settings.hpp>
+
+#include "../mwbase/environment.hpp"
+#include "../mwbase/scriptmanager.hpp"
+
 #include "esmstore.hpp"
 #include "cellstore.hpp"
 
@@ -51,42 +58,156 @@ namespace
     }
 }
 
-MWWorld::LocalScripts::LocalScripts (const MWWorld::ESMStore& store) : mStore (store) {}
+MWWorld::LocalScripts::LocalScripts (const MWWorld::ESMStore& store)
+: mIndex (0), mVisited (0), mCursor (0), mDeferredPhase (false), mDeferRemaining (false),
+  mDeferredRun (0), mDuration (0), mStore (store)
+{
+    mBudget = Settings::Manager::getFloat ("local script budget", "General") / 1000;
+}
 
-void MWWorld::LocalScripts::setIgnore (const Ptr& ptr)
+MWWorld::LocalScripts::Script& MWWorld::LocalScripts::resolve (Script& script)
 {
-    mIgnore = ptr;
+    if (script.mSlot==-1)
+        script.mSlot = MWBase::Environment::get().getScriptManager()->getScriptSlot (script.mName);
+
+    return script;
 }
 
-void MWWorld::LocalScripts::startIteration()
+bool MWWorld::LocalScripts::isDeferrable (Script& script)
 {
-    mIter = mScripts.begin();
+    if (script.mDeferrable==-1)
+        script.mDeferrable =
+            MWBase::Environment::get().getScriptManager()->isDeferrable (resolve (script).mSlot);
+
+    return script.mDeferrable!=0;
 }
 
-bool MWWorld::LocalScripts::isFinished() const
+bool MWWorld::LocalScripts::isNext (Script& script)
 {
-    if (mIter==mScripts.end())
+    if (script.mRemoved || (!mIgnore.isEmpty() && script.mPtr==mIgnore))
+        return false;
+
+    if (mBudget<=0)
         return true;
 
-    if (!mIgnore.isEmpty() && mIter->second==mIgnore)
+    return isDeferrable (script)==mDeferredPhase;
+}
+
+void MWWorld::LocalScripts::advance()
+{
+    if (!mDeferredPhase)
+    {
+        while (mIndex<mScripts.size() && !isNext (mScripts[mIndex]))
+            ++mIndex;
+
+        if (mIndex<mScripts.size() || mBudget<=0)
+            return;
+
+        // continue with the deferrable scripts, where the last iteration stopped
+        mDeferredPhase = true;
+        mVisited = 0;
+        mIndex = mCursor;
+    }
+
+    while (mVisited<mScripts.size() && !(mDeferRemaining && mDeferredRun>0))
     {
-        std::list<std::pair<std::string, Ptr> >::iterator iter = mIter;
-        return ++iter==mScripts.end();
+        if (mIndex>=mScripts.size())
+            mIndex = 0;
+
+        if (isNext (mScripts[mIndex]))
+            return;
+
+        ++mIndex;
+        ++mVisited;
     }
 
-    return false;
+    mCursor = mIndex;
+}
+
+void MWWorld::LocalScripts::setIgnore (const Ptr& ptr)
+{
+    mIgnore = ptr;
 }
 
-std::pair<std::string, MWWorld::Ptr> MWWorld::LocalScripts::getNext()
+void MWWorld::LocalScripts::startIteration (float duration)
 {
+    // erase the scripts that have been removed and keep the cursor on the same script
+    std::size_t cursor = mCursor;
+    std::vector<Script>::iterator end = mScripts.begin();
+
+    for (std::vector<Script>::iterator iter (mScripts.begin()); iter!=mScripts.end(); ++iter)
+    {
+        if (iter->mRemoved)
+        {
+            if (static_cast<std::size_t> (iter-mScripts.begin())<mCursor)
+                --cursor;
+
+            continue;
+        }
+
+        iter->mSecondsPassed += duration;
+
+        if (end!=iter)
+            *end = *iter;
+
+        ++end;
+    }
+
+    mScripts.erase (end, mScripts.end());
+
+    mCursor = cursor<mScripts.size() ? cursor : 0;
+    mDuration = duration;
+    mIndex = 0;
+    mVisited = 0;
+    mDeferredPhase = false;
+    mDeferRemaining = false;
+    mDeferredRun = 0;
+}
+
+bool MWWorld::LocalScripts::isFinished()
+{
+    advance();
+
+    if (!mDeferredPhase)
+        return mIndex>=mScripts.size();
+
+    return mVisited>=mScripts.size() || (mDeferRemaining && mDeferredRun>0);
+}
+
+MWWorld::LocalScripts::Entry MWWorld::LocalScripts::getNext()
+{
+    advance();
     assert (!isFinished());
 
-    std::list<std::pair<std::string, Ptr> >::iterator iter = mIter++;
+    Script& script = resolve (mScripts[mIndex]);
 
-    if (mIgnore.isEmpty() || iter->second!=mIgnore)
-        return *iter;
+    Entry entry;
+    entry.mSlot = script.mSlot;
+    entry.mPtr = script.mPtr;
+    entry.mSecondsPassed = script.mSecondsPassed;
 
-    return getNext();
+    script.mSecondsPassed = 0;
+
+    ++mIndex;
+
+    if (mDeferredPhase)
+    {
+        ++mVisited;
+        ++mDeferredRun;
+        mCursor = mIndex;
+    }
+
+    return entry;
+}
+
+float MWWorld::LocalScripts::getBudget() const
+{
+    return mBudget;
+}
+
+void MWWorld::LocalScripts::deferRemaining()
+{
+    mDeferRemaining = true;
 }
 
 void MWWorld::LocalScripts::add (const std::string& scriptName, const Ptr& ptr)
@@ -95,7 +216,14 @@ void MWWorld::LocalScripts::add (const std::string& scriptName, const Ptr& ptr)
     {
         ptr.getRefData().setLocals (*script);
 
-        mScripts.push_back (std::make_pair (scriptName, ptr));
+        Script entry;
+        entry.mName = scriptName;
+        entry.mSlot = -1;
+        entry.mDeferrable = -1;
+        entry.mRemoved = false;
+        entry.mSecondsPassed = mDuration;
+        entry.mPtr = ptr;
+        mScripts.push_back (entry);
     }
 }
 
@@ -126,50 +254,33 @@ void MWWorld::LocalScripts::addCell (Ptr::CellStore *cell)
 void MWWorld::LocalScripts::clear()
 {
     mScripts.clear();
+    mIndex = 0;
+    mCursor = 0;
 }
 
 void MWWorld::LocalScripts::clearCell (Ptr::CellStore *cell)
 {
-    std::list<std::pair<std::string, Ptr> >::iterator iter = mScripts.begin();
-
-    while (iter!=mScripts.end())
-    {
-        if (iter->second.mCell==cell)
-        {
-            if (iter==mIter)
-               ++mIter;
-
-            mScripts.erase (iter++);
-        }
-        else
-            ++iter;
-    }
+    for (std::vector<Script>::iterator iter = mScripts.begin(); iter!=mScripts.end(); ++iter)
+        if (iter->mPtr.mCell==cell)
+            iter->mRemoved = true;
 }
 
 void MWWorld::LocalScripts::remove (RefData *ref)
 {
-    for (std::list<std::pair<std::string, Ptr> >::iterator iter = mScripts.begin();
-        iter!=mScripts.end(); ++iter)
-        if (&(iter->second.getRefData()) == ref)
+    for (std::vector<Script>::iterator iter = mScripts.begin(); iter!=mScripts.end(); ++iter)
+        if (!iter->mRemoved && &(iter->mPtr.getRefData()) == ref)
         {
-            if (iter==mIter)
-                ++mIter;
-
-            mScripts.erase (iter);
+            iter->mRemoved = true;
             break;
         }
 }
 
 void MWWorld::LocalScripts::remove (const Ptr& ptr)
 {
-    for (std::list<std::pair<std::string, Ptr> >::iterator iter = mScripts.begin();
-        iter!=mScripts.end(); ++iter)
-        if (iter->second==ptr)
+    for (std::vector<Script>::iterator iter = mScripts.begin(); iter!=mScripts.end(); ++iter)
+        if (!iter->mRemoved && iter->mPtr==ptr)
         {
-            if (iter==mIter)
-                ++mIter;
-
-            mScripts.erase (iter);
+            iter->mRemoved = true;
             break;
         }
 }
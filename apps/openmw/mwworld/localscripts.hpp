@@ -1,7 +1,7 @@
 #ifndef GAME_MWWORLD_LOCALSCRIPTS_H
 #define GAME_MWWORLD_LOCALSCRIPTS_H
 
-#include <list>
+#include <vector>
 #include <string>
 
 #include "ptr.hpp"
@@ -13,13 +13,57 @@ namespace MWWorld
     class RefData;
 
     /// \brief List of active local scripts
+    ///
+    /// By default every script is run once per iteration, in the order the scripts have been
+    /// added. If a "local script budget" is set, scripts that only read the state of the game and
+    /// change their own local variables (see MWBase::ScriptManager::isDeferrable) are run after
+    /// all other scripts, in round-robin order and only until deferRemaining() is called. Scripts
+    /// that have been skipped are run first in the next iteration.
     class LocalScripts
     {
-            std::list<std::pair<std::string, Ptr> > mScripts;
-            std::list<std::pair<std::string, Ptr> >::iterator mIter;
+        public:
+
+            struct Entry
+            {
+                int mSlot; // see MWBase::ScriptManager::getScriptSlot
+                Ptr mPtr;
+                float mSecondsPassed; ///< since the script has been run the last time
+            };
+
+        private:
+
+            struct Script
+            {
+                std::string mName;
+                int mSlot; // see MWBase::ScriptManager::getScriptSlot; -1 until first used
+                int mDeferrable; // -1 until first used
+                bool mRemoved; // removed during an iteration; erased when the next one starts
+                float mSecondsPassed;
+                Ptr mPtr;
+            };
+
+            std::vector<Script> mScripts;
+            std::size_t mIndex; // next script to check in the current phase
+            std::size_t mVisited; // scripts checked in the deferred phase
+            std::size_t mCursor; // first script of the next deferred phase
+            bool mDeferredPhase;
+            bool mDeferRemaining;
+            std::size_t mDeferredRun;
+            float mDuration;
+            float mBudget;
             MWWorld::Ptr mIgnore;
             const MWWorld::ESMStore& mStore;
 
+            Script& resolve (Script& script);
+
+            bool isDeferrable (Script& script);
+
+            bool isNext (Script& script);
+            ///< Should \a script be run in the current phase?
+
+            void advance();
+            ///< Move mIndex to the next script to run, starting with the one at mIndex.
+
         public:
 
             LocalScripts (const MWWorld::ESMStore& store);
@@ -28,14 +72,22 @@ namespace MWWorld
             ///< Mark a single reference for ignoring during iteration over local scripts (will revoke
             /// previous ignores).
 
-            void startIteration();
+            void startIteration (float duration);
             ///< Set the iterator to the begin of the script list.
+            /// \param duration Time passed since the last iteration
 
-            bool isFinished() const;
+            bool isFinished();
             ///< Is iteration finished?
 
-            std::pair<std::string, Ptr> getNext();
-            ///< Get next local script (must not be called if isFinished())
+            Entry getNext();
+            ///< Get the next local script (must not be called if isFinished())
+
+            float getBudget() const;
+            ///< Time in seconds, after which deferRemaining() should be called (0: no budget)
+
+            void deferRemaining();
+            ///< Skip the remaining deferrable scripts of the current iteration, after at least one of
+            /// them has been run.
 
             void add (const std::string& scriptName, const Ptr& ptr);
             ///< Add script to collection of active local scripts.
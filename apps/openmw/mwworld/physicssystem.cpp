@@ -1,6 +1,11 @@
 #include "physicssystem.hpp"
 
 #include <stdexcept>
+#include <ostream>
+#include <algorithm>
+#include <limits>
+
+#include <boost/shared_ptr.hpp>
 
 #include <OgreRoot.h>
 #include <OgreRenderWindow.h>
@@ -8,12 +13,15 @@
 #include <OgreViewport.h>
 #include <OgreCamera.h>
 #include <OgreTextureManager.h>
+#include <OgreTimer.h>
 
 #include <openengine/bullet/trace.h>
 #include <openengine/bullet/physic.hpp>
 #include <openengine/ogre/renderer.hpp>
 
 #include <components/nifbullet/bulletnifloader.hpp>
+#include <components/settings/settings.hpp>
+#include <components/misc/workqueue.hpp>
 
 #include "../mwbase/world.hpp" // FIXME
 #include "../mwbase/environment.hpp"
@@ -34,6 +42,12 @@ namespace MWWorld
     static const float sStepSize = 32.0f;
     // Arbitrary number. To prevent infinite loops. They shouldn't happen but it's good to be prepared.
     static const int sMaxIterations = 8;
+    // Length of a physics step in seconds
+    static const float sPhysicsStep = 1.0f/60.0f;
+    // Steps per frame at most. The simulation slows down rather than taking ever longer to catch up.
+    static const int sMaxPhysicsSteps = 4;
+    // Actors per movement thread at least. Handing fewer to a thread costs more than it saves.
+    static const std::size_t sMinActorsPerJob = 8;
 
     class MovementSolver
     {
@@ -45,9 +59,9 @@ namespace MWWorld
 
         static bool stepMove(btCollisionObject *colobj, Ogre::Vector3 &position,
                              const Ogre::Vector3 &velocity, float &remainingTime,
-                             OEngine::Physic::PhysicEngine *engine)
+                             OEngine::Physic::PhysicEngine *engine, bool concurrent)
         {
-            OEngine::Physic::ActorTracer tracer, stepper;
+            OEngine::Physic::ActorTracer tracer(concurrent), stepper(concurrent);
 
             stepper.doTrace(colobj, position, position+Ogre::Vector3(0.0f,0.0f,sStepSize), engine);
             if(stepper.mFraction < std::numeric_limits<float>::epsilon())
@@ -107,21 +121,35 @@ namespace MWWorld
             return tracer.mEndPos;
         }
 
-        static Ogre::Vector3 move(const MWWorld::Ptr &ptr, const Ogre::Vector3 &movement, float time,
-                                  bool isFlying, float waterlevel, OEngine::Physic::PhysicEngine *engine)
+        /// Move \a actor from its position in the simulation for \a time seconds.
+        ///
+        /// Only reads the collision world and the actor, so that several actors can be moved at the
+        /// same time. The new state of the physic actor is stored in \a actor and has to be
+        /// committed with commit(). The traces never use the shared state of the collision world,
+        /// so that the outcome is the same on any thread.
+        static void move(ActorMovement &actor, float time, OEngine::Physic::PhysicEngine *engine)
         {
+            const bool concurrent = true;
+
+            const MWWorld::Ptr &ptr = actor.mPtr;
+            const Ogre::Vector3 &movement = actor.mMovement;
+            const bool isFlying = actor.mIsFlying;
+            float waterlevel = actor.mWaterlevel;
+
             const ESM::Position &refpos = ptr.getRefData().getPosition();
-            Ogre::Vector3 position(refpos.pos);
+            Ogre::Vector3 position(actor.mPosition);
 
             /* Anything to collide with? */
-            OEngine::Physic::PhysicActor *physicActor = engine->getCharacter(ptr.getRefData().getHandle());
+            OEngine::Physic::PhysicActor *physicActor = actor.mPhysicActor;
             if(!physicActor || !physicActor->getCollisionMode())
             {
                 // FIXME: This works, but it's inconcsistent with how the rotations are applied elsewhere. Why?
-                return position + (Ogre::Quaternion(Ogre::Radian(-refpos.rot[2]), Ogre::Vector3::UNIT_Z)*
-                                   Ogre::Quaternion(Ogre::Radian(-refpos.rot[1]), Ogre::Vector3::UNIT_Y)*
-                                   Ogre::Quaternion(Ogre::Radian( refpos.rot[0]), Ogre::Vector3::UNIT_X)) *
+                actor.mPosition = position + (Ogre::Quaternion(Ogre::Radian(-refpos.rot[2]), Ogre::Vector3::UNIT_Z)*
+                                              Ogre::Quaternion(Ogre::Radian(-refpos.rot[1]), Ogre::Vector3::UNIT_Y)*
+                                              Ogre::Quaternion(Ogre::Radian( refpos.rot[0]), Ogre::Vector3::UNIT_X)) *
                                   movement * time;
+                actor.mPhysicActor = 0;
+                return;
             }
 
             btCollisionObject *colobj = physicActor->getCollisionBody();
@@ -130,7 +158,7 @@ namespace MWWorld
 
             waterlevel -= halfExtents.z * 0.5;
 
-            OEngine::Physic::ActorTracer tracer;
+            OEngine::Physic::ActorTracer tracer(concurrent);
             bool wasOnGround = false;
             bool isOnGround = false;
             Ogre::Vector3 inertia(0.0f);
@@ -196,7 +224,7 @@ namespace MWWorld
                 }
 
                 // We hit something. Try to step up onto it.
-                if(stepMove(colobj, newPosition, velocity, remainingTime, engine))
+                if(stepMove(colobj, newPosition, velocity, remainingTime, engine, concurrent))
                     isOnGround = !(newPosition.z < waterlevel || isFlying); // Only on the ground if there's gravity
                 else
                 {
@@ -226,30 +254,80 @@ namespace MWWorld
             }
 
             if(isOnGround || newPosition.z < waterlevel || isFlying)
-                physicActor->setInertialForce(Ogre::Vector3(0.0f));
+                actor.mInertia = Ogre::Vector3(0.0f);
             else
             {
                 inertia.z += time*-627.2f;
-                physicActor->setInertialForce(inertia);
+                actor.mInertia = inertia;
             }
-            physicActor->setOnGround(isOnGround);
+            actor.mOnGround = isOnGround;
 
             newPosition.z -= halfExtents.z;
-            return newPosition;
+            actor.mPosition = newPosition;
+        }
+
+        /// \param previous Position of the actor before the last move()
+        static void commit(const ActorMovement &actor, const Ogre::Vector3 &previous)
+        {
+            if(actor.mPhysicActor)
+            {
+                actor.mPhysicActor->setInertialForce(actor.mInertia);
+                actor.mPhysicActor->setOnGround(actor.mOnGround);
+            }
+
+            float heightDiff = actor.mPosition.z - previous.z;
+
+            if (heightDiff < 0)
+                actor.mPtr.getClass().getCreatureStats(actor.mPtr).addToFallHeight(-heightDiff);
         }
     };
 
 
-    PhysicsSystem::PhysicsSystem(OEngine::Render::OgreRenderer &_rend) :
-        mRender(_rend), mEngine(0), mTimeAccum(0.0f)
+    /// Moves a share of the actors on a movement thread
+    class PhysicsSystem::MovementJob : public Misc::WorkItem
+    {
+            std::vector<ActorMovement> &mActors;
+            std::size_t mBegin;
+            std::size_t mEnd;
+            float mTime;
+            OEngine::Physic::PhysicEngine *mEngine;
+
+        public:
+
+            MovementJob(std::vector<ActorMovement> &actors, std::size_t begin, std::size_t end, float time,
+                        OEngine::Physic::PhysicEngine *engine)
+              : mActors(actors), mBegin(begin), mEnd(end), mTime(time), mEngine(engine)
+            {}
+
+        protected:
+
+            virtual void doWork()
+            {
+                for(std::size_t i = mBegin;i < mEnd;++i)
+                    MovementSolver::move(mActors[i], mTime, mEngine);
+            }
+    };
+
+
+    PhysicsSystem::PhysicsSystem(OEngine::Render::OgreRenderer &_rend, const boost::filesystem::path& cacheDir) :
+        mRender(_rend), mEngine(0), mMovementThreads(0), mTimeAccum(0.0f)
     {
+        boost::filesystem::path shapeCacheDir;
+        if (Settings::Manager::getBool("shape cache", "General"))
+            shapeCacheDir = cacheDir / "shapes";
+
         // Create physics. shapeLoader is deleted by the physic engine
-        NifBullet::ManualBulletShapeLoader* shapeLoader = new NifBullet::ManualBulletShapeLoader();
+        NifBullet::ManualBulletShapeLoader* shapeLoader = new NifBullet::ManualBulletShapeLoader(shapeCacheDir);
         mEngine = new OEngine::Physic::PhysicEngine(shapeLoader);
+
+        int threads = Settings::Manager::getInt("actor movement threads", "General");
+        if(threads != 1)
+            mMovementThreads = new Misc::WorkQueue(threads > 1 ? threads : 0);
     }
 
     PhysicsSystem::~PhysicsSystem()
     {
+        delete mMovementThreads;
         delete mEngine;
     }
 
@@ -431,6 +509,10 @@ namespace MWWorld
 
     void PhysicsSystem::removeObject (const std::string& handle)
     {
+        // the movements of the last frame may refer to the object
+        mMovements.clear();
+        mActorStates.erase(handle);
+
         mEngine->removeCharacter(handle);
         mEngine->removeRigidBody(handle);
         mEngine->deleteRigidBody(handle);
@@ -499,27 +581,13 @@ namespace MWWorld
 
     bool PhysicsSystem::toggleCollisionMode()
     {
-        for(std::map<std::string,OEngine::Physic::PhysicActor*>::iterator it = mEngine->mActorMap.begin(); it != mEngine->mActorMap.end();++it)
-        {
-            if (it->first=="player")
-            {
-                OEngine::Physic::PhysicActor* act = it->second;
-
-                bool cmode = act->getCollisionMode();
-                if(cmode)
-                {
-                    act->enableCollisions(false);
-                    return false;
-                }
-                else
-                {
-                    act->enableCollisions(true);
-                    return true;
-                }
-            }
-        }
+        OEngine::Physic::PhysicActor* act = mEngine->getCharacter("player");
+        if (!act)
+            throw std::logic_error ("can't find player");
 
-        throw std::logic_error ("can't find player");
+        bool cmode = act->getCollisionMode();
+        act->enableCollisions(!cmode);
+        return !cmode;
     }
 
     bool PhysicsSystem::getObjectAABB(const MWWorld::Ptr &ptr, Ogre::Vector3 &min, Ogre::Vector3 &max)
@@ -559,40 +627,179 @@ namespace MWWorld
         mMovementQueue.push_back(std::make_pair(ptr, movement));
     }
 
+    void PhysicsSystem::solveMovement(std::vector<ActorMovement> &actors, float time, bool threaded)
+    {
+        std::size_t jobs = 1;
+        if(threaded && mMovementThreads)
+            jobs = std::min(actors.size()/sMinActorsPerJob, std::size_t(mMovementThreads->getThreadCount()+1));
+
+        if(jobs < 2)
+        {
+            for(std::vector<ActorMovement>::iterator iter(actors.begin());iter != actors.end();++iter)
+                MovementSolver::move(*iter, time, mEngine);
+            return;
+        }
+
+        // The first share is moved on this thread, while the movement threads do the others.
+        std::vector<boost::shared_ptr<MovementJob> > queued;
+        for(std::size_t i = 1;i < jobs;++i)
+        {
+            queued.push_back(boost::shared_ptr<MovementJob>(new MovementJob(
+                actors, actors.size()*i/jobs, actors.size()*(i+1)/jobs, time, mEngine)));
+            mMovementThreads->addWorkItem(queued.back().get());
+        }
+
+        std::string error;
+        try
+        {
+            for(std::size_t i = 0;i < actors.size()/jobs;++i)
+                MovementSolver::move(actors[i], time, mEngine);
+        }
+        catch(const std::exception &e)
+        {
+            error = e.what();
+        }
+
+        // the jobs refer to actors, so wait for all of them in any case
+        for(std::vector<boost::shared_ptr<MovementJob> >::iterator iter(queued.begin());iter != queued.end();++iter)
+        {
+            (*iter)->waitTillDone();
+            if(error.empty())
+                error = (*iter)->getError();
+        }
+
+        if(!error.empty())
+            throw std::runtime_error("moving actors failed: " + error);
+    }
+
     const PtrVelocityList& PhysicsSystem::applyQueuedMovement(float dt)
     {
         mMovementResults.clear();
 
         mTimeAccum += dt;
-        if(mTimeAccum >= 1.0f/60.0f)
+        int steps = static_cast<int>(mTimeAccum / sPhysicsStep);
+        if(steps > sMaxPhysicsSteps)
         {
-            const MWBase::World *world = MWBase::Environment::get().getWorld();
-            PtrVelocityList::iterator iter = mMovementQueue.begin();
-            for(;iter != mMovementQueue.end();iter++)
-            {
-                float waterlevel = -std::numeric_limits<float>::max();
-                const ESM::Cell *cell = iter->first.getCell()->mCell;
-                if(cell->hasWater())
-                    waterlevel = cell->mWater;
+            // drop the time that can't be caught up with
+            steps = sMaxPhysicsSteps;
+            mTimeAccum = steps * sPhysicsStep;
+        }
+        mTimeAccum = std::max(0.0f, mTimeAccum - steps * sPhysicsStep);
 
-                float oldHeight = iter->first.getRefData().getPosition().pos[2];
+        const MWBase::World *world = MWBase::Environment::get().getWorld();
 
-                Ogre::Vector3 newpos = MovementSolver::move(iter->first, iter->second, mTimeAccum,
-                                                            world->isFlying(iter->first),
-                                                            waterlevel, mEngine);
+        mMovements.resize(mMovementQueue.size());
+        std::vector<ActorState*> states(mMovementQueue.size());
+        for(std::size_t i = 0;i < mMovementQueue.size();++i)
+        {
+            ActorMovement &actor = mMovements[i];
+            actor.mPtr = mMovementQueue[i].first;
+            actor.mMovement = mMovementQueue[i].second;
+            actor.mIsFlying = world->isFlying(actor.mPtr);
+
+            actor.mWaterlevel = -std::numeric_limits<float>::max();
+            const ESM::Cell *cell = actor.mPtr.getCell()->mCell;
+            if(cell->hasWater())
+                actor.mWaterlevel = cell->mWater;
+
+            const std::string &handle = actor.mPtr.getRefData().getHandle();
+            actor.mPhysicActor = mEngine->getCharacter(handle);
+
+            // Continue from the simulated position, unless the actor has been put somewhere else
+            // than where it was rendered.
+            ActorState &state = mActorStates[handle];
+            Ogre::Vector3 position(actor.mPtr.getRefData().getPosition().pos);
+            if(!state.mValid || position != state.mRendered)
+            {
+                state.mPrevious = state.mCurrent = position;
+                state.mValid = true;
+            }
+            actor.mPosition = state.mCurrent;
+            states[i] = &state;
+        }
 
-                float heightDiff = newpos.z - oldHeight;
+        for(int step = 0;step < steps;++step)
+        {
+            // the actors collide with each other where the last step has left them
+            for(std::size_t i = 0;i < mMovements.size();++i)
+            {
+                states[i]->mPrevious = mMovements[i].mPosition;
+                if(mMovements[i].mPhysicActor)
+                {
+                    mMovements[i].mPhysicActor->setPosition(mMovements[i].mPosition);
+                    mMovements[i].mPhysicActor->updateAabbs();
+                }
+            }
 
-                if (heightDiff < 0)
-                    iter->first.getClass().getCreatureStats(iter->first).addToFallHeight(-heightDiff);
+            solveMovement(mMovements, sPhysicsStep, true);
 
-                mMovementResults.push_back(std::make_pair(iter->first, newpos));
-            }
+            // commit in the order of the queue, to get the same result on any number of threads
+            for(std::size_t i = 0;i < mMovements.size();++i)
+                MovementSolver::commit(mMovements[i], states[i]->mPrevious);
+        }
 
-            mTimeAccum = 0.0f;
+        // render the actors between the last two steps, by the time that is left over
+        const float alpha = mTimeAccum / sPhysicsStep;
+        for(std::size_t i = 0;i < mMovements.size();++i)
+        {
+            ActorState &state = *states[i];
+            state.mCurrent = mMovements[i].mPosition;
+            state.mRendered = state.mPrevious + (state.mCurrent - state.mPrevious) * alpha;
+            mMovementResults.push_back(std::make_pair(mMovements[i].mPtr, state.mRendered));
         }
+
         mMovementQueue.clear();
 
         return mMovementResults;
     }
+
+    void PhysicsSystem::castRays(OEngine::Physic::RayBatch &batch)
+    {
+        batch.run(*mEngine, mMovementThreads);
+    }
+
+    void PhysicsSystem::stepSimulation(float dt)
+    {
+        mEngine->stepSimulation(dt, sMaxPhysicsSteps, sPhysicsStep);
+    }
+
+    bool PhysicsSystem::benchmarkMovement(int frames, int copies, std::ostream &stream)
+    {
+        std::vector<ActorMovement> actors;
+        for(int i = 0;i < copies;++i)
+            actors.insert(actors.end(), mMovements.begin(), mMovements.end());
+
+        if(actors.empty())
+        {
+            stream << "No actors have been moved in the last frame";
+            return true;
+        }
+
+        std::vector<ActorMovement> serial(actors);
+        std::vector<ActorMovement> threaded(actors);
+        const float time = sPhysicsStep;
+
+        Ogre::Timer timer;
+        for(int i = 0;i < frames;++i)
+            solveMovement(serial, time, false);
+        unsigned long serialTime = timer.getMicroseconds();
+
+        timer.reset();
+        for(int i = 0;i < frames;++i)
+            solveMovement(threaded, time, true);
+        unsigned long threadedTime = timer.getMicroseconds();
+
+        bool same = true;
+        for(std::size_t i = 0;i < actors.size();++i)
+            if(serial[i].mPosition != threaded[i].mPosition || serial[i].mOnGround != threaded[i].mOnGround)
+                same = false;
+
+        stream << actors.size() << " actors, " << frames << " frames: "
+               << serialTime/1e3/frames << " ms per frame on the main thread, "
+               << threadedTime/1e3/frames << " ms per frame on "
+               << (mMovementThreads ? mMovementThreads->getThreadCount()+1 : 1) << " threads"
+               << (same ? "" : " (results differ)");
+
+        return same;
+    }
 }
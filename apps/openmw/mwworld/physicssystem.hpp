@@ -1,6 +1,12 @@
 #ifndef GAME_MWWORLD_PHYSICSSYSTEM_H
 #define GAME_MWWORLD_PHYSICSSYSTEM_H
 
+#include <iosfwd>
+#include <map>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
 #include <OgreVector3.h>
 
 #include <btBulletCollisionCommon.h>
@@ -17,19 +23,40 @@ namespace OEngine
     namespace Physic
     {
         class PhysicEngine;
+        class PhysicActor;
+        class RayBatch;
     }
 }
 
+namespace Misc
+{
+    class WorkQueue;
+}
+
 namespace MWWorld
 {
     class World;
 
     typedef std::vector<std::pair<Ptr,Ogre::Vector3> > PtrVelocityList;
 
+    /// An actor queued for movement and the outcome of moving it
+    struct ActorMovement
+    {
+        Ptr mPtr;
+        Ogre::Vector3 mMovement;
+        bool mIsFlying;
+        float mWaterlevel;
+        OEngine::Physic::PhysicActor *mPhysicActor; // 0 if the actor does not collide
+
+        Ogre::Vector3 mPosition; // where the move starts and ends
+        Ogre::Vector3 mInertia;
+        bool mOnGround;
+    };
+
     class PhysicsSystem
     {
         public:
-            PhysicsSystem (OEngine::Render::OgreRenderer &_rend);
+            PhysicsSystem (OEngine::Render::OgreRenderer &_rend, const boost::filesystem::path& cacheDir);
             ~PhysicsSystem ();
 
             void addObject (const MWWorld::Ptr& ptr, bool placeable=false);
@@ -73,6 +100,9 @@ namespace MWWorld
             std::pair<bool, Ogre::Vector3> castRay(float mouseX, float mouseY);
             ///< cast ray from the mouse, return true if it hit something and the first result (in OGRE coordinates)
 
+            /// Trace the queries of \a batch, on the movement threads too.
+            void castRays(OEngine::Physic::RayBatch& batch);
+
             OEngine::Physic::PhysicEngine* getEngine();
 
             bool getObjectAABB(const MWWorld::Ptr &ptr, Ogre::Vector3 &min, Ogre::Vector3 &max);
@@ -81,18 +111,49 @@ namespace MWWorld
             /// be overwritten. Valid until the next call to applyQueuedMovement.
             void queueObjectMovement(const Ptr &ptr, const Ogre::Vector3 &velocity);
 
+            /// Move the queued actors in fixed steps of the physics simulation and return the
+            /// positions to render them at, interpolated between the last two steps.
             const PtrVelocityList& applyQueuedMovement(float dt);
 
+            /// Advance the dynamics world in the same fixed steps as the actors.
+            void stepSimulation(float dt);
+
+            /// Move the actors of the last frame \a copies times over for \a frames frames, once
+            /// on the main thread and once on the movement threads, without changing the world.
+            /// Timings are written to \a stream.
+            /// \return Did both give the same positions?
+            bool benchmarkMovement(int frames, int copies, std::ostream& stream);
+
         private:
 
+            class MovementJob;
+
+            /// Positions of an actor in the physics simulation
+            struct ActorState
+            {
+                bool mValid;
+                Ogre::Vector3 mPrevious; // before the last step
+                Ogre::Vector3 mCurrent; // after the last step
+                Ogre::Vector3 mRendered;
+
+                ActorState() : mValid(false) {}
+            };
+
+            /// Move \a actors without changing the world. Uses the movement threads, if
+            /// \a threaded is set and there are enough actors.
+            void solveMovement(std::vector<ActorMovement>& actors, float time, bool threaded);
+
             OEngine::Render::OgreRenderer &mRender;
             OEngine::Physic::PhysicEngine* mEngine;
             std::map<std::string, std::string> handleToMesh;
 
             PtrVelocityList mMovementQueue;
             PtrVelocityList mMovementResults;
+            std::vector<ActorMovement> mMovements; // of the last frame
+            std::map<std::string, ActorState> mActorStates; // by handle
+            Misc::WorkQueue *mMovementThreads; // 0 if actors are moved on the main thread
 
-            float mTimeAccum;
+            float mTimeAccum; // time that has not been simulated yet
 
             PhysicsSystem (const PhysicsSystem&);
             PhysicsSystem& operator= (const PhysicsSystem&);
@@ -116,6 +116,11 @@ namespace MWWorld
         }
     }
 
+    bool RefData::hasLocals() const
+    {
+        return mHasLocals;
+    }
+
     void RefData::setCount (int count)
     {
         if(count == 0)
@@ -72,6 +72,8 @@ namespace MWWorld
 
             void setLocals (const ESM::Script& script);
 
+            bool hasLocals() const;
+
             void setCount (int count);
             /// Set object count (an object pile is a simple object with a count >1).
             ///
@@ -1,8 +1,13 @@
 #include "scene.hpp"
 
 #include <OgreSceneNode.h>
+#include <OgreTimer.h>
 
 #include <components/nif/niffile.hpp>
+#include <components/bsa/bsa_archive.hpp>
+#include <components/settings/settings.hpp>
+#include <components/misc/stringops.hpp>
+#include <components/misc/workqueue.hpp>
 
 #include <libs/openengine/ogre/fader.hpp>
 
@@ -17,6 +22,7 @@
 #include "localscripts.hpp"
 #include "esmstore.hpp"
 #include "class.hpp"
+#include "cells.hpp"
 
 #include "cellfunctors.hpp"
 
@@ -25,7 +31,8 @@ namespace
 
     template<typename T>
     void insertCellRefList(MWRender::RenderingManager& rendering,
-        T& cellRefList, MWWorld::CellStore &cell, MWWorld::PhysicsSystem& physics, bool rescale, Loading::Listener* loadingListener)
+        T& cellRefList, MWWorld::CellStore &cell, MWWorld::PhysicsSystem& physics, bool rescale, Loading::Listener* loadingListener,
+        MWWorld::Scene::HandleIndex& handles)
     {
         if (!cellRefList.mList.empty())
         {
@@ -51,6 +58,9 @@ namespace
                         rendering.addObject(ptr);
                         class_.insertObject(ptr, physics);
 
+                        if (ptr.getRefData().getBaseNode())
+                            handles[ptr.getRefData().getHandle()] = ptr;
+
                         float ax = Ogre::Radian(ptr.getRefData().getLocalRotation().rot[0]).valueDegrees();
                         float ay = Ogre::Radian(ptr.getRefData().getLocalRotation().rot[1]).valueDegrees();
                         float az = Ogre::Radian(ptr.getRefData().getLocalRotation().rot[2]).valueDegrees();
@@ -71,16 +81,178 @@ namespace
         }
     }
 
+    template<typename T>
+    void listModels (T& cellRefList, MWWorld::CellStore& cell, std::vector<std::string>& models)
+    {
+        for (typename T::List::iterator it = cellRefList.mList.begin();
+            it != cellRefList.mList.end(); ++it)
+        {
+            if (it->mData.getCount() && it->mData.isEnabled())
+            {
+                MWWorld::Ptr ptr (&*it, &cell);
+                std::string model = MWWorld::Class::get (ptr).getModel (ptr);
+
+                if (!model.empty())
+                    models.push_back (model);
+            }
+        }
+    }
+
+    /// List the meshes of all references in \a cell that will be inserted into the scene.
+    void listModels (MWWorld::CellStore& cell, std::vector<std::string>& models)
+    {
+        listModels (cell.mActivators, cell, models);
+        listModels (cell.mPotions, cell, models);
+        listModels (cell.mAppas, cell, models);
+        listModels (cell.mArmors, cell, models);
+        listModels (cell.mBooks, cell, models);
+        listModels (cell.mClothes, cell, models);
+        listModels (cell.mContainers, cell, models);
+        listModels (cell.mDoors, cell, models);
+        listModels (cell.mIngreds, cell, models);
+        listModels (cell.mLights, cell, models);
+        listModels (cell.mLockpicks, cell, models);
+        listModels (cell.mMiscItems, cell, models);
+        listModels (cell.mProbes, cell, models);
+        listModels (cell.mRepairs, cell, models);
+        listModels (cell.mStatics, cell, models);
+        listModels (cell.mWeapons, cell, models);
+        listModels (cell.mCreatures, cell, models);
+        listModels (cell.mNpcs, cell, models);
+
+        // The NIF loaders work with lower case names
+        for (std::vector<std::string>::iterator iter (models.begin()); iter!=models.end(); ++iter)
+            Misc::StringUtils::toLower (*iter);
+
+        std::sort (models.begin(), models.end());
+        models.erase (std::unique (models.begin(), models.end()), models.end());
+    }
 }
 
 
 namespace MWWorld
 {
+    /// Parses the meshes of a cell on a worker thread and keeps them in the NIF cache
+    /// until the cell has been inserted.
+    class Scene::ModelParser : public Misc::WorkItem
+    {
+            std::vector<std::string> mModels;
+            std::vector<Nif::NIFFile::ptr> mFiles;
+
+        public:
+
+            ModelParser (const std::vector<std::string>& models) : mModels (models) {}
+
+        protected:
+
+            void doWork()
+            {
+                for (std::vector<std::string>::const_iterator iter (mModels.begin());
+                    iter!=mModels.end(); ++iter)
+                {
+                    try
+                    {
+                        mFiles.push_back (Nif::NIFFile::create (*iter));
+                    }
+                    catch (const std::exception&)
+                    {
+                        // Reported by the main thread when it loads the mesh itself
+                    }
+                }
+            }
+    };
+
+    void Scene::prefetchModels (CellStore& cell)
+    {
+        std::vector<std::string> models;
+        listModels (cell, models);
+
+        Bsa::prefetch (models);
+
+        if (mParseQueue.get())
+        {
+            boost::shared_ptr<ModelParser> parser (new ModelParser (models));
+            mModelParsers.push_back (std::make_pair (&cell, parser));
+            mParseQueue->addWorkItem (parser.get());
+        }
+    }
+
+    void Scene::releaseParsedModels()
+    {
+        // Keep the meshes of cells that are about to be inserted, but not too many of them.
+        // Parsers that are still running have to stay, since the queue doesn't own them.
+        for (ModelParserList::iterator iter (mModelParsers.begin()); iter!=mModelParsers.end();)
+        {
+            bool obsolete = mActiveCells.find (iter->first)!=mActiveCells.end() ||
+                mModelParsers.size()>sMaxParsedCells;
+
+            if (obsolete && iter->second->isDone())
+                iter = mModelParsers.erase (iter);
+            else
+                ++iter;
+        }
+    }
+
 
     void Scene::update (float duration, bool paused){
+        if (!paused)
+            preloadCells (duration);
+
+        releaseParsedModels();
+
         mRendering.update (duration, paused);
     }
 
+    void Scene::preloadCells (float duration)
+    {
+        if (!mCurrentCell || !mCurrentCell->isExterior())
+        {
+            mHasLastPlayerPos = false;
+            return;
+        }
+
+        MWBase::World *world = MWBase::Environment::get().getWorld();
+
+        Ogre::Vector3 position (world->getPlayer().getPlayer().getRefData().getPosition().pos);
+        Ogre::Vector3 velocity (Ogre::Vector3::ZERO);
+
+        // Don't extrapolate a teleport.
+        if (mHasLastPlayerPos && duration>0 &&
+            position.squaredDistance (mLastPlayerPos)<ESM::Land::REAL_SIZE*ESM::Land::REAL_SIZE)
+            velocity = (position - mLastPlayerPos) / duration;
+
+        mLastPlayerPos = position;
+        mHasLastPlayerPos = true;
+
+        Ogre::Vector3 predicted = position + velocity * mPreloadLookahead;
+
+        int cellX = 0;
+        int cellY = 0;
+        world->positionToIndex (predicted.x, predicted.y, cellX, cellY);
+
+        int currentX = mCurrentCell->mCell->getGridX();
+        int currentY = mCurrentCell->mCell->getGridY();
+
+        // Only the cells of the predicted 3x3 grid that are not active yet are of interest.
+        if (cellX!=currentX || cellY!=currentY)
+            for (int x=cellX-1; x<=cellX+1; ++x)
+                for (int y=cellY-1; y<=cellY+1; ++y)
+                    if (std::abs (x-currentX)>1 || std::abs (y-currentY)>1)
+                        mCells.preloadExterior (x, y);
+
+        Ogre::Timer timer;
+
+        while (timer.getMicroseconds()<mPreloadFrameBudget)
+        {
+            CellStore *cell = mCells.adoptPreloaded();
+
+            if (!cell)
+                break;
+
+            prefetchModels (*cell);
+        }
+    }
+
     void Scene::unloadCell (CellStoreCollection::iterator iter)
     {
         std::cout << "Unloading cell\n";
@@ -94,6 +266,7 @@ namespace MWWorld
             {
                 Ogre::SceneNode* node = *iter2;
                 mPhysics->removeObject (node->getName());
+                mHandles.erase (node->getName());
             }
         }
 
@@ -124,6 +297,8 @@ namespace MWWorld
 
         if(result.second)
         {
+            prefetchModels (*cell);
+
             float verts = ESM::Land::LAND_SIZE;
             float worldsize = ESM::Land::REAL_SIZE;
 
@@ -198,6 +373,7 @@ namespace MWWorld
         while (active!=mActiveCells.end())
             unloadCell (active++);
         assert(mActiveCells.empty());
+        mHandles.clear();
         mCurrentCell = NULL;
     }
 
@@ -329,9 +505,22 @@ namespace MWWorld
     }
 
     //We need the ogre renderer and a scene node.
-    Scene::Scene (MWRender::RenderingManager& rendering, PhysicsSystem *physics)
-    : mCurrentCell (0), mCellChanged (false), mPhysics(physics), mRendering(rendering)
+    Scene::Scene (MWRender::RenderingManager& rendering, PhysicsSystem *physics, Cells& cells)
+    : mCurrentCell (0), mCellChanged (false), mPhysics(physics), mRendering(rendering), mCells (cells),
+      mHasLastPlayerPos (false), mLastPlayerPos (Ogre::Vector3::ZERO),
+      mPreloadLookahead (Settings::Manager::getFloat ("preload lookahead", "General")),
+      mPreloadFrameBudget (static_cast<unsigned long> (
+          Settings::Manager::getFloat ("preload frame budget", "General") * 1000))
     {
+        int threads = Settings::Manager::getInt ("preload model threads", "General");
+
+#if OGRE_THREAD_SUPPORT
+        if (threads>0)
+            mParseQueue.reset (new Misc::WorkQueue (threads));
+#else
+        // The Ogre resource system can only be used from the main thread.
+        (void) threads;
+#endif
     }
 
     Scene::~Scene()
@@ -477,33 +666,37 @@ namespace MWWorld
     void Scene::insertCell (Ptr::CellStore &cell, bool rescale, Loading::Listener* loadingListener)
     {
         // Loop through all references in the cell
-        insertCellRefList(mRendering, cell.mActivators, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mPotions, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mAppas, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mArmors, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mBooks, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mClothes, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mContainers, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mDoors, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mIngreds, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mCreatureLists, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mItemLists, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mLights, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mLockpicks, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mMiscItems, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mProbes, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mRepairs, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mStatics, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mWeapons, cell, *mPhysics, rescale, loadingListener);
+        insertCellRefList(mRendering, cell.mActivators, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mPotions, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mAppas, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mArmors, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mBooks, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mClothes, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mContainers, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mDoors, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mIngreds, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mCreatureLists, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mItemLists, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mLights, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mLockpicks, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mMiscItems, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mProbes, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mRepairs, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mStatics, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mWeapons, cell, *mPhysics, rescale, loadingListener, mHandles);
         // Load NPCs and creatures _after_ everything else (important for adjustPosition to work correctly)
-        insertCellRefList(mRendering, cell.mCreatures, cell, *mPhysics, rescale, loadingListener);
-        insertCellRefList(mRendering, cell.mNpcs, cell, *mPhysics, rescale, loadingListener);
+        insertCellRefList(mRendering, cell.mCreatures, cell, *mPhysics, rescale, loadingListener, mHandles);
+        insertCellRefList(mRendering, cell.mNpcs, cell, *mPhysics, rescale, loadingListener, mHandles);
     }
 
     void Scene::addObjectToScene (const Ptr& ptr)
     {
         mRendering.addObject(ptr);
         MWWorld::Class::get(ptr).insertObject(ptr, *mPhysics);
+
+        if (ptr.getRefData().getBaseNode())
+            mHandles[ptr.getRefData().getHandle()] = ptr;
+
         MWBase::Environment::get().getWorld()->rotateObject(ptr, 0, 0, 0, true);
         MWBase::Environment::get().getWorld()->scaleObject(ptr, ptr.getCellRef().mScale);
     }
@@ -513,6 +706,7 @@ namespace MWWorld
         MWBase::Environment::get().getMechanicsManager()->remove (ptr);
         MWBase::Environment::get().getSoundManager()->stopSound3D (ptr);
         mPhysics->removeObject (ptr.getRefData().getHandle());
+        mHandles.erase (ptr.getRefData().getHandle());
         mRendering.removeObject (ptr);
     }
 
@@ -527,4 +721,20 @@ namespace MWWorld
         }
         return false;
     }
+
+    Ptr Scene::searchPtrViaHandle (const std::string& handle) const
+    {
+        HandleIndex::const_iterator iter = mHandles.find (handle);
+
+        if (iter==mHandles.end() || !iter->second.getRefData().getCount())
+            return Ptr();
+
+        return iter->second;
+    }
+
+    void Scene::updateHandle (const Ptr& ptr)
+    {
+        if (ptr.getRefData().getBaseNode())
+            mHandles[ptr.getRefData().getHandle()] = ptr;
+    }
 }
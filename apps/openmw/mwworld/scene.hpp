@@ -1,19 +1,34 @@
 #ifndef GAME_MWWORLD_SCENE_H
 #define GAME_MWWORLD_SCENE_H
 
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#include <list>
+#include <memory>
+
+#include <boost/shared_ptr.hpp>
+
+#include <OgreVector3.h>
+
 #include "../mwrender/renderingmanager.hpp"
 
 #include "ptr.hpp"
 #include "globals.hpp"
 
-namespace Ogre
+namespace ESM
 {
-    class Vector3;
+    struct Position;
 }
 
-namespace ESM
+namespace Misc
 {
-    struct Position;
+    class WorkQueue;
 }
 
 namespace Files
@@ -37,6 +52,7 @@ namespace MWWorld
     class PhysicsSystem;
     class Player;
     class CellStore;
+    class Cells;
 
     class Scene
     {
@@ -44,14 +60,39 @@ namespace MWWorld
 
             typedef std::set<CellStore *> CellStoreCollection;
 
+#if defined HAVE_UNORDERED_MAP
+            typedef std::unordered_map<std::string, Ptr> HandleIndex;
+#else
+            typedef std::tr1::unordered_map<std::string, Ptr> HandleIndex;
+#endif
+
         private:
 
             //OEngine::Render::OgreRenderer& mRenderer;
             CellStore* mCurrentCell; // the cell the player is in
             CellStoreCollection mActiveCells;
+            HandleIndex mHandles; // objects of the active cells that are in the scene graph
             bool mCellChanged;
             PhysicsSystem *mPhysics;
             MWRender::RenderingManager& mRendering;
+            Cells& mCells;
+
+            class ModelParser;
+
+            typedef std::list<std::pair<CellStore *, boost::shared_ptr<ModelParser> > >
+                ModelParserList;
+
+            /// Cells whose meshes are parsed are released once they are in the scene or there
+            /// are more than this.
+            static const std::size_t sMaxParsedCells = 9;
+
+            ModelParserList mModelParsers; // oldest first
+            std::auto_ptr<Misc::WorkQueue> mParseQueue; // null if models are parsed on demand only
+
+            bool mHasLastPlayerPos;
+            Ogre::Vector3 mLastPlayerPos;
+            float mPreloadLookahead;
+            unsigned long mPreloadFrameBudget; // microseconds
 
             void playerCellChange (CellStore *cell, const ESM::Position& position,
                 bool adjustPlayerPos = true);
@@ -60,9 +101,18 @@ namespace MWWorld
 
             int countRefs (const Ptr::CellStore& cell);
 
+            void prefetchModels (CellStore& cell);
+            ///< Start reading and parsing the meshes of \a cell in the background.
+
+            void releaseParsedModels();
+
+            void preloadCells (float duration);
+            ///< Read ahead the exterior cells the player is heading towards and finish loading the
+            /// ones that are ready, as far as the frame budget allows.
+
         public:
 
-            Scene (MWRender::RenderingManager& rendering, PhysicsSystem *physics);
+            Scene (MWRender::RenderingManager& rendering, PhysicsSystem *physics, Cells& cells);
 
             ~Scene();
 
@@ -99,6 +149,14 @@ namespace MWWorld
             ///< Remove an object from the scene, but not from the world model.
 
             bool isCellActive(const CellStore &cell);
+
+            Ptr searchPtrViaHandle (const std::string& handle) const;
+            ///< Find an object of the active cells by its Ogre handle. Does not include the player.
+            /// \return empty Ptr if the handle is not known
+
+            void updateHandle (const Ptr& ptr);
+            ///< Let the handle of \a ptr refer to \a ptr, after the object has been copied to
+            /// another active cell along with its scene node.
     };
 }
 
@@ -1,10 +1,153 @@
 #include "store.hpp"
 #include "esmstore.hpp"
 
+namespace
+{
+    // Reader positions and references are engine state that the record's own save()
+    // functions don't cover, so the content cache writes them field by field.
+
+    void writeContext(ESM::ESMWriter &writer, const ESM::ESM_Context &context)
+    {
+        // File names must not go through the encoder
+        writer.startSubRecord("XCTF");
+        writer.write(context.filename.c_str(), context.filename.size());
+        writer.endRecord("XCTF");
+
+        writer.startSubRecord("XCTX");
+        writer.writeT(context.index);
+        writer.writeT(context.leftRec);
+        writer.writeT(context.leftSub);
+        writer.writeT(static_cast<uint64_t>(context.leftFile));
+        writer.writeT(context.recName.val);
+        writer.writeT(context.subName.val);
+        writer.writeT(static_cast<int>(context.subCached));
+        writer.writeT(static_cast<uint64_t>(context.filePos));
+        writer.endRecord("XCTX");
+    }
+
+    void readContext(ESM::ESMReader &esm, ESM::ESM_Context &context)
+    {
+        Misc::SString filename = esm.getHNView("XCTF");
+        context.filename.assign(filename.ptr, filename.length);
+
+        uint64_t leftFile, filePos;
+        int subCached;
+
+        esm.getSubNameIs("XCTX");
+        esm.getSubHeaderIs(40);
+        esm.getT(context.index);
+        esm.getT(context.leftRec);
+        esm.getT(context.leftSub);
+        esm.getT(leftFile);
+        esm.getT(context.recName.val);
+        esm.getT(context.subName.val);
+        esm.getT(subCached);
+        esm.getT(filePos);
+
+        context.leftFile = static_cast<size_t>(leftFile);
+        context.subCached = subCached != 0;
+        context.filePos = static_cast<size_t>(filePos);
+    }
+
+    void writeCellRef(ESM::ESMWriter &writer, const ESM::CellRef &ref)
+    {
+        writer.writeHNT("FRMR", ref.mRefnum);
+        writer.writeHNCString("NAME", ref.mRefID);
+        writer.writeHNT("XSCL", ref.mScale);
+        writer.writeHNCString("ANAM", ref.mOwner);
+        writer.writeHNCString("BNAM", ref.mGlob);
+        writer.writeHNCString("XSOL", ref.mSoul);
+        writer.writeHNCString("CNAM", ref.mFaction);
+        writer.writeHNT("INDX", ref.mFactIndex);
+        writer.writeHNT("INTV", ref.mCharge);
+        writer.writeHNT("XCHG", ref.mEnchantmentCharge);
+        writer.writeHNT("NAM9", ref.mGoldValue);
+        writer.writeHNT("XTEL", static_cast<int>(ref.mTeleport));
+        writer.writeHNT("DODT", ref.mDoorDest, 24);
+        writer.writeHNCString("DNAM", ref.mDestCell);
+        writer.writeHNT("XLCK", ref.mLockLevel);
+        writer.writeHNCString("KNAM", ref.mKey);
+        writer.writeHNCString("TNAM", ref.mTrap);
+        writer.writeHNT("UNAM", ref.mReferenceBlocked);
+        writer.writeHNT("XDEL", ref.mDeleted);
+        writer.writeHNT("FLTV", ref.mFltv);
+        writer.writeHNT("NAM0", ref.mNam0);
+        writer.writeHNT("DATA", ref.mPos, 24);
+    }
+
+    void readCellRef(ESM::ESMReader &esm, ESM::CellRef &ref)
+    {
+        int teleport;
+
+        esm.getHNT(ref.mRefnum, "FRMR");
+        ref.mRefID = esm.getHNString("NAME");
+        esm.getHNT(ref.mScale, "XSCL");
+        ref.mOwner = esm.getHNString("ANAM");
+        ref.mGlob = esm.getHNString("BNAM");
+        ref.mSoul = esm.getHNString("XSOL");
+        ref.mFaction = esm.getHNString("CNAM");
+        esm.getHNT(ref.mFactIndex, "INDX");
+        esm.getHNT(ref.mCharge, "INTV");
+        esm.getHNT(ref.mEnchantmentCharge, "XCHG");
+        esm.getHNT(ref.mGoldValue, "NAM9");
+        esm.getHNT(teleport, "XTEL");
+        esm.getHNT(ref.mDoorDest, "DODT", 24);
+        ref.mDestCell = esm.getHNString("DNAM");
+        esm.getHNT(ref.mLockLevel, "XLCK");
+        ref.mKey = esm.getHNString("KNAM");
+        ref.mTrap = esm.getHNString("TNAM");
+        esm.getHNT(ref.mReferenceBlocked, "UNAM");
+        esm.getHNT(ref.mDeleted, "XDEL");
+        esm.getHNT(ref.mFltv, "FLTV");
+        esm.getHNT(ref.mNam0, "NAM0");
+        esm.getHNT(ref.mPos, "DATA", 24);
+
+        ref.mTeleport = teleport != 0;
+    }
+
+    void writeCell(ESM::ESMWriter &writer, const std::string &name, const ESM::Cell &cell)
+    {
+        writer.startRecord(name);
+        writer.writeHNCString("NAME", cell.mName);
+        writer.writeHNT("DATA", cell.mData, 12);
+        writer.writeHNCString("RGNN", cell.mRegion);
+        writer.writeHNT("AMBI", cell.mAmbi, 16);
+        writer.writeHNT("WHGT", cell.mWater);
+        writer.writeHNT("XWIN", static_cast<int>(cell.mWaterInt));
+        writer.writeHNT("NAM5", cell.mMapColor);
+        writer.writeHNT("NAM0", cell.mNAM0);
+
+        writer.writeHNT("XCTN", static_cast<int>(cell.mContextList.size()));
+        writer.writeHNT("XMVN", static_cast<int>(cell.mMovedRefs.size()));
+        writer.writeHNT("XLSN", static_cast<int>(cell.mLeasedRefs.size()));
+
+        for (std::vector<ESM::ESM_Context>::const_iterator it = cell.mContextList.begin();
+            it != cell.mContextList.end(); ++it)
+        {
+            writeContext(writer, *it);
+        }
+
+        for (ESM::MovedCellRefTracker::const_iterator it = cell.mMovedRefs.begin();
+            it != cell.mMovedRefs.end(); ++it)
+        {
+            writer.writeHNT("MVRF", it->mRefnum);
+            writer.writeHNT("CNDT", it->mTarget);
+        }
+
+        for (ESM::CellRefTracker::const_iterator it = cell.mLeasedRefs.begin();
+            it != cell.mLeasedRefs.end(); ++it)
+        {
+            writeCellRef(writer, *it);
+        }
+
+        writer.endRecord(name);
+    }
+}
+
 namespace MWWorld {
 
 
-void Store<ESM::Cell>::load(ESM::ESMReader &esm, const std::string &id)
+StagedRecord *Store<ESM::Cell>::read(ESM::ESMReader &esm, const std::string &id) const
 {
     // Don't automatically assume that a new cell must be spawned. Multiple plugins write to the same cell,
     //  and we merge all this data into one Cell object. However, we can't simply search for the cell id,
@@ -12,8 +155,8 @@ void Store<ESM::Cell>::load(ESM::ESMReader &esm, const std::string &id)
     //  are not available until both cells have been loaded! So first, proceed as usual.
     
     // All cells have a name record, even nameless exterior cells.
-    std::string idLower = Misc::StringUtils::lowerCase(id);
-    ESM::Cell *cell = new ESM::Cell;
+    std::auto_ptr<StagedCell> staged(new StagedCell);
+    ESM::Cell *cell = &staged->mRecord;
     cell->mName = id;
 
     //First part of cell loading
@@ -25,20 +168,39 @@ void Store<ESM::Cell>::load(ESM::ESMReader &esm, const std::string &id)
         ESM::MovedCellRef cMRef;
         cell->getNextMVRF(esm, cMRef);
 
-        MWWorld::Store<ESM::Cell> &cStore = const_cast<MWWorld::Store<ESM::Cell>&>(mEsmStore->get<ESM::Cell>());
-        ESM::Cell *cellAlt = const_cast<ESM::Cell*>(cStore.searchOrCreate(cMRef.mTarget[0], cMRef.mTarget[1]));
-
         // Get regular moved reference data. Adapted from CellStore::loadRefs. Maybe we can optimize the following
         //  implementation when the oher implementation works as well.
         cell->getNextRef(esm, ref);
-        std::string lowerCase;
-
-        std::transform (ref.mRefID.begin(), ref.mRefID.end(), std::back_inserter (lowerCase),
-            (int(*)(int)) std::tolower);
 
         // Add data required to make reference appear in the correct cell.
         // We should not need to test for duplicates, as this part of the code is pre-cell merge.
         cell->mMovedRefs.push_back(cMRef);
+
+        // The target cell is updated in insertStaged()
+        staged->mMovedRefs.push_back(std::make_pair(cMRef, ref));
+    }
+
+    //Second part of cell loading
+    cell->postLoad(esm);
+
+    return staged.release();
+}
+
+void Store<ESM::Cell>::insertStaged(StagedRecord &record)
+{
+    StagedCell &staged = static_cast<StagedCell &>(record);
+    ESM::Cell *cell = &staged.mRecord;
+    std::string idLower = Misc::StringUtils::lowerCase(cell->mName);
+
+    for (std::vector<std::pair<ESM::MovedCellRef, ESM::CellRef> >::const_iterator it = staged.mMovedRefs.begin();
+        it != staged.mMovedRefs.end(); ++it)
+    {
+        const ESM::MovedCellRef &cMRef = it->first;
+        const ESM::CellRef &ref = it->second;
+
+        MWWorld::Store<ESM::Cell> &cStore = const_cast<MWWorld::Store<ESM::Cell>&>(mEsmStore->get<ESM::Cell>());
+        ESM::Cell *cellAlt = const_cast<ESM::Cell*>(cStore.searchOrCreate(cMRef.mTarget[0], cMRef.mTarget[1]));
+
         // But there may be duplicates here!
         ESM::CellRefTracker::iterator iter = std::find(cellAlt->mLeasedRefs.begin(), cellAlt->mLeasedRefs.end(), ref.mRefnum);
         if (iter == cellAlt->mLeasedRefs.end())
@@ -47,9 +209,6 @@ void Store<ESM::Cell>::load(ESM::ESMReader &esm, const std::string &id)
           *iter = ref;
     }
 
-    //Second part of cell loading
-    cell->postLoad(esm);
-
     if(cell->mData.mFlags & ESM::Cell::Interior)
     {
         // Store interior cell by name, try to merge with existing parent data.
@@ -62,7 +221,7 @@ void Store<ESM::Cell>::load(ESM::ESMReader &esm, const std::string &id)
             // have new cell replace old cell
             *oldcell = *cell;
         } else
-            mInt[idLower] = *cell;
+            mInt.insert(idLower, *cell);
     }
     else
     {
@@ -91,7 +250,104 @@ void Store<ESM::Cell>::load(ESM::ESMReader &esm, const std::string &id)
         } else
             mExt[std::make_pair(cell->mData.mX, cell->mData.mY)] = *cell;
     }
-    delete cell;
+}
+
+void Store<ESM::Cell>::writeCache(ESM::ESMWriter &writer, const std::string &name) const
+{
+    std::vector<const ESM::Cell *> interiors;
+    mInt.list(interiors);
+
+    for (std::vector<const ESM::Cell *>::const_iterator it = interiors.begin(); it != interiors.end(); ++it)
+        writeCell(writer, name, **it);
+
+    for (DynamicExt::const_iterator it = mExt.begin(); it != mExt.end(); ++it)
+        writeCell(writer, name, it->second);
+}
+
+void Store<ESM::Cell>::readCache(ESM::ESMReader &esm, const std::string &id)
+{
+    ESM::Cell cell;
+    int waterInt, contexts, movedRefs, leasedRefs;
+
+    cell.mName = id;
+    esm.getHNT(cell.mData, "DATA", 12);
+    cell.mRegion = esm.getHNString("RGNN");
+    esm.getHNT(cell.mAmbi, "AMBI", 16);
+    esm.getHNT(cell.mWater, "WHGT");
+    esm.getHNT(waterInt, "XWIN");
+    esm.getHNT(cell.mMapColor, "NAM5");
+    esm.getHNT(cell.mNAM0, "NAM0");
+    cell.mWaterInt = waterInt != 0;
+
+    esm.getHNT(contexts, "XCTN");
+    esm.getHNT(movedRefs, "XMVN");
+    esm.getHNT(leasedRefs, "XLSN");
+
+    cell.mContextList.resize(contexts);
+    for (int i = 0; i < contexts; ++i)
+        readContext(esm, cell.mContextList[i]);
+
+    for (int i = 0; i < movedRefs; ++i) {
+        ESM::MovedCellRef ref;
+        esm.getHNT(ref.mRefnum, "MVRF");
+        esm.getHNT(ref.mTarget, "CNDT");
+        cell.mMovedRefs.push_back(ref);
+    }
+
+    for (int i = 0; i < leasedRefs; ++i) {
+        ESM::CellRef ref;
+        readCellRef(esm, ref);
+        cell.mLeasedRefs.push_back(ref);
+    }
+
+    if (cell.mData.mFlags & ESM::Cell::Interior)
+        mInt.insert(cell.mName, cell);
+    else
+        mExt[std::make_pair(cell.mData.mX, cell.mData.mY)] = cell;
+}
+
+void Store<ESM::Land>::writeCache(ESM::ESMWriter &writer, const std::string &name) const
+{
+    for (std::vector<ESM::Land *>::const_iterator it = mStatic.begin(); it != mStatic.end(); ++it)
+    {
+        const ESM::Land &land = **it;
+
+        writer.startRecord(name);
+        writer.startSubRecord("INTV");
+        writer.writeT(land.mX);
+        writer.writeT(land.mY);
+        writer.endRecord("INTV");
+        writer.writeHNT("DATA", land.mFlags);
+        writer.writeHNT("XPLG", land.mPlugin);
+        writer.writeHNT("XDTY", land.mDataTypes);
+        writeContext(writer, land.mContext);
+        writer.endRecord(name);
+    }
+}
+
+void Store<ESM::Land>::readCache(ESM::ESMReader &esm, const std::string &id)
+{
+    std::auto_ptr<ESM::Land> land(new ESM::Land);
+
+    esm.getSubNameIs("INTV");
+    esm.getSubHeaderIs(8);
+    esm.getT(land->mX);
+    esm.getT(land->mY);
+    esm.getHNT(land->mFlags, "DATA");
+    esm.getHNT(land->mPlugin, "XPLG");
+    esm.getHNT(land->mDataTypes, "XDTY");
+    readContext(esm, land->mContext);
+
+    // Same as in Land::load()
+    land->mHasData = land->mDataTypes & (ESM::Land::DATA_VNML|ESM::Land::DATA_VHGT|ESM::Land::DATA_WNAM);
+
+    // Land data is read through the reader of the content file, see insertStaged()
+    std::vector<ESM::ESMReader> *readers = esm.getGlobalReaderList();
+    if (!readers || land->mPlugin >= (int)readers->size())
+        esm.fail("Land record refers to a content file that is not loaded");
+    land->mEsm = &(*readers)[land->mPlugin];
+
+    mStatic.push_back(land.release());
 }
 
 }
@@ -4,12 +4,43 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <stdexcept>
 
+#include <components/misc/idmap.hpp>
+#include <components/esm/esmwriter.hpp>
+
 #include "recordcmp.hpp"
 
 namespace MWWorld
 {
+    /// Record header flags to write with \a record, so that its load() sees the same
+    /// flags when it is read back from the content cache.
+    template <class T>
+    inline unsigned int getRecordFlags(const T &record) {
+        return 0;
+    }
+
+    inline unsigned int getRecordFlags(const ESM::NPC &record) {
+        return record.mRecordFlags;
+    }
+
+    inline unsigned int getRecordFlags(const ESM::Creature &record) {
+        return record.mRecordFlags;
+    }
+
+    /// A record that has been read from a content file, but not added to its store yet.
+    struct StagedRecord
+    {
+        virtual ~StagedRecord() {}
+    };
+
+    template <class T>
+    struct Staged : public StagedRecord
+    {
+        T mRecord;
+    };
+
     struct StoreBase
     {
         virtual ~StoreBase() {}
@@ -18,10 +49,31 @@ namespace MWWorld
         virtual void listIdentifier(std::vector<std::string> &list) const {}
 
         virtual size_t getSize() const = 0;
-        virtual void load(ESM::ESMReader &esm, const std::string &id) = 0;
+
+        void load(ESM::ESMReader &esm, const std::string &id)
+        {
+            std::auto_ptr<StagedRecord> record(read(esm, id));
+            insertStaged(*record);
+        }
+
+        /// Read a record without modifying the store. May be called from any
+        /// thread, as long as each thread uses its own reader.
+        virtual StagedRecord *read(ESM::ESMReader &esm, const std::string &id) const = 0;
+
+        /// Add a record returned by read(). Has to be called in load order.
+        virtual void insertStaged(StagedRecord &record) = 0;
 
         virtual bool eraseStatic(const std::string &id) {return false;}
         virtual void clearDynamic() {}
+
+        /// Write all static records as \a name records, in a form readCache() understands.
+        virtual void writeCache(ESM::ESMWriter &writer, const std::string &name) const = 0;
+
+        /// Add a record written by writeCache(). \a id is the content of the NAME sub-record.
+        virtual void readCache(ESM::ESMReader &esm, const std::string &id)
+        {
+            load(esm, id);
+        }
     };
 
     template <class T>
@@ -88,12 +140,12 @@ namespace MWWorld
     template <class T>
     class Store : public StoreBase
     {
-        std::map<std::string, T>      mStatic;
-        std::vector<T *>    mShared;
-        std::map<std::string, T> mDynamic;
+        typedef Misc::IdMap<T> Dynamic;
+        typedef Misc::IdMap<T> Static;
 
-        typedef std::map<std::string, T> Dynamic;
-        typedef std::map<std::string, T> Static;
+        Static              mStatic;
+        std::vector<T *>    mShared;
+        Dynamic             mDynamic;
 
         class GetRecords {
             const std::string mFind;
@@ -132,21 +184,11 @@ namespace MWWorld
         }
 
         const T *search(const std::string &id) const {
-            T item;
-            item.mId = Misc::StringUtils::lowerCase(id);
-
-            typename std::map<std::string, T>::const_iterator it = mStatic.find(item.mId);
-
-            if (it != mStatic.end() && Misc::StringUtils::ciEqual(it->second.mId, id)) {
-                return &(it->second);
-            }
-
-            typename Dynamic::const_iterator dit = mDynamic.find(item.mId);
-            if (dit != mDynamic.end()) {
-                return &dit->second;
+            const T *ptr = mStatic.search(id);
+            if (ptr == 0) {
+                ptr = mDynamic.search(id);
             }
-
-            return 0;
+            return ptr;
         }
 
         /** Returns a random record that starts with the named ID, or NULL if not found. */
@@ -183,20 +225,31 @@ namespace MWWorld
             return ptr;
         }
 
-        void load(ESM::ESMReader &esm, const std::string &id) {
-            std::string idLower = Misc::StringUtils::lowerCase(id);
-            mStatic[idLower] = T();
-            mStatic[idLower].mId = idLower;
-            mStatic[idLower].load(esm);
+        StagedRecord *read(ESM::ESMReader &esm, const std::string &id) const {
+            std::auto_ptr<Staged<T> > staged(new Staged<T>);
+            staged->mRecord.mId = Misc::StringUtils::lowerCase(id);
+            staged->mRecord.load(esm);
+            return staged.release();
+        }
+
+        void insertStaged(StagedRecord &record) {
+            const T &item = static_cast<Staged<T> &>(record).mRecord;
+            mStatic.insert(item.mId, item);
         }
 
         void setUp() {
-            //std::sort(mStatic.begin(), mStatic.end(), RecordCmp());
+            mStatic.list(mShared);
+        }
+
+        void writeCache(ESM::ESMWriter &writer, const std::string &name) const {
+            std::vector<const T *> records;
+            mStatic.list(records);
 
-            mShared.reserve(mStatic.size());
-            typename std::map<std::string, T>::iterator it = mStatic.begin();
-            for (; it != mStatic.end(); ++it) {
-                mShared.push_back(&(it->second));
+            for (typename std::vector<const T *>::const_iterator it = records.begin(); it != records.end(); ++it) {
+                writer.startRecord(name, getRecordFlags(**it));
+                writer.writeHNCString("NAME", (*it)->mId);
+                (*it)->save(writer);
+                writer.endRecord(name);
             }
         }
 
@@ -221,69 +274,51 @@ namespace MWWorld
         }
 
         T *insert(const T &item) {
-            std::string id = Misc::StringUtils::lowerCase(item.mId);
-            std::pair<typename Dynamic::iterator, bool> result =
-                mDynamic.insert(std::pair<std::string, T>(id, item));
-            T *ptr = &result.first->second;
+            std::pair<T *, bool> result = mDynamic.insert(item.mId, item);
             if (result.second) {
-                mShared.push_back(ptr);
-            } else {
-                *ptr = item;
+                mShared.push_back(result.first);
             }
-            return ptr;
+            return result.first;
         }
 
         T *insertStatic(const T &item) {
-            std::string id = Misc::StringUtils::lowerCase(item.mId);
-            std::pair<typename Static::iterator, bool> result =
-                mStatic.insert(std::pair<std::string, T>(id, item));
-            T *ptr = &result.first->second;
+            std::pair<T *, bool> result = mStatic.insert(item.mId, item);
             if (result.second) {
-                mShared.push_back(ptr);
-            } else {
-                *ptr = item;
+                mShared.push_back(result.first);
             }
-            return ptr;
+            return result.first;
         }
 
 
         bool eraseStatic(const std::string &id) {
-            T item;
-            item.mId = Misc::StringUtils::lowerCase(id);
+            T *ptr = mStatic.search(id);
 
-            typename std::map<std::string, T>::iterator it = mStatic.find(item.mId);
-
-            if (it != mStatic.end() && Misc::StringUtils::ciEqual(it->second.mId, id)) {
+            if (ptr != 0) {
                 // delete from the static part of mShared
                 typename std::vector<T *>::iterator sharedIter = mShared.begin();
                 typename std::vector<T *>::iterator end = sharedIter + mStatic.size();
 
                 while (sharedIter != mShared.end() && sharedIter != end) {
-                    if((*sharedIter)->mId == item.mId) {
+                    if(*sharedIter == ptr) {
                         mShared.erase(sharedIter);
                         break;
                     }
                     ++sharedIter;
                 }
-                mStatic.erase(it);
+                mStatic.erase(id);
             }
 
             return true;
         }
 
         bool erase(const std::string &id) {
-            std::string key = Misc::StringUtils::lowerCase(id);
-            typename Dynamic::iterator it = mDynamic.find(key);
-            if (it == mDynamic.end()) {
+            if (!mDynamic.erase(id)) {
                 return false;
             }
-            mDynamic.erase(it);
 
             // have to reinit the whole shared part
             mShared.erase(mShared.begin() + mStatic.size(), mShared.end());
-            for (it = mDynamic.begin(); it != mDynamic.end(); ++it) {
-                mShared.push_back(&it->second);
-            }
+            mDynamic.list(mShared);
             return true;
         }
 
@@ -293,33 +328,64 @@ namespace MWWorld
     };
 
     template <>
-    inline void Store<ESM::Dialogue>::load(ESM::ESMReader &esm, const std::string &id) {
-        std::string idLower = Misc::StringUtils::lowerCase(id);
+    inline StagedRecord *Store<ESM::Dialogue>::read(ESM::ESMReader &esm, const std::string &id) const {
+        std::auto_ptr<Staged<ESM::Dialogue> > staged(new Staged<ESM::Dialogue>);
+        staged->mRecord.mId = id; // don't smash case here, as this line is printed... I think
+        staged->mRecord.load(esm);
+        return staged.release();
+    }
+
+    template <>
+    inline void Store<ESM::Dialogue>::insertStaged(StagedRecord &record) {
+        const ESM::Dialogue &dialogue = static_cast<Staged<ESM::Dialogue> &>(record).mRecord;
 
-        std::map<std::string, ESM::Dialogue>::iterator it = mStatic.find(idLower);
-        if (it == mStatic.end()) {
-            it = mStatic.insert( std::make_pair( idLower, ESM::Dialogue() ) ).first;
-            it->second.mId = id; // don't smash case here, as this line is printed... I think
+        ESM::Dialogue *ptr = mStatic.search(dialogue.mId);
+        if (ptr == 0) {
+            ESM::Dialogue item;
+            item.mId = dialogue.mId;
+            ptr = mStatic.insert(dialogue.mId, item).first;
         }
 
         //I am not sure is it need to load the dialog from a plugin if it was already loaded from prevois plugins
-        it->second.load(esm);
+        // Dialogue::load only reads the type. Infos of earlier files are kept.
+        ptr->mType = dialogue.mType;
     }
 
     template <>
-    inline void Store<ESM::Script>::load(ESM::ESMReader &esm, const std::string &id) {
-        ESM::Script scpt;
-        scpt.load(esm);
-        Misc::StringUtils::toLower(scpt.mId);
-        mStatic[scpt.mId] = scpt;
+    inline void Store<ESM::Dialogue>::writeCache(ESM::ESMWriter &writer, const std::string &name) const {
+        std::vector<const ESM::Dialogue *> records;
+        mStatic.list(records);
+
+        for (std::vector<const ESM::Dialogue *>::const_iterator it = records.begin(); it != records.end(); ++it) {
+            writer.startRecord(name);
+            writer.writeHNCString("NAME", (*it)->mId);
+            (*it)->save(writer);
+            writer.endRecord(name);
+
+            // ESMStore::readCache() adds infos to the dialogue preceding them
+            for (std::vector<ESM::DialInfo>::const_iterator info = (*it)->mInfo.begin(); info != (*it)->mInfo.end(); ++info) {
+                writer.startRecord("INFO");
+                writer.writeHNCString("INAM", info->mId);
+                info->save(writer);
+                writer.endRecord("INFO");
+            }
+        }
     }
 
     template <>
-    inline void Store<ESM::StartScript>::load(ESM::ESMReader &esm, const std::string &id) {
-        ESM::StartScript s;
-        s.load(esm);
-        s.mId = Misc::StringUtils::toLower(s.mScript);
-        mStatic[s.mId] = s;
+    inline StagedRecord *Store<ESM::Script>::read(ESM::ESMReader &esm, const std::string &id) const {
+        std::auto_ptr<Staged<ESM::Script> > staged(new Staged<ESM::Script>);
+        staged->mRecord.load(esm);
+        Misc::StringUtils::toLower(staged->mRecord.mId);
+        return staged.release();
+    }
+
+    template <>
+    inline StagedRecord *Store<ESM::StartScript>::read(ESM::ESMReader &esm, const std::string &id) const {
+        std::auto_ptr<Staged<ESM::StartScript> > staged(new Staged<ESM::StartScript>);
+        staged->mRecord.load(esm);
+        staged->mRecord.mId = Misc::StringUtils::toLower(staged->mRecord.mScript);
+        return staged.release();
     }
 
     template <>
@@ -329,6 +395,12 @@ namespace MWWorld
         typedef std::vector<ESM::LandTexture> LandTextureList;
         std::vector<LandTextureList> mStatic;
 
+        struct StagedLandTexture : public StagedRecord
+        {
+            ESM::LandTexture mRecord;
+            size_t mPlugin;
+        };
+
     public:
         Store<ESM::LandTexture>() {
             mStatic.push_back(LandTextureList());
@@ -367,16 +439,33 @@ namespace MWWorld
             return mStatic[plugin].size();
         }
 
+        using StoreBase::load;
+
         void load(ESM::ESMReader &esm, const std::string &id, size_t plugin) {
-            ESM::LandTexture lt;
-            lt.load(esm);
-            lt.mId = id;
+            StagedLandTexture staged;
+            staged.mRecord.load(esm);
+            staged.mRecord.mId = id;
+            staged.mPlugin = plugin;
+            insertStaged(staged);
+        }
+
+        StagedRecord *read(ESM::ESMReader &esm, const std::string &id) const {
+            std::auto_ptr<StagedLandTexture> staged(new StagedLandTexture);
+            staged->mRecord.load(esm);
+            staged->mRecord.mId = id;
+            staged->mPlugin = esm.getIndex();
+            return staged.release();
+        }
+
+        void insertStaged(StagedRecord &record) {
+            const StagedLandTexture &staged = static_cast<StagedLandTexture &>(record);
+            const ESM::LandTexture &lt = staged.mRecord;
 
             // Make sure we have room for the structure
-            if (plugin >= mStatic.size()) {
-                mStatic.resize(plugin+1);
+            if (staged.mPlugin >= mStatic.size()) {
+                mStatic.resize(staged.mPlugin+1);
             }
-            LandTextureList &ltexl = mStatic[plugin];
+            LandTextureList &ltexl = mStatic[staged.mPlugin];
             if(lt.mIndex + 1 > (int)ltexl.size())
                 ltexl.resize(lt.mIndex+1);
 
@@ -384,8 +473,28 @@ namespace MWWorld
             ltexl[lt.mIndex] = lt;
         }
 
-        void load(ESM::ESMReader &esm, const std::string &id) {
-            load(esm, id, esm.getIndex());
+        void writeCache(ESM::ESMWriter &writer, const std::string &name) const {
+            // Unused slots are written too, so that the lists keep their size
+            for (size_t plugin = 0; plugin < mStatic.size(); ++plugin) {
+                for (size_t i = 0; i < mStatic[plugin].size(); ++i) {
+                    writer.startRecord(name);
+                    writer.writeHNCString("NAME", mStatic[plugin][i].mId);
+                    writer.writeHNT("XPLG", static_cast<int>(plugin));
+                    writer.writeHNT("INTV", static_cast<int>(i));
+                    writer.writeHNCString("DATA", mStatic[plugin][i].mTexture);
+                    writer.endRecord(name);
+                }
+            }
+        }
+
+        void readCache(ESM::ESMReader &esm, const std::string &id) {
+            StagedLandTexture staged;
+            int plugin;
+            esm.getHNT(plugin, "XPLG");
+            staged.mRecord.load(esm);
+            staged.mRecord.mId = id;
+            staged.mPlugin = plugin;
+            insertStaged(staged);
         }
 
         iterator begin(size_t plugin) const {
@@ -404,6 +513,17 @@ namespace MWWorld
     {
         std::vector<ESM::Land *> mStatic;
 
+        // ESM::Land is not copyable, so the staged record owns a heap object
+        // until it is handed over to mStatic.
+        struct StagedLand : public StagedRecord
+        {
+            ESM::Land *mRecord;
+            std::vector<ESM::ESMReader> *mReaders;
+
+            StagedLand() : mRecord(0), mReaders(0) {}
+            ~StagedLand() { delete mRecord; }
+        };
+
         struct Compare
         {
             bool operator()(const ESM::Land *x, const ESM::Land *y) {
@@ -462,9 +582,25 @@ namespace MWWorld
             return ptr;
         }
 
-        void load(ESM::ESMReader &esm, const std::string &id) {
-            ESM::Land *ptr = new ESM::Land();
-            ptr->load(esm);
+        StagedRecord *read(ESM::ESMReader &esm, const std::string &id) const {
+            std::auto_ptr<StagedLand> staged(new StagedLand);
+            staged->mRecord = new ESM::Land();
+            staged->mRecord->load(esm);
+            staged->mReaders = esm.getGlobalReaderList();
+            return staged.release();
+        }
+
+        void insertStaged(StagedRecord &record) {
+            StagedLand &staged = static_cast<StagedLand &>(record);
+            ESM::Land *ptr = staged.mRecord;
+            staged.mRecord = 0;
+
+            // The land data is loaded later through the reader the record was
+            // read from. That may have been a temporary one, so switch to the
+            // reader kept by the world.
+            if (staged.mReaders && ptr->mPlugin < (int)staged.mReaders->size()) {
+                ptr->mEsm = &(*staged.mReaders)[ptr->mPlugin];
+            }
 
             // Same area defined in multiple plugins? -> last plugin wins
             // Can't use search() because we aren't sorted yet - is there any other way to speed this up?
@@ -484,6 +620,9 @@ namespace MWWorld
         void setUp() {
             std::sort(mStatic.begin(), mStatic.end(), Compare());
         }
+
+        void writeCache(ESM::ESMWriter &writer, const std::string &name) const;
+        void readCache(ESM::ESMReader &esm, const std::string &id);
     };
 
     template <>
@@ -509,7 +648,15 @@ namespace MWWorld
             }
         };
 
-        typedef std::map<std::string, ESM::Cell>                           DynamicInt;
+        struct StagedCell : public StagedRecord
+        {
+            ESM::Cell mRecord;
+
+            // References moved into other cells by this cell record
+            std::vector<std::pair<ESM::MovedCellRef, ESM::CellRef> > mMovedRefs;
+        };
+
+        typedef Misc::IdMap<ESM::Cell>                                     DynamicInt;
         typedef std::map<std::pair<int, int>, ESM::Cell, DynamicExtCmp>    DynamicExt;
 
         DynamicInt      mInt;
@@ -537,27 +684,14 @@ namespace MWWorld
         {}
 
         const ESM::Cell *search(const std::string &id) const {
-            ESM::Cell cell;
-            cell.mName = Misc::StringUtils::lowerCase(id);
-
-            std::map<std::string, ESM::Cell>::const_iterator it = mInt.find(cell.mName);
-
-            if (it != mInt.end() && Misc::StringUtils::ciEqual(it->second.mName, id)) {
-                return &(it->second);
-            }
-
-            DynamicInt::const_iterator dit = mDynamicInt.find(cell.mName);
-            if (dit != mDynamicInt.end()) {
-                return &dit->second;
+            const ESM::Cell *ptr = mInt.search(id);
+            if (ptr == 0) {
+                ptr = mDynamicInt.search(id);
             }
-
-            return 0;
+            return ptr;
         }
 
         const ESM::Cell *search(int x, int y) const {
-            ESM::Cell cell;
-            cell.mData.mX = x, cell.mData.mY = y;
-
             std::pair<int, int> key(x, y);
             DynamicExt::const_iterator it = mExt.find(key);
             if (it != mExt.end()) {
@@ -619,13 +753,8 @@ namespace MWWorld
         void setUp() {
             //typedef std::vector<ESM::Cell>::iterator Iterator;
             typedef DynamicExt::iterator ExtIterator;
-            typedef std::map<std::string, ESM::Cell>::iterator IntIterator;
 
-            //std::sort(mInt.begin(), mInt.end(), RecordCmp());
-            mSharedInt.reserve(mInt.size());
-            for (IntIterator it = mInt.begin(); it != mInt.end(); ++it) {
-                mSharedInt.push_back(&(it->second));
-            }
+            mInt.list(mSharedInt);
 
             //std::sort(mExt.begin(), mExt.end(), ExtCmp());
             mSharedExt.reserve(mExt.size());
@@ -638,7 +767,11 @@ namespace MWWorld
         //  errors related to the compare operator used in std::find for ESM::MovedCellRefTracker::find.
         //  There some nasty three-way cyclic header dependency involved, which I could only fix by moving
         //  this method.
-        void load(ESM::ESMReader &esm, const std::string &id);
+        StagedRecord *read(ESM::ESMReader &esm, const std::string &id) const;
+        void insertStaged(StagedRecord &record);
+
+        void writeCache(ESM::ESMWriter &writer, const std::string &name) const;
+        void readCache(ESM::ESMReader &esm, const std::string &id);
 
         iterator intBegin() const {
             return iterator(mSharedInt.begin());
@@ -723,13 +856,8 @@ namespace MWWorld
                 ptr = &result.first->second;
                 mSharedExt.push_back(ptr);
             } else {
-                std::string key = Misc::StringUtils::lowerCase(cell.mName);
-
                 // duplicate insertions are avoided by search(ESM::Cell &)
-                std::pair<DynamicInt::iterator, bool> result =
-                    mDynamicInt.insert(std::make_pair(key, cell));
-
-                ptr = &result.first->second;
+                ptr = mDynamicInt.insert(cell.mName, cell).first;
                 mSharedInt.push_back(ptr);
             }
             return ptr;
@@ -743,21 +871,15 @@ namespace MWWorld
         }
 
         bool erase(const std::string &id) {
-            std::string key = Misc::StringUtils::lowerCase(id);
-            DynamicInt::iterator it = mDynamicInt.find(key);
-
-            if (it == mDynamicInt.end()) {
+            if (!mDynamicInt.erase(id)) {
                 return false;
             }
-            mDynamicInt.erase(it);
             mSharedInt.erase(
-                mSharedInt.begin() + mSharedInt.size(),
+                mSharedInt.begin() + mInt.size(),
                 mSharedInt.end()
             );
 
-            for (it = mDynamicInt.begin(); it != mDynamicInt.end(); ++it) {
-                mSharedInt.push_back(&it->second);
-            }
+            mDynamicInt.list(mSharedInt);
 
             return true;
         }
@@ -819,9 +941,23 @@ namespace MWWorld
 
     public:
 
-        void load(ESM::ESMReader &esm, const std::string &id) {
-            mStatic.push_back(ESM::Pathgrid());
-            mStatic.back().load(esm);
+        StagedRecord *read(ESM::ESMReader &esm, const std::string &id) const {
+            std::auto_ptr<Staged<ESM::Pathgrid> > staged(new Staged<ESM::Pathgrid>);
+            staged->mRecord.load(esm);
+            return staged.release();
+        }
+
+        void insertStaged(StagedRecord &record) {
+            mStatic.push_back(static_cast<Staged<ESM::Pathgrid> &>(record).mRecord);
+        }
+
+        void writeCache(ESM::ESMWriter &writer, const std::string &name) const {
+            // Pathgrid::save() writes the cell name itself
+            for (iterator it = mStatic.begin(); it != mStatic.end(); ++it) {
+                writer.startRecord(name);
+                it->save(writer);
+                writer.endRecord(name);
+            }
         }
 
         size_t getSize() const {
@@ -963,6 +1099,27 @@ namespace MWWorld
             mStatic.back().load(esm);
         }
 
+        /// Same as StoreBase::read()
+        StagedRecord *read(ESM::ESMReader &esm) const {
+            std::auto_ptr<Staged<T> > staged(new Staged<T>);
+            staged->mRecord.load(esm);
+            return staged.release();
+        }
+
+        /// Same as StoreBase::insertStaged()
+        void insertStaged(StagedRecord &record) {
+            mStatic.push_back(static_cast<Staged<T> &>(record).mRecord);
+        }
+
+        /// Same as StoreBase::writeCache(). Records are read back with load().
+        void writeCache(ESM::ESMWriter &writer, const std::string &name) const {
+            for (iterator it = mStatic.begin(); it != mStatic.end(); ++it) {
+                writer.startRecord(name, getRecordFlags(*it));
+                it->save(writer);
+                writer.endRecord(name);
+            }
+        }
+
         int getSize() const {
             return mStatic.size();
         }
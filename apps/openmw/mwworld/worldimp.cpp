@@ -7,9 +7,14 @@
 #include <tr1/unordered_map>
 #endif
 
+#include <set>
+#include <sstream>
+#include <algorithm>
+
 #include <OgreSceneNode.h>
 
 #include <libs/openengine/bullet/physic.hpp>
+#include <libs/openengine/bullet/trace.h>
 
 #include <components/bsa/bsa_archive.hpp>
 #include <components/files/collections.hpp>
@@ -120,6 +125,18 @@ namespace MWWorld
             }
         }
 
+        void finishLoading()
+        {
+            // The same loader may be registered for several extensions
+            std::set<ContentLoader*> finished;
+
+            for (LoadersContainer::iterator it = mLoaders.begin(); it != mLoaders.end(); ++it)
+            {
+                if (finished.insert(it->second).second)
+                    it->second->finishLoading();
+            }
+        }
+
         private:
           typedef std::tr1::unordered_map<std::string, ContentLoader*> LoadersContainer;
           LoadersContainer mLoaders;
@@ -217,7 +234,7 @@ namespace MWWorld
       mFallback(fallbackMap), mPlayIntro(0), mTeleportEnabled(true), mLevitationEnabled(false),
       mFacedDistance(FLT_MAX), mGodMode(false)
     {
-        mPhysics = new PhysicsSystem(renderer);
+        mPhysics = new PhysicsSystem(renderer, cacheDir);
         mPhysEngine = mPhysics->getEngine();
 
         mRendering = new MWRender::RenderingManager(renderer, resDir, cacheDir, mPhysEngine,&mFallback);
@@ -232,7 +249,7 @@ namespace MWWorld
         listener->loadingOn();
 
         GameContentLoader gameContentLoader(*listener);
-        EsmLoader esmLoader(mStore, mEsm, encoder, *listener);
+        EsmLoader esmLoader(mStore, mEsm, encoder, *listener, cacheDir);
         OmwLoader omwLoader(*listener);
 
         gameContentLoader.addLoader(".esm", &esmLoader);
@@ -253,7 +270,7 @@ namespace MWWorld
 
         mGlobalVariables = new Globals (mStore);
 
-        mWorldScene = new Scene(*mRendering, mPhysics);
+        mWorldScene = new Scene(*mRendering, mPhysics, mCells);
     }
 
     void World::startNewGame()
@@ -433,6 +450,21 @@ namespace MWWorld
         return (*mGlobalVariables)[name];
     }
 
+    Globals::Data& World::getGlobalVariable (int index)
+    {
+        return (*mGlobalVariables)[index];
+    }
+
+    Globals::Data World::getGlobalVariable (int index) const
+    {
+        return (*mGlobalVariables)[index];
+    }
+
+    int World::getGlobalVariableIndex (const std::string& name) const
+    {
+        return mGlobalVariables->getIndex (name);
+    }
+
     char World::getGlobalVariableType (const std::string& name) const
     {
         return mGlobalVariables->getType (name);
@@ -498,6 +530,13 @@ namespace MWWorld
         if (!ptr.isEmpty())
             return ptr;
 
+        // references that have been looked up or placed before
+        Ptr indexed = mCells.searchIndex (name);
+
+        if (!indexed.isEmpty() &&
+            mWorldScene->getActiveCells().find (indexed.getCell())!=mWorldScene->getActiveCells().end())
+            return indexed;
+
         // active cells
         for (Scene::CellStoreCollection::const_iterator iter (mWorldScene->getActiveCells().begin());
             iter!=mWorldScene->getActiveCells().end(); ++iter)
@@ -511,6 +550,9 @@ namespace MWWorld
 
         if (!activeOnly)
         {
+            if (!indexed.isEmpty())
+                return indexed;
+
             Ptr ptr = mCells.getPtr (name);
 
             if (!ptr.isEmpty())
@@ -532,6 +574,24 @@ namespace MWWorld
     {
         if (mPlayer->getPlayer().getRefData().getHandle()==handle)
             return mPlayer->getPlayer();
+
+        Ptr ptr = mWorldScene->searchPtrViaHandle (handle);
+
+#ifndef NDEBUG
+        Ptr scanned = scanPtrViaHandle (handle);
+
+        if (ptr!=scanned)
+        {
+            std::cerr << "Warning: handle index out of sync for " << handle << std::endl;
+            return scanned;
+        }
+#endif
+
+        return ptr;
+    }
+
+    Ptr World::scanPtrViaHandle (const std::string& handle)
+    {
         for (Scene::CellStoreCollection::const_iterator iter (mWorldScene->getActiveCells().begin());
             iter!=mWorldScene->getActiveCells().end(); ++iter)
         {
@@ -850,6 +910,9 @@ namespace MWWorld
         {
             ptr.getRefData().setCount(0);
 
+            if (ptr.isInCell())
+                mCells.removeFromIndex (ptr);
+
             if (ptr.isInCell()
                 && mWorldScene->getActiveCells().find(ptr.getCell()) != mWorldScene->getActiveCells().end()
                 && ptr.getRefData().isEnabled())
@@ -893,8 +956,10 @@ namespace MWWorld
             }
             else
             {
+                MWWorld::Ptr moved;
+
                 if (!mWorldScene->isCellActive(*currCell))
-                    copyObjectToCell(ptr, newCell, pos);
+                    moved = copyObjectToCell(ptr, newCell, pos);
                 else if (!mWorldScene->isCellActive(newCell))
                 {
                     mWorldScene->removeObjectFromScene(ptr);
@@ -907,6 +972,7 @@ namespace MWWorld
                     newPtr.getRefData().setBaseNode(0);
 
                     objectLeftActiveCell(ptr, newPtr);
+                    moved = newPtr;
                 }
                 else
                 {
@@ -914,6 +980,7 @@ namespace MWWorld
                         MWWorld::Class::get(ptr).copyToCell(ptr, newCell, pos);
 
                     mRendering->updateObjectCell(ptr, copy);
+                    mWorldScene->updateHandle(copy);
 
                     MWBase::MechanicsManager *mechMgr = MWBase::Environment::get().getMechanicsManager();
                     mechMgr->updateCell(ptr, copy);
@@ -927,8 +994,13 @@ namespace MWWorld
                         mLocalScripts.add(script, copy);
                         addContainerScripts (copy, &newCell);
                     }
+
+                    moved = copy;
                 }
                 ptr.getRefData().setCount(0);
+
+                // replaces the entry of the original, which has just been deleted
+                mCells.addToIndex (moved);
             }
         }
         if (haveToMove)
@@ -1146,7 +1218,7 @@ namespace MWWorld
         if(player != results.end())
             moveObjectImp(player->first, player->second.x, player->second.y, player->second.z);
 
-        mPhysEngine->stepSimulation(duration);
+        mPhysics->stepSimulation(duration);
     }
 
     bool World::castRay (float x1, float y1, float z1, float x2, float y2, float z2)
@@ -1196,6 +1268,13 @@ namespace MWWorld
         return mPhysics->toggleCollisionMode();
     }
 
+    std::string World::benchmarkMovement (int frames, int copies)
+    {
+        std::ostringstream stream;
+        mPhysics->benchmarkMovement (std::max (frames, 1), std::max (copies, 1), stream);
+        return stream.str();
+    }
+
     bool World::toggleRenderMode (RenderMode mode)
     {
         return mRendering->toggleRenderMode (mode);
@@ -1543,6 +1622,8 @@ namespace MWWorld
         MWWorld::Ptr dropped =
             MWWorld::Class::get(object).copyToCell(object, cell, pos);
 
+        mCells.addToIndex (dropped);
+
         if (object.getClass().isActor() || adjustPos)
         {
             Ogre::Vector3 min, max;
@@ -1845,24 +1926,48 @@ namespace MWWorld
 
     bool World::getLOS(const MWWorld::Ptr& npc,const MWWorld::Ptr& targetNpc)
     {
-        // This is a placeholder! Needs to go into an NPC awareness check function (see
-        // https://wiki.openmw.org/index.php?title=Research:NPC_AI_Behaviour#NPC_Awareness_Check )
-        if (targetNpc.getClass().getCreatureStats(targetNpc).getMagicEffects().get(ESM::MagicEffect::Invisibility).mMagnitude)
-            return false;
-        if (targetNpc.getClass().getCreatureStats(targetNpc).getMagicEffects().get(ESM::MagicEffect::Chameleon).mMagnitude > 100)
-            return false;
+        std::vector<std::pair<MWWorld::Ptr, MWWorld::Ptr> > pairs(1, std::make_pair(npc, targetNpc));
+        std::vector<bool> visible;
+        getLOS(pairs, visible);
+        return visible[0];
+    }
 
-        Ogre::Vector3 halfExt1 = mPhysEngine->getCharacter(npc.getRefData().getHandle())->getHalfExtents();
-        float* pos1 = npc.getRefData().getPosition().pos;
-        Ogre::Vector3 halfExt2 = mPhysEngine->getCharacter(targetNpc.getRefData().getHandle())->getHalfExtents();
-        float* pos2 = targetNpc.getRefData().getPosition().pos;
+    void World::getLOS(const std::vector<std::pair<MWWorld::Ptr, MWWorld::Ptr> >& pairs,
+        std::vector<bool>& visible)
+    {
+        OEngine::Physic::RayBatch batch;
+        std::vector<int> queries(pairs.size(), -1);
 
-        btVector3 from(pos1[0],pos1[1],pos1[2]+halfExt1.z);
-        btVector3 to(pos2[0],pos2[1],pos2[2]+halfExt2.z);
+        for (std::size_t i = 0; i < pairs.size(); ++i)
+        {
+            const MWWorld::Ptr& npc = pairs[i].first;
+            const MWWorld::Ptr& targetNpc = pairs[i].second;
 
-        std::pair<std::string, float> result = mPhysEngine->rayTest(from, to,false);
-        if(result.first == "") return true;
-        return false;
+            // This is a placeholder! Needs to go into an NPC awareness check function (see
+            // https://wiki.openmw.org/index.php?title=Research:NPC_AI_Behaviour#NPC_Awareness_Check )
+            if (targetNpc.getClass().getCreatureStats(targetNpc).getMagicEffects().get(ESM::MagicEffect::Invisibility).mMagnitude)
+                continue;
+            if (targetNpc.getClass().getCreatureStats(targetNpc).getMagicEffects().get(ESM::MagicEffect::Chameleon).mMagnitude > 100)
+                continue;
+
+            Ogre::Vector3 halfExt1 = mPhysEngine->getCharacter(npc.getRefData().getHandle())->getHalfExtents();
+            float* pos1 = npc.getRefData().getPosition().pos;
+            Ogre::Vector3 halfExt2 = mPhysEngine->getCharacter(targetNpc.getRefData().getHandle())->getHalfExtents();
+            float* pos2 = targetNpc.getRefData().getPosition().pos;
+
+            btVector3 from(pos1[0],pos1[1],pos1[2]+halfExt1.z);
+            btVector3 to(pos2[0],pos2[1],pos2[2]+halfExt2.z);
+
+            queries[i] = static_cast<int> (batch.add(OEngine::Physic::RayQuery(from, to,
+                OEngine::Physic::CollisionType_World|OEngine::Physic::CollisionType_HeightMap)));
+        }
+
+        mPhysics->castRays(batch);
+
+        visible.assign(pairs.size(), false);
+        for (std::size_t i = 0; i < pairs.size(); ++i)
+            if (queries[i] != -1)
+                visible[i] = batch.getHit(queries[i]).mObject == -1;
     }
 
     void World::enableActorCollision(const MWWorld::Ptr& actor, bool enable)
@@ -2047,6 +2152,8 @@ namespace MWWorld
                 contentLoader.load(col.getPath(*it), idx);
             }
         }
+
+        contentLoader.finishLoading();
     }
 
     bool World::startSpellCast(const Ptr &actor)
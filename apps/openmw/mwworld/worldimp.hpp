@@ -80,6 +80,10 @@ namespace MWWorld
 
             Ptr getPtrViaHandle (const std::string& handle, Ptr::CellStore& cellStore);
 
+            Ptr scanPtrViaHandle (const std::string& handle);
+            ///< Search all active cells for \a handle. Used to validate the scene's handle index
+            /// in debug builds.
+
             int mActivationDistanceOverride;
             std::string mFacedHandle;
             float mFacedDistance;
@@ -215,6 +219,14 @@ namespace MWWorld
 
             virtual Globals::Data getGlobalVariable (const std::string& name) const;
 
+            virtual Globals::Data& getGlobalVariable (int index);
+
+            virtual Globals::Data getGlobalVariable (int index) const;
+
+            virtual int getGlobalVariableIndex (const std::string& name) const;
+            ///< Return an index, that can be used instead of the name of the global variable, or -1,
+            /// if there is no global variable with this name.
+
             virtual char getGlobalVariableType (const std::string& name) const;
             ///< Return ' ', if there is no global variable with this name.
 
@@ -332,6 +344,11 @@ namespace MWWorld
             /// collisions and gravity.
             ///< \return Resulting mode
 
+            virtual std::string benchmarkMovement (int frames, int copies);
+            ///< Move the actors of the last frame \a copies times over for \a frames frames, on
+            /// the main thread and on the movement threads, without changing the world.
+            /// \return Report of the timings
+
             virtual bool toggleRenderMode (RenderMode mode);
             ///< Toggle a render mode.
             ///< \return Resulting mode
@@ -452,6 +469,11 @@ namespace MWWorld
             virtual bool getLOS(const MWWorld::Ptr& npc,const MWWorld::Ptr& targetNpc);
             ///< get Line of Sight (morrowind stupid implementation)
 
+            virtual void getLOS(const std::vector<std::pair<MWWorld::Ptr, MWWorld::Ptr> >& pairs,
+                std::vector<bool>& visible);
+            ///< Line of Sight for all \a pairs (npc, target) at once. \a visible[i] is the result
+            /// for \a pairs[i].
+
             virtual void enableActorCollision(const MWWorld::Ptr& actor, bool enable);
 
             virtual void setupExternalRendering (MWRender::ExternalRendering& rendering);
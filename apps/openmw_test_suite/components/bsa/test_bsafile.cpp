@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+#include <ctime>
+
+#include "components/bsa/bsa_file.hpp"
+#include "components/files/lowlevelfile.hpp"
+
+struct BSAFileTest : public ::testing::Test
+{
+  protected:
+    BSAFileTest()
+      : mFileName("./bsa_file_test.bsa")
+    {
+    }
+
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+      std::remove(mFileName.c_str());
+    }
+
+    static void write32(std::ostream& stream, uint32_t value)
+    {
+      stream.write(reinterpret_cast<const char*>(&value), 4);
+    }
+
+    /// Write an archive in the Morrowind BSA layout
+    void write(const std::vector<std::string>& names, const std::vector<std::string>& contents)
+    {
+      uint32_t count = names.size();
+      uint32_t nameSize = 0;
+      for (size_t i = 0; i < names.size(); ++i)
+        nameSize += names[i].size() + 1;
+
+      std::ofstream ofs(mFileName.c_str(), std::ofstream::out | std::ofstream::binary);
+
+      write32(ofs, 0x100);
+      write32(ofs, 12 * count + nameSize);
+      write32(ofs, count);
+
+      uint32_t offset = 0;
+      for (size_t i = 0; i < contents.size(); ++i)
+      {
+        write32(ofs, contents[i].size());
+        write32(ofs, offset);
+        offset += contents[i].size();
+      }
+
+      offset = 0;
+      for (size_t i = 0; i < names.size(); ++i)
+      {
+        write32(ofs, offset);
+        offset += names[i].size() + 1;
+      }
+
+      for (size_t i = 0; i < names.size(); ++i)
+        ofs.write(names[i].c_str(), names[i].size() + 1);
+
+      // hash table, not used
+      for (size_t i = 0; i < count; ++i)
+      {
+        write32(ofs, 0);
+        write32(ofs, 0);
+      }
+
+      for (size_t i = 0; i < contents.size(); ++i)
+        ofs.write(contents[i].data(), contents[i].size());
+    }
+
+    static std::string read(Ogre::DataStreamPtr stream)
+    {
+      std::string data(stream->size(), '\0');
+      if (!data.empty())
+        data.resize(stream->read(&data[0], data.size()));
+      return data;
+    }
+
+    std::string mFileName;
+};
+
+TEST_F(BSAFileTest, lookup_ignores_case)
+{
+  std::vector<std::string> names, contents;
+  names.push_back("meshes\\a.nif");
+  contents.push_back("first file, long enough to be a valid archive entry");
+  names.push_back("textures\\B.dds");
+  contents.push_back("second file, long enough to be a valid archive entry");
+  write(names, contents);
+
+  Bsa::BSAFile file;
+  file.open(mFileName);
+
+  ASSERT_TRUE(file.exists("MESHES\\A.NIF"));
+  ASSERT_TRUE(file.exists("textures\\b.dds"));
+  ASSERT_FALSE(file.exists("meshes\\b.nif"));
+  ASSERT_EQ(2u, file.getList().size());
+}
+
+TEST_F(BSAFileTest, get_file_returns_contents)
+{
+  std::vector<std::string> names, contents;
+  names.push_back("a.txt");
+  contents.push_back("the contents of the first file in the archive");
+  names.push_back("b.txt");
+  contents.push_back("the contents of the second file in the archive");
+  write(names, contents);
+
+  Bsa::BSAFile file;
+  file.open(mFileName);
+
+  ASSERT_EQ(contents[1], read(file.getFile("B.TXT")));
+  ASSERT_EQ(contents[0], read(file.getFile("a.txt")));
+  ASSERT_THROW(file.getFile("c.txt"), std::runtime_error);
+}
+
+TEST_F(BSAFileTest, prefetch_skips_unknown_files)
+{
+  std::vector<std::string> names, contents;
+  names.push_back("a.txt");
+  contents.push_back("the contents of the first file in the archive");
+  names.push_back("b.txt");
+  contents.push_back("the contents of the second file in the archive");
+  write(names, contents);
+
+  Bsa::BSAFile file;
+  file.open(mFileName);
+
+  std::vector<std::string> request;
+  request.push_back("B.txt");
+  request.push_back("c.txt");
+  file.prefetch(request);
+  file.waitForPrefetches();
+
+  ASSERT_EQ(contents[1], read(file.getFile("b.txt")));
+
+#if FILE_API != FILE_API_STDIO
+  ASSERT_EQ(contents[1].size(), file.getPrefetchedBytes());
+#endif
+}
+
+// Reads every file of a generated archive through getFile(), once directly and once after
+// prefetching all of them. Run with --gtest_also_run_disabled_tests.
+TEST_F(BSAFileTest, DISABLED_throughput_benchmark)
+{
+  const int files = 4000;
+  const size_t fileSize = 16 * 1024;
+
+  std::vector<std::string> names, contents;
+  for (int i = 0; i < files; ++i)
+  {
+    std::ostringstream name;
+    name << "meshes\\x\\file" << i << ".nif";
+    names.push_back(name.str());
+    contents.push_back(std::string(fileSize, char('a' + i % 26)));
+  }
+  write(names, contents);
+  contents.clear();
+
+  Bsa::BSAFile file;
+  file.open(mFileName);
+
+  size_t bytes = 0;
+  std::clock_t start = std::clock();
+  for (int i = 0; i < files; ++i)
+    bytes += read(file.getFile(names[i].c_str())).size();
+  double direct = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  file.prefetch(names);
+  file.waitForPrefetches();
+  for (int i = 0; i < files; ++i)
+    bytes -= read(file.getFile(names[i].c_str())).size();
+  double prefetched = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  ASSERT_EQ(0u, bytes);
+
+  double megabytes = double(files) * fileSize / (1024 * 1024);
+  std::cout << "getFile:            " << megabytes / direct << " MB/s" << std::endl;
+  std::cout << "prefetch + getFile: " << megabytes / prefetched << " MB/s" << std::endl;
+}
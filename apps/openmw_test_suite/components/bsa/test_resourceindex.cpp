@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <ctime>
+
+#include <boost/filesystem.hpp>
+
+#include "components/bsa/resourceindex.hpp"
+
+struct ResourceIndexTest : public ::testing::Test
+{
+  protected:
+    ResourceIndexTest()
+      : mDir("./resource_index_test")
+      , mArchive("./resource_index_test.bsa")
+    {
+    }
+
+    virtual void SetUp()
+    {
+      boost::filesystem::create_directories(mDir + "/Meshes/X");
+    }
+
+    virtual void TearDown()
+    {
+      boost::filesystem::remove_all(mDir);
+      boost::filesystem::remove(mArchive);
+    }
+
+    void writeFile(const std::string& name, const std::string& content)
+    {
+      std::ofstream ofs((mDir + "/" + name).c_str(), std::ofstream::out | std::ofstream::binary);
+      ofs << content;
+    }
+
+    static void write32(std::ostream& stream, uint32_t value)
+    {
+      stream.write(reinterpret_cast<const char*>(&value), 4);
+    }
+
+    /// Write an archive in the Morrowind BSA layout
+    void writeArchive(const std::vector<std::string>& names, const std::vector<std::string>& contents)
+    {
+      uint32_t nameSize = 0;
+      for (size_t i = 0; i < names.size(); ++i)
+        nameSize += names[i].size() + 1;
+
+      std::ofstream ofs(mArchive.c_str(), std::ofstream::out | std::ofstream::binary);
+
+      write32(ofs, 0x100);
+      write32(ofs, 12 * names.size() + nameSize);
+      write32(ofs, names.size());
+
+      uint32_t offset = 0;
+      for (size_t i = 0; i < contents.size(); ++i)
+      {
+        write32(ofs, contents[i].size());
+        write32(ofs, offset);
+        offset += contents[i].size();
+      }
+
+      offset = 0;
+      for (size_t i = 0; i < names.size(); ++i)
+      {
+        write32(ofs, offset);
+        offset += names[i].size() + 1;
+      }
+
+      for (size_t i = 0; i < names.size(); ++i)
+        ofs.write(names[i].c_str(), names[i].size() + 1);
+
+      for (size_t i = 0; i < names.size() * 2; ++i)
+        write32(ofs, 0);
+
+      for (size_t i = 0; i < contents.size(); ++i)
+        ofs.write(contents[i].data(), contents[i].size());
+    }
+
+    static std::string read(Ogre::DataStreamPtr stream)
+    {
+      std::string data(stream->size(), '\0');
+      if (!data.empty())
+        data.resize(stream->read(&data[0], data.size()));
+      return data;
+    }
+
+    std::string mDir;
+    std::string mArchive;
+};
+
+TEST_F(ResourceIndexTest, later_sources_take_precedence)
+{
+  std::vector<std::string> names, contents;
+  names.push_back("meshes\\x\\a.nif");
+  contents.push_back("a.nif from the archive");
+  names.push_back("meshes\\x\\b.nif");
+  contents.push_back("b.nif from the archive");
+  writeArchive(names, contents);
+
+  writeFile("Meshes/X/A.NIF", "a.nif from the directory");
+
+  Bsa::ResourceIndex index;
+  index.addArchive(mArchive);
+  index.addDirectory(mDir);
+
+  ASSERT_EQ(2u, index.getEntries().size());
+
+  const Bsa::ResourceIndex::Entry *a = index.lookup("meshes\\x\\a.nif");
+  ASSERT_TRUE(a != 0);
+  ASSERT_TRUE(index.getArchive(*a) == 0);
+  ASSERT_EQ("a.nif from the directory", read(index.open(*a)));
+
+  const Bsa::ResourceIndex::Entry *b = index.lookup("MESHES/X/B.NIF");
+  ASSERT_TRUE(b != 0);
+  ASSERT_TRUE(index.getArchive(*b) != 0);
+  ASSERT_EQ(contents[1].size(), b->mSize);
+  ASSERT_EQ("b.nif from the archive", read(index.open(*b)));
+
+  ASSERT_TRUE(index.lookup("meshes/x/c.nif") == 0);
+  ASSERT_THROW(index.open("meshes/x/c.nif"), std::runtime_error);
+}
+
+TEST_F(ResourceIndexTest, strict_directories_match_case)
+{
+  writeFile("Meshes/X/A.NIF", "a.nif");
+
+  Bsa::ResourceIndex index;
+  index.addDirectory(mDir, true);
+
+  ASSERT_TRUE(index.lookup("Meshes\\X\\A.NIF") != 0);
+  ASSERT_TRUE(index.lookup("meshes/x/a.nif") == 0);
+}
+
+TEST_F(ResourceIndexTest, strict_directories_fall_back_to_archives)
+{
+  std::vector<std::string> names, contents;
+  names.push_back("meshes\\x\\a.nif");
+  contents.push_back("a.nif from the archive");
+  writeArchive(names, contents);
+
+  writeFile("Meshes/X/A.NIF", "a.nif from the directory");
+
+  Bsa::ResourceIndex index;
+  index.addArchive(mArchive);
+  index.addDirectory(mDir, true);
+
+  const Bsa::ResourceIndex::Entry *exact = index.lookup("Meshes/X/A.NIF");
+  ASSERT_TRUE(exact != 0);
+  ASSERT_EQ("a.nif from the directory", read(index.open(*exact)));
+
+  const Bsa::ResourceIndex::Entry *other = index.lookup("meshes\\x\\a.nif");
+  ASSERT_TRUE(other != 0);
+  ASSERT_EQ("a.nif from the archive", read(index.open(*other)));
+}
+
+// Resolves names against 20 archives, the way Ogre searched one archive after another,
+// and against the merged index. Run with --gtest_also_run_disabled_tests.
+TEST_F(ResourceIndexTest, DISABLED_lookup_benchmark)
+{
+  const int archives = 20;
+  const int filesPerArchive = 2000;
+  const int lookups = 200000;
+
+  std::vector<std::string> names, contents;
+  for (int i = 0; i < filesPerArchive; ++i)
+  {
+    std::ostringstream name;
+    name << "meshes\\x\\file" << i << ".nif";
+    names.push_back(name.str());
+    contents.push_back("data");
+  }
+  writeArchive(names, contents);
+
+  std::vector<Bsa::ResourceIndex> separate(archives);
+  Bsa::ResourceIndex merged;
+  for (int i = 0; i < archives; ++i)
+  {
+    separate[i].addArchive(mArchive);
+    merged.addArchive(mArchive);
+  }
+
+  // Every other name is missing, which means searching all archives
+  std::vector<std::string> requests;
+  for (int i = 0; i < filesPerArchive; ++i)
+    requests.push_back(i % 2 ? "Meshes/X/File" + names[i].substr(13) : "meshes/x/missing.nif");
+
+  int found = 0;
+  std::clock_t start = std::clock();
+  for (int i = 0; i < lookups; ++i)
+    for (int j = archives - 1; j >= 0; --j)
+      if (separate[j].lookup(requests[i % requests.size()]))
+      {
+        ++found;
+        break;
+      }
+  double separateTime = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  for (int i = 0; i < lookups; ++i)
+    if (merged.lookup(requests[i % requests.size()]))
+      --found;
+  double mergedTime = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  ASSERT_EQ(0, found);
+
+  std::cout << "one index per archive: " << separateTime << " s" << std::endl;
+  std::cout << "merged index:          " << mergedTime << " s" << std::endl;
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "components/compiler/batchcompiler.hpp"
+
+#include "../interpreter/scripttestcontext.hpp"
+
+struct BatchCompilerTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      Compiler::registerExtensions(mExtensions);
+      mContext.setExtensions(&mExtensions);
+    }
+
+    virtual void TearDown()
+    {
+    }
+
+    /// Compile \a source on this thread, without the batch compiler
+    bool compileSerially(const std::string& source, std::vector<Interpreter::Type_Code>& code,
+      Compiler::Locals& locals, std::string& messages)
+    {
+      std::ostringstream stream;
+      Compiler::StreamErrorHandler errorHandler(stream);
+      Compiler::FileParser parser(errorHandler, mContext);
+
+      std::istringstream input(source);
+      Compiler::Scanner scanner(errorHandler, input, &mExtensions);
+
+      try
+      {
+        scanner.scan(parser);
+      }
+      catch (const Compiler::SourceException&)
+      {
+      }
+
+      messages = stream.str();
+
+      if (!errorHandler.isGood())
+        return false;
+
+      parser.getCode(code);
+      locals = parser.getLocals();
+      return true;
+    }
+
+    std::vector<std::string> getScripts()
+    {
+      std::vector<std::string> scripts = ScriptTest::getSampleScripts();
+
+      scripts.push_back(
+        "Begin BrokenScript\n"
+        "short x\n"
+        "set y to 1\n"
+        "set x to\n"
+        "End\n");
+
+      return scripts;
+    }
+
+    Compiler::Extensions mExtensions;
+    ScriptTest::CompilerContext mContext;
+};
+
+TEST_F(BatchCompilerTest, results_match_serial_compilation)
+{
+  std::vector<std::string> scripts = getScripts();
+
+  for (unsigned int threads = 1; threads <= 4; threads += 3)
+  {
+    Compiler::BatchCompiler compiler(mContext, threads);
+
+    // several copies, so that the scripts are compiled at the same time
+    for (int n = 0; n < 8; ++n)
+      for (std::size_t i = 0; i < scripts.size(); ++i)
+        ASSERT_EQ(static_cast<int>(n * scripts.size() + i), compiler.add("script", scripts[i]));
+
+    ASSERT_EQ(static_cast<int>(8 * scripts.size()), compiler.size());
+
+    for (int i = 0; i < compiler.size(); ++i)
+    {
+      std::vector<Interpreter::Type_Code> code;
+      Compiler::Locals locals;
+      std::string messages;
+      bool success = compileSerially(scripts[i % scripts.size()], code, locals, messages);
+      const Compiler::Locals& expected = locals;
+
+      const Compiler::BatchCompiler::Result& result = compiler.getResult(i);
+
+      ASSERT_EQ("script", result.mName);
+      ASSERT_EQ(success, result.mSuccess);
+      ASSERT_EQ(messages, result.mMessages);
+      ASSERT_EQ(code, result.mCode);
+
+      for (const char *type = "slf"; *type; ++type)
+        ASSERT_EQ(expected.get(*type), result.mLocals.get(*type));
+    }
+  }
+}
+
+TEST_F(BatchCompilerTest, broken_script_reports_errors)
+{
+  Compiler::BatchCompiler compiler(mContext, 2);
+  compiler.add("broken", getScripts().back());
+
+  const Compiler::BatchCompiler::Result& result = compiler.getResult(0);
+  ASSERT_FALSE(result.mSuccess);
+  ASSERT_TRUE(result.mCode.empty());
+  ASSERT_NE(std::string::npos, result.mMessages.find("error"));
+}
+
+TEST_F(BatchCompilerTest, buffer_and_stream_give_the_same_code)
+{
+  std::vector<std::string> scripts = getScripts();
+
+  // also without the final line break, so that the input ends in the middle of a token
+  scripts.push_back(scripts[0].substr(0, scripts[0].size() - 1));
+
+  for (std::size_t i = 0; i < scripts.size(); ++i)
+  {
+    std::vector<Interpreter::Type_Code> code;
+    Compiler::Locals locals;
+    std::string messages;
+    bool success = compileSerially(scripts[i], code, locals, messages);
+
+    std::ostringstream stream;
+    Compiler::StreamErrorHandler errorHandler(stream);
+    Compiler::FileParser parser(errorHandler, mContext);
+
+    ASSERT_EQ(success, Compiler::compile(scripts[i], parser, errorHandler, &mExtensions, stream));
+    ASSERT_EQ(messages, stream.str());
+
+    if (success)
+    {
+      std::vector<Interpreter::Type_Code> bufferCode;
+      parser.getCode(bufferCode);
+      ASSERT_EQ(code, bufferCode);
+    }
+  }
+}
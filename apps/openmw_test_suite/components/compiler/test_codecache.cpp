@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <ctime>
+
+#include <boost/filesystem.hpp>
+
+#include "components/compiler/codecache.hpp"
+
+#include "../interpreter/scripttestcontext.hpp"
+
+struct CodeCacheTest : public ::testing::Test
+{
+  protected:
+    CodeCacheTest()
+      : mFile("./code_cache_test.cache")
+    {
+    }
+
+    virtual void SetUp()
+    {
+      Compiler::registerExtensions(mExtensions);
+    }
+
+    virtual void TearDown()
+    {
+      boost::filesystem::remove(mFile);
+    }
+
+    std::string mFile;
+    Compiler::Extensions mExtensions;
+};
+
+TEST_F(CodeCacheTest, scripts_survive_save_and_load)
+{
+  std::vector<std::string> scripts = ScriptTest::getSampleScripts();
+
+  Compiler::CodeCache cache(mExtensions);
+  ASSERT_FALSE(cache.load(mFile));
+
+  std::vector<std::vector<Interpreter::Type_Code> > code(scripts.size());
+  std::vector<Compiler::Locals> locals(scripts.size());
+
+  for (size_t i = 0; i < scripts.size(); ++i)
+  {
+    ScriptTest::compile(scripts[i], code[i], locals[i]);
+    std::ostringstream name;
+    name << "script" << i;
+    cache.set(name.str(), scripts[i], code[i], locals[i]);
+  }
+
+  ASSERT_TRUE(cache.isModified());
+  cache.save(mFile);
+  ASSERT_FALSE(cache.isModified());
+
+  Compiler::CodeCache loaded(mExtensions);
+  ASSERT_TRUE(loaded.load(mFile));
+  ASSERT_EQ(scripts.size(), loaded.size());
+
+  for (size_t i = 0; i < scripts.size(); ++i)
+  {
+    std::ostringstream name;
+    name << "script" << i;
+
+    std::vector<Interpreter::Type_Code> cachedCode;
+    Compiler::Locals cachedLocals;
+    ASSERT_TRUE(loaded.get(name.str(), scripts[i], cachedCode, cachedLocals));
+    ASSERT_EQ(code[i], cachedCode);
+
+    std::ostringstream expected, actual;
+    locals[i].write(expected);
+    cachedLocals.write(actual);
+    ASSERT_EQ(expected.str(), actual.str());
+
+    // a changed script has to be compiled again
+    ASSERT_FALSE(loaded.get(name.str(), scripts[i] + ";\n", cachedCode, cachedLocals));
+  }
+}
+
+TEST_F(CodeCacheTest, changed_extensions_invalidate_the_cache)
+{
+  std::vector<Interpreter::Type_Code> code;
+  Compiler::Locals locals;
+  ScriptTest::compile(ScriptTest::getSampleScripts()[0], code, locals);
+
+  Compiler::CodeCache cache(mExtensions);
+  cache.set("script", "source", code, locals);
+  cache.save(mFile);
+
+  mExtensions.registerInstruction("newinstruction", "", 0x2000000 + 0xffff);
+
+  Compiler::CodeCache loaded(mExtensions);
+  ASSERT_FALSE(loaded.load(mFile));
+  ASSERT_EQ(0u, loaded.size());
+}
+
+TEST_F(CodeCacheTest, changed_key_data_invalidates_the_cache)
+{
+  std::vector<Interpreter::Type_Code> code;
+  Compiler::Locals locals;
+  ScriptTest::compile(ScriptTest::getSampleScripts()[0], code, locals);
+
+  std::string content("morrowind.esm");
+
+  Compiler::CodeCache cache(mExtensions);
+  cache.addToKey(content.c_str(), content.size());
+  cache.set("script", "source", code, locals);
+  cache.save(mFile);
+
+  Compiler::CodeCache same(mExtensions);
+  same.addToKey(content.c_str(), content.size());
+  ASSERT_TRUE(same.load(mFile));
+
+  content = "tribunal.esm";
+
+  Compiler::CodeCache changed(mExtensions);
+  changed.addToKey(content.c_str(), content.size());
+  ASSERT_FALSE(changed.load(mFile));
+  ASSERT_EQ(0u, changed.size());
+}
+
+// Compiles the sample scripts and reads them from a cache file.
+// Run with --gtest_also_run_disabled_tests.
+TEST_F(CodeCacheTest, DISABLED_compile_versus_load_benchmark)
+{
+  const int copies = 2000;
+
+  std::vector<std::string> scripts = ScriptTest::getSampleScripts();
+
+  Compiler::CodeCache cache(mExtensions);
+
+  std::clock_t start = std::clock();
+  for (int i = 0; i < copies; ++i)
+    for (size_t j = 0; j < scripts.size(); ++j)
+    {
+      std::vector<Interpreter::Type_Code> code;
+      Compiler::Locals locals;
+      ScriptTest::compile(scripts[j], code, locals);
+
+      std::ostringstream name;
+      name << "script" << i << "_" << j;
+      cache.set(name.str(), scripts[j], code, locals);
+    }
+  double compiled = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  cache.save(mFile);
+
+  start = std::clock();
+  Compiler::CodeCache loaded(mExtensions);
+  ASSERT_TRUE(loaded.load(mFile));
+  double load = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  ASSERT_EQ(cache.size(), loaded.size());
+
+  std::cout << "compiling " << cache.size() << " scripts: " << compiled << " s" << std::endl;
+  std::cout << "loading them from the cache: " << load << " s" << std::endl;
+}
@@ -0,0 +1,246 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+
+#include <boost/filesystem.hpp>
+
+#include "components/compiler/keywordtable.hpp"
+#include "components/compiler/parser.hpp"
+#include "components/compiler/nullerrorhandler.hpp"
+#include "components/misc/stringops.hpp"
+
+#include "../interpreter/scripttestcontext.hpp"
+
+namespace
+{
+  /// Records the tokens delivered by the scanner
+  class TokenParser : public Compiler::Parser
+  {
+    public:
+
+      std::vector<int> mKeywords;
+      std::vector<std::string> mNames;
+      int mTokens;
+
+      TokenParser(Compiler::ErrorHandler& errorHandler, Compiler::Context& context)
+        : Compiler::Parser(errorHandler, context)
+        , mTokens(0)
+      {}
+
+      virtual bool parseInt(int value, const Compiler::TokenLoc& loc, Compiler::Scanner& scanner)
+      { ++mTokens; return true; }
+
+      virtual bool parseFloat(float value, const Compiler::TokenLoc& loc, Compiler::Scanner& scanner)
+      { ++mTokens; return true; }
+
+      virtual bool parseName(const std::string& name, const Compiler::TokenLoc& loc,
+        Compiler::Scanner& scanner)
+      { ++mTokens; mNames.push_back(name); return true; }
+
+      virtual bool parseKeyword(int keyword, const Compiler::TokenLoc& loc, Compiler::Scanner& scanner)
+      { ++mTokens; mKeywords.push_back(keyword); return true; }
+
+      virtual bool parseSpecial(int code, const Compiler::TokenLoc& loc, Compiler::Scanner& scanner)
+      { ++mTokens; return true; }
+
+      virtual bool parseComment(const std::string& comment, const Compiler::TokenLoc& loc,
+        Compiler::Scanner& scanner)
+      { ++mTokens; return true; }
+
+      virtual void parseEOF(Compiler::Scanner& scanner) {}
+  };
+}
+
+struct ScannerTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      Compiler::registerExtensions(mExtensions);
+      mContext.setExtensions(&mExtensions);
+    }
+
+    virtual void TearDown()
+    {
+    }
+
+    void scan(const std::string& source, TokenParser& parser)
+    {
+      Compiler::Scanner scanner(mErrorHandler, source.data(), source.data() + source.size(),
+        &mExtensions);
+      scanner.scan(parser);
+    }
+
+    /// Scripts of the content files dumped into the directory in OPENMW_SCRIPT_CORPUS (one
+    /// script per file) or, if it is not set, the sample scripts and a script that uses every
+    /// keyword of the extensions.
+    std::vector<std::string> getCorpus()
+    {
+      std::vector<std::string> scripts;
+
+      if (const char *directory = std::getenv("OPENMW_SCRIPT_CORPUS"))
+      {
+        for (boost::filesystem::directory_iterator iter(directory);
+          iter != boost::filesystem::directory_iterator(); ++iter)
+        {
+          std::ifstream file(iter->path().string().c_str(), std::ios::binary);
+          std::ostringstream text;
+          text << file.rdbuf();
+          scripts.push_back(text.str());
+        }
+
+        return scripts;
+      }
+
+      scripts = ScriptTest::getSampleScripts();
+
+      std::vector<std::string> keywords;
+      mExtensions.listKeywords(keywords);
+
+      std::string all = "Begin AllKeywords\n";
+      for (std::size_t i = 0; i < keywords.size(); ++i)
+        all += "player->" + keywords[i] + " \"some_id\" 1 2.5\n";
+      scripts.push_back(all + "End\n");
+
+      return scripts;
+    }
+
+    Compiler::Extensions mExtensions;
+    ScriptTest::CompilerContext mContext;
+    Compiler::NullErrorHandler mErrorHandler;
+};
+
+TEST_F(ScannerTest, keyword_table_ignores_case)
+{
+  Compiler::KeywordTable table;
+
+  // enough keywords to make the table grow several times
+  for (int i = 0; i < 200; ++i)
+  {
+    std::ostringstream keyword;
+    keyword << "keyword" << i;
+    ASSERT_TRUE(table.insert(keyword.str(), i));
+  }
+
+  ASSERT_FALSE(table.insert("keyword7", 1000));
+  ASSERT_FALSE(table.insert("", 1000));
+  ASSERT_EQ(200u, table.size());
+
+  int value = -1;
+  ASSERT_TRUE(table.search("KeyWord7", value));
+  ASSERT_EQ(7, value);
+  ASSERT_TRUE(table.search("KEYWORD199", value));
+  ASSERT_EQ(199, value);
+  ASSERT_FALSE(table.search("keyword", value));
+  ASSERT_FALSE(table.search("keyword200", value));
+  ASSERT_FALSE(table.search("", value));
+
+  const char text[] = "xkeyword12x";
+  ASSERT_TRUE(table.search(text + 1, text + 10, value));
+  ASSERT_EQ(12, value);
+}
+
+TEST_F(ScannerTest, keywords_are_recognised_in_any_case)
+{
+  TokenParser parser(mErrorHandler, mContext);
+  scan("Begin test\nIF ( menumode )\nreturn\nEndIf\nGetPos x\nfoo\n\"begin\"\nEND\n", parser);
+
+  // begin, if, menumode, return, endif, getpos, end
+  ASSERT_EQ(7u, parser.mKeywords.size());
+  ASSERT_EQ(Compiler::Scanner::K_begin, parser.mKeywords[0]);
+  ASSERT_EQ(Compiler::Scanner::K_if, parser.mKeywords[1]);
+  ASSERT_EQ(Compiler::Scanner::K_menumode, parser.mKeywords[2]);
+  ASSERT_EQ(Compiler::Scanner::K_return, parser.mKeywords[3]);
+  ASSERT_EQ(Compiler::Scanner::K_endif, parser.mKeywords[4]);
+  ASSERT_EQ(mExtensions.searchKeyword("getpos"), parser.mKeywords[5]);
+  ASSERT_EQ(Compiler::Scanner::K_end, parser.mKeywords[6]);
+
+  ASSERT_EQ(4u, parser.mNames.size());
+  ASSERT_EQ("test", parser.mNames[0]);
+  ASSERT_EQ("x", parser.mNames[1]);
+  ASSERT_EQ("foo", parser.mNames[2]);
+  ASSERT_EQ("begin", parser.mNames[3]);
+}
+
+TEST_F(ScannerTest, all_extension_keywords_are_recognised)
+{
+  std::vector<std::string> keywords;
+  mExtensions.listKeywords(keywords);
+  ASSERT_FALSE(keywords.empty());
+
+  for (std::size_t i = 0; i < keywords.size(); ++i)
+  {
+    std::string upper = keywords[i];
+    for (std::size_t j = 0; j < upper.size(); ++j)
+      upper[j] = std::toupper(upper[j]);
+
+    int keyword = mExtensions.searchKeyword(keywords[i]);
+    ASSERT_NE(0, keyword);
+    ASSERT_EQ(keyword, mExtensions.searchKeyword(upper.data(), upper.data() + upper.size()));
+  }
+}
+
+// Scans the script corpus and compares the keyword table with the lower case and map lookup
+// the scanner used before. Run with --gtest_also_run_disabled_tests, optionally with
+// OPENMW_SCRIPT_CORPUS set.
+TEST_F(ScannerTest, DISABLED_scanner_benchmark)
+{
+  const int runs = 200;
+
+  std::vector<std::string> scripts = getCorpus();
+
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < scripts.size(); ++i)
+    bytes += scripts[i].size();
+
+  int tokens = 0;
+  std::vector<std::string> names;
+
+  std::clock_t start = std::clock();
+  for (int n = 0; n < runs; ++n)
+    for (std::size_t i = 0; i < scripts.size(); ++i)
+    {
+      TokenParser parser(mErrorHandler, mContext);
+      scan(scripts[i], parser);
+      tokens += parser.mTokens;
+
+      if (n == 0)
+        names.insert(names.end(), parser.mNames.begin(), parser.mNames.end());
+    }
+  double scanning = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  std::cout << scripts.size() << " scripts, " << bytes << " bytes: "
+    << tokens / scanning << " tokens/s, " << runs * bytes / scanning / 1e6 << " MB/s" << std::endl;
+
+  // look up every identifier of the corpus, keywords and names alike
+  std::vector<std::string> identifiers(names);
+  mExtensions.listKeywords(identifiers);
+
+  std::map<std::string, int> map;
+  for (std::size_t i = 0; i < identifiers.size(); ++i)
+    map.insert(std::make_pair(Misc::StringUtils::lowerCase(identifiers[i]), int(i)));
+
+  int found = 0;
+
+  start = std::clock();
+  for (int n = 0; n < runs; ++n)
+    for (std::size_t i = 0; i < identifiers.size(); ++i)
+      found += map.find(Misc::StringUtils::lowerCase(identifiers[i])) != map.end();
+  double mapLookup = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  for (int n = 0; n < runs; ++n)
+    for (std::size_t i = 0; i < identifiers.size(); ++i)
+      found += mExtensions.searchKeyword(identifiers[i].data(),
+        identifiers[i].data() + identifiers[i].size()) != 0;
+  double tableLookup = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  std::cout << identifiers.size() << " identifiers: "
+    << runs * identifiers.size() / mapLookup << " lookups/s with lower case and map, "
+    << runs * identifiers.size() / tableLookup << " lookups/s with keyword table"
+    << " (" << found << ")" << std::endl;
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#include "components/files/mappedfile.hpp"
+
+struct MappedFileTest : public ::testing::Test
+{
+  protected:
+    MappedFileTest()
+      : mFileName("./mapped_file_test.bin")
+    {
+    }
+
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+      std::remove(mFileName.c_str());
+    }
+
+    void write(const char* data, size_t size)
+    {
+      std::ofstream ofs(mFileName.c_str(), std::ofstream::out | std::ofstream::binary);
+      ofs.write(data, size);
+    }
+
+    std::string mFileName;
+};
+
+TEST_F(MappedFileTest, maps_whole_file)
+{
+  const char data[] = "TES3\0\1\2\3";
+  write(data, sizeof(data));
+
+  MappedFile file;
+  file.open(mFileName.c_str());
+
+  ASSERT_TRUE(file.isOpen());
+  ASSERT_EQ(sizeof(data), file.size());
+  ASSERT_EQ(0, std::memcmp(data, file.data(), sizeof(data)));
+
+  file.close();
+  ASSERT_FALSE(file.isOpen());
+  ASSERT_EQ(0u, file.size());
+}
+
+TEST_F(MappedFileTest, empty_file)
+{
+  write("", 0);
+
+  MappedFile file;
+  file.open(mFileName.c_str());
+
+  ASSERT_TRUE(file.isOpen());
+  ASSERT_EQ(0u, file.size());
+}
+
+TEST_F(MappedFileTest, missing_file_throws)
+{
+  MappedFile file;
+  ASSERT_THROW(file.open("./does_not_exist.bin"), std::runtime_error);
+  ASSERT_FALSE(file.isOpen());
+}
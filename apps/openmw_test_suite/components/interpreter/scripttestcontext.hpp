@@ -0,0 +1,265 @@
+#ifndef OPENMW_TEST_SUITE_SCRIPTTESTCONTEXT_H
+#define OPENMW_TEST_SUITE_SCRIPTTESTCONTEXT_H
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "components/compiler/context.hpp"
+#include "components/compiler/extensions.hpp"
+#include "components/compiler/extensions0.hpp"
+#include "components/compiler/fileparser.hpp"
+#include "components/compiler/scanner.hpp"
+#include "components/compiler/streamerrorhandler.hpp"
+#include "components/compiler/exception.hpp"
+
+#include "components/interpreter/context.hpp"
+#include "components/interpreter/interpreter.hpp"
+#include "components/interpreter/installopcodes.hpp"
+
+namespace ScriptTest
+{
+  /// Compiler context without any IDs and with the global variables in mGlobals
+  class CompilerContext : public Compiler::Context
+  {
+    public:
+
+      std::map<std::string, char> mGlobals; // type by name
+
+      virtual bool canDeclareLocals() const { return true; }
+
+      virtual char getGlobalType(const std::string& name) const
+      {
+        std::map<std::string, char>::const_iterator iter = mGlobals.find(name);
+        return iter != mGlobals.end() ? iter->second : ' ';
+      }
+
+      virtual char getMemberType(const std::string& name, const std::string& id) const { return ' '; }
+
+      virtual bool isId(const std::string& name) const { return false; }
+  };
+
+  /// Interpreter context that only has local variables and a fixed frame duration
+  class InterpreterContext : public Interpreter::Context
+  {
+    public:
+
+      std::vector<int> mShorts;
+      std::vector<int> mLongs;
+      std::vector<float> mFloats;
+      std::vector<std::string> mMessages;
+
+      explicit InterpreterContext(const Compiler::Locals& locals)
+        : mShorts(locals.get('s').size())
+        , mLongs(locals.get('l').size())
+        , mFloats(locals.get('f').size())
+      {}
+
+      virtual int getLocalShort(int index) const { return mShorts.at(index); }
+      virtual int getLocalLong(int index) const { return mLongs.at(index); }
+      virtual float getLocalFloat(int index) const { return mFloats.at(index); }
+      virtual void setLocalShort(int index, int value) { mShorts.at(index) = value; }
+      virtual void setLocalLong(int index, int value) { mLongs.at(index) = value; }
+      virtual void setLocalFloat(int index, float value) { mFloats.at(index) = value; }
+
+      virtual void messageBox(const std::string& message, const std::vector<std::string>& buttons)
+      { mMessages.push_back(message); }
+
+      virtual void report(const std::string& message) { mMessages.push_back(message); }
+
+      virtual bool menuMode() { return false; }
+
+      virtual int getGlobalShort(const std::string& name) const { return 0; }
+      virtual int getGlobalLong(const std::string& name) const { return 0; }
+      virtual float getGlobalFloat(const std::string& name) const { return 0; }
+      virtual void setGlobalShort(const std::string& name, int value) {}
+      virtual void setGlobalLong(const std::string& name, int value) {}
+      virtual void setGlobalFloat(const std::string& name, float value) {}
+      virtual std::vector<std::string> getGlobals() const { return std::vector<std::string>(); }
+      virtual char getGlobalType(const std::string& name) const { return ' '; }
+
+      virtual std::string getActionBinding(const std::string& action) const { return ""; }
+      virtual std::string getNPCName() const { return ""; }
+      virtual std::string getNPCRace() const { return ""; }
+      virtual std::string getNPCClass() const { return ""; }
+      virtual std::string getNPCFaction() const { return ""; }
+      virtual std::string getNPCRank() const { return ""; }
+      virtual std::string getPCName() const { return ""; }
+      virtual std::string getPCRace() const { return ""; }
+      virtual std::string getPCClass() const { return ""; }
+      virtual std::string getPCRank() const { return ""; }
+      virtual std::string getPCNextRank() const { return ""; }
+      virtual int getPCBounty() const { return 0; }
+      virtual std::string getCurrentCellName() const { return ""; }
+
+      virtual bool isScriptRunning(const std::string& name) const { return false; }
+      virtual void startScript(const std::string& name) {}
+      virtual void stopScript(const std::string& name) {}
+
+      virtual float getDistance(const std::string& name, const std::string& id = "") const { return 0; }
+      virtual float getSecondsPassed() const { return 1.0f / 60; }
+
+      virtual bool isDisabled(const std::string& id = "") const { return false; }
+      virtual void enable(const std::string& id = "") {}
+      virtual void disable(const std::string& id = "") {}
+
+      virtual int getMemberShort(const std::string& id, const std::string& name) const { return 0; }
+      virtual int getMemberLong(const std::string& id, const std::string& name) const { return 0; }
+      virtual float getMemberFloat(const std::string& id, const std::string& name) const { return 0; }
+      virtual void setMemberShort(const std::string& id, const std::string& name, int value) {}
+      virtual void setMemberLong(const std::string& id, const std::string& name, int value) {}
+      virtual void setMemberFloat(const std::string& id, const std::string& name, float value) {}
+  };
+
+  /// Compile \a source with the extensions of the game. Throws if the script has errors.
+  inline void compile(const std::string& source, std::vector<Interpreter::Type_Code>& code,
+    Compiler::Locals& locals, CompilerContext& context)
+  {
+    Compiler::Extensions extensions;
+    Compiler::registerExtensions(extensions);
+
+    context.setExtensions(&extensions);
+
+    std::ostringstream errors;
+    Compiler::StreamErrorHandler errorHandler(errors);
+    Compiler::FileParser parser(errorHandler, context);
+
+    std::istringstream input(source);
+    Compiler::Scanner scanner(errorHandler, input, &extensions);
+
+    try
+    {
+      scanner.scan(parser);
+    }
+    catch (const Compiler::SourceException&)
+    {
+    }
+
+    if (!errorHandler.isGood())
+      throw std::runtime_error("script failed to compile:\n" + errors.str());
+
+    parser.getCode(code);
+    locals = parser.getLocals();
+    context.setExtensions();
+  }
+
+  inline void compile(const std::string& source, std::vector<Interpreter::Type_Code>& code,
+    Compiler::Locals& locals)
+  {
+    CompilerContext context;
+    compile(source, code, locals, context);
+  }
+
+  /// Read the scripts of the content files dumped into the directory in OPENMW_SCRIPT_CORPUS
+  /// (one script per file).
+  /// \return Is the variable set?
+  inline bool getCorpusScripts(std::vector<std::string>& scripts)
+  {
+    const char *directory = std::getenv("OPENMW_SCRIPT_CORPUS");
+
+    if (!directory)
+      return false;
+
+    for (boost::filesystem::directory_iterator iter(directory);
+      iter != boost::filesystem::directory_iterator(); ++iter)
+    {
+      std::ifstream file(iter->path().string().c_str(), std::ios::binary);
+      std::ostringstream text;
+      text << file.rdbuf();
+      scripts.push_back(text.str());
+    }
+
+    return true;
+  }
+
+  /// Scripts in the style of the local scripts of the original game, using only the
+  /// instructions that are implemented by the interpreter itself.
+  inline std::vector<std::string> getSampleScripts()
+  {
+    std::vector<std::string> scripts;
+
+    // a door that closes itself after some time
+    scripts.push_back(
+      "Begin DoorTimerScript\n"
+      "short doOnce\n"
+      "short state\n"
+      "float timer\n"
+      "\n"
+      "if ( MenuMode == 1 )\n"
+      "    return\n"
+      "endif\n"
+      "\n"
+      "if ( doOnce == 0 )\n"
+      "    set doOnce to 1\n"
+      "    set state to 0\n"
+      "endif\n"
+      "\n"
+      "set timer to ( timer + GetSecondsPassed )\n"
+      "\n"
+      "if ( state == 0 )\n"
+      "    if ( timer > 10 )\n"
+      "        set state to 1\n"
+      "        set timer to 0\n"
+      "    endif\n"
+      "elseif ( state == 1 )\n"
+      "    if ( timer >= 2.5 )\n"
+      "        set state to 0\n"
+      "        set timer to 0\n"
+      "    endif\n"
+      "endif\n"
+      "\n"
+      "End\n");
+
+    // a flickering light
+    scripts.push_back(
+      "Begin LightFlickerScript\n"
+      "float flickerTimer\n"
+      "float intensity\n"
+      "long flickers\n"
+      "\n"
+      "set flickerTimer to flickerTimer - GetSecondsPassed\n"
+      "\n"
+      "if ( flickerTimer <= 0 )\n"
+      "    set flickerTimer to ( ( Random 100 ) / 200.0 ) + 0.1\n"
+      "    set intensity to 0.5 + ( ( Random 50 ) / 100.0 )\n"
+      "    set flickers to flickers + 1\n"
+      "endif\n"
+      "\n"
+      "if ( intensity > 1 )\n"
+      "    set intensity to 1\n"
+      "elseif ( intensity < 0.5 )\n"
+      "    set intensity to 0.5\n"
+      "endif\n"
+      "\n"
+      "End\n");
+
+    // a quest counter that does some arithmetic every frame
+    scripts.push_back(
+      "Begin CounterScript\n"
+      "short counter\n"
+      "long total\n"
+      "float average\n"
+      "\n"
+      "set counter to counter + 1\n"
+      "set total to total + ( counter * 3 )\n"
+      "set total to total - 1\n"
+      "set average to total / counter\n"
+      "\n"
+      "if ( counter >= 1000 )\n"
+      "    set counter to 0\n"
+      "    set total to 0\n"
+      "endif\n"
+      "\n"
+      "End\n");
+
+    return scripts;
+  }
+}
+
+#endif
@@ -0,0 +1,477 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "components/interpreter/opcodes.hpp"
+#include "components/interpreter/profiler.hpp"
+
+#include "scripttestcontext.hpp"
+
+struct InterpreterTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      Interpreter::installOpcodes(mInterpreter);
+    }
+
+    virtual void TearDown()
+    {
+    }
+
+    Interpreter::Interpreter mInterpreter;
+};
+
+namespace
+{
+  const Interpreter::Type_Code sSegment5 = 0xc8000000;
+}
+
+TEST_F(InterpreterTest, decoded_program_matches_code)
+{
+  std::vector<std::string> scripts = ScriptTest::getSampleScripts();
+
+  for (std::size_t i = 0; i < scripts.size(); ++i)
+  {
+    std::vector<Interpreter::Type_Code> code;
+    Compiler::Locals locals;
+    ScriptTest::compile(scripts[i], code, locals);
+
+    Interpreter::Program program;
+    mInterpreter.decode(&code[0], code.size(), program);
+    ASSERT_FALSE(program.empty());
+
+    ScriptTest::InterpreterContext direct(locals);
+    ScriptTest::InterpreterContext decoded(locals);
+
+    // Random has to return the same sequence for both
+    std::srand(1);
+    for (int n = 0; n < 1000; ++n)
+      mInterpreter.run(&code[0], code.size(), direct);
+
+    std::srand(1);
+    for (int n = 0; n < 1000; ++n)
+      mInterpreter.run(program, decoded);
+
+    ASSERT_EQ(direct.mShorts, decoded.mShorts);
+    ASSERT_EQ(direct.mLongs, decoded.mLongs);
+    ASSERT_EQ(direct.mFloats, decoded.mFloats);
+  }
+}
+
+TEST_F(InterpreterTest, unknown_opcode_fails_when_executed)
+{
+  // return, then an opcode that is not installed
+  Interpreter::Type_Code skipped[] = { 2, 0, 0, 0, sSegment5 | 20, sSegment5 | 0x2000000 };
+  Interpreter::Type_Code executed[] = { 1, 0, 0, 0, sSegment5 | 0x2000000 };
+
+  ScriptTest::InterpreterContext context((Compiler::Locals()));
+
+  Interpreter::Program program;
+  mInterpreter.decode(skipped, 6, program);
+  ASSERT_NO_THROW(mInterpreter.run(program, context));
+
+  mInterpreter.decode(executed, 5, program);
+  ASSERT_THROW(mInterpreter.run(program, context), std::runtime_error);
+}
+
+TEST_F(InterpreterTest, only_scripts_without_side_effects_are_deferrable)
+{
+  std::vector<std::string> scripts = ScriptTest::getSampleScripts();
+
+  for (std::size_t i = 0; i < scripts.size(); ++i)
+  {
+    std::vector<Interpreter::Type_Code> code;
+    Compiler::Locals locals;
+    ScriptTest::compile(scripts[i], code, locals);
+
+    Interpreter::Program program;
+    mInterpreter.decode(&code[0], code.size(), program);
+    ASSERT_TRUE(program.isDeferrable());
+  }
+
+  std::vector<Interpreter::Type_Code> code;
+  Compiler::Locals locals;
+  ScriptTest::compile(
+    "Begin MessageScript\n"
+    "float timer\n"
+    "set timer to timer + GetSecondsPassed\n"
+    "if ( timer > 5 )\n"
+    "    MessageBox \"Time is up\"\n"
+    "endif\n"
+    "End\n", code, locals);
+
+  Interpreter::Program program;
+  mInterpreter.decode(&code[0], code.size(), program);
+  ASSERT_FALSE(program.isDeferrable());
+}
+
+namespace
+{
+  /// Keeps global variables in slots and counts how often they are accessed by name
+  class GlobalsContext : public ScriptTest::InterpreterContext
+  {
+    public:
+
+      std::vector<std::string> mNames;
+      std::vector<float> mValues;
+      mutable int mResolved;
+      mutable int mByName;
+
+      GlobalsContext()
+        : ScriptTest::InterpreterContext(Compiler::Locals())
+        , mResolved(0)
+        , mByName(0)
+      {
+        mNames.push_back("counter");
+        mValues.push_back(0);
+        mNames.push_back("unbound");
+        mValues.push_back(0);
+      }
+
+      int find(const std::string& name) const
+      {
+        return std::find(mNames.begin(), mNames.end(), name) - mNames.begin();
+      }
+
+      virtual int getGlobalSlot(const std::string& name) const
+      {
+        ++mResolved;
+        return name == "unbound" ? -1 : find(name);
+      }
+
+      virtual int getGlobalShort(const std::string& name) const
+      {
+        ++mByName;
+        return mValues.at(find(name));
+      }
+
+      virtual void setGlobalShort(const std::string& name, int value)
+      {
+        ++mByName;
+        mValues.at(find(name)) = value;
+      }
+
+      virtual int getGlobalShort(int slot) const { return mValues.at(slot); }
+      virtual void setGlobalShort(int slot, int value) { mValues.at(slot) = value; }
+  };
+}
+
+TEST_F(InterpreterTest, globals_are_bound_to_slots_once)
+{
+  ScriptTest::CompilerContext compilerContext;
+  compilerContext.mGlobals["counter"] = 's';
+  compilerContext.mGlobals["unbound"] = 's';
+
+  std::vector<Interpreter::Type_Code> code;
+  Compiler::Locals locals;
+  ScriptTest::compile(
+    "Begin GlobalScript\n"
+    "set counter to counter + 1\n"
+    "set unbound to unbound + 2\n"
+    "End\n", code, locals, compilerContext);
+
+  Interpreter::Program program;
+  mInterpreter.decode(&code[0], code.size(), program);
+
+  GlobalsContext context;
+  mInterpreter.run(program, context);
+  int resolved = context.mResolved;
+  ASSERT_GT(resolved, 0);
+
+  for (int n = 1; n < 10; ++n)
+    mInterpreter.run(program, context);
+
+  ASSERT_EQ(10, context.mValues[0]);
+  ASSERT_EQ(20, context.mValues[1]);
+
+  // names are only resolved on the first run and only the unbound variable is accessed by name
+  ASSERT_EQ(resolved, context.mResolved);
+  ASSERT_EQ(20, context.mByName);
+}
+
+TEST_F(InterpreterTest, profiler_counts_runs_and_instructions)
+{
+  std::vector<Interpreter::Type_Code> code;
+  Compiler::Locals locals;
+  ScriptTest::compile(ScriptTest::getSampleScripts()[0], code, locals);
+
+  Interpreter::Program program;
+  mInterpreter.decode(&code[0], code.size(), program);
+
+  ScriptTest::InterpreterContext context(locals);
+  Interpreter::Profiler profiler;
+  mInterpreter.setProfiler(&profiler);
+
+  for (int n = 0; n < 10; ++n)
+  {
+    profiler.setScript("doortimerscript", n % 2 ? "door_a" : "door_b");
+    mInterpreter.run(program, context);
+  }
+
+  mInterpreter.setProfiler(0);
+  mInterpreter.run(program, context);
+
+  const Interpreter::Profiler::Stats& script = profiler.getScripts().find("doortimerscript")->second;
+  ASSERT_EQ(10u, script.mCount);
+  ASSERT_EQ(2u, profiler.getReferences().size());
+  ASSERT_EQ(5u, profiler.getReferences().find(std::make_pair(std::string("doortimerscript"),
+    std::string("door_a")))->second.mCount);
+
+  unsigned long executed = 0;
+  for (Interpreter::Profiler::OpcodeCollection::const_iterator iter = profiler.getOpcodes().begin();
+    iter != profiler.getOpcodes().end(); ++iter)
+    executed += iter->second.mCount;
+
+  ASSERT_GT(script.mInstructions, 0u);
+  ASSERT_EQ(script.mInstructions, executed);
+}
+
+namespace
+{
+  /// Same as ToggleScriptProfiler
+  class OpToggleProfiler : public Interpreter::Opcode0
+  {
+      Interpreter::Interpreter& mInterpreter;
+      Interpreter::Profiler& mProfiler;
+
+    public:
+      OpToggleProfiler(Interpreter::Interpreter& interpreter, Interpreter::Profiler& profiler)
+        : mInterpreter(interpreter), mProfiler(profiler)
+      {
+      }
+
+      virtual void execute(Interpreter::Runtime& runtime)
+      {
+        mInterpreter.setProfiler(mInterpreter.getProfiler() ? 0 : &mProfiler);
+      }
+  };
+}
+
+TEST_F(InterpreterTest, profiler_can_be_turned_off_while_running)
+{
+  Interpreter::Profiler profiler;
+  mInterpreter.installSegment5(0x2000000, new OpToggleProfiler(mInterpreter, profiler));
+
+  // toggle the profiler, then return
+  Interpreter::Type_Code code[] = { 2, 0, 0, 0, sSegment5 | 0x2000000, sSegment5 | 20 };
+
+  Interpreter::Program program;
+  mInterpreter.decode(code, 6, program);
+
+  ScriptTest::InterpreterContext context((Compiler::Locals()));
+  profiler.setScript("togglescript", "");
+  mInterpreter.setProfiler(&profiler);
+  mInterpreter.run(program, context);
+
+  ASSERT_TRUE(mInterpreter.getProfiler() == 0);
+  ASSERT_EQ(1u, profiler.getScripts().find("togglescript")->second.mCount);
+  ASSERT_EQ(2u, profiler.getScripts().find("togglescript")->second.mInstructions);
+}
+
+namespace
+{
+  /// Stands in for every opcode in the throughput benchmark, so that it measures the dispatch
+  class NullOpcode : public Interpreter::Opcode0, public Interpreter::Opcode1,
+    public Interpreter::Opcode2
+  {
+    public:
+
+      virtual void execute(Interpreter::Runtime& runtime) {}
+      virtual void execute(Interpreter::Runtime& runtime, unsigned int arg0) {}
+      virtual void execute(Interpreter::Runtime& runtime, unsigned int arg0, unsigned int arg1) {}
+  };
+
+  /// The dispatch of the interpreter before scripts were decoded: one std::map per segment,
+  /// searched for every instruction on every run
+  class MapInterpreter
+  {
+      Interpreter::Runtime mRuntime;
+      std::map<int, Interpreter::Opcode1 *> mSegment0;
+      std::map<int, Interpreter::Opcode2 *> mSegment1;
+      std::map<int, Interpreter::Opcode1 *> mSegment2;
+      std::map<int, Interpreter::Opcode1 *> mSegment3;
+      std::map<int, Interpreter::Opcode2 *> mSegment4;
+      std::map<int, Interpreter::Opcode0 *> mSegment5;
+
+      template<typename T>
+      static T *find(const std::map<int, T *>& segment, int opcode)
+      {
+        typename std::map<int, T *>::const_iterator iter = segment.find(opcode);
+
+        if (iter == segment.end())
+          throw std::runtime_error("unknown opcode");
+
+        return iter->second;
+      }
+
+      void execute(Interpreter::Type_Code code)
+      {
+        switch (code >> 30)
+        {
+          case 0: find(mSegment0, code >> 24)->execute(mRuntime, code & 0xffffff); return;
+          case 1: find(mSegment1, (code >> 24) & 0x3f)->execute(mRuntime, (code >> 16) & 0xfff,
+            code & 0xfff); return;
+          case 2: find(mSegment2, (code >> 20) & 0x3ff)->execute(mRuntime, code & 0xfffff); return;
+        }
+
+        switch (code >> 26)
+        {
+          case 0x30: find(mSegment3, (code >> 8) & 0x3ffff)->execute(mRuntime, code & 0xff); return;
+          case 0x31: find(mSegment4, (code >> 16) & 0x3ff)->execute(mRuntime, (code >> 8) & 0xff,
+            code & 0xff); return;
+          case 0x32: find(mSegment5, code & 0x3ffffff)->execute(mRuntime); return;
+        }
+
+        throw std::runtime_error("opcode outside of the allocated segment range");
+      }
+
+    public:
+
+      /// \a opcode is not owned
+      void install(const Interpreter::Profiler::Opcode& code, NullOpcode *opcode)
+      {
+        switch (code.first)
+        {
+          case 0: mSegment0.insert(std::make_pair(code.second, opcode)); break;
+          case 1: mSegment1.insert(std::make_pair(code.second, opcode)); break;
+          case 2: mSegment2.insert(std::make_pair(code.second, opcode)); break;
+          case 3: mSegment3.insert(std::make_pair(code.second, opcode)); break;
+          case 4: mSegment4.insert(std::make_pair(code.second, opcode)); break;
+          case 5: mSegment5.insert(std::make_pair(code.second, opcode)); break;
+        }
+      }
+
+      void run(const Interpreter::Type_Code *code, int codeSize, Interpreter::Context& context)
+      {
+        mRuntime.configure(code, codeSize, context);
+
+        int opcodes = static_cast<int>(code[0]);
+        const Interpreter::Type_Code *codeBlock = code + 4;
+
+        while (mRuntime.getPC() >= 0 && mRuntime.getPC() < opcodes)
+        {
+          Interpreter::Type_Code instruction = codeBlock[mRuntime.getPC()];
+          mRuntime.setPC(mRuntime.getPC() + 1);
+          execute(instruction);
+        }
+
+        mRuntime.clear();
+      }
+  };
+
+  /// Accepts every name as an ID, so that more scripts of a content file compile
+  class CorpusCompilerContext : public ScriptTest::CompilerContext
+  {
+    public:
+
+      virtual bool isId(const std::string& name) const { return true; }
+  };
+}
+
+// Runs the scripts in OPENMW_SCRIPT_CORPUS (see ScriptTest::getCorpusScripts) or, if it is not
+// set, the sample scripts through the std::map dispatch the interpreter used before and through
+// the current one, decoding the scripts on every run and decoded once. All opcodes are replaced by
+// NullOpcode, so that every run executes each instruction once and only the dispatch is timed.
+// Run with --gtest_also_run_disabled_tests.
+TEST_F(InterpreterTest, DISABLED_script_throughput_benchmark)
+{
+  const int runs = 2000;
+
+  std::vector<std::string> scripts;
+
+  if (!ScriptTest::getCorpusScripts(scripts))
+  {
+    std::cout << "OPENMW_SCRIPT_CORPUS is not set, using the sample scripts" << std::endl;
+    scripts = ScriptTest::getSampleScripts();
+  }
+
+  std::vector<std::vector<Interpreter::Type_Code> > codes;
+  std::vector<Compiler::Locals> locals;
+  std::size_t failed = 0;
+
+  for (std::size_t i = 0; i < scripts.size(); ++i)
+  {
+    codes.push_back(std::vector<Interpreter::Type_Code>());
+    locals.push_back(Compiler::Locals());
+
+    try
+    {
+      CorpusCompilerContext context;
+      ScriptTest::compile(scripts[i], codes.back(), locals.back(), context);
+    }
+    catch (const std::runtime_error&)
+    {
+      codes.pop_back();
+      locals.pop_back();
+      ++failed;
+    }
+  }
+
+  Interpreter::Interpreter interpreter;
+  MapInterpreter mapInterpreter;
+  NullOpcode nullOpcode;
+  unsigned long instructions = 0;
+
+  for (std::size_t i = 0; i < codes.size(); ++i)
+  {
+    for (std::size_t n = 4; n < 4 + codes[i][0]; ++n)
+    {
+      Interpreter::Profiler::Opcode opcode = Interpreter::Profiler::getOpcode(codes[i][n]);
+
+      switch (opcode.first)
+      {
+        case 0: interpreter.installSegment0(opcode.second, new NullOpcode); break;
+        case 1: interpreter.installSegment1(opcode.second, new NullOpcode); break;
+        case 2: interpreter.installSegment2(opcode.second, new NullOpcode); break;
+        case 3: interpreter.installSegment3(opcode.second, new NullOpcode); break;
+        case 4: interpreter.installSegment4(opcode.second, new NullOpcode); break;
+        case 5: interpreter.installSegment5(opcode.second, new NullOpcode); break;
+      }
+
+      mapInterpreter.install(opcode, &nullOpcode);
+    }
+
+    instructions += codes[i][0];
+  }
+
+  std::vector<Interpreter::Program> programs(codes.size());
+  for (std::size_t i = 0; i < codes.size(); ++i)
+    interpreter.decode(&codes[i][0], codes[i].size(), programs[i]);
+
+  double map = 0;
+  double direct = 0;
+  double decoded = 0;
+
+  for (std::size_t i = 0; i < codes.size(); ++i)
+  {
+    ScriptTest::InterpreterContext context(locals[i]);
+
+    std::clock_t start = std::clock();
+    for (int n = 0; n < runs; ++n)
+      mapInterpreter.run(&codes[i][0], codes[i].size(), context);
+    map += double(std::clock() - start) / CLOCKS_PER_SEC;
+
+    start = std::clock();
+    for (int n = 0; n < runs; ++n)
+      interpreter.run(&codes[i][0], codes[i].size(), context);
+    direct += double(std::clock() - start) / CLOCKS_PER_SEC;
+
+    start = std::clock();
+    for (int n = 0; n < runs; ++n)
+      interpreter.run(programs[i], context);
+    decoded += double(std::clock() - start) / CLOCKS_PER_SEC;
+  }
+
+  double total = double(instructions) * runs;
+
+  std::cout << codes.size() << " scripts (" << failed << " failed to compile), "
+    << instructions << " instructions, " << runs << " runs each" << std::endl
+    << "  std::map dispatch: " << total / map << " instructions/s" << std::endl
+    << "  decoding every run: " << total / direct << " instructions/s" << std::endl
+    << "  decoded once: " << total / decoded << " instructions/s" << std::endl;
+}
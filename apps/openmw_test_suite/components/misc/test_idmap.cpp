@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "components/misc/idmap.hpp"
+
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <ctime>
+
+struct IdMapTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+TEST_F(IdMapTest, search_ignores_case)
+{
+  Misc::IdMap<int> map;
+  map.insert("Fargoth", 1);
+
+  ASSERT_TRUE(map.search("fargoth") != 0);
+  ASSERT_TRUE(map.search("FARGOTH") != 0);
+  ASSERT_EQ(1, *map.search("fArGoTh"));
+  ASSERT_TRUE(map.search("fargoth_") == 0);
+}
+
+TEST_F(IdMapTest, insert_overwrites_existing)
+{
+  Misc::IdMap<int> map;
+  std::pair<int *, bool> first = map.insert("ID", 1);
+  std::pair<int *, bool> second = map.insert("id", 2);
+
+  ASSERT_TRUE(first.second);
+  ASSERT_FALSE(second.second);
+  ASSERT_EQ(first.first, second.first);
+  ASSERT_EQ(2, *map.search("Id"));
+  ASSERT_EQ(1u, map.size());
+}
+
+TEST_F(IdMapTest, values_do_not_move)
+{
+  Misc::IdMap<int> map;
+  int *ptr = map.insert("first", 1).first;
+
+  for (int i = 0; i < 10000; ++i)
+  {
+    std::ostringstream id;
+    id << "id" << i;
+    map.insert(id.str(), i);
+  }
+
+  ASSERT_EQ(ptr, map.search("FIRST"));
+  ASSERT_EQ(1, *ptr);
+}
+
+TEST_F(IdMapTest, erase_and_reuse)
+{
+  Misc::IdMap<int> map;
+  map.insert("a", 1);
+  map.insert("b", 2);
+
+  ASSERT_TRUE(map.erase("A"));
+  ASSERT_FALSE(map.erase("a"));
+  ASSERT_TRUE(map.search("a") == 0);
+  ASSERT_EQ(1u, map.size());
+
+  map.insert("c", 3);
+  ASSERT_EQ(3, *map.search("c"));
+  ASSERT_EQ(2, *map.search("b"));
+}
+
+TEST_F(IdMapTest, list_is_sorted_by_lower_case_id)
+{
+  Misc::IdMap<int> map;
+  map.insert("Charlie", 3);
+  map.insert("alpha", 1);
+  map.insert("BRAVO", 2);
+
+  std::vector<int *> list;
+  map.list(list);
+
+  ASSERT_EQ(3u, list.size());
+  ASSERT_EQ(1, *list[0]);
+  ASSERT_EQ(2, *list[1]);
+  ASSERT_EQ(3, *list[2]);
+}
+
+// Compares IdMap lookups with the lower case copy + std::map lookup it replaced in MWWorld::Store.
+// Run with --gtest_also_run_disabled_tests.
+TEST_F(IdMapTest, DISABLED_lookup_benchmark)
+{
+  const int records = 20000;
+  const int lookups = 2000000;
+
+  std::vector<std::string> ids;
+  std::map<std::string, int> tree;
+  Misc::IdMap<int> map;
+
+  for (int i = 0; i < records; ++i)
+  {
+    std::ostringstream id;
+    id << "Misc_Com_Bottle_" << i;
+    ids.push_back(id.str());
+    tree[Misc::StringUtils::lowerCase(id.str())] = i;
+    map.insert(id.str(), i);
+  }
+
+  long sum = 0;
+  std::clock_t start = std::clock();
+  for (int i = 0; i < lookups; ++i)
+  {
+    std::map<std::string, int>::const_iterator it =
+        tree.find(Misc::StringUtils::lowerCase(ids[i % records]));
+    sum += it->second;
+  }
+  double treeTime = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  for (int i = 0; i < lookups; ++i)
+    sum -= *map.search(ids[i % records]);
+  double mapTime = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  ASSERT_EQ(0, sum);
+
+  std::cout << "std::map: " << lookups / treeTime << " lookups/s" << std::endl;
+  std::cout << "IdMap:    " << lookups / mapTime << " lookups/s" << std::endl;
+}
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include "components/misc/segmentedvector.hpp"
+
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#include <list>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <ctime>
+
+struct SegmentedVectorTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+TEST_F(SegmentedVectorTest, elements_do_not_move)
+{
+  Misc::SegmentedVector<int, 4> vector;
+  vector.push_back(1);
+  int *first = &vector.front();
+  Misc::SegmentedVector<int, 4>::iterator iter = vector.begin();
+
+  for (int i = 0; i < 1000; ++i)
+    vector.push_back(i);
+
+  ASSERT_EQ(first, &vector[0]);
+  ASSERT_EQ(first, &*iter);
+  ASSERT_EQ(1001u, vector.size());
+  ASSERT_EQ(999, vector.back());
+}
+
+TEST_F(SegmentedVectorTest, iterates_in_order)
+{
+  Misc::SegmentedVector<int, 4> vector;
+  for (int i = 0; i < 10; ++i)
+    vector.push_back(i);
+
+  int expected = 0;
+  for (Misc::SegmentedVector<int, 4>::const_iterator iter = vector.begin(); iter != vector.end(); ++iter)
+    ASSERT_EQ(expected++, *iter);
+
+  ASSERT_EQ(10, expected);
+  ASSERT_EQ(9, *--vector.end());
+}
+
+TEST_F(SegmentedVectorTest, erase_moves_following_elements)
+{
+  Misc::SegmentedVector<std::string, 2> vector;
+  vector.push_back("a");
+  vector.push_back("b");
+  vector.push_back("c");
+
+  Misc::SegmentedVector<std::string, 2>::iterator next = vector.erase(vector.begin());
+
+  ASSERT_EQ("b", *next);
+  ASSERT_EQ(2u, vector.size());
+  ASSERT_EQ("c", vector[1]);
+}
+
+TEST_F(SegmentedVectorTest, copies_are_independent)
+{
+  Misc::SegmentedVector<std::string, 2> vector;
+  vector.push_back("a");
+  vector.push_back("b");
+  vector.push_back("c");
+
+  Misc::SegmentedVector<std::string, 2> copy(vector);
+  copy[0] = "x";
+
+  ASSERT_EQ("a", vector[0]);
+  ASSERT_EQ(3u, copy.size());
+  ASSERT_EQ("c", copy.back());
+
+  copy = Misc::SegmentedVector<std::string, 2>();
+  ASSERT_TRUE(copy.empty());
+}
+
+namespace
+{
+  // Roughly the size of a LiveCellRef
+  struct Ref
+  {
+    int mRefnum;
+    float mPos[6];
+    char mPadding[280];
+  };
+
+  bool operator==(const Ref& ref, int refnum)
+  {
+    return ref.mRefnum == refnum;
+  }
+
+#if defined HAVE_UNORDERED_MAP
+  typedef std::unordered_map<int, std::size_t> RefnumIndex;
+#else
+  typedef std::tr1::unordered_map<int, std::size_t> RefnumIndex;
+#endif
+}
+
+// Loads and iterates dense exterior cells the way MWWorld::CellRefList did with a
+// std::list (linear search by refnum for every reference) and does now with a
+// SegmentedVector and a refnum index. Run with --gtest_also_run_disabled_tests.
+TEST_F(SegmentedVectorTest, DISABLED_cell_benchmark)
+{
+  const int cells = 50;
+  const int refsPerCell = 2000;
+  const int iterations = 200;
+
+  Ref ref = Ref();
+  double sum = 0;
+
+  std::clock_t start = std::clock();
+  std::vector<std::list<Ref> > lists(cells);
+  for (int c = 0; c < cells; ++c)
+    for (int i = 0; i < refsPerCell; ++i)
+    {
+      ref.mRefnum = i;
+      std::list<Ref>::iterator iter = std::find(lists[c].begin(), lists[c].end(), ref.mRefnum);
+      if (iter != lists[c].end())
+        *iter = ref;
+      else
+        lists[c].push_back(ref);
+    }
+  double listLoad = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  std::vector<Misc::SegmentedVector<Ref> > vectors(cells);
+  std::vector<RefnumIndex> indices(cells);
+  for (int c = 0; c < cells; ++c)
+    for (int i = 0; i < refsPerCell; ++i)
+    {
+      ref.mRefnum = i;
+      RefnumIndex::iterator index = indices[c].find(ref.mRefnum);
+      if (index != indices[c].end())
+        vectors[c][index->second] = ref;
+      else
+      {
+        indices[c].insert(std::make_pair(ref.mRefnum, vectors[c].size()));
+        vectors[c].push_back(ref);
+      }
+    }
+  double vectorLoad = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  for (int n = 0; n < iterations; ++n)
+    for (int c = 0; c < cells; ++c)
+      for (std::list<Ref>::const_iterator iter = lists[c].begin(); iter != lists[c].end(); ++iter)
+        sum += iter->mPos[0] + iter->mRefnum;
+  double listIterate = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  for (int n = 0; n < iterations; ++n)
+    for (int c = 0; c < cells; ++c)
+      for (Misc::SegmentedVector<Ref>::const_iterator iter = vectors[c].begin(); iter != vectors[c].end(); ++iter)
+        sum -= iter->mPos[0] + iter->mRefnum;
+  double vectorIterate = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  ASSERT_EQ(0, sum);
+
+  std::cout << "std::list:       load " << listLoad << " s, iterate " << listIterate << " s" << std::endl;
+  std::cout << "SegmentedVector: load " << vectorLoad << " s, iterate " << vectorIterate << " s" << std::endl;
+}
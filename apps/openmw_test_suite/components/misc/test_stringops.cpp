@@ -77,3 +77,17 @@ TEST_F(StringOpsTest, iends_not_matching)
   ASSERT_FALSE(Misc::iends("abc", "abcd"));
 }
 
+
+TEST_F(StringOpsTest, ci_hash_and_equal_fold_alike)
+{
+  // ids in the legacy encoding may contain bytes >= 0x80
+  std::string lower("caf\xe9_ring");
+  std::string upper("CAF\xe9_RING");
+
+  Misc::StringUtils::CiHash hash;
+  Misc::StringUtils::CiEqual equal;
+
+  ASSERT_TRUE(equal(lower, upper));
+  ASSERT_EQ(hash(lower), hash(upper));
+  ASSERT_FALSE(equal(lower, std::string("caf\xe8_ring")));
+}
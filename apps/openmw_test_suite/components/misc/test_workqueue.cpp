@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+#include "components/misc/workqueue.hpp"
+
+struct WorkQueueTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+namespace
+{
+  struct SquareItem : public Misc::WorkItem
+  {
+    int mValue;
+    int mResult;
+
+    SquareItem(int value) : mValue(value), mResult(0) {}
+
+    void doWork()
+    {
+      if (mValue < 0)
+        throw std::runtime_error("negative");
+      mResult = mValue * mValue;
+    }
+  };
+}
+
+TEST_F(WorkQueueTest, processes_all_items)
+{
+  std::vector<SquareItem *> items;
+  {
+    Misc::WorkQueue queue(4);
+    ASSERT_EQ(4u, queue.getThreadCount());
+
+    for (int i = 0; i < 100; ++i)
+    {
+      items.push_back(new SquareItem(i));
+      queue.addWorkItem(items.back());
+    }
+
+    for (int i = 0; i < 100; ++i)
+    {
+      items[i]->waitTillDone();
+      ASSERT_TRUE(items[i]->isDone());
+      ASSERT_EQ("", items[i]->getError());
+      ASSERT_EQ(i*i, items[i]->mResult);
+    }
+  }
+
+  for (size_t i = 0; i < items.size(); ++i)
+    delete items[i];
+}
+
+TEST_F(WorkQueueTest, reports_exceptions)
+{
+  SquareItem item(-1);
+  Misc::WorkQueue queue(1);
+  queue.addWorkItem(&item);
+
+  item.waitTillDone();
+  ASSERT_EQ("negative", item.getError());
+}
+
+TEST_F(WorkQueueTest, zero_threads_means_hardware_concurrency)
+{
+  Misc::WorkQueue queue(0);
+  ASSERT_LT(0u, queue.getThreadCount());
+}
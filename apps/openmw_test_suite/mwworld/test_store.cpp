@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <cstdio>
+
+#include <components/esm/esmreader.hpp>
+#include <components/esm/esmwriter.hpp>
+#include <components/to_utf8/to_utf8.hpp>
+
+#include "apps/openmw/mwworld/store.hpp"
+
+struct StoreTest : public ::testing::Test
+{
+  protected:
+    StoreTest()
+      : mFileName("./store_test_cache.esm")
+      , mEncoder(ToUTF8::WINDOWS_1252)
+    {
+    }
+
+    virtual void TearDown()
+    {
+      std::remove(mFileName.c_str());
+    }
+
+    template <class T>
+    void writeCache(const MWWorld::Store<T>& store, const std::string& name)
+    {
+      std::ofstream stream(mFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+      ESM::ESMWriter writer;
+      writer.setEncoder(&mEncoder);
+      writer.setVersion();
+      writer.setFormat(0);
+      writer.setRecordCount(0);
+      writer.setAuthor("");
+      writer.setDescription("");
+      writer.save(stream);
+      store.writeCache(writer, name);
+      writer.close();
+    }
+
+    /// Same as ESMStore::readCache(), for a single store
+    template <class T>
+    void readCache(MWWorld::Store<T>& store)
+    {
+      ESM::ESMReader reader;
+      reader.setEncoder(&mEncoder);
+      reader.open(mFileName);
+
+      while (reader.hasMoreRecs())
+      {
+        reader.getRecName();
+        reader.getRecHeader();
+        store.readCache(reader, reader.getHNOString("NAME"));
+      }
+      store.setUp();
+    }
+
+    std::string mFileName;
+    ToUTF8::Utf8Encoder mEncoder;
+};
+
+TEST_F(StoreTest, persistent_npc_survives_content_cache)
+{
+  ESM::NPC npc;
+  npc.blank();
+  npc.mId = "persistent_npc";
+  npc.mNpdtType = ESM::NPC::NPC_WITH_AUTOCALCULATED_STATS;
+  npc.mRecordFlags = 0x0400;
+  npc.mPersistent = true;
+
+  MWWorld::Store<ESM::NPC> written;
+  MWWorld::Staged<ESM::NPC> staged;
+  staged.mRecord = npc;
+  written.insertStaged(staged);
+  written.setUp();
+
+  writeCache(written, "NPC_");
+
+  MWWorld::Store<ESM::NPC> read;
+  readCache(read);
+
+  const ESM::NPC* loaded = read.search("persistent_npc");
+  ASSERT_TRUE(loaded != NULL);
+  ASSERT_TRUE(loaded->mPersistent);
+  ASSERT_EQ(0x0400u, loaded->mRecordFlags);
+}
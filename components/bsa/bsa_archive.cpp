@@ -27,92 +27,57 @@
 #include <OgreArchive.h>
 #include <OgreArchiveFactory.h>
 #include <OgreArchiveManager.h>
-#include "bsa_file.hpp"
 
-#include "../files/constrainedfiledatastream.hpp"
+#include <map>
+#include "bsa_file.hpp"
+#include "resourceindex.hpp"
 
 using namespace Ogre;
 
-static bool fsstrict = false;
+/// All data directories and BSA archives, in order of increasing priority
+static Bsa::ResourceIndex sIndex;
 
-static char strict_normalize_char(char ch)
+/// An OGRE Archive serving the files of sIndex
+class IndexArchive : public Archive
 {
-    return ch == '\\' ? '/' : ch;
-}
-
-static char nonstrict_normalize_char(char ch)
-{
-    return ch == '\\' ? '/' : std::tolower(ch);
-}
-
-template<typename T1, typename T2>
-static std::string normalize_path(T1 begin, T2 end)
-{
-    std::string normalized;
-    normalized.reserve(std::distance(begin, end));
-    char (*normalize_char)(char) = fsstrict ? &strict_normalize_char : &nonstrict_normalize_char;
-    std::transform(begin, end, std::back_inserter(normalized), normalize_char);
-    return normalized;
-}
+    static void addFileInfo(FileInfoList& list, Archive *archive, const std::string& name,
+        const Bsa::ResourceIndex::Entry& entry)
+    {
+        std::string::size_type pt = name.rfind('/');
+        if(pt == std::string::npos)
+            pt = 0;
 
-/// An OGRE Archive wrapping a BSAFile archive
-class DirArchive: public Ogre::Archive
-{
-    typedef std::map <std::string, std::string> index;
+        FileInfo fi;
+        fi.archive = archive;
+        fi.path = name.substr(0, pt);
+        fi.filename = name.substr((name[pt]=='/') ? pt+1 : pt);
+        fi.compressedSize = fi.uncompressedSize = entry.mSize;
 
-    index mIndex;
+        list.push_back(fi);
+    }
 
-    index::const_iterator lookup_filename (std::string const & filename) const
+    static bool matches(const std::string& name, const std::string& pattern, bool recursive)
     {
-        std::string normalized = normalize_path (filename.begin (), filename.end ());
-        return mIndex.find (normalized);
+        return Ogre::StringUtil::match(name, pattern) ||
+            (recursive && Ogre::StringUtil::match(name, "*/"+pattern));
     }
 
 public:
 
-    DirArchive(const String& name)
-        : Archive(name, "Dir")
-    {
-        typedef boost::filesystem::recursive_directory_iterator directory_iterator;
-
-        directory_iterator end;
-
-        size_t prefix = name.size ();
+    IndexArchive(const String& name)
+        : Archive(name, "Index")
+    {}
 
-        if (name.size () > 0 && name [prefix - 1] != '\\' && name [prefix - 1] != '/')
-            ++prefix;
-
-        for (directory_iterator i (name); i != end; ++i)
-        {
-            if(boost::filesystem::is_directory (*i))
-                continue;
+    // Strict directories are checked by the index itself
+    bool isCaseSensitive() const { return false; }
 
-            std::string proper = i->path ().string ();
-
-            std::string searchable = normalize_path (proper.begin () + prefix, proper.end ());
-
-            mIndex.insert (std::make_pair (searchable, proper));
-        }
-    }
-
-    bool isCaseSensitive() const { return fsstrict; }
-
-  // The archive is loaded in the constructor, and never unloaded.
+    // The index is built before the archive is created and never unloaded.
     void load() {}
     void unload() {}
 
     DataStreamPtr open(const String& filename, bool readonly = true) const
     {
-        index::const_iterator i = lookup_filename (filename);
-
-        if (i == mIndex.end ())
-        {
-            std::ostringstream os;
-            os << "The file '" << filename << "' could not be found.";
-            throw std::runtime_error (os.str ());
-        }
-
-        return openConstrainedFileDataStream (i->second.c_str ());
+        return sIndex.open(filename);
     }
 
     StringVectorPtr list(bool recursive = true, bool dirs = false)
@@ -128,12 +93,16 @@ public:
     StringVectorPtr find(const String& pattern, bool recursive = true,
                         bool dirs = false)
     {
-        std::string normalizedPattern = normalize_path(pattern.begin(), pattern.end());
+        std::string normalizedPattern = Bsa::ResourceIndex::normalize(pattern);
+        const Bsa::ResourceIndex::Map& entries = sIndex.getEntries();
         StringVectorPtr ptr = StringVectorPtr(new StringVector());
-        for(index::const_iterator iter = mIndex.begin();iter != mIndex.end();++iter)
+
+        if(normalizedPattern == "*")
+            ptr->reserve(entries.size());
+
+        for(Bsa::ResourceIndex::Map::const_iterator iter = entries.begin();iter != entries.end();++iter)
         {
-            if(Ogre::StringUtil::match(iter->first, normalizedPattern) ||
-               (recursive && Ogre::StringUtil::match(iter->first, "*/"+normalizedPattern)))
+            if(normalizedPattern == "*" || matches(iter->first, normalizedPattern, recursive))
                 ptr->push_back(iter->first);
         }
         return ptr;
@@ -141,7 +110,7 @@ public:
 
     bool exists(const String& filename)
     {
-        return lookup_filename(filename) != mIndex.end ();
+        return sIndex.lookup(filename) != 0;
     }
 
     time_t getModifiedTime(const String&) { return 0; }
@@ -149,140 +118,22 @@ public:
     FileInfoListPtr findFileInfo(const String& pattern, bool recursive = true,
                             bool dirs = false) const
     {
-        std::string normalizedPattern = normalize_path(pattern.begin(), pattern.end());
+        std::string normalizedPattern = Bsa::ResourceIndex::normalize(pattern);
         FileInfoListPtr ptr = FileInfoListPtr(new FileInfoList());
+        Archive *archive = const_cast<IndexArchive*>(this);
 
-        index::const_iterator i = mIndex.find(normalizedPattern);
-        if(i != mIndex.end())
+        if(const Bsa::ResourceIndex::Entry *entry = sIndex.lookup(pattern))
         {
-            std::string::size_type pt = i->first.rfind('/');
-            if(pt == std::string::npos)
-                pt = 0;
-
-            FileInfo fi;
-            fi.archive = const_cast<DirArchive*>(this);
-            fi.path = i->first.substr(0, pt);
-            fi.filename = i->first.substr((i->first[pt]=='/') ? pt+1 : pt);
-            fi.compressedSize = fi.uncompressedSize = 0;
-
-            ptr->push_back(fi);
+            addFileInfo(*ptr, archive, normalizedPattern, *entry);
         }
         else
         {
-            for(index::const_iterator iter = mIndex.begin();iter != mIndex.end();++iter)
-            {
-                if(Ogre::StringUtil::match(iter->first, normalizedPattern) ||
-                   (recursive && Ogre::StringUtil::match(iter->first, "*/"+normalizedPattern)))
-                {
-                    std::string::size_type pt = iter->first.rfind('/');
-                    if(pt == std::string::npos)
-                        pt = 0;
-
-                    FileInfo fi;
-                    fi.archive = const_cast<DirArchive*>(this);
-                    fi.path = iter->first.substr(0, pt);
-                    fi.filename = iter->first.substr((iter->first[pt]=='/') ? pt+1 : pt);
-                    fi.compressedSize = fi.uncompressedSize = 0;
-
-                    ptr->push_back(fi);
-                }
-            }
-        }
-
-        return ptr;
-    }
-};
-
-class BSAArchive : public Archive
-{
-  Bsa::BSAFile arc;
-
-  static const char *extractFilename(const Bsa::BSAFile::FileStruct &entry)
-  {
-      return entry.name;
-  }
-
-public:
-  BSAArchive(const String& name)
-             : Archive(name, "BSA")
-  { arc.open(name); }
-
-  bool isCaseSensitive() const { return false; }
-
-  // The archive is loaded in the constructor, and never unloaded.
-  void load() {}
-  void unload() {}
-
-  DataStreamPtr open(const String& filename, bool readonly = true) const
-  {
-    // Get a non-const reference to arc. This is a hack and it's all
-    // OGRE's fault. You should NOT expect an open() command not to
-    // have any side effects on the archive, and hence this function
-    // should not have been declared const in the first place.
-    Bsa::BSAFile *narc = const_cast<Bsa::BSAFile*>(&arc);
-
-    // Open the file
-    return narc->getFile(filename.c_str());
-  }
-
-  bool exists(const String& filename) {
-    return arc.exists(filename.c_str());
-  }
+            const Bsa::ResourceIndex::Map& entries = sIndex.getEntries();
 
-  time_t getModifiedTime(const String&) { return 0; }
-
-  // This is never called as far as I can see.
-  StringVectorPtr list(bool recursive = true, bool dirs = false)
-  {
-    return find ("*", recursive, dirs);
-  }
-
-  // Also never called.
-  FileInfoListPtr listFileInfo(bool recursive = true, bool dirs = false)
-  {
-    return findFileInfo ("*", recursive, dirs);
-  }
-
-    StringVectorPtr find(const String& pattern, bool recursive = true,
-                         bool dirs = false)
-    {
-        std::string normalizedPattern = normalize_path(pattern.begin(), pattern.end());
-        const Bsa::BSAFile::FileList &filelist = arc.getList();
-        StringVectorPtr ptr = StringVectorPtr(new StringVector());
-        for(Bsa::BSAFile::FileList::const_iterator iter = filelist.begin();iter != filelist.end();++iter)
-        {
-            std::string ent = normalize_path(iter->name, iter->name+std::strlen(iter->name));
-            if(Ogre::StringUtil::match(ent, normalizedPattern) ||
-               (recursive && Ogre::StringUtil::match(ent, "*/"+normalizedPattern)))
-                ptr->push_back(iter->name);
-        }
-        return ptr;
-    }
-
-    FileInfoListPtr findFileInfo(const String& pattern, bool recursive = true,
-                                bool dirs = false) const
-    {
-        std::string normalizedPattern = normalize_path(pattern.begin(), pattern.end());
-        FileInfoListPtr ptr = FileInfoListPtr(new FileInfoList());
-        const Bsa::BSAFile::FileList &filelist = arc.getList();
-
-        for(Bsa::BSAFile::FileList::const_iterator iter = filelist.begin();iter != filelist.end();++iter)
-        {
-            std::string ent = normalize_path(iter->name, iter->name+std::strlen(iter->name));
-            if(Ogre::StringUtil::match(ent, normalizedPattern) ||
-                (recursive && Ogre::StringUtil::match(ent, "*/"+normalizedPattern)))
+            for(Bsa::ResourceIndex::Map::const_iterator iter = entries.begin();iter != entries.end();++iter)
             {
-                std::string::size_type pt = ent.rfind('/');
-                if(pt == std::string::npos)
-                    pt = 0;
-
-                FileInfo fi;
-                fi.archive = const_cast<BSAArchive*>(this);
-                fi.path = std::string(iter->name, pt);
-                fi.filename = std::string(iter->name + ((ent[pt]=='/') ? pt+1 : pt));
-                fi.compressedSize = fi.uncompressedSize = iter->fileSize;
-
-                ptr->push_back(fi);
+                if(matches(iter->first, normalizedPattern, recursive))
+                    addFileInfo(*ptr, archive, iter->first, iter->second);
             }
         }
 
@@ -290,46 +141,23 @@ public:
     }
 };
 
-// An archive factory for BSA archives
-class BSAArchiveFactory : public ArchiveFactory
-{
-public:
-  const String& getType() const
-  {
-    static String name = "BSA";
-    return name;
-  }
-
-  Archive *createInstance( const String& name )
-  {
-    return new BSAArchive(name);
-  }
-
-  virtual Archive* createInstance(const String& name, bool readOnly)
-  {
-    return new BSAArchive(name);
-  }
-
-  void destroyInstance( Archive* arch) { delete arch; }
-};
-
-class DirArchiveFactory : public ArchiveFactory
+class IndexArchiveFactory : public ArchiveFactory
 {
 public:
     const String& getType() const
     {
-      static String name = "Dir";
+      static String name = "Index";
       return name;
     }
 
     Archive *createInstance( const String& name )
     {
-      return new DirArchive(name);
+      return new IndexArchive(name);
     }
 
     virtual Archive* createInstance(const String& name, bool readOnly)
     {
-      return new DirArchive(name);
+      return new IndexArchive(name);
     }
 
     void destroyInstance( Archive* arch) { delete arch; }
@@ -337,46 +165,65 @@ public:
 
 
 static bool init = false;
-static bool init2 = false;
 
-static void insertBSAFactory()
+/// Resource group the index is registered with, if any
+static std::string sGroup;
+
+static void insertIndexFactory()
 {
   if(!init)
     {
-      ArchiveManager::getSingleton().addArchiveFactory( new BSAArchiveFactory );
+      ArchiveManager::getSingleton().addArchiveFactory( new IndexArchiveFactory );
       init = true;
     }
 }
 
-static void insertDirFactory()
+
+namespace Bsa
 {
-  if(!init2)
-    {
-      ArchiveManager::getSingleton().addArchiveFactory( new DirArchiveFactory );
-      init2 = true;
-    }
+
+void addBSA(const std::string& name)
+{
+  sIndex.addArchive(name);
 }
 
+void addDir(const std::string& name, const bool& fs)
+{
+  sIndex.addDirectory(name, fs);
+}
 
-namespace Bsa
+void registerResources(const std::string& group)
 {
+  insertIndexFactory();
 
-// The function below is the only publicly exposed part of this file
+  ResourceGroupManager& manager = ResourceGroupManager::getSingleton();
 
-void addBSA(const std::string& name, const std::string& group)
-{
-  insertBSAFactory();
-  ResourceGroupManager::getSingleton().
-    addResourceLocation(name, "BSA", group, true);
+  // Ogre copies the file list when the location is added, so it has to be added again
+  // to pick up new files.
+  if(!sGroup.empty())
+    manager.removeResourceLocation("index", sGroup);
+
+  manager.addResourceLocation("index", "Index", group, true);
+  sGroup = group;
 }
 
-void addDir(const std::string& name, const bool& fs, const std::string& group)
+void prefetch(const std::vector<std::string>& files)
 {
-    fsstrict = fs;
-    insertDirFactory();
+  // Only prefetch from the archive that actually serves a file
+  std::map<BSAFile*, std::vector<std::string> > names;
+
+  for (std::vector<std::string>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+  {
+    const ResourceIndex::Entry *entry = sIndex.lookup(*iter);
+    if (!entry)
+      continue;
+
+    if (BSAFile *archive = sIndex.getArchive(*entry))
+      names[archive].push_back(archive->getList()[entry->mFile].name);
+  }
 
-    ResourceGroupManager::getSingleton().
-    addResourceLocation(name, "Dir", group, true);
+  for (std::map<BSAFile*, std::vector<std::string> >::iterator iter = names.begin(); iter != names.end(); ++iter)
+    iter->first->prefetch(iter->second);
 }
 
 }
@@ -22,6 +22,7 @@
  */
 
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 #include <algorithm>
@@ -32,10 +33,23 @@
 namespace Bsa
 {
 
-/// Add the given BSA file as an input archive in the Ogre resource
-/// system.
-void addBSA(const std::string& file, const std::string& group="General");
-void addDir(const std::string& file, const bool& fs, const std::string& group="General");
+/// Add the given BSA file to the resource index. Files from archives and
+/// directories that are added later take precedence.
+void addBSA(const std::string& file);
+
+/// Add all files below the given directory to the resource index.
+/// \param fs Treat the directory as case sensitive
+void addDir(const std::string& file, const bool& fs);
+
+/// Make the resource index available in the Ogre resource system, as a
+/// single resource location in the given group. Has to be called again
+/// when files have been added afterwards.
+void registerResources(const std::string& group="General");
+
+/// Read the given files into memory in the background, so that they are
+/// ready once they are opened. Only files served from BSA archives are
+/// read.
+void prefetch(const std::vector<std::string>& files);
 
 }
 
@@ -24,12 +24,94 @@
 #include "bsa_file.hpp"
 
 #include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <cassert>
+#include <cctype>
 
 #include "../files/constrainedfiledatastream.hpp"
+#include "../files/mappedfile.hpp"
+#include "../misc/workqueue.hpp"
 
 using namespace std;
 using namespace Bsa;
 
+namespace
+{
+    /// A file inside a memory mapped archive. Keeps the mapping alive.
+    class MappedDataStream : public Ogre::MemoryDataStream
+    {
+        boost::shared_ptr<MappedFile> mMapping;
+
+    public:
+        MappedDataStream(const boost::shared_ptr<MappedFile> &mapping, const char *name,
+            size_t offset, size_t size)
+          : Ogre::MemoryDataStream(name, const_cast<char*>(mapping->data() + offset), size, false, true)
+          , mMapping(mapping)
+        {}
+    };
+
+    /// Worker thread shared by the prefetch requests of all archives.
+    /// Reads are sequential anyway, more threads would only make the disk seek.
+    Misc::WorkQueue &getPrefetchQueue()
+    {
+        static Misc::WorkQueue queue(1);
+        return queue;
+    }
+}
+
+/// Touches the pages of a list of file ranges, so that they are in memory when they are needed.
+class BSAFile::Prefetch : public Misc::WorkItem
+{
+    boost::shared_ptr<MappedFile> mMapping;
+    vector<pair<uint32_t, uint32_t> > mRanges;
+
+public:
+    uint64_t mBytes;
+
+    /// \param ranges offset and size of each file, sorted by offset
+    Prefetch(const boost::shared_ptr<MappedFile> &mapping, const vector<pair<uint32_t, uint32_t> > &ranges)
+      : mMapping(mapping), mRanges(ranges), mBytes(0)
+    {}
+
+protected:
+    void doWork()
+    {
+        static const size_t pageSize = 4096;
+
+        // Reads through a volatile pointer can't be optimized away
+        const volatile char *data = mMapping->data();
+
+        for(size_t i = 0; i < mRanges.size(); ++i)
+        {
+            size_t begin = mRanges[i].first;
+            size_t end = begin + mRanges[i].second;
+
+            for(size_t pos = begin - begin % pageSize; pos < end; pos += pageSize)
+                (void) data[pos];
+
+            mBytes += mRanges[i].second;
+        }
+    }
+};
+
+size_t BSAFile::ihash::operator()(const char *str) const
+{
+    // FNV-1a over the lower case name
+    size_t hash = 2166136261u;
+    for(; *str; ++str)
+    {
+        hash ^= static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(*str)));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+BSAFile::~BSAFile()
+{
+    waitForPrefetches();
+}
+
 
 /// Error handling
 void BSAFile::fail(const string &msg)
@@ -143,6 +225,12 @@ void BSAFile::readHeader()
     }
 
     isLoaded = true;
+
+#if FILE_API != FILE_API_STDIO
+    // Without a native file API the whole archive would be read into memory up front
+    mapping.reset(new MappedFile);
+    mapping->open(filename.c_str());
+#endif
 }
 
 /// Get the index of a given file name, or -1 if not found
@@ -171,6 +259,68 @@ Ogre::DataStreamPtr BSAFile::getFile(const char *file)
     if(i == -1)
         fail("File not found: " + string(file));
 
-    const FileStruct &fs = files[i];
-	return openConstrainedFileDataStream (filename.c_str (), fs.offset, fs.fileSize);
+    return getFile(files[i]);
+}
+
+Ogre::DataStreamPtr BSAFile::getFile(const FileStruct &fs)
+{
+    if(mapping)
+        return Ogre::DataStreamPtr(new MappedDataStream(mapping, fs.name, fs.offset, fs.fileSize));
+
+    return openConstrainedFileDataStream (filename.c_str (), fs.offset, fs.fileSize);
+}
+
+void BSAFile::prefetch(const vector<string> &names)
+{
+    if(!mapping)
+        return;
+
+    // Forget about requests that are done
+    for(size_t i = 0; i < prefetches.size();)
+    {
+        if(prefetches[i]->isDone())
+        {
+            prefetchedBytes += prefetches[i]->mBytes;
+            prefetches[i] = prefetches.back();
+            prefetches.pop_back();
+        }
+        else
+            ++i;
+    }
+
+    vector<pair<uint32_t, uint32_t> > ranges;
+    ranges.reserve(names.size());
+
+    for(vector<string>::const_iterator it = names.begin(); it != names.end(); ++it)
+    {
+        int i = getIndex(it->c_str());
+        if(i != -1)
+            ranges.push_back(make_pair(files[i].offset, files[i].fileSize));
+    }
+
+    if(ranges.empty())
+        return;
+
+    sort(ranges.begin(), ranges.end());
+
+    boost::shared_ptr<Prefetch> request(new Prefetch(mapping, ranges));
+    prefetches.push_back(request);
+    getPrefetchQueue().addWorkItem(request.get());
+}
+
+uint64_t BSAFile::getPrefetchedBytes() const
+{
+    uint64_t bytes = prefetchedBytes;
+
+    for(size_t i = 0; i < prefetches.size(); ++i)
+        if(prefetches[i]->isDone())
+            bytes += prefetches[i]->mBytes;
+
+    return bytes;
+}
+
+void BSAFile::waitForPrefetches()
+{
+    for(size_t i = 0; i < prefetches.size(); ++i)
+        prefetches[i]->waitTillDone();
 }
@@ -24,14 +24,25 @@
 #ifndef BSA_BSA_FILE_H
 #define BSA_BSA_FILE_H
 
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
 #include <libs/platform/stdint.h>
 #include <libs/platform/strings.h>
 #include <string>
 #include <vector>
-#include <map>
+
+#include <boost/shared_ptr.hpp>
 
 #include <OgreDataStream.h>
 
+class MappedFile;
+
 
 namespace Bsa
 {
@@ -68,20 +79,46 @@ private:
     /// Used for error messages
     std::string filename;
 
+    /// Case insensitive hash of a file name
+    struct ihash
+    {
+        size_t operator()(const char *str) const;
+    };
+
     /// Case insensitive string comparison
-    struct iltstr
+    struct ieqstr
     {
         bool operator()(const char *s1, const char *s2) const
-        { return strcasecmp(s1,s2) < 0; }
+        { return strcasecmp(s1,s2) == 0; }
     };
 
-    /** A map used for fast file name lookup. The value is the index into
-        the files[] vector above. The iltstr ensures that file name
-        checks are case insensitive.
+    /** A hash table used for fast file name lookup. The value is the
+        index into the files[] vector above. ihash and ieqstr ensure
+        that file name checks are case insensitive.
     */
-    typedef std::map<const char*, int, iltstr> Lookup;
+#if defined HAVE_UNORDERED_MAP
+    typedef std::unordered_map<const char*, int, ihash, ieqstr> Lookup;
+#else
+    typedef std::tr1::unordered_map<const char*, int, ihash, ieqstr> Lookup;
+#endif
     Lookup lookup;
 
+    /// The whole archive mapped into memory, shared with all streams
+    /// returned by getFile(). Null if the platform can't map files, in
+    /// which case every stream opens the archive on its own.
+    boost::shared_ptr<MappedFile> mapping;
+
+    class Prefetch;
+
+    /// Prefetch requests that may still be running
+    std::vector<boost::shared_ptr<Prefetch> > prefetches;
+
+    /// Bytes read by prefetch requests that have been removed from prefetches
+    uint64_t prefetchedBytes;
+
+    BSAFile(const BSAFile&);
+    BSAFile& operator=(const BSAFile&);
+
     /// Error handling
     void fail(const std::string &msg);
 
@@ -98,9 +135,12 @@ public:
      */
 
     BSAFile()
-      : isLoaded(false)
+      : isLoaded(false), prefetchedBytes(0)
     { }
 
+    /// Waits for running prefetch requests
+    ~BSAFile();
+
     /// Open an archive file.
     void open(const std::string &file);
 
@@ -118,6 +158,22 @@ public:
     */
     Ogre::DataStreamPtr getFile(const char *file);
 
+    /// Open a file from getList()
+    Ogre::DataStreamPtr getFile(const FileStruct &file);
+
+    /** Read the data of the given files into memory on a background
+        thread, in the order in which they are stored in the archive,
+        so that opening them later doesn't have to wait for the disk.
+        Names that are not in the archive are ignored.
+    */
+    void prefetch(const std::vector<std::string> &names);
+
+    /// Total number of bytes read by finished prefetch requests
+    uint64_t getPrefetchedBytes() const;
+
+    /// Block until all prefetch requests are done
+    void waitForPrefetches();
+
     /// Get a list of all files
     const FileList &getList() const
     { return files; }
@@ -0,0 +1,169 @@
+#include "resourceindex.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#include "../files/constrainedfiledatastream.hpp"
+
+#include "bsa_file.hpp"
+
+namespace
+{
+    char normalizeChar (char ch)
+    {
+        if (ch=='\\')
+            return '/';
+
+        if (ch>='A' && ch<='Z')
+            return ch - 'A' + 'a';
+
+        return ch;
+    }
+
+    char normalizeSlash (char ch)
+    {
+        return ch=='\\' ? '/' : ch;
+    }
+}
+
+namespace Bsa
+{
+    void ResourceIndex::addDirectory (const std::string& dir, bool strict)
+    {
+        Source source;
+        source.mPath = dir;
+        source.mStrict = strict;
+        mSources.push_back (source);
+
+        Entry entry;
+        entry.mSource = mSources.size()-1;
+        entry.mFile = -1;
+        entry.mOffset = 0;
+
+        std::size_t prefix = dir.size();
+
+        if (!dir.empty() && dir[prefix-1]!='\\' && dir[prefix-1]!='/')
+            ++prefix;
+
+        typedef boost::filesystem::recursive_directory_iterator directory_iterator;
+
+        for (directory_iterator iter (dir), end; iter!=end; ++iter)
+        {
+            if (boost::filesystem::is_directory (*iter))
+                continue;
+
+            entry.mPath = iter->path().string();
+            entry.mName = entry.mPath.substr (prefix);
+            std::transform (entry.mName.begin(), entry.mName.end(), entry.mName.begin(), normalizeSlash);
+            entry.mSize = boost::filesystem::file_size (iter->path());
+
+            insert (entry);
+        }
+    }
+
+    void ResourceIndex::addArchive (const std::string& file)
+    {
+        Source source;
+        source.mPath = file;
+        source.mArchive.reset (new BSAFile);
+        source.mArchive->open (file);
+        source.mStrict = false;
+        mSources.push_back (source);
+
+        Entry entry;
+        entry.mSource = mSources.size()-1;
+
+        const BSAFile::FileList& files = source.mArchive->getList();
+
+        for (std::size_t i = 0; i<files.size(); ++i)
+        {
+            entry.mFile = i;
+            entry.mOffset = files[i].offset;
+            entry.mSize = files[i].fileSize;
+            entry.mName = files[i].name;
+            std::transform (entry.mName.begin(), entry.mName.end(), entry.mName.begin(), normalizeSlash);
+
+            insert (entry);
+        }
+    }
+
+    void ResourceIndex::insert (const Entry& entry)
+    {
+        std::string key = normalize (entry.mName);
+
+        std::pair<Map::iterator, bool> result = mEntries.insert (std::make_pair (key, entry));
+
+        if (result.second)
+            return;
+
+        Entry& previous = result.first->second;
+
+        if (!mSources[entry.mSource].mStrict)
+            mFallbacks.erase (key);
+        else if (!mSources[previous.mSource].mStrict)
+            mFallbacks[key] = previous;
+
+        previous = entry;
+    }
+
+    const ResourceIndex::Entry *ResourceIndex::lookup (const std::string& name) const
+    {
+        Map::const_iterator iter = mEntries.find (normalize (name));
+
+        if (iter==mEntries.end())
+            return 0;
+
+        if (mSources[iter->second.mSource].mStrict)
+        {
+            std::string spelled (name);
+            std::transform (spelled.begin(), spelled.end(), spelled.begin(), normalizeSlash);
+
+            if (spelled!=iter->second.mName)
+            {
+                Map::const_iterator fallback = mFallbacks.find (iter->first);
+                return fallback!=mFallbacks.end() ? &fallback->second : 0;
+            }
+        }
+
+        return &iter->second;
+    }
+
+    Ogre::DataStreamPtr ResourceIndex::open (const std::string& name) const
+    {
+        const Entry *entry = lookup (name);
+
+        if (!entry)
+            throw std::runtime_error ("The file '" + name + "' could not be found.");
+
+        return open (*entry);
+    }
+
+    Ogre::DataStreamPtr ResourceIndex::open (const Entry& entry) const
+    {
+        if (BSAFile *archive = getArchive (entry))
+            return archive->getFile (archive->getList()[entry.mFile]);
+
+        return openConstrainedFileDataStream (entry.mPath.c_str());
+    }
+
+    BSAFile *ResourceIndex::getArchive (const Entry& entry) const
+    {
+        return mSources[entry.mSource].mArchive.get();
+    }
+
+    void ResourceIndex::clear()
+    {
+        mEntries.clear();
+        mFallbacks.clear();
+        mSources.clear();
+    }
+
+    std::string ResourceIndex::normalize (const std::string& name)
+    {
+        std::string normalized (name);
+        std::transform (normalized.begin(), normalized.end(), normalized.begin(), normalizeChar);
+        return normalized;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef BSA_RESOURCE_INDEX_H
+#define BSA_RESOURCE_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#include <OgreDataStream.h>
+
+namespace Bsa
+{
+    class BSAFile;
+
+    /// \brief One lookup table for the files of all data directories and BSA archives
+    ///
+    /// Paths are normalised to lower case with forward slashes. A path that is added
+    /// again replaces the earlier entry, so directories and archives have to be added
+    /// in order of increasing priority. If the new entry comes from a strict-case
+    /// directory, the case-insensitive entry it replaces is still found by lookups with
+    /// different case.
+    class ResourceIndex
+    {
+        public:
+
+            /// Where the data of a file is stored
+            struct Entry
+            {
+                /// Directory or archive, in the order they were added
+                std::size_t mSource;
+
+                /// Index into the archive's BSAFile::getList(), or -1 for a loose file
+                int mFile;
+
+                /// Offset and size of the data within the file on disk
+                std::size_t mOffset;
+                std::size_t mSize;
+
+                /// Path of the file on disk (loose files only)
+                std::string mPath;
+
+                /// Name relative to the directory or archive, with forward slashes
+                std::string mName;
+            };
+
+#if defined HAVE_UNORDERED_MAP
+            typedef std::unordered_map<std::string, Entry> Map;
+#else
+            typedef std::tr1::unordered_map<std::string, Entry> Map;
+#endif
+
+        private:
+
+            struct Source
+            {
+                std::string mPath;
+                boost::shared_ptr<BSAFile> mArchive;
+                bool mStrict;
+            };
+
+            std::vector<Source> mSources;
+            Map mEntries;
+            Map mFallbacks; // case-insensitive entries replaced by an entry from a strict directory
+
+            void insert (const Entry& entry);
+
+        public:
+
+            /// Add all files below \a dir.
+            ///
+            /// \param strict Files from this directory are only found if the case of the
+            /// name matches.
+            void addDirectory (const std::string& dir, bool strict = false);
+
+            /// Add all files in the BSA archive \a file. Throws if the archive can't be read.
+            void addArchive (const std::string& file);
+
+            /// \return Entry serving \a name, or 0 if there is none
+            const Entry *lookup (const std::string& name) const;
+
+            /// Throws if \a name can't be found.
+            Ogre::DataStreamPtr open (const std::string& name) const;
+
+            Ogre::DataStreamPtr open (const Entry& entry) const;
+
+            /// \return Archive \a entry is stored in, or 0 for a loose file
+            BSAFile *getArchive (const Entry& entry) const;
+
+            const Map& getEntries() const { return mEntries; }
+
+            std::size_t getSourceCount() const { return mSources.size(); }
+
+            void clear();
+
+            /// Lower case and forward slashes
+            static std::string normalize (const std::string& name);
+    };
+}
+
+#endif
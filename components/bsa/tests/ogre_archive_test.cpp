@@ -20,6 +20,7 @@ int main()
 
   // Add the BSA
   Bsa::addBSA("../../data/Morrowind.bsa");
+  Bsa::registerResources();
 
   // Pick a sample file
   String tex = "textures\\tx_natural_cavern_wall13.dds";
@@ -0,0 +1,143 @@
+
+#include "batchcompiler.hpp"
+
+#include <sstream>
+#include <exception>
+#include <stdexcept>
+
+#include "scanner.hpp"
+#include "fileparser.hpp"
+#include "streamerrorhandler.hpp"
+#include "exception.hpp"
+
+namespace Compiler
+{
+    bool compile (const std::string& source, FileParser& parser, ErrorHandler& errorHandler,
+        const Extensions *extensions, std::ostream& errors)
+    {
+        parser.reset();
+        errorHandler.reset();
+
+        try
+        {
+            Scanner scanner (errorHandler, source.data(), source.data()+source.size(), extensions);
+
+            scanner.scan (parser);
+        }
+        catch (const SourceException&)
+        {
+            // error has already been reported via error handler
+            return false;
+        }
+        catch (const std::exception& error)
+        {
+            errors << "An exception has been thrown: " << error.what() << std::endl;
+            return false;
+        }
+
+        return errorHandler.isGood();
+    }
+
+    LockedContext::LockedContext (const Context& context) : mContext (context)
+    {
+        setExtensions (context.getExtensions());
+    }
+
+    bool LockedContext::canDeclareLocals() const
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+        return mContext.canDeclareLocals();
+    }
+
+    char LockedContext::getGlobalType (const std::string& name) const
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+        return mContext.getGlobalType (name);
+    }
+
+    char LockedContext::getMemberType (const std::string& name, const std::string& id) const
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+        return mContext.getMemberType (name, id);
+    }
+
+    bool LockedContext::isId (const std::string& name) const
+    {
+        boost::mutex::scoped_lock lock (mMutex);
+        return mContext.isId (name);
+    }
+
+    class BatchCompiler::Job : public Misc::WorkItem
+    {
+            Context& mContext;
+            std::string mSource;
+
+        public:
+
+            Result mResult;
+
+            Job (Context& context, const std::string& name, const std::string& source)
+            : mContext (context), mSource (source)
+            {
+                mResult.mName = name;
+                mResult.mSuccess = false;
+            }
+
+        protected:
+
+            virtual void doWork()
+            {
+                std::ostringstream messages;
+                StreamErrorHandler errorHandler (messages);
+                FileParser parser (errorHandler, mContext);
+
+                mResult.mSuccess =
+                    compile (mSource, parser, errorHandler, mContext.getExtensions(), messages);
+
+                if (mResult.mSuccess)
+                {
+                    parser.getCode (mResult.mCode);
+                    mResult.mLocals = parser.getLocals();
+                }
+
+                mResult.mMessages = messages.str();
+            }
+    };
+
+    BatchCompiler::BatchCompiler (const Context& context, unsigned int threads)
+    : mContext (context), mQueue (threads)
+    {}
+
+    BatchCompiler::~BatchCompiler() {}
+
+    int BatchCompiler::add (const std::string& name, const std::string& source)
+    {
+        mJobs.push_back (boost::shared_ptr<Job> (new Job (mContext, name, source)));
+        mQueue.addWorkItem (mJobs.back().get());
+        return static_cast<int> (mJobs.size())-1;
+    }
+
+    const BatchCompiler::Result& BatchCompiler::getResult (int index) const
+    {
+        Job& job = *mJobs.at (index);
+
+        job.waitTillDone();
+
+        if (!job.getError().empty() && job.mResult.mMessages.empty())
+            job.mResult.mMessages = "An exception has been thrown: " + job.getError() + "\n";
+
+        return job.mResult;
+    }
+
+    void BatchCompiler::waitTillDone() const
+    {
+        for (std::vector<boost::shared_ptr<Job> >::const_iterator iter (mJobs.begin());
+            iter!=mJobs.end(); ++iter)
+            (*iter)->waitTillDone();
+    }
+
+    int BatchCompiler::size() const
+    {
+        return static_cast<int> (mJobs.size());
+    }
+}
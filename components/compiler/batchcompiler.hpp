@@ -0,0 +1,105 @@
+#ifndef COMPILER_BATCHCOMPILER_H_INCLUDED
+#define COMPILER_BATCHCOMPILER_H_INCLUDED
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <components/interpreter/types.hpp>
+#include <components/misc/workqueue.hpp>
+
+#include "context.hpp"
+#include "locals.hpp"
+
+namespace Compiler
+{
+    class Extensions;
+    class FileParser;
+    class ErrorHandler;
+
+    bool compile (const std::string& source, FileParser& parser, ErrorHandler& errorHandler,
+        const Extensions *extensions, std::ostream& errors);
+    ///< Compile \a source with \a parser, which has to report errors to \a errorHandler. Both
+    /// are reset first. Exceptions that are not reported via \a errorHandler are written to
+    /// \a errors.
+    ///
+    /// Can be called on different threads at the same time, as long as the threads do not share
+    /// \a parser or \a errorHandler and the context of the parsers is safe to query concurrently.
+    /// \return Success?
+
+    /// \brief Serialises the queries of compilers running on different threads
+    class LockedContext : public Context
+    {
+            const Context& mContext;
+            mutable boost::mutex mMutex;
+
+        public:
+
+            LockedContext (const Context& context);
+            ///< The extensions of \a context are shared without locking; they are only read
+            /// while compiling.
+
+            virtual bool canDeclareLocals() const;
+
+            virtual char getGlobalType (const std::string& name) const;
+
+            virtual char getMemberType (const std::string& name, const std::string& id) const;
+
+            virtual bool isId (const std::string& name) const;
+    };
+
+    /// \brief Compile a batch of scripts on several threads
+    ///
+    /// Every script is compiled with its own parser, scanner and error handler. The results
+    /// are independent of the number of threads and can be collected in the order the scripts
+    /// have been added, which keeps the diagnostics deterministic.
+    class BatchCompiler
+    {
+        public:
+
+            struct Result
+            {
+                std::string mName;
+                bool mSuccess;
+                std::vector<Interpreter::Type_Code> mCode; ///< empty, if compiling failed
+                Locals mLocals;
+                std::string mMessages; ///< errors and warnings, in the order they were reported
+            };
+
+        private:
+
+            class Job;
+
+            LockedContext mContext;
+            std::vector<boost::shared_ptr<Job> > mJobs;
+            Misc::WorkQueue mQueue; // declared after the jobs, so that it stops before they are deleted
+
+            BatchCompiler (const BatchCompiler&);
+            BatchCompiler& operator= (const BatchCompiler&);
+
+        public:
+
+            BatchCompiler (const Context& context, unsigned int threads = 0);
+            ///< \param threads Number of worker threads, 0 for one per hardware thread
+
+            ~BatchCompiler();
+
+            int add (const std::string& name, const std::string& source);
+            ///< Queue a script for compiling.
+            /// \return Index of the result
+
+            const Result& getResult (int index) const;
+            ///< Block until the script \a index has been compiled.
+
+            void waitTillDone() const;
+            ///< Block until all scripts have been compiled. Until then the context passed to the
+            /// constructor may be queried by the worker threads.
+
+            int size() const;
+    };
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include "codecache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "extensions.hpp"
+
+namespace
+{
+    const char sMagic[4] = { 'O', 'M', 'W', 'S' };
+
+    // Increase when the layout of the file or the code generated by the compiler changes
+    const uint32_t sVersion = 1;
+
+    // FNV-1a
+    void addToHash (uint64_t& key, const void *data, std::size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *> (data);
+
+        for (std::size_t i = 0; i<size; ++i)
+        {
+            key ^= bytes[i];
+            key *= 1099511628211ULL;
+        }
+    }
+
+    template<typename T>
+    void write (std::ostream& stream, const T& value)
+    {
+        stream.write (reinterpret_cast<const char *> (&value), sizeof (T));
+    }
+
+    void write (std::ostream& stream, const std::string& value)
+    {
+        write (stream, static_cast<uint32_t> (value.size()));
+        stream.write (value.c_str(), value.size());
+    }
+
+    template<typename T>
+    T read (std::istream& stream)
+    {
+        T value;
+
+        if (!stream.read (reinterpret_cast<char *> (&value), sizeof (T)))
+            throw std::runtime_error ("unexpected end of file");
+
+        return value;
+    }
+
+    std::string readString (std::istream& stream)
+    {
+        uint32_t size = read<uint32_t> (stream);
+
+        std::string value (size, '\0');
+
+        if (size && !stream.read (&value[0], size))
+            throw std::runtime_error ("unexpected end of file");
+
+        return value;
+    }
+}
+
+namespace Compiler
+{
+    CodeCache::CodeCache (const Extensions& extensions)
+    : mKey (14695981039346656037ULL), mModified (false)
+    {
+        addToHash (mKey, &sVersion, sizeof (sVersion));
+
+        std::ostringstream signature;
+        extensions.write (signature);
+        std::string data = signature.str();
+        addToHash (mKey, data.c_str(), data.size());
+    }
+
+    void CodeCache::addToKey (const void *data, std::size_t size)
+    {
+        addToHash (mKey, data, size);
+    }
+
+    bool CodeCache::load (const std::string& file)
+    {
+        mEntries.clear();
+        mModified = false;
+
+        std::ifstream stream (file.c_str(), std::ios::in | std::ios::binary);
+
+        if (!stream)
+            return false;
+
+        try
+        {
+            char magic[sizeof (sMagic)];
+
+            if (!stream.read (magic, sizeof (magic)) ||
+                !std::equal (magic, magic+sizeof (magic), sMagic))
+                throw std::runtime_error ("not a script cache");
+
+            if (read<uint64_t> (stream)!=mKey)
+                return false;
+
+            uint32_t count = read<uint32_t> (stream);
+
+            for (uint32_t i = 0; i<count; ++i)
+            {
+                std::string name = readString (stream);
+
+                Entry entry;
+                entry.mSourceHash = read<uint64_t> (stream);
+
+                uint32_t codeSize = read<uint32_t> (stream);
+                entry.mCode.resize (codeSize);
+
+                if (codeSize && !stream.read (reinterpret_cast<char *> (&entry.mCode[0]),
+                    codeSize * sizeof (Interpreter::Type_Code)))
+                    throw std::runtime_error ("unexpected end of file");
+
+                const char types[] = { 's', 'l', 'f' };
+
+                for (int j = 0; j<3; ++j)
+                {
+                    uint32_t locals = read<uint32_t> (stream);
+
+                    for (uint32_t k = 0; k<locals; ++k)
+                        entry.mLocals.declare (types[j], readString (stream));
+                }
+
+                mEntries[name] = entry;
+            }
+        }
+        catch (const std::exception&)
+        {
+            mEntries.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    void CodeCache::save (const std::string& file)
+    {
+        std::ofstream stream (file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!stream)
+            throw std::runtime_error ("can't open " + file);
+
+        stream.write (sMagic, sizeof (sMagic));
+        write (stream, mKey);
+        write (stream, static_cast<uint32_t> (mEntries.size()));
+
+        for (std::map<std::string, Entry>::const_iterator iter (mEntries.begin());
+            iter!=mEntries.end(); ++iter)
+        {
+            write (stream, iter->first);
+            write (stream, iter->second.mSourceHash);
+
+            const std::vector<Interpreter::Type_Code>& code = iter->second.mCode;
+            write (stream, static_cast<uint32_t> (code.size()));
+
+            if (!code.empty())
+                stream.write (reinterpret_cast<const char *> (&code[0]),
+                    code.size() * sizeof (Interpreter::Type_Code));
+
+            const char types[] = { 's', 'l', 'f' };
+
+            for (int j = 0; j<3; ++j)
+            {
+                const std::vector<std::string>& locals = iter->second.mLocals.get (types[j]);
+
+                write (stream, static_cast<uint32_t> (locals.size()));
+
+                for (std::vector<std::string>::const_iterator local (locals.begin());
+                    local!=locals.end(); ++local)
+                    write (stream, *local);
+            }
+        }
+
+        if (!stream.flush())
+            throw std::runtime_error ("can't write " + file);
+
+        mModified = false;
+    }
+
+    bool CodeCache::get (const std::string& name, const std::string& source,
+        std::vector<Interpreter::Type_Code>& code, Locals& locals) const
+    {
+        std::map<std::string, Entry>::const_iterator iter = mEntries.find (name);
+
+        if (iter==mEntries.end() || iter->second.mSourceHash!=hash (source))
+            return false;
+
+        code = iter->second.mCode;
+        locals = iter->second.mLocals;
+        return true;
+    }
+
+    void CodeCache::set (const std::string& name, const std::string& source,
+        const std::vector<Interpreter::Type_Code>& code, const Locals& locals)
+    {
+        Entry& entry = mEntries[name];
+        entry.mSourceHash = hash (source);
+        entry.mCode = code;
+        entry.mLocals = locals;
+        mModified = true;
+    }
+
+    void CodeCache::erase (const std::string& name)
+    {
+        if (mEntries.erase (name))
+            mModified = true;
+    }
+
+    void CodeCache::clear()
+    {
+        if (!mEntries.empty())
+            mModified = true;
+
+        mEntries.clear();
+    }
+
+    std::size_t CodeCache::size() const
+    {
+        return mEntries.size();
+    }
+
+    bool CodeCache::isModified() const
+    {
+        return mModified;
+    }
+
+    uint64_t CodeCache::hash (const std::string& data)
+    {
+        uint64_t key = 14695981039346656037ULL;
+        addToHash (key, data.c_str(), data.size());
+        return key;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef COMPILER_CODECACHE_H_INCLUDED
+#define COMPILER_CODECACHE_H_INCLUDED
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <libs/platform/stdint.h>
+
+#include <components/interpreter/types.hpp>
+
+#include "locals.hpp"
+
+namespace Compiler
+{
+    class Extensions;
+
+    /// \brief Compiled scripts that can be stored in a file
+    ///
+    /// Every script is stored with a hash of its source text, so that changed scripts are
+    /// recompiled individually. The whole cache is invalid, if the extensions the scripts
+    /// were compiled with or any data added with addToKey() have changed.
+    class CodeCache
+    {
+            struct Entry
+            {
+                uint64_t mSourceHash;
+                std::vector<Interpreter::Type_Code> mCode;
+                Locals mLocals;
+            };
+
+            uint64_t mKey;
+            std::map<std::string, Entry> mEntries;
+            bool mModified;
+
+        public:
+
+            explicit CodeCache (const Extensions& extensions);
+
+            void addToKey (const void *data, std::size_t size);
+            ///< Make the whole cache depend on \a data, e.g. on what the context of the compiler
+            /// knows about globals, IDs and the locals of other scripts. Call before load().
+
+            bool load (const std::string& file);
+            ///< Replace the content of the cache with the scripts in \a file.
+            /// \return false, if \a file does not exist, can't be read or has been written with
+            /// different extensions or key data. The cache is empty in this case.
+
+            void save (const std::string& file);
+            ///< Throws an exception, if \a file can't be written.
+
+            bool get (const std::string& name, const std::string& source,
+                std::vector<Interpreter::Type_Code>& code, Locals& locals) const;
+            ///< Look up script \a name.
+            /// \return false, if the script is not cached or \a source has changed.
+
+            void set (const std::string& name, const std::string& source,
+                const std::vector<Interpreter::Type_Code>& code, const Locals& locals);
+
+            void erase (const std::string& name);
+
+            void clear();
+
+            std::size_t size() const;
+
+            bool isModified() const;
+            ///< Has the cache been changed since it was loaded or saved?
+
+            static uint64_t hash (const std::string& data);
+    };
+}
+
+#endif
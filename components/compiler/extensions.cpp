@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <stdexcept>
+#include <ostream>
 
 #include "generator.hpp"
 #include "literals.hpp"
@@ -21,6 +22,13 @@ namespace Compiler
         return iter->second;
     }
 
+    int Extensions::searchKeyword (const char *begin, const char *end) const
+    {
+        int keyword = 0;
+        mKeywordTable.search (begin, end, keyword);
+        return keyword;
+    }
+
     bool Extensions::isFunction (int keyword, char& returnType, std::string& argumentType,
         bool explicitReference) const
     {
@@ -73,6 +81,7 @@ namespace Compiler
         int keywordIndex = mNextKeywordIndex--;
 
         mKeywords.insert (std::make_pair (keyword, keywordIndex));
+        mKeywordTable.insert (keyword, keywordIndex);
 
         function.mReturn = returnType;
         function.mArguments = argumentType;
@@ -103,6 +112,7 @@ namespace Compiler
         int keywordIndex = mNextKeywordIndex--;
 
         mKeywords.insert (std::make_pair (keyword, keywordIndex));
+        mKeywordTable.insert (keyword, keywordIndex);
 
         instruction.mArguments = argumentType;
         instruction.mCode = code;
@@ -214,4 +224,71 @@ namespace Compiler
             iter!=mKeywords.end(); ++iter)
             keywords.push_back (iter->first);
     }
+
+    void Extensions::listOpcodes (std::map<std::pair<int, int>, std::string>& opcodes) const
+    {
+        for (std::map<std::string, int>::const_iterator iter (mKeywords.begin());
+            iter!=mKeywords.end(); ++iter)
+        {
+            int segment = 0;
+            int codes[2] = { -1, -1 };
+
+            std::map<int, Function>::const_iterator function = mFunctions.find (iter->second);
+
+            if (function!=mFunctions.end())
+            {
+                segment = function->second.mSegment;
+                codes[0] = function->second.mCode;
+                codes[1] = function->second.mCodeExplicit;
+            }
+            else
+            {
+                std::map<int, Instruction>::const_iterator instruction =
+                    mInstructions.find (iter->second);
+
+                if (instruction==mInstructions.end())
+                    continue;
+
+                segment = instruction->second.mSegment;
+                codes[0] = instruction->second.mCode;
+                codes[1] = instruction->second.mCodeExplicit;
+            }
+
+            for (int i=0; i<2; ++i)
+            {
+                if (codes[i]==-1 || (i==1 && codes[1]==codes[0]))
+                    continue;
+
+                std::string name = i==0 ? iter->first : iter->first + " (explicit)";
+                std::string& entry = opcodes[std::make_pair (segment, codes[i])];
+
+                if (entry.size()<name.size())
+                    entry = name;
+            }
+        }
+    }
+
+    void Extensions::write (std::ostream& stream) const
+    {
+        for (std::map<std::string, int>::const_iterator iter (mKeywords.begin());
+            iter!=mKeywords.end(); ++iter)
+        {
+            std::map<int, Function>::const_iterator function = mFunctions.find (iter->second);
+
+            if (function!=mFunctions.end())
+                stream
+                    << iter->first << " function " << function->second.mReturn << ' '
+                    << function->second.mArguments << ' ' << function->second.mCode << ' '
+                    << function->second.mCodeExplicit << std::endl;
+
+            std::map<int, Instruction>::const_iterator instruction =
+                mInstructions.find (iter->second);
+
+            if (instruction!=mInstructions.end())
+                stream
+                    << iter->first << " instruction " << instruction->second.mArguments << ' '
+                    << instruction->second.mCode << ' ' << instruction->second.mCodeExplicit
+                    << std::endl;
+        }
+    }
 }
@@ -4,9 +4,12 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <iosfwd>
 
 #include <components/interpreter/types.hpp>
 
+#include "keywordtable.hpp"
+
 namespace Compiler
 {
     class Literals;
@@ -34,6 +37,7 @@ namespace Compiler
 
             int mNextKeywordIndex;
             std::map<std::string, int> mKeywords;
+            KeywordTable mKeywordTable; // same content as mKeywords, for the scanner
             std::map<int, Function> mFunctions;
             std::map<int, Instruction> mInstructions;
 
@@ -46,6 +50,10 @@ namespace Compiler
             /// - if no match is found 0 is returned.
             /// - keyword must be all lower case.
 
+            int searchKeyword (const char *begin, const char *end) const;
+            ///< Return extension keyword code of the keyword [\a begin, \a end), ignoring case.
+            /// - if no match is found 0 is returned.
+
             bool isFunction (int keyword, char& returnType, std::string& argumentType,
                 bool explicitReference) const;
             ///< Is this keyword registered with a function? If yes, return return and argument
@@ -81,6 +89,13 @@ namespace Compiler
 
             void listKeywords (std::vector<std::string>& keywords) const;
             ///< Append all known keywords to \æ kaywords.
+
+            void listOpcodes (std::map<std::pair<int, int>, std::string>& opcodes) const;
+            ///< Add the keywords of all instructions and functions to \a opcodes by segment and
+            /// opcode. Of several keywords for the same opcode the longest one is used.
+
+            void write (std::ostream& stream) const;
+            ///< Write all registered keywords with their arguments and opcodes to \a stream.
     };
 }
 
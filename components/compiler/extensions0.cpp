@@ -266,6 +266,11 @@ namespace Compiler
             extensions.registerInstruction("togglegodmode", "", opcodeToggleGodMode);
             extensions.registerInstruction ("disablelevitation", "", opcodeDisableLevitation);
             extensions.registerInstruction ("enablelevitation", "", opcodeEnableLevitation);
+            extensions.registerInstruction ("togglescriptprofiler", "", opcodeToggleScriptProfiler);
+            extensions.registerInstruction ("tsp", "", opcodeToggleScriptProfiler);
+            extensions.registerInstruction ("showscriptprofile", "", opcodeShowScriptProfile);
+            extensions.registerInstruction ("ssp", "", opcodeShowScriptProfile);
+            extensions.registerInstruction ("benchmarkmovement", "ll", opcodeBenchmarkMovement);
         }
     }
 
@@ -0,0 +1,117 @@
+
+#include "keywordtable.hpp"
+
+namespace Compiler
+{
+    namespace
+    {
+        inline char toLower (char c)
+        {
+            return (c>='A' && c<='Z') ? c-'A'+'a' : c;
+        }
+    }
+
+    unsigned int KeywordTable::hash (const char *begin, const char *end)
+    {
+        // FNV-1a
+        unsigned int hash = 2166136261u;
+
+        for (; begin!=end; ++begin)
+        {
+            hash ^= static_cast<unsigned char> (toLower (*begin));
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    std::size_t KeywordTable::find (const char *begin, const char *end, unsigned int hash) const
+    {
+        std::size_t mask = mSlots.size()-1;
+        std::size_t length = end-begin;
+
+        for (std::size_t index = hash & mask; ; index = (index+1) & mask)
+        {
+            const Slot& slot = mSlots[index];
+
+            if (slot.mKeyword.empty())
+                return index;
+
+            if (slot.mHash==hash && slot.mKeyword.size()==length)
+            {
+                std::size_t i = 0;
+
+                while (i<length && slot.mKeyword[i]==toLower (begin[i]))
+                    ++i;
+
+                if (i==length)
+                    return index;
+            }
+        }
+    }
+
+    void KeywordTable::grow()
+    {
+        std::vector<Slot> slots (mSlots.size()*2);
+        slots.swap (mSlots);
+
+        for (std::vector<Slot>::const_iterator iter (slots.begin()); iter!=slots.end(); ++iter)
+            if (!iter->mKeyword.empty())
+            {
+                const char *begin = iter->mKeyword.data();
+                mSlots[find (begin, begin+iter->mKeyword.size(), iter->mHash)] = *iter;
+            }
+    }
+
+    KeywordTable::KeywordTable() : mSlots (16), mSize (0) {}
+
+    bool KeywordTable::insert (const std::string& keyword, int value)
+    {
+        if (keyword.empty())
+            return false;
+
+        // keep the table at most half full, so that the probe sequences stay short
+        if ((mSize+1)*2>mSlots.size())
+            grow();
+
+        const char *begin = keyword.data();
+        const char *end = begin+keyword.size();
+        unsigned int hash = KeywordTable::hash (begin, end);
+
+        Slot& slot = mSlots[find (begin, end, hash)];
+
+        if (!slot.mKeyword.empty())
+            return false;
+
+        slot.mKeyword = keyword;
+        slot.mHash = hash;
+        slot.mValue = value;
+        ++mSize;
+
+        return true;
+    }
+
+    bool KeywordTable::search (const char *begin, const char *end, int& value) const
+    {
+        if (begin==end)
+            return false;
+
+        const Slot& slot = mSlots[find (begin, end, hash (begin, end))];
+
+        if (slot.mKeyword.empty())
+            return false;
+
+        value = slot.mValue;
+        return true;
+    }
+
+    bool KeywordTable::search (const std::string& keyword, int& value) const
+    {
+        return search (keyword.data(), keyword.data()+keyword.size(), value);
+    }
+
+    std::size_t KeywordTable::size() const
+    {
+        return mSize;
+    }
+}
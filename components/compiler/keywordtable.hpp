@@ -0,0 +1,51 @@
+#ifndef COMPILER_KEYWORDTABLE_H_INCLUDED
+#define COMPILER_KEYWORDTABLE_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+namespace Compiler
+{
+    /// \brief Case insensitive lookup of keywords
+    ///
+    /// An open addressing hash table, that looks up a name directly in the characters of the
+    /// source text, without lower casing or copying it first.
+    class KeywordTable
+    {
+            struct Slot
+            {
+                std::string mKeyword; // lower case, empty for an unused slot
+                unsigned int mHash;
+                int mValue;
+            };
+
+            std::vector<Slot> mSlots; // the size is a power of 2
+            std::size_t mSize;
+
+            static unsigned int hash (const char *begin, const char *end);
+
+            std::size_t find (const char *begin, const char *end, unsigned int hash) const;
+            ///< Return the slot of the keyword [\a begin, \a end) or the unused slot it would
+            /// be inserted into.
+
+            void grow();
+
+        public:
+
+            KeywordTable();
+
+            bool insert (const std::string& keyword, int value);
+            ///< Add \a keyword, which must be all lower case.
+            /// \return false, if \a keyword is already in the table. Its value is not changed in
+            /// this case.
+
+            bool search (const char *begin, const char *end, int& value) const;
+            ///< Look up the keyword [\a begin, \a end), ignoring case.
+
+            bool search (const std::string& keyword, int& value) const;
+
+            std::size_t size() const;
+    };
+}
+
+#endif
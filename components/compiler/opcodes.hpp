@@ -228,6 +228,9 @@ namespace Compiler
         const int opcodeToggleGodMode = 0x200021f;
         const int opcodeDisableLevitation = 0x2000220;
         const int opcodeEnableLevitation = 0x2000221;
+        const int opcodeToggleScriptProfiler = 0x2000226;
+        const int opcodeShowScriptProfile = 0x2000227;
+        const int opcodeBenchmarkMovement = 0x2000228;
     }
 
     namespace Sky
@@ -6,22 +6,26 @@
 #include <sstream>
 #include <algorithm>
 #include <iterator>
+#include <istream>
+#include <cstdio>
 
 #include "exception.hpp"
 #include "errorhandler.hpp"
 #include "parser.hpp"
 #include "extensions.hpp"
-
-#include <components/misc/stringops.hpp>
+#include "keywordtable.hpp"
 
 namespace Compiler
 {
     bool Scanner::get (char& c)
     {
-        mStream.get (c);
-
-        if (!mStream.good())
+        if (mEof || mPos==mEnd)
+        {
+            mEof = true;
             return false;
+        }
+
+        c = *mPos++;
 
         mPrevLoc =mLoc;
 
@@ -42,10 +46,17 @@ namespace Compiler
 
     void Scanner::putback (char c)
     {
-        mStream.putback (c);
+        if (!mEof)
+            --mPos;
+
         mLoc = mPrevLoc;
     }
 
+    int Scanner::peek() const
+    {
+        return mPos!=mEnd ? static_cast<unsigned char> (*mPos) : EOF;
+    }
+
     bool Scanner::scanToken (Parser& parser)
     {
         switch (mPutback)
@@ -263,6 +274,22 @@ namespace Compiler
         0
     };
 
+    namespace
+    {
+        KeywordTable makeKeywordTable()
+        {
+            KeywordTable table;
+
+            for (int i=0; keywords[i]; ++i)
+                table.insert (keywords[i], i);
+
+            return table;
+        }
+
+        // built during static initialisation, so that scanners on different threads can share it
+        const KeywordTable sKeywords = makeKeywordTable();
+    }
+
     bool Scanner::scanName (char c, Parser& parser, bool& cont)
     {
         std::string name;
@@ -280,23 +307,20 @@ namespace Compiler
             return true;
         }
 
-        int i = 0;
-
-        std::string lowerCase = Misc::StringUtils::lowerCase(name);
+        const char *begin = name.data();
+        const char *end = begin+name.size();
 
-        for (; keywords[i]; ++i)
-            if (lowerCase==keywords[i])
-                break;
+        int index = 0;
 
-        if (keywords[i])
+        if (sKeywords.search (begin, end, index))
         {
-            cont = parser.parseKeyword (i, loc, *this);
+            cont = parser.parseKeyword (index, loc, *this);
             return true;
         }
 
         if (mExtensions)
         {
-            if (int keyword = mExtensions->searchKeyword (lowerCase))
+            if (int keyword = mExtensions->searchKeyword (begin, end))
             {
                 cont = parser.parseKeyword (keyword, loc, *this);
                 return true;
@@ -347,7 +371,7 @@ namespace Compiler
                     /// \todo add an option to disable the following hack. Also, find out who is
                     /// responsible for allowing it in the first place and meet up with that person in
                     /// a dark alley.
-                    (c=='-' && !name.empty() && std::isalpha (mStream.peek()))))
+                    (c=='-' && !name.empty() && std::isalpha (peek()))))
                 {
                     putback (c);
                     break;
@@ -508,7 +532,18 @@ namespace Compiler
 
     Scanner::Scanner (ErrorHandler& errorHandler, std::istream& inputStream,
         const Extensions *extensions)
-    : mErrorHandler (errorHandler), mStream (inputStream), mExtensions (extensions),
+    : mErrorHandler (errorHandler),
+      mBuffer ((std::istreambuf_iterator<char> (inputStream)), std::istreambuf_iterator<char>()),
+      mPos (mBuffer.data()), mEnd (mBuffer.data()+mBuffer.size()), mEof (false),
+      mExtensions (extensions),
+      mPutback (Putback_None), mPutbackCode(0), mPutbackInteger(0), mPutbackFloat(0)
+    {
+    }
+
+    Scanner::Scanner (ErrorHandler& errorHandler, const char *begin, const char *end,
+        const Extensions *extensions)
+    : mErrorHandler (errorHandler), mPos (begin), mEnd (end), mEof (false),
+      mExtensions (extensions),
       mPutback (Putback_None), mPutbackCode(0), mPutbackInteger(0), mPutbackFloat(0)
     {
     }
@@ -16,7 +16,8 @@ namespace Compiler
     /// \brief Scanner
     ///
     /// This class translate a char-stream to a token stream (delivered via
-    /// parser-callbacks).
+    /// parser-callbacks). The characters are read from a buffer; a stream is read into a
+    /// buffer of the scanner first.
 
     class Scanner
     {
@@ -29,7 +30,10 @@ namespace Compiler
             ErrorHandler& mErrorHandler;
             TokenLoc mLoc;
             TokenLoc mPrevLoc;
-            std::istream& mStream;
+            std::string mBuffer; // copy of the input, if it has been passed as a stream
+            const char *mPos;
+            const char *mEnd;
+            bool mEof; // get() has failed; like a failed stream, the scanner does not read or put back any more
             const Extensions *mExtensions;
             putback_type mPutback;
             int mPutbackCode;
@@ -80,6 +84,8 @@ namespace Compiler
 
             void putback (char c);
 
+            int peek() const;
+
             bool scanToken (Parser& parser);
 
             bool scanInt (char c, Parser& parser, bool& cont);
@@ -100,6 +106,11 @@ namespace Compiler
                 const Extensions *extensions = 0);
             ///< constructor
 
+            Scanner (ErrorHandler& errorHandler, const char *begin, const char *end,
+                const Extensions *extensions = 0);
+            ///< Scan the characters in [\a begin, \a end), which have to stay valid while the
+            /// scanner is used.
+
             void scan (Parser& parser);
             ///< Scan a token and deliver it to the parser.
 
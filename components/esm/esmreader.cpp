@@ -1,7 +1,10 @@
 #include "esmreader.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
 
 #include "../files/constrainedfiledatastream.hpp"
+#include "../files/mappedfile.hpp"
 
 namespace ESM
 {
@@ -11,7 +14,7 @@ using namespace Misc;
 ESM_Context ESMReader::getContext()
 {
     // Update the file position before returning
-    mCtx.filePos = mEsm->tell();
+    mCtx.filePos = tell();
     return mCtx;
 }
 
@@ -19,6 +22,10 @@ ESMReader::ESMReader()
     : mBuffer(50*1024)
     , mRecordFlags(0)
     , mIdx(0)
+    , mMapStart(NULL)
+    , mMapPos(NULL)
+    , mMapEnd(NULL)
+    , mUseMemoryMap(false)
     , mGlobalReaderList(NULL)
     , mEncoder(NULL)
 {
@@ -39,12 +46,14 @@ void ESMReader::restoreContext(const ESM_Context &rc)
     mCtx = rc;
 
     // Make sure we seek to the right place
-    mEsm->seek(mCtx.filePos);
+    seek(mCtx.filePos);
 }
 
 void ESMReader::close()
 {
     mEsm.setNull();
+    mMappedFile.reset();
+    mMapStart = mMapPos = mMapEnd = NULL;
     mCtx.filename.clear();
     mCtx.leftFile = 0;
     mCtx.leftRec = 0;
@@ -76,12 +85,42 @@ void ESMReader::open(Ogre::DataStreamPtr _esm, const std::string &name)
 
 void ESMReader::open(const std::string &file)
 {
-    open (openConstrainedFileDataStream (file.c_str ()), file);
+    if (!mUseMemoryMap)
+    {
+        open (openConstrainedFileDataStream (file.c_str ()), file);
+        return;
+    }
+
+    openMapped(file);
+
+    if (getRecName() != "TES3")
+        fail("Not a valid Morrowind file");
+
+    getRecHeader();
+
+    mHeader.load (*this);
 }
 
 void ESMReader::openRaw(const std::string &file)
 {
-    openRaw (openConstrainedFileDataStream (file.c_str ()), file);
+    if (mUseMemoryMap)
+        openMapped(file);
+    else
+        openRaw (openConstrainedFileDataStream (file.c_str ()), file);
+}
+
+void ESMReader::openMapped(const std::string &file)
+{
+    close();
+
+    boost::shared_ptr<MappedFile> mapped (new MappedFile);
+    mapped->open (file.c_str());
+
+    mMappedFile = mapped;
+    mMapStart = mMapPos = mapped->data();
+    mMapEnd = mMapStart + mapped->size();
+    mCtx.filename = file;
+    mCtx.leftFile = mapped->size();
 }
 
 int64_t ESMReader::getHNLong(const char *name)
@@ -118,7 +157,7 @@ std::string ESMReader::getHString()
         // Skip the following zero byte
         mCtx.leftRec--;
         char c;
-        mEsm->read(&c, 1);
+        read(&c, 1);
         return "";
     }
 
@@ -140,6 +179,74 @@ void ESMReader::getHNExact(void*p, int size, const char* name)
     getHExact(p, size);
 }
 
+Misc::SString ESMReader::getHView()
+{
+    getSubHeader();
+    return getView(mCtx.leftSub);
+}
+
+Misc::SString ESMReader::getHNView(const char* name)
+{
+    getSubNameIs(name);
+    return getHView();
+}
+
+Misc::SString ESMReader::getHNOView(const char* name)
+{
+    if (isNextSub(name))
+        return getHView();
+    return Misc::SString();
+}
+
+Misc::SString ESMReader::getHStringView()
+{
+    getSubHeader();
+
+    // Same MultiMark.esp hack as in getHString()
+    if (mCtx.leftSub == 0)
+    {
+        mCtx.leftRec--;
+        char c;
+        read(&c, 1);
+        return Misc::SString();
+    }
+
+    Misc::SString view = getView(mCtx.leftSub);
+
+    while (view.length > 0 && view.ptr[view.length-1] == 0)
+        --view.length;
+
+    return view;
+}
+
+Misc::SString ESMReader::getHNOStringView(const char* name)
+{
+    if (isNextSub(name))
+        return getHStringView();
+    return Misc::SString();
+}
+
+Misc::SString ESMReader::getView(int size)
+{
+    if (mMapStart)
+    {
+        if (size < 0 || mMapEnd - mMapPos < size)
+            fail("Read error");
+
+        Misc::SString view(mMapPos, size);
+        mMapPos += size;
+        return view;
+    }
+
+    // Zero terminated, like mBuffer in getString()
+    if (mViewBuffer.size() <= static_cast<size_t> (size))
+        mViewBuffer.resize(size+1);
+
+    mViewBuffer[size] = 0;
+    getExact(&mViewBuffer[0], size);
+    return Misc::SString(&mViewBuffer[0], size);
+}
+
 // Get the next subrecord name and check if it matches the parameter
 void ESMReader::getSubNameIs(const char* name)
 {
@@ -177,7 +284,7 @@ void ESMReader::getSubName()
     }
 
     // reading the subrecord data anyway.
-    mEsm->read(mCtx.subName.name, 4);
+    read(mCtx.subName.name, 4);
     mCtx.leftRec -= 4;
 }
 
@@ -185,7 +292,7 @@ bool ESMReader::isEmptyOrGetName()
 {
     if (mCtx.leftRec)
     {
-        mEsm->read(mCtx.subName.name, 4);
+        read(mCtx.subName.name, 4);
         mCtx.leftRec -= 4;
         return false;
     }
@@ -280,15 +387,55 @@ void ESMReader::getRecHeader(uint32_t &flags)
  *
  *************************************************************************/
 
+size_t ESMReader::read(void *x, size_t size)
+{
+    if (!mMapStart)
+        return mEsm->read(x, size);
+
+    size_t left = mMapEnd - mMapPos;
+    if (size > left)
+        size = left;
+
+    std::memcpy(x, mMapPos, size);
+    mMapPos += size;
+    return size;
+}
+
+size_t ESMReader::tell()
+{
+    return mMapStart ? mMapPos - mMapStart : mEsm->tell();
+}
+
+void ESMReader::seek(size_t pos)
+{
+    if (!mMapStart)
+    {
+        mEsm->seek(pos);
+        return;
+    }
+
+    // Clamp like Ogre's streams do
+    mMapPos = mMapStart + std::min(pos, static_cast<size_t> (mMapEnd - mMapStart));
+}
+
 void ESMReader::getExact(void*x, int size)
 {
-    int t = mEsm->read(x, size);
+    int t = read(x, size);
     if (t != size)
         fail("Read error");
 }
 
 std::string ESMReader::getString(int size)
 {
+    // Strings stored with a zero terminator can be converted in place,
+    // without copying them into mBuffer first.
+    if (mMapStart && size > 0 && mMapEnd - mMapPos >= size && mMapPos[size-1] == 0)
+    {
+        const char *ptr = mMapPos;
+        mMapPos += size;
+        return mEncoder->getUtf8(ptr, size-1);
+    }
+
     size_t s = size;
     if (mBuffer.size() <= s)
         // Add some extra padding to reduce the chance of having to resize
@@ -316,8 +463,8 @@ void ESMReader::fail(const std::string &msg)
     ss << "\n  File: " << mCtx.filename;
     ss << "\n  Record: " << mCtx.recName.toString();
     ss << "\n  Subrecord: " << mCtx.subName.toString();
-    if (!mEsm.isNull())
-        ss << "\n  Offset: 0x" << hex << mEsm->tell();
+    if (!mEsm.isNull() || mMapStart)
+        ss << "\n  Offset: 0x" << hex << tell();
     throw std::runtime_error(ss.str());
 }
 
@@ -9,13 +9,18 @@
 
 #include <OgreDataStream.h>
 
+#include <boost/shared_ptr.hpp>
+
 #include <components/misc/stringops.hpp>
+#include <components/misc/slice_array.hpp>
 
 #include <components/to_utf8/to_utf8.hpp>
 
 #include "esmcommon.hpp"
 #include "loadtes3.hpp"
 
+class MappedFile;
+
 namespace ESM {
 
 class ESMReader
@@ -70,10 +75,19 @@ public:
 
   void openRaw(const std::string &file);
 
+  /// Memory map files opened by name instead of streaming them. Takes effect
+  /// on the next open() or openRaw() call. Off by default.
+  ///
+  /// In this mode subrecord data is read straight out of the mapping and the
+  /// view accessors (getHView() and friends) hand out pointers into it
+  /// without copying.
+  void setMemoryMapped(bool enable) { mUseMemoryMap = enable; }
+  bool isMemoryMapped() const { return mMapStart != NULL; }
+
   /// Get the file size. Make sure that the file has been opened!
-  size_t getFileSize() { return mEsm->size(); }
+  size_t getFileSize() { return mMapStart ? mMapEnd - mMapStart : mEsm->size(); }
   /// Get the current position in the file. Make sure that the file has been opened!
-  size_t getFileOffset() { return mEsm->tell(); }
+  size_t getFileOffset() { return tell(); }
 
   // This is a quick hack for multiple esm/esp files. Each plugin introduces its own
   //  terrain palette, but ESMReader does not pass a reference to the correct plugin
@@ -162,6 +176,37 @@ public:
   // Read the given number of bytes from a named subrecord
   void getHNExact(void*p, int size, const char* name);
 
+  /*************************************************************************
+   *
+   *  View based reading. These return the raw subrecord data without
+   *  copying it into a std::string. In memory mapped mode the view points
+   *  into the mapping and stays valid until the file is closed. In stream
+   *  mode it points into an internal buffer that is overwritten by the next
+   *  view request.
+   *
+   *************************************************************************/
+
+  // Read the header of the current sub-record and get its data
+  Misc::SString getHView();
+
+  // Get the data of a sub-record with the given name
+  Misc::SString getHNView(const char* name);
+
+  // Optional version of getHNView. Returns an empty view if the next
+  // sub-record has a different name.
+  Misc::SString getHNOView(const char* name);
+
+  // Same as getHView(), but with trailing zero terminators removed.
+  // The string is NOT converted to UTF8.
+  Misc::SString getHStringView();
+
+  // Optional version of getHStringView() for a sub-record with the
+  // given name
+  Misc::SString getHNOStringView(const char* name);
+
+  // Get a view of the next 'size' bytes
+  Misc::SString getView(int size);
+
   /*************************************************************************
    *
    *  Low level sub-record methods
@@ -245,8 +290,8 @@ public:
   // them from native encoding to UTF8 in the process.
   std::string getString(int size);
 
-  void skip(int bytes) { mEsm->seek(mEsm->tell()+bytes); }
-  uint64_t getOffset() { return mEsm->tell(); }
+  void skip(int bytes) { seek(tell()+bytes); }
+  uint64_t getOffset() { return tell(); }
 
   /// Used for error handling
   void fail(const std::string &msg);
@@ -254,12 +299,29 @@ public:
   /// Sets font encoder for ESM strings
   void setEncoder(ToUTF8::Utf8Encoder* encoder);
 
+  ToUTF8::Utf8Encoder* getEncoder() const { return mEncoder; }
+
   /// Get record flags of last record
   unsigned int getRecordFlags() { return mRecordFlags; }
 
 private:
+  // Raw access to whichever backend is active
+  size_t read(void *x, size_t size);
+  size_t tell();
+  void seek(size_t pos);
+
+  void openMapped(const std::string &file);
+
   Ogre::DataStreamPtr mEsm;
 
+  // Memory mapped backend. Shared so that copies of the reader (see
+  // setGlobalReaderList) can keep using the same mapping.
+  boost::shared_ptr<MappedFile> mMappedFile;
+  const char *mMapStart;
+  const char *mMapPos;
+  const char *mMapEnd;
+  bool mUseMemoryMap;
+
   ESM_Context mCtx;
 
   unsigned int mRecordFlags;
@@ -269,6 +331,9 @@ private:
   // Buffer for ESM strings
   std::vector<char> mBuffer;
 
+  // Buffer backing views in stream mode
+  std::vector<char> mViewBuffer;
+
   Header mHeader;
 
   std::vector<ESMReader> *mGlobalReaderList;
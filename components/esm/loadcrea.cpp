@@ -10,7 +10,8 @@ namespace ESM {
 
 void Creature::load(ESMReader &esm)
 {
-    mPersistent = esm.getRecordFlags() & 0x0400;
+    mRecordFlags = esm.getRecordFlags();
+    mPersistent = mRecordFlags & 0x0400;
 
     mModel = esm.getHNString("MODL");
     mOriginal = esm.getHNOString("CNAM");
@@ -70,6 +71,8 @@ void Creature::save(ESMWriter &esm) const
         for (int i=0; i<6; ++i) mData.mAttack[i] = 0;
         mData.mGold = 0;
         mFlags = 0;
+        mRecordFlags = 0;
+        mPersistent = false;
         mScale = 0;
         mModel.clear();
         mName.clear();
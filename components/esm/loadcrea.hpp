@@ -73,6 +73,7 @@ struct Creature
     int mFlags;
 
     bool mPersistent;
+    unsigned int mRecordFlags; ///< Record header flags, as read by load()
 
     float mScale;
 
@@ -12,7 +12,8 @@ void NPC::load(ESMReader &esm)
 {
     //mNpdt52.mGold = -10;
 
-    mPersistent = esm.getRecordFlags() & 0x0400;
+    mRecordFlags = esm.getRecordFlags();
+    mPersistent = mRecordFlags & 0x0400;
 
     mModel = esm.getHNOString("MODL");
     mName = esm.getHNOString("FNAM");
@@ -131,6 +132,8 @@ void NPC::save(ESMWriter &esm) const
         mNpdt12.mUnknown3 = 0;
         mNpdt12.mGold = 0;
         mFlags = 0;
+        mRecordFlags = 0;
+        mPersistent = false;
         mInventory.mList.clear();
         mSpells.mList.clear();
         mAiData.blank();
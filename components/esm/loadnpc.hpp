@@ -110,6 +110,7 @@ struct NPC
     int mFlags;
 
     bool mPersistent;
+    unsigned int mRecordFlags; ///< Record header flags, as read by load()
 
     InventoryList mInventory;
     SpellList mSpells;
@@ -0,0 +1,228 @@
+#include "mappedfile.hpp"
+
+#include <stdexcept>
+#include <sstream>
+#include <cassert>
+
+#if FILE_API == FILE_API_POSIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#if FILE_API != FILE_API_STDIO
+namespace
+{
+	void throwOpenError (char const * filename)
+	{
+		std::ostringstream os;
+		os << "Failed to open '" << filename << "' for reading.";
+		throw std::runtime_error (os.str ());
+	}
+}
+#endif
+
+#if FILE_API == FILE_API_STDIO
+/*
+ *
+ *	Implementation of MappedFile methods using c stdio
+ *
+ */
+
+MappedFile::MappedFile ()
+	: mData (NULL), mSize (0), mOpen (false)
+{
+}
+
+MappedFile::~MappedFile ()
+{
+}
+
+void MappedFile::open (char const * filename)
+{
+	assert (!mOpen);
+
+	LowLevelFile file;
+	file.open (filename);
+
+	mBuffer.resize (file.size ());
+
+	if (!mBuffer.empty () && file.read (&mBuffer[0], mBuffer.size ()) != mBuffer.size ())
+		throw std::runtime_error ("A read operation on a file failed.");
+
+	mData = mBuffer.empty () ? NULL : &mBuffer[0];
+	mSize = mBuffer.size ();
+	mOpen = true;
+}
+
+void MappedFile::close ()
+{
+	assert (mOpen);
+
+	std::vector<char> ().swap (mBuffer);
+
+	mData = NULL;
+	mSize = 0;
+	mOpen = false;
+}
+
+#elif FILE_API == FILE_API_POSIX
+/*
+ *
+ *	Implementation of MappedFile methods using posix mmap
+ *
+ */
+
+MappedFile::MappedFile ()
+	: mData (NULL), mSize (0), mOpen (false), mMapping (MAP_FAILED)
+{
+}
+
+MappedFile::~MappedFile ()
+{
+	if (mMapping != MAP_FAILED)
+		::munmap (mMapping, mSize);
+}
+
+void MappedFile::open (char const * filename)
+{
+	assert (!mOpen);
+
+	int handle = ::open (filename, O_RDONLY, 0);
+
+	if (handle == -1)
+		throwOpenError (filename);
+
+	struct stat info;
+
+	if (::fstat (handle, &info) == -1)
+	{
+		::close (handle);
+		throw std::runtime_error ("A query operation on a file failed.");
+	}
+
+	mSize = info.st_size;
+
+	// mmap refuses zero length mappings
+	if (mSize > 0)
+	{
+		mMapping = ::mmap (NULL, mSize, PROT_READ, MAP_PRIVATE, handle, 0);
+
+		if (mMapping == MAP_FAILED)
+		{
+			::close (handle);
+			mSize = 0;
+			throwOpenError (filename);
+		}
+
+		// Content files are parsed front to back
+		::madvise (mMapping, mSize, MADV_SEQUENTIAL);
+
+		mData = static_cast<char const *> (mMapping);
+	}
+
+	// The mapping keeps its own reference to the file
+	::close (handle);
+
+	mOpen = true;
+}
+
+void MappedFile::close ()
+{
+	assert (mOpen);
+
+	if (mMapping != MAP_FAILED)
+		::munmap (mMapping, mSize);
+
+	mMapping = MAP_FAILED;
+	mData = NULL;
+	mSize = 0;
+	mOpen = false;
+}
+
+#elif FILE_API == FILE_API_WIN32
+/*
+ *
+ *	Implementation of MappedFile methods using Win32 file mappings
+ *
+ */
+
+MappedFile::MappedFile ()
+	: mData (NULL), mSize (0), mOpen (false), mHandle (INVALID_HANDLE_VALUE), mMapping (NULL)
+{
+}
+
+MappedFile::~MappedFile ()
+{
+	if (mOpen)
+		close ();
+}
+
+void MappedFile::open (char const * filename)
+{
+	assert (!mOpen);
+
+	mHandle = CreateFileA (filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+	if (mHandle == INVALID_HANDLE_VALUE)
+		throwOpenError (filename);
+
+	BY_HANDLE_FILE_INFORMATION info;
+
+	if (!GetFileInformationByHandle (mHandle, &info))
+	{
+		close ();
+		throw std::runtime_error ("A query operation on a file failed.");
+	}
+
+	if (info.nFileSizeHigh != 0)
+	{
+		close ();
+		throw std::runtime_error ("Files greater that 4GB are not supported.");
+	}
+
+	mSize = info.nFileSizeLow;
+	mOpen = true;
+
+	// CreateFileMapping refuses zero length mappings
+	if (mSize > 0)
+	{
+		mMapping = CreateFileMappingA (mHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (mMapping == NULL)
+		{
+			close ();
+			throwOpenError (filename);
+		}
+
+		mData = static_cast<char const *> (MapViewOfFile (mMapping, FILE_MAP_READ, 0, 0, 0));
+
+		if (mData == NULL)
+		{
+			close ();
+			throwOpenError (filename);
+		}
+	}
+}
+
+void MappedFile::close ()
+{
+	if (mData != NULL)
+		UnmapViewOfFile (mData);
+
+	if (mMapping != NULL)
+		CloseHandle (mMapping);
+
+	if (mHandle != INVALID_HANDLE_VALUE)
+		CloseHandle (mHandle);
+
+	mHandle = INVALID_HANDLE_VALUE;
+	mMapping = NULL;
+	mData = NULL;
+	mSize = 0;
+	mOpen = false;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef COMPONENTS_FILES_MAPPEDFILE_HPP
+#define COMPONENTS_FILES_MAPPEDFILE_HPP
+
+#include "lowlevelfile.hpp"
+
+#if FILE_API == FILE_API_STDIO
+#include <vector>
+#endif
+
+/// Read-only view of a whole file in memory.
+///
+/// On platforms with a native file API the file is memory mapped, so pages are
+/// only faulted in when they are touched. Elsewhere the file is read into a
+/// buffer in one go.
+class MappedFile
+{
+public:
+
+	MappedFile ();
+	~MappedFile ();
+
+	void open (char const * filename);
+	void close ();
+
+	bool isOpen () const { return mOpen; }
+
+	char const * data () const { return mData; }
+	size_t size () const { return mSize; }
+
+private:
+
+	MappedFile (MappedFile const &);
+	MappedFile & operator= (MappedFile const &);
+
+	char const * mData;
+	size_t mSize;
+	bool mOpen;
+
+#if FILE_API == FILE_API_STDIO
+	std::vector<char> mBuffer;
+#elif FILE_API == FILE_API_POSIX
+	void * mMapping;
+#elif FILE_API == FILE_API_WIN32
+	HANDLE mHandle;
+	HANDLE mMapping;
+#endif
+};
+
+#endif
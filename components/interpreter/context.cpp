@@ -0,0 +1,96 @@
+
+#include "context.hpp"
+
+#include <stdexcept>
+
+namespace
+{
+    void throwNoSlots()
+    {
+        throw std::logic_error ("context does not support variable slots");
+    }
+}
+
+namespace Interpreter
+{
+    int Context::getGlobalSlot (const std::string& name) const
+    {
+        return -1;
+    }
+
+    int Context::getGlobalShort (int slot) const
+    {
+        throwNoSlots();
+        return 0;
+    }
+
+    int Context::getGlobalLong (int slot) const
+    {
+        throwNoSlots();
+        return 0;
+    }
+
+    float Context::getGlobalFloat (int slot) const
+    {
+        throwNoSlots();
+        return 0;
+    }
+
+    void Context::setGlobalShort (int slot, int value)
+    {
+        throwNoSlots();
+    }
+
+    void Context::setGlobalLong (int slot, int value)
+    {
+        throwNoSlots();
+    }
+
+    void Context::setGlobalFloat (int slot, float value)
+    {
+        throwNoSlots();
+    }
+
+    int Context::getMemberSlot (const std::string& id, const std::string& name, char type) const
+    {
+        return -1;
+    }
+
+    int Context::getMemberShort (const std::string& id, int slot) const
+    {
+        throwNoSlots();
+        return 0;
+    }
+
+    int Context::getMemberLong (const std::string& id, int slot) const
+    {
+        throwNoSlots();
+        return 0;
+    }
+
+    float Context::getMemberFloat (const std::string& id, int slot) const
+    {
+        throwNoSlots();
+        return 0;
+    }
+
+    void Context::setMemberShort (const std::string& id, int slot, int value)
+    {
+        throwNoSlots();
+    }
+
+    void Context::setMemberLong (const std::string& id, int slot, int value)
+    {
+        throwNoSlots();
+    }
+
+    void Context::setMemberFloat (const std::string& id, int slot, float value)
+    {
+        throwNoSlots();
+    }
+
+    std::string Context::getReferenceId() const
+    {
+        return "";
+    }
+}
@@ -49,6 +49,22 @@ namespace Interpreter
 
             virtual void setGlobalFloat (const std::string& name, float value) = 0;
 
+            virtual int getGlobalSlot (const std::string& name) const;
+            ///< Return a slot, through which the global variable \a name can be accessed instead of
+            /// by its name, or -1. A slot must stay valid as long as the variable exists.
+
+            virtual int getGlobalShort (int slot) const;
+
+            virtual int getGlobalLong (int slot) const;
+
+            virtual float getGlobalFloat (int slot) const;
+
+            virtual void setGlobalShort (int slot, int value);
+
+            virtual void setGlobalLong (int slot, int value);
+
+            virtual void setGlobalFloat (int slot, float value);
+
             virtual std::vector<std::string> getGlobals () const = 0;
             
             virtual char getGlobalType (const std::string& name) const = 0;
@@ -108,6 +124,25 @@ namespace Interpreter
 
             virtual void setMemberFloat (const std::string& id, const std::string& name, float value)
                 = 0;
+
+            virtual int getMemberSlot (const std::string& id, const std::string& name, char type) const;
+            ///< Return a slot, through which the member variable \a name of type \a type can be
+            /// accessed for every reference with the ID \a id instead of by its name, or -1.
+
+            virtual int getMemberShort (const std::string& id, int slot) const;
+
+            virtual int getMemberLong (const std::string& id, int slot) const;
+
+            virtual float getMemberFloat (const std::string& id, int slot) const;
+
+            virtual void setMemberShort (const std::string& id, int slot, int value);
+
+            virtual void setMemberLong (const std::string& id, int slot, int value);
+
+            virtual void setMemberFloat (const std::string& id, int slot, float value);
+
+            virtual std::string getReferenceId() const;
+            ///< Return the ID of the reference the script is running from or an empty string.
     };
 }
 
@@ -111,5 +111,20 @@ namespace Interpreter
         // spacial
         interpreter.installSegment5 (49, new OpGetDistance);
         interpreter.installSegment5 (57, new OpGetDistanceExplicit);
+
+        // instructions that only read the state of the game or access local variables
+        interpreter.declareDeferrable (0, 0);
+        interpreter.declareDeferrable (0, 1);
+        interpreter.declareDeferrable (0, 2);
+
+        const int deferrable[] =
+        {
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,
+            24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 42, 43, 44, 45, 46, 49, 50,
+            53, 56, 57, 62, 63, 64
+        };
+
+        for (std::size_t i=0; i<sizeof (deferrable) / sizeof (deferrable[0]); ++i)
+            interpreter.declareDeferrable (5, deferrable[i]);
     }
 }
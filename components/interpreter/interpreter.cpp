@@ -7,60 +7,67 @@
 #include <stdexcept>
 
 #include "opcodes.hpp"
+#include "profiler.hpp"
 
 namespace Interpreter
 {
-    void Interpreter::execute (Type_Code code)
+    Program::Program() : mCode (0), mCodeSize (0), mDeferrable (false) {}
+
+    bool Program::empty() const
+    {
+        return mInstructions.empty();
+    }
+
+    void Program::clear()
+    {
+        mInstructions.clear();
+        mCode = 0;
+        mCodeSize = 0;
+        mLinkage.clear();
+        mDeferrable = false;
+    }
+
+    bool Program::isDeferrable() const
+    {
+        return mDeferrable;
+    }
+
+    void Interpreter::decodeInstruction (Type_Code code, Program::Instruction& instruction) const
     {
+        instruction.mType = Program::Type_Unknown;
+        instruction.mOpcode0 = 0;
+        instruction.mArg0 = 0;
+        instruction.mArg1 = 0;
+        instruction.mCode = code;
+
         unsigned int segSpec = code>>30;
 
         switch (segSpec)
         {
             case 0:
-            {
-                int opcode = code>>24;
-                unsigned int arg0 = code & 0xffffff;
-
-                std::map<int, Opcode1 *>::iterator iter = mSegment0.find (opcode);
 
-                if (iter==mSegment0.end())
-                    abortUnknownCode (0, opcode);
-
-                iter->second->execute (mRuntime, arg0);
+                if ((instruction.mOpcode1 = mSegment0.get (code>>24)))
+                    instruction.mType = Program::Type_1;
 
+                instruction.mArg0 = code & 0xffffff;
                 return;
-            }
 
             case 1:
-            {
-                int opcode = (code>>24) & 0x3f;
-                unsigned int arg0 = (code>>16) & 0xfff;
-                unsigned int arg1 = code & 0xfff;
-
-                std::map<int, Opcode2 *>::iterator iter = mSegment1.find (opcode);
-
-                if (iter==mSegment1.end())
-                    abortUnknownCode (1, opcode);
 
-                iter->second->execute (mRuntime, arg0, arg1);
+                if ((instruction.mOpcode2 = mSegment1.get ((code>>24) & 0x3f)))
+                    instruction.mType = Program::Type_2;
 
+                instruction.mArg0 = (code>>16) & 0xfff;
+                instruction.mArg1 = code & 0xfff;
                 return;
-            }
 
             case 2:
-            {
-                int opcode = (code>>20) & 0x3ff;
-                unsigned int arg0 = code & 0xfffff;
 
-                std::map<int, Opcode1 *>::iterator iter = mSegment2.find (opcode);
-
-                if (iter==mSegment2.end())
-                    abortUnknownCode (2, opcode);
-
-                iter->second->execute (mRuntime, arg0);
+                if ((instruction.mOpcode1 = mSegment2.get ((code>>20) & 0x3ff)))
+                    instruction.mType = Program::Type_1;
 
+                instruction.mArg0 = code & 0xfffff;
                 return;
-            }
         }
 
         segSpec = code>>26;
@@ -68,52 +75,29 @@ namespace Interpreter
         switch (segSpec)
         {
             case 0x30:
-            {
-                int opcode = (code>>8) & 0x3ffff;
-                unsigned int arg0 = code & 0xff;
-
-                std::map<int, Opcode1 *>::iterator iter = mSegment3.find (opcode);
 
-                if (iter==mSegment3.end())
-                    abortUnknownCode (3, opcode);
-
-                iter->second->execute (mRuntime, arg0);
+                if ((instruction.mOpcode1 = mSegment3.get ((code>>8) & 0x3ffff)))
+                    instruction.mType = Program::Type_1;
 
+                instruction.mArg0 = code & 0xff;
                 return;
-            }
 
             case 0x31:
-            {
-                int opcode = (code>>16) & 0x3ff;
-                unsigned int arg0 = (code>>8) & 0xff;
-                unsigned int arg1 = code & 0xff;
-
-                std::map<int, Opcode2 *>::iterator iter = mSegment4.find (opcode);
-
-                if (iter==mSegment4.end())
-                    abortUnknownCode (4, opcode);
 
-                iter->second->execute (mRuntime, arg0, arg1);
+                if ((instruction.mOpcode2 = mSegment4.get ((code>>16) & 0x3ff)))
+                    instruction.mType = Program::Type_2;
 
+                instruction.mArg0 = (code>>8) & 0xff;
+                instruction.mArg1 = code & 0xff;
                 return;
-            }
 
             case 0x32:
-            {
-                int opcode = code & 0x3ffffff;
 
-                std::map<int, Opcode0 *>::iterator iter = mSegment5.find (opcode);
-
-                if (iter==mSegment5.end())
-                    abortUnknownCode (5, opcode);
-
-                iter->second->execute (mRuntime);
+                if ((instruction.mOpcode0 = mSegment5.get (code & 0x3ffffff)))
+                    instruction.mType = Program::Type_0;
 
                 return;
-            }
         }
-
-        abortUnknownSegment (code);
     }
 
     void Interpreter::abortUnknownCode (int segment, int opcode)
@@ -134,83 +118,184 @@ namespace Interpreter
         throw std::runtime_error (error.str());
     }
 
-    Interpreter::Interpreter()
-    {}
-
-    Interpreter::~Interpreter()
+    void Interpreter::abortUnknownInstruction (Type_Code code)
     {
-        for (std::map<int, Opcode1 *>::iterator iter (mSegment0.begin());
-            iter!=mSegment0.end(); ++iter)
-            delete iter->second;
-
-        for (std::map<int, Opcode2 *>::iterator iter (mSegment1.begin());
-            iter!=mSegment1.end(); ++iter)
-            delete iter->second;
+        unsigned int segSpec = code>>30;
 
-        for (std::map<int, Opcode1 *>::iterator iter (mSegment2.begin());
-            iter!=mSegment2.end(); ++iter)
-            delete iter->second;
+        switch (segSpec)
+        {
+            case 0: abortUnknownCode (0, code>>24); return;
+            case 1: abortUnknownCode (1, (code>>24) & 0x3f); return;
+            case 2: abortUnknownCode (2, (code>>20) & 0x3ff); return;
+        }
 
-        for (std::map<int, Opcode1 *>::iterator iter (mSegment3.begin());
-            iter!=mSegment3.end(); ++iter)
-            delete iter->second;
+        segSpec = code>>26;
 
-        for (std::map<int, Opcode2 *>::iterator iter (mSegment4.begin());
-            iter!=mSegment4.end(); ++iter)
-            delete iter->second;
+        switch (segSpec)
+        {
+            case 0x30: abortUnknownCode (3, (code>>8) & 0x3ffff); return;
+            case 0x31: abortUnknownCode (4, (code>>16) & 0x3ff); return;
+            case 0x32: abortUnknownCode (5, code & 0x3ffffff); return;
+        }
 
-        for (std::map<int, Opcode0 *>::iterator iter (mSegment5.begin());
-            iter!=mSegment5.end(); ++iter)
-            delete iter->second;
+        abortUnknownSegment (code);
     }
 
+    Interpreter::Interpreter()
+    : mSegment0 (32), mSegment1 (32), mSegment2 (512), mSegment3 (131072), mSegment4 (512),
+      mSegment5 (33554432), mProfiler (0)
+    {}
+
+    Interpreter::~Interpreter() {}
+
     void Interpreter::installSegment0 (int code, Opcode1 *opcode)
     {
-        mSegment0.insert (std::make_pair (code, opcode));
+        mSegment0.install (code, opcode);
     }
 
     void Interpreter::installSegment1 (int code, Opcode2 *opcode)
     {
-        mSegment1.insert (std::make_pair (code, opcode));
+        mSegment1.install (code, opcode);
     }
 
     void Interpreter::installSegment2 (int code, Opcode1 *opcode)
     {
-        mSegment2.insert (std::make_pair (code, opcode));
+        mSegment2.install (code, opcode);
     }
 
     void Interpreter::installSegment3 (int code, Opcode1 *opcode)
     {
-        mSegment3.insert (std::make_pair (code, opcode));
+        mSegment3.install (code, opcode);
     }
 
     void Interpreter::installSegment4 (int code, Opcode2 *opcode)
     {
-        mSegment4.insert (std::make_pair (code, opcode));
+        mSegment4.install (code, opcode);
     }
 
     void Interpreter::installSegment5 (int code, Opcode0 *opcode)
     {
-        mSegment5.insert (std::make_pair (code, opcode));
+        mSegment5.install (code, opcode);
     }
 
-    void Interpreter::run (const Type_Code *code, int codeSize, Context& context)
+    void Interpreter::declareDeferrable (int segment, int code)
     {
-        assert (codeSize>=4);
+        mDeferrable.insert (std::make_pair (segment, code));
+    }
 
-        mRuntime.configure (code, codeSize, context);
+    void Interpreter::decode (const Type_Code *code, int codeSize, Program& program) const
+    {
+        assert (codeSize>=4);
 
         int opcodes = static_cast<int> (code[0]);
 
         const Type_Code *codeBlock = code + 4;
 
-        while (mRuntime.getPC()>=0 && mRuntime.getPC()<opcodes)
+        program.mInstructions.resize (opcodes);
+
+        program.mDeferrable = true;
+
+        for (int i=0; i<opcodes; ++i)
+        {
+            decodeInstruction (codeBlock[i], program.mInstructions[i]);
+
+            if (program.mDeferrable &&
+                !mDeferrable.count (Profiler::getOpcode (codeBlock[i])))
+                program.mDeferrable = false;
+        }
+
+        program.mCode = code;
+        program.mCodeSize = codeSize;
+        program.mLinkage.clear();
+    }
+
+    inline void Interpreter::execute (const Program::Instruction& instruction)
+    {
+        switch (instruction.mType)
+        {
+            case Program::Type_0:
+
+                instruction.mOpcode0->execute (mRuntime);
+                break;
+
+            case Program::Type_1:
+
+                instruction.mOpcode1->execute (mRuntime, instruction.mArg0);
+                break;
+
+            case Program::Type_2:
+
+                instruction.mOpcode2->execute (mRuntime, instruction.mArg0, instruction.mArg1);
+                break;
+
+            case Program::Type_Unknown:
+
+                abortUnknownInstruction (instruction.mCode);
+        }
+    }
+
+    void Interpreter::runProfiled (const Program& program, Context& context)
+    {
+        // ToggleScriptProfiler may change mProfiler while the script is running
+        Profiler *profiler = mProfiler;
+
+        mRuntime.configure (program.mCode, program.mCodeSize, context, &program.mLinkage);
+
+        int size = static_cast<int> (program.mInstructions.size());
+        unsigned long instructions = 0;
+        double start = Profiler::getTime();
+
+        while (mRuntime.getPC()>=0 && mRuntime.getPC()<size)
+        {
+            const Program::Instruction& instruction = program.mInstructions[mRuntime.getPC()];
+            mRuntime.setPC (mRuntime.getPC()+1);
+
+            double instructionStart = Profiler::getTime();
+            execute (instruction);
+            profiler->addInstruction (instruction.mCode, Profiler::getTime()-instructionStart);
+            ++instructions;
+        }
+
+        profiler->addRun (Profiler::getTime()-start, instructions);
+
+        mRuntime.clear();
+    }
+
+    void Interpreter::run (const Program& program, Context& context)
+    {
+        if (mProfiler)
+        {
+            runProfiled (program, context);
+            return;
+        }
+
+        mRuntime.configure (program.mCode, program.mCodeSize, context, &program.mLinkage);
+
+        int size = static_cast<int> (program.mInstructions.size());
+
+        while (mRuntime.getPC()>=0 && mRuntime.getPC()<size)
         {
-            Type_Code code = codeBlock[mRuntime.getPC()];
+            const Program::Instruction& instruction = program.mInstructions[mRuntime.getPC()];
             mRuntime.setPC (mRuntime.getPC()+1);
-            execute (code);
+            execute (instruction);
         }
 
         mRuntime.clear();
     }
+
+    void Interpreter::setProfiler (Profiler *profiler)
+    {
+        mProfiler = profiler;
+    }
+
+    Profiler *Interpreter::getProfiler() const
+    {
+        return mProfiler;
+    }
+
+    void Interpreter::run (const Type_Code *code, int codeSize, Context& context)
+    {
+        decode (code, codeSize, mScratch);
+        run (mScratch, context);
+    }
 }
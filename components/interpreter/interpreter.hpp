@@ -1,7 +1,8 @@
 #ifndef INTERPRETER_INTERPRETER_H_INCLUDED
 #define INTERPRETER_INTERPRETER_H_INCLUDED
 
-#include <map>
+#include <set>
+#include <vector>
 
 #include "runtime.hpp"
 #include "types.hpp"
@@ -11,27 +12,149 @@ namespace Interpreter
     class Opcode0;
     class Opcode1;
     class Opcode2;
+    class Profiler;
+
+    /// \brief Opcodes of one segment, indexed by their code
+    ///
+    /// The lower half of a segment's code space and the upper half, which is reserved for
+    /// extensions, are stored in separate arrays, so that both of them stay dense.
+    template<typename T>
+    class OpcodeTable
+    {
+            std::vector<T *> mCore;
+            std::vector<T *> mExtensions;
+            unsigned int mExtensionBase;
+
+            // not implemented
+            OpcodeTable (const OpcodeTable&);
+            OpcodeTable& operator= (const OpcodeTable&);
+
+        public:
+
+            explicit OpcodeTable (unsigned int extensionBase) : mExtensionBase (extensionBase) {}
+
+            ~OpcodeTable()
+            {
+                for (typename std::vector<T *>::iterator iter (mCore.begin()); iter!=mCore.end(); ++iter)
+                    delete *iter;
+
+                for (typename std::vector<T *>::iterator iter (mExtensions.begin());
+                    iter!=mExtensions.end(); ++iter)
+                    delete *iter;
+            }
+
+            /// \return Was \a opcode installed? If not, there already is an opcode for \a code
+            /// and \a opcode is deleted.
+            bool install (unsigned int code, T *opcode)
+            {
+                std::vector<T *>& table = code<mExtensionBase ? mCore : mExtensions;
+                unsigned int index = code<mExtensionBase ? code : code-mExtensionBase;
+
+                if (index>=table.size())
+                    table.resize (index+1, 0);
+
+                if (table[index])
+                {
+                    delete opcode;
+                    return false;
+                }
+
+                table[index] = opcode;
+                return true;
+            }
+
+            /// \return 0 if there is no opcode for \a code
+            T *get (unsigned int code) const
+            {
+                if (code<mExtensionBase)
+                    return code<mCore.size() ? mCore[code] : 0;
+
+                code -= mExtensionBase;
+                return code<mExtensions.size() ? mExtensions[code] : 0;
+            }
+    };
+
+    /// \brief A compiled script with its code words decoded for one Interpreter
+    ///
+    /// Every instruction holds the opcode it resolves to and its unpacked arguments, so
+    /// that running the script doesn't have to look anything up. Variables, that are accessed
+    /// by name, are bound to slots when the program is run for the first time.
+    class Program
+    {
+            enum Type
+            {
+                Type_Unknown, ///< no opcode installed; raises an error when executed
+                Type_0,
+                Type_1,
+                Type_2
+            };
+
+            struct Instruction
+            {
+                Type mType;
+
+                union
+                {
+                    Opcode0 *mOpcode0;
+                    Opcode1 *mOpcode1;
+                    Opcode2 *mOpcode2;
+                };
+
+                unsigned int mArg0;
+                unsigned int mArg1;
+                Type_Code mCode;
+            };
+
+            std::vector<Instruction> mInstructions;
+            const Type_Code *mCode;
+            int mCodeSize;
+            mutable Linkage mLinkage;
+            bool mDeferrable;
+
+            friend class Interpreter;
+
+        public:
+
+            Program();
+
+            bool empty() const;
+
+            void clear();
+
+            bool isDeferrable() const;
+            ///< Does the program consist of instructions only, that have been declared deferrable
+            /// (see Interpreter::declareDeferrable)?
+    };
 
     class Interpreter
     {
             Runtime mRuntime;
-            std::map<int, Opcode1 *> mSegment0;
-            std::map<int, Opcode2 *> mSegment1;
-            std::map<int, Opcode1 *> mSegment2;
-            std::map<int, Opcode1 *> mSegment3;
-            std::map<int, Opcode2 *> mSegment4;
-            std::map<int, Opcode0 *> mSegment5;
+            OpcodeTable<Opcode1> mSegment0;
+            OpcodeTable<Opcode2> mSegment1;
+            OpcodeTable<Opcode1> mSegment2;
+            OpcodeTable<Opcode1> mSegment3;
+            OpcodeTable<Opcode2> mSegment4;
+            OpcodeTable<Opcode0> mSegment5;
+            Program mScratch; // used by the run function that takes code words
+            Profiler *mProfiler;
+            std::set<std::pair<int, int> > mDeferrable; // segment, opcode
 
             // not implemented
             Interpreter (const Interpreter&);
             Interpreter& operator= (const Interpreter&);
 
-            void execute (Type_Code code);
+            void decodeInstruction (Type_Code code, Program::Instruction& instruction) const;
+
+            void execute (const Program::Instruction& instruction);
+
+            void runProfiled (const Program& program, Context& context);
 
             void abortUnknownCode (int segment, int opcode);
 
             void abortUnknownSegment (Type_Code code);
 
+            void abortUnknownInstruction (Type_Code code);
+
         public:
 
             Interpreter();
@@ -56,7 +179,29 @@ namespace Interpreter
             void installSegment5 (int code, Opcode0 *opcode);
             ///< ownership of \a opcode is transferred to *this.
 
+            void declareDeferrable (int segment, int code);
+            ///< Declare that the instruction \a code of \a segment only changes local variables of
+            /// the script and doesn't change the state of the game. Scripts that consist of such
+            /// instructions only may be run later than requested.
+
+            void decode (const Type_Code *code, int codeSize, Program& program) const;
+            ///< Decode \a code for this interpreter. Unknown opcodes are only reported once they
+            /// are executed.
+            ///
+            /// \note \a code must exist as long as \a program is used and all opcodes have to be
+            /// installed before.
+
+            void run (const Program& program, Context& context);
+
+            void setProfiler (Profiler *profiler);
+            ///< Time all following runs with \a profiler (0: disable profiling). Ownership of
+            /// \a profiler is not transferred.
+
+            Profiler *getProfiler() const;
+
             void run (const Type_Code *code, int codeSize, Context& context);
+            ///< Decode and run \a code. Scripts that are run repeatedly should be decoded once
+            /// instead.
     };
 }
 
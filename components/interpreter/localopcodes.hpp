@@ -122,9 +122,12 @@ namespace Interpreter
                 Type_Integer data = runtime[0].mInteger;
                 int index = runtime[1].mInteger;
 
-                std::string name = runtime.getStringLiteral (index);
+                int slot = runtime.getGlobalSlot (index);
 
-                runtime.getContext().setGlobalShort (name, data);
+                if (slot!=-1)
+                    runtime.getContext().setGlobalShort (slot, data);
+                else
+                    runtime.getContext().setGlobalShort (runtime.getStringLiteral (index), data);
 
                 runtime.pop();
                 runtime.pop();
@@ -140,9 +143,12 @@ namespace Interpreter
                 Type_Integer data = runtime[0].mInteger;
                 int index = runtime[1].mInteger;
 
-                std::string name = runtime.getStringLiteral (index);
+                int slot = runtime.getGlobalSlot (index);
 
-                runtime.getContext().setGlobalLong (name, data);
+                if (slot!=-1)
+                    runtime.getContext().setGlobalLong (slot, data);
+                else
+                    runtime.getContext().setGlobalLong (runtime.getStringLiteral (index), data);
 
                 runtime.pop();
                 runtime.pop();
@@ -158,9 +164,12 @@ namespace Interpreter
                 Type_Float data = runtime[0].mFloat;
                 int index = runtime[1].mInteger;
 
-                std::string name = runtime.getStringLiteral (index);
+                int slot = runtime.getGlobalSlot (index);
 
-                runtime.getContext().setGlobalFloat (name, data);
+                if (slot!=-1)
+                    runtime.getContext().setGlobalFloat (slot, data);
+                else
+                    runtime.getContext().setGlobalFloat (runtime.getStringLiteral (index), data);
 
                 runtime.pop();
                 runtime.pop();
@@ -174,8 +183,9 @@ namespace Interpreter
             virtual void execute (Runtime& runtime)
             {
                 int index = runtime[0].mInteger;
-                std::string name = runtime.getStringLiteral (index);
-                Type_Integer value = runtime.getContext().getGlobalShort (name);
+                int slot = runtime.getGlobalSlot (index);
+                Type_Integer value = slot!=-1 ? runtime.getContext().getGlobalShort (slot) :
+                    runtime.getContext().getGlobalShort (runtime.getStringLiteral (index));
                 runtime[0].mInteger = value;
             }
     };
@@ -187,8 +197,9 @@ namespace Interpreter
             virtual void execute (Runtime& runtime)
             {
                 int index = runtime[0].mInteger;
-                std::string name = runtime.getStringLiteral (index);
-                Type_Integer value = runtime.getContext().getGlobalLong (name);
+                int slot = runtime.getGlobalSlot (index);
+                Type_Integer value = slot!=-1 ? runtime.getContext().getGlobalLong (slot) :
+                    runtime.getContext().getGlobalLong (runtime.getStringLiteral (index));
                 runtime[0].mInteger = value;
             }
     };
@@ -200,8 +211,9 @@ namespace Interpreter
             virtual void execute (Runtime& runtime)
             {
                 int index = runtime[0].mInteger;
-                std::string name = runtime.getStringLiteral (index);
-                Type_Float value = runtime.getContext().getGlobalFloat (name);
+                int slot = runtime.getGlobalSlot (index);
+                Type_Float value = slot!=-1 ? runtime.getContext().getGlobalFloat (slot) :
+                    runtime.getContext().getGlobalFloat (runtime.getStringLiteral (index));
                 runtime[0].mFloat = value;
             }
     };
@@ -215,10 +227,14 @@ namespace Interpreter
                 Type_Integer data = runtime[0].mInteger;
                 Type_Integer index = runtime[1].mInteger;
                 std::string id = runtime.getStringLiteral (index);
-                index = runtime[2].mInteger;
-                std::string variable = runtime.getStringLiteral (index);
+                Type_Integer variable = runtime[2].mInteger;
 
-                runtime.getContext().setMemberShort (id, variable, data);
+                int slot = runtime.getMemberSlot (index, variable, 's');
+
+                if (slot!=-1)
+                    runtime.getContext().setMemberShort (id, slot, data);
+                else
+                    runtime.getContext().setMemberShort (id, runtime.getStringLiteral (variable), data);
 
                 runtime.pop();
                 runtime.pop();
@@ -235,10 +251,14 @@ namespace Interpreter
                 Type_Integer data = runtime[0].mInteger;
                 Type_Integer index = runtime[1].mInteger;
                 std::string id = runtime.getStringLiteral (index);
-                index = runtime[2].mInteger;
-                std::string variable = runtime.getStringLiteral (index);
+                Type_Integer variable = runtime[2].mInteger;
+
+                int slot = runtime.getMemberSlot (index, variable, 'l');
 
-                runtime.getContext().setMemberLong (id, variable, data);
+                if (slot!=-1)
+                    runtime.getContext().setMemberLong (id, slot, data);
+                else
+                    runtime.getContext().setMemberLong (id, runtime.getStringLiteral (variable), data);
 
                 runtime.pop();
                 runtime.pop();
@@ -255,10 +275,14 @@ namespace Interpreter
                 Type_Float data = runtime[0].mFloat;
                 Type_Integer index = runtime[1].mInteger;
                 std::string id = runtime.getStringLiteral (index);
-                index = runtime[2].mInteger;
-                std::string variable = runtime.getStringLiteral (index);
+                Type_Integer variable = runtime[2].mInteger;
+
+                int slot = runtime.getMemberSlot (index, variable, 'f');
 
-                runtime.getContext().setMemberFloat (id, variable, data);
+                if (slot!=-1)
+                    runtime.getContext().setMemberFloat (id, slot, data);
+                else
+                    runtime.getContext().setMemberFloat (id, runtime.getStringLiteral (variable), data);
 
                 runtime.pop();
                 runtime.pop();
@@ -274,11 +298,13 @@ namespace Interpreter
             {
                 Type_Integer index = runtime[0].mInteger;
                 std::string id = runtime.getStringLiteral (index);
-                index = runtime[1].mInteger;
-                std::string variable = runtime.getStringLiteral (index);
+                Type_Integer variable = runtime[1].mInteger;
                 runtime.pop();
 
-                int value = runtime.getContext().getMemberShort (id, variable);
+                int slot = runtime.getMemberSlot (index, variable, 's');
+
+                int value = slot!=-1 ? runtime.getContext().getMemberShort (id, slot) :
+                    runtime.getContext().getMemberShort (id, runtime.getStringLiteral (variable));
                 runtime[0].mInteger = value;
             }
     };
@@ -291,11 +317,13 @@ namespace Interpreter
             {
                 Type_Integer index = runtime[0].mInteger;
                 std::string id = runtime.getStringLiteral (index);
-                index = runtime[1].mInteger;
-                std::string variable = runtime.getStringLiteral (index);
+                Type_Integer variable = runtime[1].mInteger;
                 runtime.pop();
 
-                int value = runtime.getContext().getMemberLong (id, variable);
+                int slot = runtime.getMemberSlot (index, variable, 'l');
+
+                int value = slot!=-1 ? runtime.getContext().getMemberLong (id, slot) :
+                    runtime.getContext().getMemberLong (id, runtime.getStringLiteral (variable));
                 runtime[0].mInteger = value;
             }
     };
@@ -308,11 +336,13 @@ namespace Interpreter
             {
                 Type_Integer index = runtime[0].mInteger;
                 std::string id = runtime.getStringLiteral (index);
-                index = runtime[1].mInteger;
-                std::string variable = runtime.getStringLiteral (index);
+                Type_Integer variable = runtime[1].mInteger;
                 runtime.pop();
 
-                float value = runtime.getContext().getMemberFloat (id, variable);
+                int slot = runtime.getMemberSlot (index, variable, 'f');
+
+                float value = slot!=-1 ? runtime.getContext().getMemberFloat (id, slot) :
+                    runtime.getContext().getMemberFloat (id, runtime.getStringLiteral (variable));
                 runtime[0].mFloat = value;
             }
     };
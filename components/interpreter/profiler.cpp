@@ -0,0 +1,308 @@
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined __APPLE__
+#include <sys/time.h>
+#else
+#include <time.h>
+#endif
+
+namespace
+{
+    template<typename Key>
+    bool compareTime (const std::pair<Key, Interpreter::Profiler::Stats>& left,
+        const std::pair<Key, Interpreter::Profiler::Stats>& right)
+    {
+        return left.second.mSeconds>right.second.mSeconds;
+    }
+
+    /// Return the \a count entries of \a collection that took the most time, slowest first
+    template<typename Key>
+    std::vector<std::pair<Key, Interpreter::Profiler::Stats> > getSlowest (
+        const std::map<Key, Interpreter::Profiler::Stats>& collection, std::size_t count)
+    {
+        std::vector<std::pair<Key, Interpreter::Profiler::Stats> > entries (collection.begin(),
+            collection.end());
+
+        count = std::min (count, entries.size());
+
+        std::partial_sort (entries.begin(), entries.begin()+count, entries.end(), compareTime<Key>);
+
+        entries.resize (count);
+
+        return entries;
+    }
+
+    void writeStats (std::ostream& stream, const Interpreter::Profiler::Stats& stats)
+    {
+        stream
+            << stats.mSeconds*1000 << " ms, " << stats.mCount << " runs, "
+            << stats.mInstructions << " instructions";
+    }
+
+    std::string quoteCsv (const std::string& text)
+    {
+        std::string quoted = "\"";
+
+        for (std::string::const_iterator iter (text.begin()); iter!=text.end(); ++iter)
+        {
+            if (*iter=='"')
+                quoted += '"';
+
+            quoted += *iter;
+        }
+
+        return quoted + "\"";
+    }
+
+    std::string quoteJson (const std::string& text)
+    {
+        std::ostringstream quoted;
+        quoted << '"';
+
+        for (std::string::const_iterator iter (text.begin()); iter!=text.end(); ++iter)
+        {
+            unsigned char c = static_cast<unsigned char> (*iter);
+
+            if (c=='"' || c=='\\')
+                quoted << '\\' << c;
+            else if (c<0x20)
+                quoted << "\\u" << std::hex << std::setw (4) << std::setfill ('0')
+                    << static_cast<int> (c) << std::dec;
+            else
+                quoted << c;
+        }
+
+        quoted << '"';
+        return quoted.str();
+    }
+
+    void writeJsonStats (std::ostream& stream, const Interpreter::Profiler::Stats& stats)
+    {
+        stream
+            << "\"count\": " << stats.mCount << ", \"instructions\": " << stats.mInstructions
+            << ", \"seconds\": " << stats.mSeconds;
+    }
+}
+
+namespace Interpreter
+{
+    Profiler::Stats::Stats() : mCount (0), mInstructions (0), mSeconds (0) {}
+
+    void Profiler::Stats::add (double seconds, unsigned long instructions)
+    {
+        ++mCount;
+        mInstructions += instructions;
+        mSeconds += seconds;
+    }
+
+    Profiler::Profiler() : mScript (0), mReference (0) {}
+
+    void Profiler::setScript (const std::string& name, const std::string& reference)
+    {
+        mScript = &mScripts[name];
+        mReference = reference.empty() ? 0 : &mReferences[std::make_pair (name, reference)];
+    }
+
+    void Profiler::addRun (double seconds, unsigned long instructions)
+    {
+        if (mScript)
+            mScript->add (seconds, instructions);
+
+        if (mReference)
+            mReference->add (seconds, instructions);
+    }
+
+    void Profiler::addInstruction (Type_Code code, double seconds)
+    {
+        mOpcodes[getOpcode (code)].add (seconds, 1);
+    }
+
+    void Profiler::clear()
+    {
+        mScripts.clear();
+        mReferences.clear();
+        mOpcodes.clear();
+        mScript = 0;
+        mReference = 0;
+    }
+
+    bool Profiler::empty() const
+    {
+        return mScripts.empty() && mOpcodes.empty();
+    }
+
+    const Profiler::ScriptCollection& Profiler::getScripts() const
+    {
+        return mScripts;
+    }
+
+    const Profiler::ReferenceCollection& Profiler::getReferences() const
+    {
+        return mReferences;
+    }
+
+    const Profiler::OpcodeCollection& Profiler::getOpcodes() const
+    {
+        return mOpcodes;
+    }
+
+    void Profiler::report (std::ostream& stream, const OpcodeNames& names, std::size_t count) const
+    {
+        stream << "Scripts:";
+
+        std::vector<std::pair<std::string, Stats> > scripts = getSlowest (mScripts, count);
+
+        for (std::vector<std::pair<std::string, Stats> >::const_iterator iter (scripts.begin());
+            iter!=scripts.end(); ++iter)
+        {
+            stream << std::endl << "  " << iter->first << ": ";
+            writeStats (stream, iter->second);
+        }
+
+        stream << std::endl << "References:";
+
+        typedef std::vector<std::pair<ReferenceCollection::key_type, Stats> > References;
+
+        References references = getSlowest (mReferences, count);
+
+        for (References::const_iterator iter (references.begin()); iter!=references.end(); ++iter)
+        {
+            stream << std::endl << "  " << iter->first.second << " (" << iter->first.first << "): ";
+            writeStats (stream, iter->second);
+        }
+
+        stream << std::endl << "Opcodes:";
+
+        std::vector<std::pair<Opcode, Stats> > opcodes = getSlowest (mOpcodes, count);
+
+        for (std::vector<std::pair<Opcode, Stats> >::const_iterator iter (opcodes.begin());
+            iter!=opcodes.end(); ++iter)
+        {
+            stream
+                << std::endl << "  " << getName (iter->first, names) << ": "
+                << iter->second.mSeconds*1000 << " ms, " << iter->second.mCount << " executions";
+        }
+    }
+
+    void Profiler::writeCsv (std::ostream& stream, const OpcodeNames& names) const
+    {
+        stream << "type,name,reference,count,instructions,seconds" << std::endl;
+
+        for (ScriptCollection::const_iterator iter (mScripts.begin()); iter!=mScripts.end(); ++iter)
+            stream
+                << "script," << quoteCsv (iter->first) << ",," << iter->second.mCount << ","
+                << iter->second.mInstructions << "," << iter->second.mSeconds << std::endl;
+
+        for (ReferenceCollection::const_iterator iter (mReferences.begin());
+            iter!=mReferences.end(); ++iter)
+            stream
+                << "reference," << quoteCsv (iter->first.first) << "," << quoteCsv (iter->first.second)
+                << "," << iter->second.mCount << "," << iter->second.mInstructions << ","
+                << iter->second.mSeconds << std::endl;
+
+        for (OpcodeCollection::const_iterator iter (mOpcodes.begin()); iter!=mOpcodes.end(); ++iter)
+            stream
+                << "opcode," << quoteCsv (getName (iter->first, names)) << ",," << iter->second.mCount
+                << "," << iter->second.mInstructions << "," << iter->second.mSeconds << std::endl;
+    }
+
+    void Profiler::writeJson (std::ostream& stream, const OpcodeNames& names) const
+    {
+        stream << "{" << std::endl << "  \"scripts\": [";
+
+        for (ScriptCollection::const_iterator iter (mScripts.begin()); iter!=mScripts.end(); ++iter)
+        {
+            stream
+                << (iter==mScripts.begin() ? "" : ",") << std::endl
+                << "    { \"name\": " << quoteJson (iter->first) << ", ";
+            writeJsonStats (stream, iter->second);
+            stream << " }";
+        }
+
+        stream << std::endl << "  ]," << std::endl << "  \"references\": [";
+
+        for (ReferenceCollection::const_iterator iter (mReferences.begin());
+            iter!=mReferences.end(); ++iter)
+        {
+            stream
+                << (iter==mReferences.begin() ? "" : ",") << std::endl
+                << "    { \"script\": " << quoteJson (iter->first.first)
+                << ", \"reference\": " << quoteJson (iter->first.second) << ", ";
+            writeJsonStats (stream, iter->second);
+            stream << " }";
+        }
+
+        stream << std::endl << "  ]," << std::endl << "  \"opcodes\": [";
+
+        for (OpcodeCollection::const_iterator iter (mOpcodes.begin()); iter!=mOpcodes.end(); ++iter)
+        {
+            stream
+                << (iter==mOpcodes.begin() ? "" : ",") << std::endl
+                << "    { \"name\": " << quoteJson (getName (iter->first, names))
+                << ", \"segment\": " << iter->first.first << ", \"opcode\": " << iter->first.second
+                << ", ";
+            writeJsonStats (stream, iter->second);
+            stream << " }";
+        }
+
+        stream << std::endl << "  ]" << std::endl << "}" << std::endl;
+    }
+
+    Profiler::Opcode Profiler::getOpcode (Type_Code code)
+    {
+        switch (code>>30)
+        {
+            case 0: return Opcode (0, code>>24);
+            case 1: return Opcode (1, (code>>24) & 0x3f);
+            case 2: return Opcode (2, (code>>20) & 0x3ff);
+        }
+
+        switch (code>>26)
+        {
+            case 0x30: return Opcode (3, (code>>8) & 0x3ffff);
+            case 0x31: return Opcode (4, (code>>16) & 0x3ff);
+            case 0x32: return Opcode (5, code & 0x3ffffff);
+        }
+
+        return Opcode (-1, code);
+    }
+
+    std::string Profiler::getName (const Opcode& opcode, const OpcodeNames& names)
+    {
+        OpcodeNames::const_iterator iter = names.find (opcode);
+
+        if (iter!=names.end())
+            return iter->second;
+
+        std::ostringstream name;
+        name << "segment " << opcode.first << " opcode 0x" << std::hex << opcode.second;
+        return name.str();
+    }
+
+    double Profiler::getTime()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER frequency, counter;
+        QueryPerformanceFrequency (&frequency);
+        QueryPerformanceCounter (&counter);
+        return static_cast<double> (counter.QuadPart) / frequency.QuadPart;
+#elif defined __APPLE__
+        timeval time;
+        gettimeofday (&time, 0);
+        return time.tv_sec + time.tv_usec * 1e-6;
+#else
+        timespec time;
+        clock_gettime (CLOCK_MONOTONIC, &time);
+        return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+    }
+}
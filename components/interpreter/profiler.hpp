@@ -0,0 +1,89 @@
+#ifndef INTERPRETER_PROFILER_H_INCLUDED
+#define INTERPRETER_PROFILER_H_INCLUDED
+
+#include <map>
+#include <string>
+#include <iosfwd>
+
+#include "types.hpp"
+
+namespace Interpreter
+{
+    /// \brief Execution times of scripts
+    ///
+    /// While a profiler is set on an Interpreter, every run of a program is timed and attributed
+    /// to the script and reference given to the last call of setScript(), and every executed
+    /// instruction to its opcode.
+    class Profiler
+    {
+        public:
+
+            struct Stats
+            {
+                unsigned long mCount; ///< runs of a script or executions of an opcode
+                unsigned long mInstructions;
+                double mSeconds;
+
+                Stats();
+
+                void add (double seconds, unsigned long instructions);
+            };
+
+            typedef std::pair<int, int> Opcode; // segment, opcode
+            typedef std::map<Opcode, std::string> OpcodeNames;
+
+            typedef std::map<std::string, Stats> ScriptCollection;
+            typedef std::map<std::pair<std::string, std::string>, Stats> ReferenceCollection;
+            typedef std::map<Opcode, Stats> OpcodeCollection;
+
+        private:
+
+            ScriptCollection mScripts;
+            ReferenceCollection mReferences; // by script and reference ID
+            OpcodeCollection mOpcodes;
+            Stats *mScript;
+            Stats *mReference;
+
+        public:
+
+            Profiler();
+
+            void setScript (const std::string& name, const std::string& reference = "");
+            ///< Attribute the following runs to script \a name and to \a reference, if it is not
+            /// empty.
+
+            void addRun (double seconds, unsigned long instructions);
+
+            void addInstruction (Type_Code code, double seconds);
+
+            void clear();
+
+            bool empty() const;
+
+            const ScriptCollection& getScripts() const;
+
+            const ReferenceCollection& getReferences() const;
+
+            const OpcodeCollection& getOpcodes() const;
+
+            void report (std::ostream& stream, const OpcodeNames& names, std::size_t count) const;
+            ///< Write the \a count scripts, references and opcodes that took the most time in a
+            /// human readable form.
+
+            void writeCsv (std::ostream& stream, const OpcodeNames& names) const;
+
+            void writeJson (std::ostream& stream, const OpcodeNames& names) const;
+
+            static Opcode getOpcode (Type_Code code);
+            ///< Return the segment and the opcode of the instruction \a code.
+
+            static std::string getName (const Opcode& opcode, const OpcodeNames& names);
+            ///< Return the name of \a opcode in \a names or a description made from its segment
+            /// and code.
+
+            static double getTime();
+            ///< Return a monotonic time in seconds.
+    };
+}
+
+#endif
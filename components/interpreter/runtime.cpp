@@ -5,9 +5,17 @@
 #include <cassert>
 #include <cstring>
 
+#include "context.hpp"
+
 namespace Interpreter
 {
-    Runtime::Runtime() : mContext (0), mCode (0), mPC (0), mCodeSize(0) {}
+    void Linkage::clear()
+    {
+        mGlobals.clear();
+        mMembers.clear();
+    }
+
+    Runtime::Runtime() : mContext (0), mCode (0), mPC (0), mCodeSize(0), mLinkage (0) {}
 
     int Runtime::getPC() const
     {
@@ -50,7 +58,44 @@ namespace Interpreter
         return literalBlock+offset;
     }
 
-    void Runtime::configure (const Interpreter::Type_Code *code, int codeSize, Context& context)
+    int Runtime::getGlobalSlot (int index)
+    {
+        if (!mLinkage)
+            return -1;
+
+        if (index>=static_cast<int> (mLinkage->mGlobals.size()))
+            mLinkage->mGlobals.resize (index+1, -2);
+
+        int& slot = mLinkage->mGlobals[index];
+
+        if (slot==-2)
+            slot = getContext().getGlobalSlot (getStringLiteral (index));
+
+        return slot;
+    }
+
+    int Runtime::getMemberSlot (int idIndex, int nameIndex, char type)
+    {
+        if (!mLinkage)
+            return -1;
+
+        std::pair<int, int> key (idIndex, nameIndex);
+
+        std::map<std::pair<int, int>, int>::const_iterator iter = mLinkage->mMembers.find (key);
+
+        if (iter!=mLinkage->mMembers.end())
+            return iter->second;
+
+        int slot = getContext().getMemberSlot (getStringLiteral (idIndex),
+            getStringLiteral (nameIndex), type);
+
+        mLinkage->mMembers.insert (std::make_pair (key, slot));
+
+        return slot;
+    }
+
+    void Runtime::configure (const Interpreter::Type_Code *code, int codeSize, Context& context,
+        Linkage *linkage)
     {
         clear();
 
@@ -58,6 +103,7 @@ namespace Interpreter
         mCode = code;
         mCodeSize = codeSize;
         mPC = 0;
+        mLinkage = linkage;
     }
 
     void Runtime::clear()
@@ -66,6 +112,7 @@ namespace Interpreter
         mCode = 0;
         mCodeSize = 0;
         mStack.clear();
+        mLinkage = 0;
     }
 
     void Runtime::setPC (int PC)
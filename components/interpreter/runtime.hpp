@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <map>
 
 #include "types.hpp"
 
@@ -10,6 +11,18 @@ namespace Interpreter
 {
     class Context;
 
+    /// \brief Slots of the variables a script accesses by name (see Context::getGlobalSlot)
+    ///
+    /// Slots are resolved when the script accesses a variable for the first time and are reused
+    /// on later runs.
+    struct Linkage
+    {
+        std::vector<int> mGlobals; // by string literal
+        std::map<std::pair<int, int>, int> mMembers; // by ID and variable string literal
+
+        void clear();
+    };
+
     /// Runtime data and engine interface
 
     class Runtime
@@ -19,6 +32,7 @@ namespace Interpreter
             int mCodeSize;
             int mPC;
             std::vector<Data> mStack;
+            Linkage *mLinkage;
 
         public:
 
@@ -33,9 +47,20 @@ namespace Interpreter
 
             std::string getStringLiteral (int index) const;
 
-            void configure (const Type_Code *code, int codeSize, Context& context);
-            ///< \a context and \a code must exist as least until either configure, clear or
-            /// the destructor is called. \a codeSize is given in 32-bit words.
+            int getGlobalSlot (int index);
+            ///< Return the slot of the global variable, whose name is string literal \a index, or
+            /// -1, if it has to be accessed by name.
+
+            int getMemberSlot (int idIndex, int nameIndex, char type);
+            ///< Return the slot of the member variable, whose name is string literal \a nameIndex,
+            /// of the reference named by string literal \a idIndex, or -1, if it has to be accessed
+            /// by name.
+
+            void configure (const Type_Code *code, int codeSize, Context& context,
+                Linkage *linkage = 0);
+            ///< \a context, \a code and \a linkage must exist as least until either configure,
+            /// clear or the destructor is called. \a codeSize is given in 32-bit words. Without
+            /// \a linkage all variables are accessed by name.
 
             void clear();
 
@@ -0,0 +1,167 @@
+#ifndef MISC_IDMAP_H
+#define MISC_IDMAP_H
+
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <utility>
+
+#include "stringops.hpp"
+
+namespace Misc
+{
+    /// \brief Maps case insensitive string ids to values
+    ///
+    /// Lookups hash the id as it is passed in, so no lower case copy has to be made.
+    /// Values are kept in a deque and never move once inserted; slots of erased
+    /// values are reused by later insertions.
+    template <class T>
+    class IdMap
+    {
+        #if defined HAVE_UNORDERED_MAP
+            typedef std::unordered_map<std::string, size_t, StringUtils::CiHash, StringUtils::CiEqual> Index;
+        #else
+            typedef std::tr1::unordered_map<std::string, size_t, StringUtils::CiHash, StringUtils::CiEqual> Index;
+        #endif
+
+            Index mIndex;
+            std::deque<T> mValues;
+            std::vector<size_t> mFree;
+
+            struct KeyLess
+            {
+                bool operator()(const std::pair<const std::string *, size_t> &x,
+                    const std::pair<const std::string *, size_t> &y) const
+                {
+                    return *x.first < *y.first;
+                }
+            };
+
+        public:
+
+            /// \return 0 if \a id is not in the map
+            T *search(const std::string &id)
+            {
+                typename Index::const_iterator it = mIndex.find(id);
+                if (it == mIndex.end())
+                    return 0;
+                return &mValues[it->second];
+            }
+
+            const T *search(const std::string &id) const
+            {
+                typename Index::const_iterator it = mIndex.find(id);
+                if (it == mIndex.end())
+                    return 0;
+                return &mValues[it->second];
+            }
+
+            /// Add \a value or overwrite the value already stored for \a id.
+            /// \return the stored value and true if \a id was not in the map before
+            std::pair<T *, bool> insert(const std::string &id, const T &value)
+            {
+                typename Index::const_iterator it = mIndex.find(id);
+                if (it != mIndex.end())
+                {
+                    T *ptr = &mValues[it->second];
+                    *ptr = value;
+                    return std::make_pair(ptr, false);
+                }
+
+                size_t slot;
+                if (!mFree.empty())
+                {
+                    slot = mFree.back();
+                    mFree.pop_back();
+                    mValues[slot] = value;
+                }
+                else
+                {
+                    slot = mValues.size();
+                    mValues.push_back(value);
+                }
+
+                mIndex.insert(std::make_pair(StringUtils::lowerCase(id), slot));
+                return std::make_pair(&mValues[slot], true);
+            }
+
+            /// \return false if \a id was not in the map
+            bool erase(const std::string &id)
+            {
+                typename Index::iterator it = mIndex.find(id);
+                if (it == mIndex.end())
+                    return false;
+
+                mValues[it->second] = T();
+                mFree.push_back(it->second);
+                mIndex.erase(it);
+                return true;
+            }
+
+            void clear()
+            {
+                mIndex.clear();
+                mValues.clear();
+                mFree.clear();
+            }
+
+            size_t size() const
+            {
+                return mIndex.size();
+            }
+
+            bool empty() const
+            {
+                return mIndex.empty();
+            }
+
+            /// Append pointers to all values to \a list, ordered by lower case id.
+            void list(std::vector<T *> &list)
+            {
+                std::vector<size_t> slots;
+                getSortedSlots(slots);
+
+                list.reserve(list.size() + slots.size());
+                for (size_t i = 0; i < slots.size(); ++i)
+                    list.push_back(&mValues[slots[i]]);
+            }
+
+            void list(std::vector<const T *> &list) const
+            {
+                std::vector<size_t> slots;
+                getSortedSlots(slots);
+
+                list.reserve(list.size() + slots.size());
+                for (size_t i = 0; i < slots.size(); ++i)
+                    list.push_back(&mValues[slots[i]]);
+            }
+
+        private:
+
+            void getSortedSlots(std::vector<size_t> &slots) const
+            {
+                std::vector<std::pair<const std::string *, size_t> > entries;
+                entries.reserve(mIndex.size());
+
+                for (typename Index::const_iterator it = mIndex.begin(); it != mIndex.end(); ++it)
+                    entries.push_back(std::make_pair(&it->first, it->second));
+
+                std::sort(entries.begin(), entries.end(), KeyLess());
+
+                slots.reserve(entries.size());
+                for (size_t i = 0; i < entries.size(); ++i)
+                    slots.push_back(entries[i].second);
+            }
+    };
+}
+
+#endif
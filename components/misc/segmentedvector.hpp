@@ -0,0 +1,185 @@
+#ifndef MISC_SEGMENTEDVECTOR_H
+#define MISC_SEGMENTEDVECTOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+namespace Misc
+{
+    /// \brief A sequence that allocates its elements in chunks of fixed size
+    ///
+    /// Growing the sequence never moves elements, so pointers and iterators stay valid
+    /// until the element itself is erased or the sequence is cleared. Elements are
+    /// contiguous within a chunk, which makes iterating much cheaper than with std::list.
+    template <class T, std::size_t ChunkSize = 32>
+    class SegmentedVector
+    {
+            template <class Value, class Container>
+            class Iterator
+            {
+                    Container *mContainer;
+                    std::size_t mIndex;
+
+                    template <class OtherValue, class OtherContainer>
+                    friend class Iterator;
+
+                public:
+
+                    typedef std::bidirectional_iterator_tag iterator_category;
+                    typedef T value_type;
+                    typedef std::ptrdiff_t difference_type;
+                    typedef Value* pointer;
+                    typedef Value& reference;
+
+                    Iterator() : mContainer (0), mIndex (0) {}
+
+                    Iterator (Container *container, std::size_t index)
+                    : mContainer (container), mIndex (index)
+                    {}
+
+                    // allow iterator -> const_iterator
+                    template <class OtherValue, class OtherContainer>
+                    Iterator (const Iterator<OtherValue, OtherContainer>& other)
+                    : mContainer (other.mContainer), mIndex (other.mIndex)
+                    {}
+
+                    Value& operator*() const { return (*mContainer)[mIndex]; }
+                    Value *operator->() const { return &(*mContainer)[mIndex]; }
+
+                    Iterator& operator++() { ++mIndex; return *this; }
+                    Iterator operator++ (int) { Iterator iter (*this); ++mIndex; return iter; }
+                    Iterator& operator--() { --mIndex; return *this; }
+                    Iterator operator-- (int) { Iterator iter (*this); --mIndex; return iter; }
+
+                    Iterator operator+ (difference_type offset) const
+                    {
+                        return Iterator (mContainer, mIndex + offset);
+                    }
+
+                    std::size_t getIndex() const { return mIndex; }
+
+                    template <class OtherValue, class OtherContainer>
+                    bool operator== (const Iterator<OtherValue, OtherContainer>& other) const
+                    {
+                        return mIndex==other.mIndex && mContainer==other.mContainer;
+                    }
+
+                    template <class OtherValue, class OtherContainer>
+                    bool operator!= (const Iterator<OtherValue, OtherContainer>& other) const
+                    {
+                        return !(*this==other);
+                    }
+            };
+
+            std::vector<T *> mChunks;
+            std::size_t mSize;
+
+            T *getSlot (std::size_t index) const
+            {
+                return mChunks[index / ChunkSize] + index % ChunkSize;
+            }
+
+        public:
+
+            typedef T value_type;
+            typedef std::size_t size_type;
+            typedef Iterator<T, SegmentedVector> iterator;
+            typedef Iterator<const T, const SegmentedVector> const_iterator;
+
+            SegmentedVector() : mSize (0) {}
+
+            SegmentedVector (const SegmentedVector& other) : mSize (0)
+            {
+                reserve (other.mSize);
+
+                for (std::size_t i = 0; i < other.mSize; ++i)
+                    push_back (other[i]);
+            }
+
+            SegmentedVector& operator= (const SegmentedVector& other)
+            {
+                SegmentedVector copy (other);
+                swap (copy);
+                return *this;
+            }
+
+            ~SegmentedVector()
+            {
+                clear();
+            }
+
+            void swap (SegmentedVector& other)
+            {
+                mChunks.swap (other.mChunks);
+                std::swap (mSize, other.mSize);
+            }
+
+            T& operator[] (std::size_t index) { return *getSlot (index); }
+            const T& operator[] (std::size_t index) const { return *getSlot (index); }
+
+            T& front() { return *getSlot (0); }
+            const T& front() const { return *getSlot (0); }
+            T& back() { return *getSlot (mSize-1); }
+            const T& back() const { return *getSlot (mSize-1); }
+
+            iterator begin() { return iterator (this, 0); }
+            iterator end() { return iterator (this, mSize); }
+            const_iterator begin() const { return const_iterator (this, 0); }
+            const_iterator end() const { return const_iterator (this, mSize); }
+
+            std::size_t size() const { return mSize; }
+            bool empty() const { return mSize==0; }
+
+            /// Allocate chunks for at least \a size elements.
+            void reserve (std::size_t size)
+            {
+                while (mChunks.size() * ChunkSize < size)
+                    mChunks.push_back (static_cast<T *> (::operator new (ChunkSize * sizeof (T))));
+            }
+
+            void push_back (const T& value)
+            {
+                reserve (mSize+1);
+                new (getSlot (mSize)) T (value);
+                ++mSize;
+            }
+
+            void pop_back()
+            {
+                --mSize;
+                getSlot (mSize)->~T();
+            }
+
+            /// Remove the element at \a iter by moving all following elements one position
+            /// to the front.
+            ///
+            /// \note Invalidates pointers and iterators to the following elements.
+            /// \return Iterator to the element that followed the erased one
+            iterator erase (iterator iter)
+            {
+                for (std::size_t i = iter.getIndex(); i+1 < mSize; ++i)
+                    (*this)[i] = (*this)[i+1];
+
+                pop_back();
+
+                return iter;
+            }
+
+            /// Destroy all elements and free all chunks.
+            void clear()
+            {
+                while (mSize)
+                    pop_back();
+
+                for (typename std::vector<T *>::iterator iter (mChunks.begin()); iter!=mChunks.end(); ++iter)
+                    ::operator delete (*iter);
+
+                mChunks.clear();
+            }
+    };
+}
+
+#endif
@@ -72,6 +72,54 @@ public:
         std::string out = in;
         return toLower(out);
     }
+
+    /// Lower case of a single character, as folded by ciHash and CiEqual
+    static int ciFold(unsigned char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            return c + 'a' - 'A';
+        if (c >= 0x80)
+            return std::tolower(c) & 0xff;
+        return c;
+    }
+
+    /// Case insensitive hash, consistent with CiEqual
+    static size_t ciHash(const std::string &str)
+    {
+        // FNV-1a
+        size_t hash = 2166136261u;
+        for (std::string::const_iterator it = str.begin(); it != str.end(); ++it) {
+            int c = ciFold(static_cast<unsigned char>(*it));
+            hash ^= static_cast<size_t>(c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /// Function objects for case insensitive hashed containers
+    struct CiHash
+    {
+        size_t operator()(const std::string &str) const {
+            return ciHash(str);
+        }
+    };
+
+    struct CiEqual
+    {
+        bool operator()(const std::string &x, const std::string &y) const {
+            if (x.size() != y.size())
+                return false;
+            // Most lookups use the same case as the stored id, so only fold differing characters
+            std::string::const_iterator xit = x.begin();
+            std::string::const_iterator yit = y.begin();
+            for (; xit != x.end(); ++xit, ++yit) {
+                if (*xit != *yit && ciFold(static_cast<unsigned char>(*xit)) !=
+                    ciFold(static_cast<unsigned char>(*yit)))
+                    return false;
+            }
+            return true;
+        }
+    };
 };
 
 
@@ -0,0 +1,154 @@
+#include "workqueue.hpp"
+
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread_time.hpp>
+
+namespace Misc
+{
+    WorkItem::WorkItem()
+    : mDone (false)
+    {}
+
+    WorkItem::~WorkItem() {}
+
+    void WorkItem::waitTillDone() const
+    {
+        boost::unique_lock<boost::mutex> lock (mMutex);
+
+        while (!mDone)
+            mCondition.wait (lock);
+    }
+
+    bool WorkItem::waitTillDone (unsigned int milliseconds) const
+    {
+        boost::unique_lock<boost::mutex> lock (mMutex);
+
+        boost::system_time timeout =
+            boost::get_system_time() + boost::posix_time::milliseconds (milliseconds);
+
+        while (!mDone)
+            if (!mCondition.timed_wait (lock, timeout))
+                break;
+
+        return mDone;
+    }
+
+    bool WorkItem::isDone() const
+    {
+        boost::unique_lock<boost::mutex> lock (mMutex);
+        return mDone;
+    }
+
+    std::string WorkItem::getError() const
+    {
+        boost::unique_lock<boost::mutex> lock (mMutex);
+        return mError;
+    }
+
+    void WorkItem::run()
+    {
+        std::string error;
+
+        try
+        {
+            doWork();
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+
+            if (error.empty())
+                error = "unknown error";
+        }
+        catch (...)
+        {
+            error = "unknown error";
+        }
+
+        markDone (error);
+    }
+
+    void WorkItem::abort()
+    {
+        markDone ("work queue shut down before the item was processed");
+    }
+
+    void WorkItem::markDone (const std::string& error)
+    {
+        boost::unique_lock<boost::mutex> lock (mMutex);
+        mError = error;
+        mDone = true;
+        mCondition.notify_all();
+    }
+
+
+    WorkQueue::WorkQueue (unsigned int threads)
+    : mStopping (false), mThreadCount (threads)
+    {
+        if (mThreadCount==0)
+            mThreadCount = boost::thread::hardware_concurrency();
+
+        if (mThreadCount==0)
+            mThreadCount = 1;
+
+        for (unsigned int i=0; i<mThreadCount; ++i)
+            mThreads.create_thread (boost::bind (&WorkQueue::threadBody, this));
+    }
+
+    WorkQueue::~WorkQueue()
+    {
+        std::deque<WorkItem *> dropped;
+
+        {
+            boost::unique_lock<boost::mutex> lock (mMutex);
+            mStopping = true;
+            dropped.swap (mQueue);
+            mCondition.notify_all();
+        }
+
+        mThreads.join_all();
+
+        for (std::deque<WorkItem *>::iterator iter (dropped.begin()); iter!=dropped.end(); ++iter)
+            (*iter)->abort();
+    }
+
+    void WorkQueue::addWorkItem (WorkItem *item)
+    {
+        if (!item)
+            throw std::logic_error ("can't add null work item to work queue");
+
+        boost::unique_lock<boost::mutex> lock (mMutex);
+        mQueue.push_back (item);
+        mCondition.notify_one();
+    }
+
+    unsigned int WorkQueue::getThreadCount() const
+    {
+        return mThreadCount;
+    }
+
+    void WorkQueue::threadBody()
+    {
+        while (true)
+        {
+            WorkItem *item = 0;
+
+            {
+                boost::unique_lock<boost::mutex> lock (mMutex);
+
+                while (mQueue.empty() && !mStopping)
+                    mCondition.wait (lock);
+
+                if (mStopping)
+                    return;
+
+                item = mQueue.front();
+                mQueue.pop_front();
+            }
+
+            item->run();
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef MISC_WORKQUEUE_H
+#define MISC_WORKQUEUE_H
+
+#include <deque>
+#include <string>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Misc
+{
+    /// A piece of work to be run on a WorkQueue thread.
+    class WorkItem
+    {
+        public:
+
+            WorkItem();
+
+            virtual ~WorkItem();
+
+            /// Block until the item has been processed.
+            void waitTillDone() const;
+
+            /// Block until the item has been processed or the timeout has expired.
+            /// \return Has the item been processed?
+            bool waitTillDone (unsigned int milliseconds) const;
+
+            bool isDone() const;
+
+            /// \return Error message of an exception thrown by doWork(), or an empty
+            /// string on success.
+            std::string getError() const;
+
+        protected:
+
+            /// Do the actual work. Called on a worker thread.
+            virtual void doWork() = 0;
+
+        private:
+
+            WorkItem (const WorkItem&);
+            WorkItem& operator= (const WorkItem&);
+
+            void run();
+
+            void abort();
+
+            void markDone (const std::string& error);
+
+            mutable boost::mutex mMutex;
+            mutable boost::condition_variable mCondition;
+            bool mDone;
+            std::string mError;
+
+            friend class WorkQueue;
+    };
+
+    /// A fixed size pool of worker threads processing WorkItems in FIFO order.
+    class WorkQueue
+    {
+        public:
+
+            /// \param threads Number of worker threads, 0 for one per hardware thread
+            explicit WorkQueue (unsigned int threads = 0);
+
+            /// Waits for items that are being processed. Items that have not been
+            /// started yet are marked as done with an error.
+            ~WorkQueue();
+
+            /// Queue \a item for processing. The queue does not take ownership; the
+            /// item must stay alive until it is done.
+            void addWorkItem (WorkItem *item);
+
+            unsigned int getThreadCount() const;
+
+        private:
+
+            WorkQueue (const WorkQueue&);
+            WorkQueue& operator= (const WorkQueue&);
+
+            void threadBody();
+
+            std::deque<WorkItem *> mQueue;
+            boost::mutex mMutex;
+            boost::condition_variable mCondition;
+            bool mStopping;
+            boost::thread_group mThreads;
+            unsigned int mThreadCount;
+    };
+}
+
+#endif
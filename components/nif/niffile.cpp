@@ -35,8 +35,8 @@
 
 #include <iostream>
 
-//TODO: when threading is needed, enable these
-//#include <boost/mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 
 namespace Nif
@@ -44,75 +44,106 @@ namespace Nif
 
 class NIFFile::LoadedCache
 {
-    //TODO: enable this to make cache thread safe...
-    //typedef boost::mutex mutex;
-    
-    struct mutex
+    typedef boost::mutex mutex;
+    typedef boost::unique_lock <mutex> lock_guard;
+
+    /// A file that one thread is parsing and others may be waiting for
+    struct Loading
     {
-        void lock () {};
-        void unlock () {}
+        bool mDone;
+        ptr mResult;
+        std::string mError;
+
+        Loading () : mDone (false) {}
     };
-    
-    typedef boost::lock_guard <mutex> lock_guard;
+
     typedef std::map < std::string, boost::weak_ptr <NIFFile> > loaded_map;
+    typedef std::map < std::string, boost::shared_ptr <Loading> > loading_map;
     typedef std::vector < boost::shared_ptr <NIFFile> > locked_files;
 
     static int sLockLevel;
     static mutex sProtector;
+    static boost::condition_variable sLoaded;
     static loaded_map sLoadedMap;
+    static loading_map sLoadingMap;
     static locked_files sLockedFiles;
 
 public:
 
     static ptr create (const std::string &name)
     {
-        lock_guard _ (sProtector);
-
-        ptr result;
+        lock_guard lock (sProtector);
 
         // lookup the resource
         loaded_map::iterator i = sLoadedMap.find (name);
 
-        if (i == sLoadedMap.end ()) // it doesn't existing currently,
-        {                           // or hasn't in the very near past
+        if (i != sLoadedMap.end ())
+        {
+            // it may (probably) still exist, unless it is in the process
+            // of being destroyed
+            if (ptr result = i->second.lock ())
+                return result;
+        }
+
+        // if another thread is parsing the file already, wait for it
+        // instead of parsing it a second time
+        loading_map::iterator l = sLoadingMap.find (name);
+
+        if (l != sLoadingMap.end ())
+        {
+            boost::shared_ptr <Loading> loading = l->second;
+
+            while (!loading->mDone)
+                sLoaded.wait (lock);
+
+            if (!loading->mResult)
+                throw std::runtime_error (loading->mError);
+
+            return loading->mResult;
+        }
 
-            // create it now, for smoother threading if needed, the
-            // loading should be performed outside of the sLoaderMap
-            // lock and an alternate mechanism should be used to
-            // synchronize threads competing to load the same resource
+        boost::shared_ptr <Loading> loading = boost::make_shared <Loading> ();
+        sLoadingMap [name] = loading;
+
+        // parse the file outside of the lock, so that other files can
+        // be looked up and parsed in the meantime
+        lock.unlock ();
+
+        ptr result;
+
+        try
+        {
             result = boost::make_shared <NIFFile> (name, psudo_private_modifier());
+        }
+        catch (const std::exception &e)
+        {
+            loading->mError = e.what ();
+        }
+
+        lock.lock ();
 
+        if (result)
+        {
             // if we are locking the cache add an extra reference
             // to keep the file in memory
             if (sLockLevel > 0)
                 sLockedFiles.push_back (result);
 
-            // stash a reference to the resource so that future
-            // calls can benefit
+            // stash a reference to the resource so that future calls can
+            // benefit. we potentially overwrite an expired pointer here
+            // but the other thread performing the delete on the previous
+            // copy of this resource will detect it and make sure not to
+            // erase the new reference
             sLoadedMap [name] = boost::weak_ptr <NIFFile> (result);
         }
-        else // it may (probably) still exists
-        {
-            // attempt to get the reference
-            result = i->second.lock ();
-
-            if (!result) // resource is in the process of being destroyed
-            {
-                // create a new instance, to replace the one that has
-                // begun the irreversible process of being destroyed
-                result = boost::make_shared <NIFFile> (name, psudo_private_modifier());
-
-                // respect the cache lock...
-                if (sLockLevel > 0)
-                    sLockedFiles.push_back (result);
-
-                // we potentially overwrite an expired pointer here
-                // but the other thread performing the delete on
-                // the previous copy of this resource will detect it
-                // and make sure not to erase the new reference
-                sLoadedMap [name] = boost::weak_ptr <NIFFile> (result);
-            }
-        }
+
+        loading->mResult = result;
+        loading->mDone = true;
+        sLoadingMap.erase (name);
+        sLoaded.notify_all ();
+
+        if (!result)
+            throw std::runtime_error (loading->mError);
 
         // we made it!
         return result;
@@ -149,20 +180,21 @@ public:
         {
             lock_guard _ (sProtector);
 
-            if (--sLockLevel)
+            if (--sLockLevel == 0)
                 sLockedFiles.swap(resetList);
         }
 
-        // this not necessary, but makes it clear that the
-        // deletion of the locked cache entries is being done
-        // outside the protection of sProtector
+        // the locked cache entries have to be deleted outside the
+        // protection of sProtector, since their destructors call release
         resetList.clear ();
     }
 };
 
 int NIFFile::LoadedCache::sLockLevel = 0;
 NIFFile::LoadedCache::mutex NIFFile::LoadedCache::sProtector;
+boost::condition_variable NIFFile::LoadedCache::sLoaded;
 NIFFile::LoadedCache::loaded_map NIFFile::LoadedCache::sLoadedMap;
+NIFFile::LoadedCache::loading_map NIFFile::LoadedCache::sLoadingMap;
 NIFFile::LoadedCache::locked_files NIFFile::LoadedCache::sLockedFiles;
 
 // these three calls are forwarded to the cache implementation...
@@ -1,6 +1,11 @@
 #ifndef OPENMW_COMPONENTS_NIF_NIFSTREAM_HPP
 #define OPENMW_COMPONENTS_NIF_NIFSTREAM_HPP
 
+#include <cstring>
+#include <algorithm>
+
+#include <boost/detail/endian.hpp>
+
 namespace Nif
 {
 
@@ -38,6 +43,41 @@ class NIFStream {
         return u.f;
     }
 
+    /// Read \a count little endian values of type T in one go. Values past the end of
+    /// the stream are zero.
+    template<typename T>
+    void read_le_array(T *dest, size_t count)
+    {
+        size_t size = count * sizeof(T);
+        if(size == 0)
+            return;
+
+        size_t read = inp->read(dest, size);
+        if(read != size)
+            std::memset(reinterpret_cast<char*>(dest) + read, 0, size - read);
+
+#ifndef BOOST_LITTLE_ENDIAN
+        char *bytes = reinterpret_cast<char*>(dest);
+        for(size_t i = 0;i < count;i++)
+            std::reverse(bytes + i*sizeof(T), bytes + (i+1)*sizeof(T));
+#endif
+    }
+
+    /// Read \a count Ogre vectors with \a components floats each. Done in one go,
+    /// unless Ogre::Real is not a float or the vector type has padding.
+    template<typename T>
+    void read_le_vectors(T *dest, size_t count, size_t components)
+    {
+        if(sizeof(Ogre::Real) == sizeof(float) && sizeof(T) == components*sizeof(float))
+            read_le_array(reinterpret_cast<float*>(dest->ptr()), count*components);
+        else
+        {
+            for(size_t i = 0;i < count;i++)
+                for(size_t j = 0;j < components;j++)
+                    dest[i].ptr()[j] = Ogre::Real(read_le32f());
+        }
+    }
+
 public:
 
     NIFFile * const file;
@@ -141,38 +181,38 @@ public:
     void getShorts(std::vector<short> &vec, size_t size)
     {
         vec.resize(size);
-        for(size_t i = 0;i < vec.size();i++)
-            vec[i] = getShort();
+        if(size)
+            read_le_array(&vec[0], size);
     }
     void getFloats(std::vector<float> &vec, size_t size)
     {
         vec.resize(size);
-        for(size_t i = 0;i < vec.size();i++)
-            vec[i] = getFloat();
+        if(size)
+            read_le_array(&vec[0], size);
     }
     void getVector2s(std::vector<Ogre::Vector2> &vec, size_t size)
     {
         vec.resize(size);
-        for(size_t i = 0;i < vec.size();i++)
-            vec[i] = getVector2();
+        if(size)
+            read_le_vectors(&vec[0], size, 2);
     }
     void getVector3s(std::vector<Ogre::Vector3> &vec, size_t size)
     {
         vec.resize(size);
-        for(size_t i = 0;i < vec.size();i++)
-            vec[i] = getVector3();
+        if(size)
+            read_le_vectors(&vec[0], size, 3);
     }
     void getVector4s(std::vector<Ogre::Vector4> &vec, size_t size)
     {
         vec.resize(size);
-        for(size_t i = 0;i < vec.size();i++)
-            vec[i] = getVector4();
+        if(size)
+            read_le_vectors(&vec[0], size, 4);
     }
     void getQuaternions(std::vector<Ogre::Quaternion> &quat, size_t size)
     {
         quat.resize(size);
-        for(size_t i = 0;i < quat.size();i++)
-            quat[i] = getQuaternion();
+        if(size)
+            read_le_vectors(&quat[0], size, 4);
     }
 };
 
@@ -24,7 +24,13 @@ http://www.gnu.org/licenses/ .
 #include "bulletnifloader.hpp"
 
 #include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <stdint.h>
 
+#include <boost/filesystem/operations.hpp>
 
 #include <components/misc/stringops.hpp>
 
@@ -49,10 +55,151 @@ typedef unsigned char ubyte;
 namespace NifBullet
 {
 
+namespace
+{
+    // Increase when the layout of the shape cache or the way meshes are built from NIFs changes
+    const int sShapeCacheVersion = 1;
+
+    const uint64_t sHashOffset = 14695981039346656037ULL;
+
+    // FNV-1a
+    void hash(uint64_t& key, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            key ^= bytes[i];
+            key *= 1099511628211ULL;
+        }
+    }
+
+    /// Key of the BVH built from \a mesh. The BVH only depends on the triangles taken from the
+    /// NIF, so those are hashed instead of the whole file.
+    uint64_t hashMesh(btTriangleMesh *mesh)
+    {
+        uint64_t key = sHashOffset;
+        hash(key, &sShapeCacheVersion, sizeof(sShapeCacheVersion));
+
+        // the layout of a serialized BVH depends on the Bullet version and the platform
+        int bulletVersion = BT_BULLET_VERSION;
+        hash(key, &bulletVersion, sizeof(bulletVersion));
+
+        int scalarSize = sizeof(btScalar);
+        hash(key, &scalarSize, sizeof(scalarSize));
+
+        int pointerSize = sizeof(void*);
+        hash(key, &pointerSize, sizeof(pointerSize));
+
+        const unsigned char *vertices, *indices;
+        int numVertices, vertexStride, numFaces, indexStride;
+        PHY_ScalarType vertexType, indexType;
+        mesh->getLockedReadOnlyVertexIndexBase(&vertices, numVertices, vertexType, vertexStride,
+            &indices, indexStride, numFaces, indexType);
+
+        hash(key, vertices, static_cast<size_t>(numVertices) * vertexStride);
+        hash(key, indices, static_cast<size_t>(numFaces) * indexStride);
+
+        mesh->unLockReadOnlyVertexBase(0);
+
+        return key;
+    }
+
+    /// Cache file layout: key, size of the serialized BVH, checksum of the serialized BVH, serialized BVH.
+    const size_t sHeaderSize = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t);
+
+    /// \return The serialized BVH in a buffer allocated with btAlignedAlloc or 0, if \a file
+    /// doesn't hold a valid BVH for \a key.
+    void *readBvh(const boost::filesystem::path &file, uint64_t key, unsigned &size)
+    {
+        std::ifstream stream(file.string().c_str(), std::ios::in | std::ios::binary);
+        if (!stream)
+            return 0;
+
+        uint64_t fileKey = 0;
+        uint32_t fileSize = 0;
+        uint64_t checksum = 0;
+        stream.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+        stream.read(reinterpret_cast<char*>(&fileSize), sizeof(fileSize));
+        stream.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
+
+        // the mesh has changed since the file was written, it will be replaced
+        if (!stream || fileKey != key)
+            return 0;
+
+        boost::system::error_code ec;
+        if (boost::filesystem::file_size(file, ec) != sHeaderSize + fileSize || ec)
+        {
+            std::cerr << "Ignoring damaged shape cache " << file.string() << std::endl;
+            return 0;
+        }
+
+        void *buffer = btAlignedAlloc(fileSize, 16);
+
+        uint64_t check = sHashOffset;
+        if (stream.read(static_cast<char*>(buffer), fileSize))
+            hash(check, buffer, fileSize);
+
+        if (!stream || check != checksum)
+        {
+            std::cerr << "Ignoring damaged shape cache " << file.string() << std::endl;
+            btAlignedFree(buffer);
+            return 0;
+        }
+
+        size = fileSize;
+        return buffer;
+    }
+
+    void writeBvh(const boost::filesystem::path &file, uint64_t key, const btOptimizedBvh &bvh)
+    {
+        boost::filesystem::path temp = file.string() + ".tmp";
+
+        uint32_t size = bvh.calculateSerializeBufferSize();
+        void *buffer = btAlignedAlloc(size, 16);
+
+        try
+        {
+            if (!bvh.serializeInPlace(buffer, size, false))
+                throw std::runtime_error("can't serialize the BVH of " + file.string());
+
+            uint64_t checksum = sHashOffset;
+            hash(checksum, buffer, size);
+
+            boost::filesystem::create_directories(file.parent_path());
+
+            {
+                std::ofstream stream(temp.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+                if (!stream)
+                    throw std::runtime_error("can't open " + temp.string());
+
+                stream.write(reinterpret_cast<const char*>(&key), sizeof(key));
+                stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+                stream.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+                stream.write(static_cast<const char*>(buffer), size);
+
+                if (!stream.flush())
+                    throw std::runtime_error("can't write " + temp.string());
+            }
+
+            boost::filesystem::rename(temp, file);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Failed to write shape cache: " << e.what() << std::endl;
+
+            boost::system::error_code ec;
+            boost::filesystem::remove(temp, ec);
+        }
+
+        btAlignedFree(buffer);
+    }
+}
+
 struct TriangleMeshShape : public btBvhTriangleMeshShape
 {
-    TriangleMeshShape(btStridingMeshInterface* meshInterface, bool useQuantizedAabbCompression)
-        : btBvhTriangleMeshShape(meshInterface, useQuantizedAabbCompression)
+    TriangleMeshShape(btStridingMeshInterface* meshInterface, bool useQuantizedAabbCompression, bool buildBvh = true)
+        : btBvhTriangleMeshShape(meshInterface, useQuantizedAabbCompression, buildBvh)
+        , mBvhBuffer(NULL)
     {
     }
 
@@ -60,7 +207,16 @@ struct TriangleMeshShape : public btBvhTriangleMeshShape
     {
         delete getTriangleInfoMap();
         delete m_meshInterface;
+
+        // A BVH read from the cache lives in mBvhBuffer and isn't owned by btBvhTriangleMeshShape
+        if (mBvhBuffer)
+        {
+            m_bvh->~btOptimizedBvh();
+            btAlignedFree(mBvhBuffer);
+        }
     }
+
+    void *mBvhBuffer;
 };
 
 ManualBulletShapeLoader::~ManualBulletShapeLoader()
@@ -89,7 +245,7 @@ void ManualBulletShapeLoader::loadResource(Ogre::Resource *resource)
     // of the early stages of development. Right now we WANT to catch
     // every error as early and intrusively as possible, as it's most
     // likely a sign of incomplete code rather than faulty input.
-    Nif::NIFFile::ptr pnif (Nif::NIFFile::create (mResourceName.substr(0, mResourceName.length()-7)));
+    Nif::NIFFile::ptr pnif (Nif::NIFFile::create (mResourceName));
     Nif::NIFFile & nif = *pnif.get ();
     if (nif.numRoots() < 1)
     {
@@ -120,7 +276,7 @@ void ManualBulletShapeLoader::loadResource(Ogre::Resource *resource)
     }
     else if (mHasShape && mShape->mCollide)
     {
-        mShape->mCollisionShape = new TriangleMeshShape(mesh1,true);
+        mShape->mCollisionShape = createMeshShape(mesh1, false);
     }
     else
         delete mesh1;
@@ -144,7 +300,7 @@ void ManualBulletShapeLoader::loadResource(Ogre::Resource *resource)
     }
     else if (mHasShape)
     {
-        mShape->mRaycastingShape = new TriangleMeshShape(mesh2,true);
+        mShape->mRaycastingShape = createMeshShape(mesh2, true);
     }
     else
         delete mesh2;
@@ -291,6 +447,41 @@ void ManualBulletShapeLoader::handleNiTriShape(btTriangleMesh* mesh, const Nif::
     }
 }
 
+btCollisionShape *ManualBulletShapeLoader::createMeshShape(btTriangleMesh *mesh, bool raycasting)
+{
+    if (mCacheDir.empty())
+        return new TriangleMeshShape(mesh, true);
+
+    uint64_t name = sHashOffset;
+    std::string lowerName = Misc::StringUtils::lowerCase(mResourceName);
+    hash(name, lowerName.c_str(), lowerName.size());
+
+    std::ostringstream fileName;
+    fileName << std::hex << std::setfill('0') << std::setw(16) << name << (raycasting ? "-ray" : "-col") << ".bvh";
+    boost::filesystem::path file = mCacheDir / fileName.str();
+
+    uint64_t key = hashMesh(mesh);
+
+    unsigned size = 0;
+    if (void *buffer = readBvh(file, key, size))
+    {
+        if (btOptimizedBvh *bvh = btOptimizedBvh::deSerializeInPlace(buffer, size, false))
+        {
+            TriangleMeshShape *shape = new TriangleMeshShape(mesh, true, false);
+            shape->setOptimizedBvh(bvh);
+            shape->mBvhBuffer = buffer;
+            return shape;
+        }
+
+        std::cerr << "Ignoring damaged shape cache " << file.string() << std::endl;
+        btAlignedFree(buffer);
+    }
+
+    TriangleMeshShape *shape = new TriangleMeshShape(mesh, true);
+    writeBvh(file, key, *shape->getOptimizedBvh());
+    return shape;
+}
+
 void ManualBulletShapeLoader::load(const std::string &name,const std::string &group)
 {
     // Check if the resource already exists
@@ -26,6 +26,7 @@
 
 #include <cassert>
 #include <string>
+#include <boost/filesystem/path.hpp>
 #include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
 #include <BulletCollision/CollisionShapes/btConvexTriangleMeshShape.h>
 #include <btBulletDynamicsCommon.h>
@@ -50,10 +51,13 @@ namespace NifBullet
 class ManualBulletShapeLoader : public OEngine::Physic::BulletShapeLoader
 {
 public:
-    ManualBulletShapeLoader()
+    /// \param cacheDir Directory for the BVHs of triangle mesh shapes. If empty, the BVHs are
+    /// built every time a mesh is loaded.
+    ManualBulletShapeLoader(const boost::filesystem::path &cacheDir = boost::filesystem::path())
       : mShape(NULL)
       , mBoundingBox(NULL)
       , mHasShape(false)
+      , mCacheDir(cacheDir)
     {
     }
 
@@ -100,12 +104,19 @@ private:
     */
     void handleNiTriShape(btTriangleMesh* mesh, const Nif::NiTriShape *shape, int flags, const Ogre::Matrix4 &transform, bool raycasting);
 
+    /**
+    *Create a triangle mesh shape that takes ownership of \a mesh. Its BVH is read from the cache if possible.
+    */
+    btCollisionShape *createMeshShape(btTriangleMesh *mesh, bool raycasting);
+
     std::string mResourceName;
 
     OEngine::Physic::BulletShape* mShape;//current shape
     btBoxShape *mBoundingBox;
 
     bool mHasShape;
+
+    boost::filesystem::path mCacheDir;
 };
 
 }
@@ -91,6 +91,7 @@ int main()
 
         //Ressources stuff
         Bsa::addBSA("Morrowind.bsa");
+        Bsa::registerResources();
         //Ogre::ResourceGroupManager::getSingleton().createResourceGroup("general");
 
         Ogre::ResourcePtr ptr = BulletShapeManager::getSingleton().getByName(mesh,"General");
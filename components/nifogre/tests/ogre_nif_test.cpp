@@ -14,6 +14,7 @@ void C::doTest()
 {
   // Add Morrowind.bsa resource location
   Bsa::addBSA("../../data/Morrowind.bsa");
+  Bsa::registerResources();
 
   // Insert the mesh
   NifOgre::NIFLoader::load(mesh);
@@ -9,13 +9,44 @@
 #include "BtOgrePG.h"
 #include "BtOgreGP.h"
 #include "BtOgreExtras.h"
+#include "trace.h"
+
+#include <stdexcept>
 
 #include <boost/lexical_cast.hpp>
-#include <boost/format.hpp>
 
 namespace OEngine {
 namespace Physic
 {
+    namespace
+    {
+        /// Return an instance of the shared \a shape with the given scale. The BVH of a triangle mesh
+        /// is shared with the instance, so scaled objects don't build one of their own.
+        btCollisionShape* createScaledShape(btCollisionShape* shape, float scale)
+        {
+            switch (shape->getShapeType())
+            {
+                case TRIANGLE_MESH_SHAPE_PROXYTYPE:
+
+                    return new btScaledBvhTriangleMeshShape(static_cast<btBvhTriangleMeshShape*>(shape),
+                        btVector3(scale,scale,scale));
+
+                case BOX_SHAPE_PROXYTYPE:
+                {
+                    // boxes are cheap to copy, and actors expect a btBoxShape
+                    btBoxShape* box = new btBoxShape(static_cast<btBoxShape*>(shape)->getHalfExtentsWithMargin());
+                    box->setLocalScaling(btVector3(scale,scale,scale));
+                    return box;
+                }
+
+                default:
+
+                    throw std::logic_error("can't scale collision shape of type " +
+                        boost::lexical_cast<std::string>(shape->getShapeType()));
+            }
+        }
+    }
+
 
     PhysicActor::PhysicActor(const std::string &name, const std::string &mesh, PhysicEngine *engine, const Ogre::Vector3 &position, const Ogre::Quaternion &rotation, float scale)
       : mName(name), mEngine(engine), mMesh(mesh), mBoxScaledTranslation(0,0,0), mBoxRotationInverse(0,0,0,0)
@@ -62,6 +93,15 @@ namespace Physic
         }
     }
 
+    void PhysicActor::updateAabbs()
+    {
+        // bodies that are not in the world (e.g. with collisions disabled) have no broadphase proxy
+        if(mBody && mBody->getBroadphaseHandle())
+            mEngine->dynamicsWorld->updateSingleAabb(mBody);
+        if(mRaycastingBody && mRaycastingBody->getBroadphaseHandle())
+            mEngine->dynamicsWorld->updateSingleAabb(mRaycastingBody);
+    }
+
     void PhysicActor::setRotation(const Ogre::Quaternion &quat)
     {
         assert(mBody);
@@ -148,16 +188,21 @@ namespace Physic
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-    RigidBody::RigidBody(btRigidBody::btRigidBodyConstructionInfo& CI,std::string name)
+    RigidBody::RigidBody(btRigidBody::btRigidBodyConstructionInfo& CI,std::string name, PhysicEngine *engine)
         : btRigidBody(CI)
         , mName(name)
         , mPlaceable(false)
+        , mObjectId(engine->acquireObjectId(name))
+        , mScaledShape(0)
+        , mEngine(engine)
     {
     }
 
     RigidBody::~RigidBody()
     {
+        mEngine->releaseObjectId(mObjectId);
         delete getMotionState();
+        delete mScaledShape;
     }
 
 
@@ -243,37 +288,27 @@ namespace Physic
             delete hf_it->second.mBody;
         }
 
-        RigidBodyContainer::iterator rb_it = mCollisionObjectMap.begin();
-        for (; rb_it != mCollisionObjectMap.end(); ++rb_it)
+        for (std::size_t id = 0; id < mObjects.size(); ++id)
         {
-            if (rb_it->second != NULL)
-            {
-                dynamicsWorld->removeRigidBody(rb_it->second);
+            ObjectSlot &slot = mObjects[id];
 
-                delete rb_it->second;
-                rb_it->second = NULL;
-            }
-        }
-        rb_it = mRaycastingObjectMap.begin();
-        for (; rb_it != mRaycastingObjectMap.end(); ++rb_it)
-        {
-            if (rb_it->second != NULL)
-            {
-                dynamicsWorld->removeRigidBody(rb_it->second);
+            RigidBody* body = slot.mCollisionBody;
+            RigidBody* raycastingBody = slot.mRaycastingBody;
+            PhysicActor* actor = slot.mActor;
+            slot.mCollisionBody = slot.mRaycastingBody = 0;
+            slot.mActor = 0;
 
-                delete rb_it->second;
-                rb_it->second = NULL;
+            if (body != NULL)
+            {
+                dynamicsWorld->removeRigidBody(body);
+                delete body;
             }
-        }
-
-        PhysicActorContainer::iterator pa_it = mActorMap.begin();
-        for (; pa_it != mActorMap.end(); ++pa_it)
-        {
-            if (pa_it->second != NULL)
+            if (raycastingBody != NULL)
             {
-                delete pa_it->second;
-                pa_it->second = NULL;
+                dynamicsWorld->removeRigidBody(raycastingBody);
+                delete raycastingBody;
             }
+            delete actor;
         }
 
         delete mDebugDrawer;
@@ -321,14 +356,14 @@ namespace Physic
         CMotionState* newMotionState = new CMotionState(this,name);
 
         btRigidBody::btRigidBodyConstructionInfo CI = btRigidBody::btRigidBodyConstructionInfo(0,newMotionState,hfShape);
-        RigidBody* body = new RigidBody(CI,name);
+        RigidBody* body = new RigidBody(CI,name,this);
         body->getWorldTransform().setOrigin(btVector3( (x+0.5)*triSize*(sqrtVerts-1), (y+0.5)*triSize*(sqrtVerts-1), (maxh+minh)/2.f));
 
         HeightField hf;
         hf.mBody = body;
         hf.mShape = hfShape;
 
-        mHeightFieldMap [name] = hf;
+        mHeightFieldMap [std::make_pair(x, y)] = hf;
 
         dynamicsWorld->addRigidBody(body,CollisionType_HeightMap|CollisionType_Raycasting,
                                     CollisionType_World|CollisionType_Actor|CollisionType_Raycasting);
@@ -336,17 +371,16 @@ namespace Physic
 
     void PhysicEngine::removeHeightField(int x, int y)
     {
-        const std::string name = "HeightField_"
-            + boost::lexical_cast<std::string>(x) + "_"
-            + boost::lexical_cast<std::string>(y);
+        HeightFieldContainer::iterator it = mHeightFieldMap.find(std::make_pair(x, y));
+        if (it == mHeightFieldMap.end())
+            return;
 
-        HeightField hf = mHeightFieldMap [name];
+        HeightField hf = it->second;
+        mHeightFieldMap.erase(it);
 
         dynamicsWorld->removeRigidBody(hf.mBody);
         delete hf.mShape;
         delete hf.mBody;
-
-        mHeightFieldMap.erase(name);
     }
 
     void PhysicEngine::adjustRigidBody(RigidBody* body, const Ogre::Vector3 &position, const Ogre::Quaternion &rotation,
@@ -364,14 +398,7 @@ namespace Physic
     void PhysicEngine::boxAdjustExternal(const std::string &mesh, RigidBody* body,
         float scale, const Ogre::Vector3 &position, const Ogre::Quaternion &rotation)
     {
-        std::string sid = (boost::format("%07.3f") % scale).str();
-        std::string outputstring = mesh + sid;
-        //std::cout << "The string" << outputstring << "\n";
-
-        //get the shape from the .nif
-        mShapeLoader->load(outputstring,"General");
-        BulletShapeManager::getSingletonPtr()->load(outputstring,"General");
-        BulletShapePtr shape = BulletShapeManager::getSingleton().getByName(outputstring,"General");
+        BulletShapePtr shape = loadShape(mesh);
 
         adjustRigidBody(body, position, rotation, shape->mBoxTranslation * scale, shape->mBoxRotation);
     }
@@ -380,13 +407,7 @@ namespace Physic
         float scale, const Ogre::Vector3 &position, const Ogre::Quaternion &rotation,
         Ogre::Vector3* scaledBoxTranslation, Ogre::Quaternion* boxRotation, bool raycasting, bool placeable)
     {
-        std::string sid = (boost::format("%07.3f") % scale).str();
-        std::string outputstring = mesh + sid;
-
-        //get the shape from the .nif
-        mShapeLoader->load(outputstring,"General");
-        BulletShapeManager::getSingletonPtr()->load(outputstring,"General");
-        BulletShapePtr shape = BulletShapeManager::getSingleton().getByName(outputstring,"General");
+        BulletShapePtr shape = loadShape(mesh);
 
         if (placeable && !raycasting && shape->mCollisionShape && !shape->mHasCollisionNode)
             return NULL;
@@ -396,19 +417,21 @@ namespace Physic
         if (!shape->mRaycastingShape && raycasting)
             return NULL;
 
-        if (!raycasting)
-            shape->mCollisionShape->setLocalScaling( btVector3(scale,scale,scale));
-        else
-            shape->mRaycastingShape->setLocalScaling( btVector3(scale,scale,scale));
+        // the shared shape is left unscaled
+        btCollisionShape* collisionShape = raycasting ? shape->mRaycastingShape : shape->mCollisionShape;
+        btCollisionShape* scaledShape = 0;
+        if (scale != 1.0f)
+            collisionShape = scaledShape = createScaledShape(collisionShape, scale);
 
         //create the motionState
         CMotionState* newMotionState = new CMotionState(this,name);
 
         //create the real body
         btRigidBody::btRigidBodyConstructionInfo CI = btRigidBody::btRigidBodyConstructionInfo
-                (0,newMotionState, raycasting ? shape->mRaycastingShape : shape->mCollisionShape);
-        RigidBody* body = new RigidBody(CI,name);
+                (0,newMotionState, collisionShape);
+        RigidBody* body = new RigidBody(CI,name,this);
         body->mPlaceable = placeable;
+        body->mScaledShape = scaledShape;
 
         if(scaledBoxTranslation != 0)
             *scaledBoxTranslation = shape->mBoxTranslation * scale;
@@ -440,74 +463,54 @@ namespace Physic
             removeRigidBody(name);
             deleteRigidBody(name);
 
+            // the new bodies hold the id of the object, so it survives the deletion of the old ones
+            ObjectSlot &slot = mObjects[body ? body->mObjectId : raycastingBody->mObjectId];
             if (body)
-                mCollisionObjectMap[name] = body;
+                slot.mCollisionBody = body;
             if (raycastingBody)
-                mRaycastingObjectMap[name] = raycastingBody;
+                slot.mRaycastingBody = raycastingBody;
         }
     }
 
     void PhysicEngine::removeRigidBody(const std::string &name)
     {
-        RigidBodyContainer::iterator it = mCollisionObjectMap.find(name);
-        if (it != mCollisionObjectMap.end() )
-        {
-            RigidBody* body = it->second;
-            if(body != NULL)
-            {
-                dynamicsWorld->removeRigidBody(body);
-            }
-        }
-        it = mRaycastingObjectMap.find(name);
-        if (it != mRaycastingObjectMap.end() )
-        {
-            RigidBody* body = it->second;
-            if(body != NULL)
-            {
-                dynamicsWorld->removeRigidBody(body);
-            }
-        }
+        int id = getObjectId(name);
+        if (id == -1)
+            return;
+
+        const ObjectSlot &slot = mObjects[id];
+        if (slot.mCollisionBody != NULL)
+            dynamicsWorld->removeRigidBody(slot.mCollisionBody);
+        if (slot.mRaycastingBody != NULL)
+            dynamicsWorld->removeRigidBody(slot.mRaycastingBody);
     }
 
     void PhysicEngine::deleteRigidBody(const std::string &name)
     {
-        RigidBodyContainer::iterator it = mCollisionObjectMap.find(name);
-        if (it != mCollisionObjectMap.end() )
-        {
-            RigidBody* body = it->second;
+        int id = getObjectId(name);
+        if (id == -1)
+            return;
 
-            if(body != NULL)
-            {
-                delete body;
-            }
-            mCollisionObjectMap.erase(it);
-        }
-        it = mRaycastingObjectMap.find(name);
-        if (it != mRaycastingObjectMap.end() )
-        {
-            RigidBody* body = it->second;
+        // deleting the last body frees the slot
+        ObjectSlot &slot = mObjects[id];
+        RigidBody* body = slot.mCollisionBody;
+        RigidBody* raycastingBody = slot.mRaycastingBody;
+        slot.mCollisionBody = slot.mRaycastingBody = 0;
 
-            if(body != NULL)
-            {
-                delete body;
-            }
-            mRaycastingObjectMap.erase(it);
-        }
+        delete body;
+        delete raycastingBody;
     }
 
     RigidBody* PhysicEngine::getRigidBody(const std::string &name, bool raycasting)
     {
-        RigidBodyContainer* map = raycasting ? &mRaycastingObjectMap : &mCollisionObjectMap;
-        RigidBodyContainer::iterator it = map->find(name);
-        if (it != map->end() )
-        {
-            RigidBody* body = (*map)[name];
-            return body;
-        }
-        else
-        {
-            return NULL;
-        }
+        int id = getObjectId(name);
+        return id != -1 ? getRigidBody(id, raycasting) : NULL;
+    }
+
+    RigidBody* PhysicEngine::getRigidBody(int id, bool raycasting)
+    {
+        const ObjectSlot &slot = mObjects.at(id);
+        return raycasting ? slot.mRaycastingBody : slot.mCollisionBody;
     }
 
     class ContactTestResultCallback : public btCollisionWorld::ContactResultCallback
@@ -620,10 +623,10 @@ namespace Physic
     }
 
 
-    void PhysicEngine::stepSimulation(double deltaT)
+    void PhysicEngine::stepSimulation(double deltaT, int maxSubSteps, double fixedTimeStep)
     {
         // This seems to be needed for character controller objects
-        dynamicsWorld->stepSimulation(deltaT,10, 1/60.0);
+        dynamicsWorld->stepSimulation(deltaT, maxSubSteps, fixedTimeStep);
         if(isDebugCreated)
         {
             mDebugDrawer->step();
@@ -641,36 +644,80 @@ namespace Physic
 
 
         //dynamicsWorld->addAction( newActor->mCharacter );
-        mActorMap[name] = newActor;
+        mObjects[acquireObjectId(name)].mActor = newActor;
     }
 
     void PhysicEngine::removeCharacter(const std::string &name)
     {
-        PhysicActorContainer::iterator it = mActorMap.find(name);
-        if (it != mActorMap.end() )
-        {
-            PhysicActor* act = it->second;
-            if(act != NULL)
-            {
+        int id = getObjectId(name);
+        if (id == -1 || !mObjects[id].mActor)
+            return;
 
-                delete act;
-            }
-            mActorMap.erase(it);
-        }
+        PhysicActor* act = mObjects[id].mActor;
+        mObjects[id].mActor = 0;
+        delete act;
+
+        releaseObjectId(id);
     }
 
-    PhysicActor* PhysicEngine::getCharacter(const std::string &name)
+    int PhysicEngine::getObjectId(const std::string &name) const
+    {
+        ObjectIdContainer::const_iterator it = mObjectIds.find(name);
+        return it != mObjectIds.end() ? it->second : -1;
+    }
+
+    const std::string &PhysicEngine::getObjectName(int id) const
+    {
+        return mObjects.at(id).mName;
+    }
+
+    int PhysicEngine::acquireObjectId(const std::string &name)
     {
-        PhysicActorContainer::iterator it = mActorMap.find(name);
-        if (it != mActorMap.end() )
+        ObjectIdContainer::iterator it = mObjectIds.find(name);
+        if (it != mObjectIds.end())
         {
-            PhysicActor* act = mActorMap[name];
-            return act;
+            ++mObjects[it->second].mRefs;
+            return it->second;
+        }
+
+        int id;
+        if (!mFreeObjectIds.empty())
+        {
+            id = mFreeObjectIds.back();
+            mFreeObjectIds.pop_back();
         }
         else
         {
-            return 0;
+            id = static_cast<int>(mObjects.size());
+            mObjects.push_back(ObjectSlot());
         }
+
+        mObjects[id].mName = name;
+        mObjects[id].mRefs = 1;
+        mObjectIds[name] = id;
+        return id;
+    }
+
+    void PhysicEngine::releaseObjectId(int id)
+    {
+        ObjectSlot &slot = mObjects[id];
+        if (--slot.mRefs > 0)
+            return;
+
+        mObjectIds.erase(slot.mName);
+        slot.mName.clear();
+        mFreeObjectIds.push_back(id);
+    }
+
+    PhysicActor* PhysicEngine::getCharacter(const std::string &name)
+    {
+        int id = getObjectId(name);
+        return id != -1 ? getCharacter(id) : 0;
+    }
+
+    PhysicActor* PhysicEngine::getCharacter(int id)
+    {
+        return mObjects.at(id).mActor;
     }
 
     void PhysicEngine::emptyEventLists(void)
@@ -757,13 +804,7 @@ namespace Physic
 
     void PhysicEngine::getObjectAABB(const std::string &mesh, float scale, btVector3 &min, btVector3 &max)
     {
-        std::string sid = (boost::format("%07.3f") % scale).str();
-        std::string outputstring = mesh + sid;
-
-        mShapeLoader->load(outputstring, "General");
-        BulletShapeManager::getSingletonPtr()->load(outputstring, "General");
-        BulletShapePtr shape =
-            BulletShapeManager::getSingleton().getByName(outputstring, "General");
+        BulletShapePtr shape = loadShape(mesh);
 
         btTransform trans;
         trans.setIdentity();
@@ -777,21 +818,42 @@ namespace Physic
             min = btVector3(0,0,0);
             max = btVector3(0,0,0);
         }
+
+        min *= scale;
+        max *= scale;
+    }
+
+    BulletShapePtr PhysicEngine::loadShape(const std::string &mesh)
+    {
+        //get the shape from the .nif
+        mShapeLoader->load(mesh,"General");
+        BulletShapeManager::getSingletonPtr()->load(mesh,"General");
+        return BulletShapeManager::getSingleton().getByName(mesh,"General");
     }
 
     bool PhysicEngine::isAnyActorStandingOn (const std::string& objectName)
     {
-        for (PhysicActorContainer::iterator it = mActorMap.begin(); it != mActorMap.end(); ++it)
+        int id = getObjectId(objectName);
+        if (id == -1)
+            return false;
+
+        // one ray down from every actor on the ground, all traced in one go
+        RayBatch batch;
+        for (std::vector<ObjectSlot>::const_iterator it = mObjects.begin(); it != mObjects.end(); ++it)
         {
-            if (!it->second->getOnGround())
+            if (!it->mActor || !it->mActor->getOnGround())
                 continue;
-            Ogre::Vector3 pos = it->second->getPosition();
+            Ogre::Vector3 pos = it->mActor->getPosition();
             btVector3 from (pos.x, pos.y, pos.z);
             btVector3 to = from - btVector3(0,0,5);
-            std::pair<std::string, float> result = rayTest(from, to);
-            if (result.first == objectName)
-                return true;
+            batch.add(RayQuery(from, to, CollisionType_Raycasting|CollisionType_HeightMap));
         }
+
+        batch.run(*this);
+
+        for (std::size_t i = 0; i < batch.size(); ++i)
+            if (batch.getHit(i).mObject == id)
+                return true;
         return false;
     }
 
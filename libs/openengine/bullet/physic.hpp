@@ -1,11 +1,20 @@
 #ifndef OENGINE_BULLET_PHYSIC_H
 #define OENGINE_BULLET_PHYSIC_H
 
+#ifdef _WIN32
+#include <boost/tr1/tr1/unordered_map>
+#elif defined HAVE_UNORDERED_MAP
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
 #include <BulletDynamics/Dynamics/btRigidBody.h>
 #include "BulletCollision/CollisionDispatch/btGhostObject.h"
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include "BulletShapeLoader.h"
 #include "BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h"
 
@@ -74,10 +83,20 @@ namespace Physic
     class RigidBody: public btRigidBody
     {
     public:
-        RigidBody(btRigidBody::btRigidBodyConstructionInfo& CI,std::string name);
+        RigidBody(btRigidBody::btRigidBodyConstructionInfo& CI,std::string name, PhysicEngine *engine);
         virtual ~RigidBody();
         std::string mName;
         bool mPlaceable;
+
+        /// Compact id of the object, shared by all its bodies. See PhysicEngine::getObjectId().
+        int mObjectId;
+
+        /// Scaled instance of the mesh's shared shape, deleted with the body. 0 if the body uses the
+        /// shared shape directly.
+        btCollisionShape* mScaledShape;
+
+    private:
+        PhysicEngine *mEngine;
     };
 
     /**
@@ -93,6 +112,12 @@ namespace Physic
 
         void setPosition(const Ogre::Vector3 &pos);
 
+        /**
+         * Updates the bounding boxes of the actor's bodies in the broadphase, so that queries see
+         * the actor where it has been moved to without updating the AABBs of the whole world.
+         */
+        void updateAabbs();
+
         /**
          * This adjusts the rotation of a PhysicActor
          * If we have any problems with this (getting stuck in pmove) we should change it 
@@ -261,6 +286,11 @@ public:
          */
         RigidBody* getRigidBody(const std::string &name, bool raycasting=false);
 
+        /**
+         * Return a pointer to the rigid body of the object with the compact id \a id.
+         */
+        RigidBody* getRigidBody(int id, bool raycasting=false);
+
         /**
          * Create and add a character to the scene, and add it to the ActorMap.
          */
@@ -278,10 +308,15 @@ public:
          */
         PhysicActor* getCharacter(const std::string &name);
 
+        /**
+         * Return a pointer to the character with the compact id \a id, or 0 if the object is no character.
+         */
+        PhysicActor* getCharacter(int id);
+
         /**
          * This step the simulation of a given time.
          */
-        void stepSimulation(double deltaT);
+        void stepSimulation(double deltaT, int maxSubSteps = 10, double fixedTimeStep = 1/60.0);
 
         /**
          * Empty events lists
@@ -323,6 +358,18 @@ public:
 
         std::vector<std::string> getCollisions(const std::string& name);
 
+        /**
+         * Return the compact id of the object \a name, or -1 if it has no bodies.
+         * Ray queries report the objects they hit by these ids. The id of an object is only valid
+         * as long as it has bodies; it is reused afterwards.
+         */
+        int getObjectId(const std::string &name) const;
+
+        /**
+         * Return the name of the object with the compact id \a id.
+         */
+        const std::string &getObjectName(int id) const;
+
         // Get the nearest object that's inside the given object, filtering out objects of the
         // provided name
         std::pair<const RigidBody*,btVector3> getFilteredContact(const std::string &filter,
@@ -346,16 +393,32 @@ public:
         //the NIF file loader.
         BulletShapeLoader* mShapeLoader;
 
-        typedef std::map<std::string, HeightField> HeightFieldContainer;
-        HeightFieldContainer mHeightFieldMap;
+        typedef std::map<std::pair<int, int>, HeightField> HeightFieldContainer;
+        HeightFieldContainer mHeightFieldMap; // by cell grid position
 
-        typedef std::map<std::string,RigidBody*> RigidBodyContainer;
-        RigidBodyContainer mCollisionObjectMap;
+        /**
+         * The rigid bodies and the character of an object, by its compact id.
+         */
+        struct ObjectSlot
+        {
+            std::string mName;
+            int mRefs; // bodies and characters of the object, 0 if the id is free
+            RigidBody* mCollisionBody;
+            RigidBody* mRaycastingBody;
+            PhysicActor* mActor;
+
+            ObjectSlot() : mRefs(0), mCollisionBody(0), mRaycastingBody(0), mActor(0) {}
+        };
 
-        RigidBodyContainer mRaycastingObjectMap;
+        std::vector<ObjectSlot> mObjects; // by object id
 
-        typedef std::map<std::string, PhysicActor*>  PhysicActorContainer;
-        PhysicActorContainer mActorMap;
+#if defined HAVE_UNORDERED_MAP
+        typedef std::unordered_map<std::string, int> ObjectIdContainer;
+#else
+        typedef std::tr1::unordered_map<std::string, int> ObjectIdContainer;
+#endif
+        ObjectIdContainer mObjectIds;
+        std::vector<int> mFreeObjectIds;
 
         Ogre::SceneManager* mSceneMgr;
 
@@ -363,6 +426,15 @@ public:
         BtOgre::DebugDrawer* mDebugDrawer;
         bool isDebugCreated;
         bool mDebugActive;
+
+    private:
+        friend class RigidBody;
+
+        int acquireObjectId(const std::string &name);
+        void releaseObjectId(int id);
+
+        /// Load the unscaled shape of \a mesh, which is shared by all bodies using the mesh.
+        BulletShapePtr loadShape(const std::string &mesh);
     };
 
 
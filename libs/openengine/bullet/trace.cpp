@@ -2,9 +2,17 @@
 #include "trace.h"
 
 #include <map>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/shared_ptr.hpp>
 
 #include <btBulletDynamicsCommon.h>
 #include <btBulletCollisionCommon.h>
+#include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <LinearMath/btTransformUtil.h>
+
+#include <components/misc/workqueue.hpp>
 
 #include "physic.hpp"
 
@@ -53,6 +61,144 @@ protected:
 };
 
 
+/// Passes the objects in the broadphase tree, whose bounds overlap the sweep, to the narrowphase
+class SweepCollider : public btDbvt::ICollide
+{
+public:
+    SweepCollider(const btConvexShape *shape, const btTransform &from, const btTransform &to,
+                  btScalar allowedPenetration, btCollisionWorld::ConvexResultCallback &callback)
+      : mShape(shape), mFrom(from), mTo(to), mAllowedPenetration(allowedPenetration), mCallback(callback)
+    {
+    }
+
+    void Process(const btDbvtNode *leaf)
+    {
+        if(mCallback.m_closestHitFraction == btScalar(0.0))
+            return;
+
+        btBroadphaseProxy *proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+        btCollisionObject *object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+
+        if(mCallback.needsCollision(object->getBroadphaseHandle()))
+            btCollisionWorld::objectQuerySingle(mShape, mFrom, mTo, object, object->getCollisionShape(),
+                                                object->getWorldTransform(), mCallback, mAllowedPenetration);
+    }
+
+private:
+    const btConvexShape *mShape;
+    const btTransform &mFrom;
+    const btTransform &mTo;
+    btScalar mAllowedPenetration;
+    btCollisionWorld::ConvexResultCallback &mCallback;
+};
+
+
+/// Passes the objects in the broadphase tree, whose bounds are crossed by a ray, to the narrowphase
+class RayCollider : public btDbvt::ICollide
+{
+public:
+    RayCollider(const btTransform &from, const btTransform &to, btCollisionWorld::RayResultCallback &callback)
+      : mFrom(from), mTo(to), mCallback(callback)
+    {
+    }
+
+    void Process(const btDbvtNode *leaf)
+    {
+        if(mCallback.m_closestHitFraction == btScalar(0.0))
+            return;
+
+        btBroadphaseProxy *proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+        btCollisionObject *object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+
+        if(mCallback.needsCollision(object->getBroadphaseHandle()))
+            btCollisionWorld::rayTestSingle(mFrom, mTo, object, object->getCollisionShape(),
+                                            object->getWorldTransform(), mCallback);
+    }
+
+private:
+    const btTransform &mFrom;
+    const btTransform &mTo;
+    btCollisionWorld::RayResultCallback &mCallback;
+};
+
+
+/// Skips the bodies of one object
+template<typename Callback>
+class NotObjectCallback : public Callback
+{
+public:
+    NotObjectCallback(const btVector3 &from, const btVector3 &to, int ignore)
+      : Callback(from, to), mIgnore(ignore)
+    {
+    }
+
+    virtual bool needsCollision(btBroadphaseProxy *proxy) const
+    {
+        const btCollisionObject *object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+        if(mIgnore != -1 && static_cast<const RigidBody*>(object)->mObjectId == mIgnore)
+            return false;
+        return Callback::needsCollision(proxy);
+    }
+
+private:
+    int mIgnore;
+};
+
+
+static void convexSweepTest(const PhysicEngine *engine, const btConvexShape *shape, const btTransform &from,
+                            const btTransform &to, btCollisionWorld::ConvexResultCallback &callback,
+                            bool concurrent)
+{
+    if(!concurrent)
+    {
+        engine->dynamicsWorld->convexSweepTest(shape, from, to, callback);
+        return;
+    }
+
+    // The bounds of the whole sweep, as in btCollisionWorld::convexSweepTest. btDbvt::collideTV
+    // keeps its traversal stack on the stack of the calling thread.
+    btVector3 linVel, angVel;
+    btTransformUtil::calculateVelocity(from, to, 1.0f, linVel, angVel);
+    btTransform rotation(from.getBasis(), btVector3(0.0f, 0.0f, 0.0f));
+    btVector3 aabbMin, aabbMax;
+    shape->calculateTemporalAabb(rotation, linVel, angVel, 1.0f, aabbMin, aabbMax);
+    aabbMin += from.getOrigin();
+    aabbMax += from.getOrigin();
+
+    const btDbvtVolume volume = btDbvtVolume::FromMM(aabbMin, aabbMax);
+    SweepCollider collider(shape, from, to,
+                           engine->dynamicsWorld->getDispatchInfo().m_allowedCcdPenetration, callback);
+
+    btDbvtBroadphase *broadphase = static_cast<btDbvtBroadphase*>(engine->broadphase);
+    for(int i = 0;i < 2;++i)
+        broadphase->m_sets[i].collideTV(broadphase->m_sets[i].m_root, volume, collider);
+}
+
+
+static void rayTest(const PhysicEngine *engine, const btVector3 &from, const btVector3 &to,
+                    btCollisionWorld::RayResultCallback &callback)
+{
+    // btDbvt::rayTest keeps its traversal stack on the stack of the calling thread, unlike
+    // btDbvtBroadphase::rayTest.
+    btTransform fromTrans, toTrans;
+    fromTrans.setIdentity();
+    fromTrans.setOrigin(from);
+    toTrans.setIdentity();
+    toTrans.setOrigin(to);
+
+    RayCollider collider(fromTrans, toTrans, callback);
+
+    btDbvtBroadphase *broadphase = static_cast<btDbvtBroadphase*>(engine->broadphase);
+    for(int i = 0;i < 2;++i)
+        btDbvt::rayTest(broadphase->m_sets[i].m_root, from, to, collider);
+}
+
+
+ActorTracer::ActorTracer(bool concurrent)
+  : mFraction(1.0f), mConcurrent(concurrent)
+{
+}
+
 void ActorTracer::doTrace(btCollisionObject *actor, const Ogre::Vector3 &start, const Ogre::Vector3 &end, const PhysicEngine *enginePass)
 {
     const btVector3 btstart(start.x, start.y, start.z);
@@ -70,8 +216,8 @@ void ActorTracer::doTrace(btCollisionObject *actor, const Ogre::Vector3 &start,
 
     btCollisionShape *shape = actor->getCollisionShape();
     assert(shape->isConvex());
-    enginePass->dynamicsWorld->convexSweepTest(static_cast<btConvexShape*>(shape),
-                                               from, to, newTraceCallback);
+    convexSweepTest(enginePass, static_cast<btConvexShape*>(shape), from, to, newTraceCallback,
+                    mConcurrent);
 
     // Copy the hit data over to our trace results struct:
     if(newTraceCallback.hasHit())
@@ -109,7 +255,7 @@ void ActorTracer::findGround(btCollisionObject *actor, const Ogre::Vector3 &star
     halfExtents[2] = 1.0f;
     btBoxShape box(halfExtents);
 
-    enginePass->dynamicsWorld->convexSweepTest(&box, from, to, newTraceCallback);
+    convexSweepTest(enginePass, &box, from, to, newTraceCallback, mConcurrent);
     if(newTraceCallback.hasHit())
     {
         const btVector3& tracehitnormal = newTraceCallback.m_hitNormalWorld;
@@ -126,5 +272,157 @@ void ActorTracer::findGround(btCollisionObject *actor, const Ogre::Vector3 &star
     }
 }
 
+
+RayQuery::RayQuery(const btVector3 &from, const btVector3 &to, int filter, float radius, int ignore)
+  : mFrom(from), mTo(to), mFilter(filter), mRadius(radius), mIgnore(ignore)
+{
+}
+
+
+// Queries per thread at least. Handing fewer to a thread costs more than it saves.
+static const std::size_t sMinQueriesPerJob = 16;
+
+class RayBatch::Job : public Misc::WorkItem
+{
+public:
+    Job(RayBatch &batch, const PhysicEngine &engine, std::size_t begin, std::size_t end)
+      : mBatch(batch), mEngine(engine), mBegin(begin), mEnd(end)
+    {
+    }
+
+protected:
+    virtual void doWork()
+    {
+        mBatch.trace(mEngine, mBegin, mEnd);
+    }
+
+private:
+    RayBatch &mBatch;
+    const PhysicEngine &mEngine;
+    std::size_t mBegin;
+    std::size_t mEnd;
+};
+
+std::size_t RayBatch::add(const RayQuery &query)
+{
+    mQueries.push_back(query);
+    return mQueries.size()-1;
+}
+
+void RayBatch::clear()
+{
+    mQueries.clear();
+    mHits.clear();
+}
+
+std::size_t RayBatch::size() const
+{
+    return mQueries.size();
+}
+
+const RayHit &RayBatch::getHit(std::size_t index) const
+{
+    return mHits.at(index);
+}
+
+void RayBatch::run(const PhysicEngine &engine, Misc::WorkQueue *threads)
+{
+    mHits.resize(mQueries.size());
+
+    std::size_t jobs = 1;
+    if(threads)
+        jobs = std::min(mQueries.size()/sMinQueriesPerJob, std::size_t(threads->getThreadCount()+1));
+
+    if(jobs < 2)
+    {
+        trace(engine, 0, mQueries.size());
+        return;
+    }
+
+    // The first share is traced on this thread, while the queue does the others.
+    std::vector<boost::shared_ptr<Job> > queued;
+    for(std::size_t i = 1;i < jobs;++i)
+    {
+        queued.push_back(boost::shared_ptr<Job>(new Job(*this, engine,
+            mQueries.size()*i/jobs, mQueries.size()*(i+1)/jobs)));
+        threads->addWorkItem(queued.back().get());
+    }
+
+    std::string error;
+    try
+    {
+        trace(engine, 0, mQueries.size()/jobs);
+    }
+    catch(const std::exception &e)
+    {
+        error = e.what();
+    }
+
+    // the jobs refer to this batch, so wait for all of them in any case
+    for(std::vector<boost::shared_ptr<Job> >::iterator iter(queued.begin());iter != queued.end();++iter)
+    {
+        (*iter)->waitTillDone();
+        if(error.empty())
+            error = (*iter)->getError();
+    }
+
+    if(!error.empty())
+        throw std::runtime_error("tracing rays failed: " + error);
+}
+
+void RayBatch::trace(const PhysicEngine &engine, std::size_t begin, std::size_t end)
+{
+    for(std::size_t i = begin;i < end;++i)
+    {
+        const RayQuery &query = mQueries[i];
+        RayHit &hit = mHits[i];
+
+        hit.mObject = -1;
+        hit.mFraction = 1.0f;
+        hit.mPoint = query.mTo;
+        hit.mNormal = btVector3(0.0f, 0.0f, 1.0f);
+
+        const btCollisionObject *object = 0;
+
+        if(query.mRadius == 0.0f)
+        {
+            NotObjectCallback<btCollisionWorld::ClosestRayResultCallback> callback(
+                query.mFrom, query.mTo, query.mIgnore);
+            callback.m_collisionFilterMask = query.mFilter;
+            rayTest(&engine, query.mFrom, query.mTo, callback);
+
+            if(callback.hasHit())
+            {
+                object = callback.m_collisionObject;
+                hit.mFraction = callback.m_closestHitFraction;
+                hit.mPoint = callback.m_hitPointWorld;
+                hit.mNormal = callback.m_hitNormalWorld;
+            }
+        }
+        else
+        {
+            NotObjectCallback<btCollisionWorld::ClosestConvexResultCallback> callback(
+                query.mFrom, query.mTo, query.mIgnore);
+            callback.m_collisionFilterMask = query.mFilter;
+
+            btSphereShape shape(query.mRadius);
+            const btQuaternion rotation(0.0f, 0.0f, 0.0f);
+            convexSweepTest(&engine, &shape, btTransform(rotation, query.mFrom),
+                            btTransform(rotation, query.mTo), callback, true);
+
+            if(callback.hasHit())
+            {
+                object = callback.m_hitCollisionObject;
+                hit.mFraction = callback.m_closestHitFraction;
+                hit.mPoint = callback.m_hitPointWorld;
+                hit.mNormal = callback.m_hitNormalWorld;
+            }
+        }
+
+        if(object)
+            hit.mObject = static_cast<const RigidBody*>(object)->mObjectId;
+    }
+}
+
 }
 }
@@ -1,11 +1,20 @@
 #ifndef OENGINE_BULLET_TRACE_H
 #define OENGINE_BULLET_TRACE_H
 
+#include <vector>
+
 #include <OgreVector3.h>
 
+#include <LinearMath/btVector3.h>
+
 
 class btCollisionObject;
 
+namespace Misc
+{
+    class WorkQueue;
+}
+
 
 namespace OEngine
 {
@@ -13,6 +22,10 @@ namespace Physic
 {
     class PhysicEngine;
 
+    /// Tracers with \a concurrent set only read the collision world: they neither use the
+    /// traversal stack of the broadphase nor the Bullet profiler, like
+    /// btCollisionWorld::convexSweepTest does. Several threads can trace at the same time, as
+    /// long as no object is added, removed or moved meanwhile.
     struct ActorTracer
     {
         Ogre::Vector3 mEndPos;
@@ -20,11 +33,66 @@ namespace Physic
 
         float mFraction;
 
+        bool mConcurrent;
+
+        ActorTracer(bool concurrent = false);
+
         void doTrace(btCollisionObject *actor, const Ogre::Vector3 &start, const Ogre::Vector3 &end,
                      const PhysicEngine *enginePass);
         void findGround(btCollisionObject *actor, const Ogre::Vector3 &start, const Ogre::Vector3 &end,
                         const PhysicEngine *enginePass);
     };
+
+    /// A ray, or a sphere if \a mRadius is not 0, traced from \a mFrom to \a mTo
+    struct RayQuery
+    {
+        btVector3 mFrom;
+        btVector3 mTo;
+        int mFilter; ///< CollisionType mask of the objects that can be hit
+        float mRadius;
+        int mIgnore; ///< Object id that is never hit, -1 for none
+
+        RayQuery(const btVector3 &from, const btVector3 &to, int filter, float radius = 0.0f,
+                 int ignore = -1);
+    };
+
+    /// The closest object hit by a RayQuery
+    struct RayHit
+    {
+        int mObject; ///< Object id (see PhysicEngine::getObjectId()), -1 if nothing was hit
+        float mFraction; ///< Of the way from \a mFrom to \a mTo, 1 if nothing was hit
+        btVector3 mPoint;
+        btVector3 mNormal;
+    };
+
+    /// Ray and sphere queries that are traced together, so that the queries of a whole frame can
+    /// be spread over several threads. Like concurrent ActorTracers, the queries only read the
+    /// collision world.
+    class RayBatch
+    {
+    public:
+        /// \return Index of the query
+        std::size_t add(const RayQuery &query);
+
+        void clear();
+
+        std::size_t size() const;
+
+        /// Trace all queries. If \a threads is not 0 and there are enough queries, some of them
+        /// are traced on its threads, while the calling thread traces the rest.
+        void run(const PhysicEngine &engine, Misc::WorkQueue *threads = 0);
+
+        /// Result of the query \a index, valid after run().
+        const RayHit &getHit(std::size_t index) const;
+
+    private:
+        class Job;
+
+        void trace(const PhysicEngine &engine, std::size_t begin, std::size_t end);
+
+        std::vector<RayQuery> mQueries;
+        std::vector<RayHit> mHits;
+    };
 }
 }
 